@@ -0,0 +1,2971 @@
+#include "Benchmarks.h"
+#include "BindingSlots.h"
+#include "BufferStructs.h"
+#include "Camera.h"
+#include "ConstantBufferRing.h"
+#include "DrawList.h"
+#include "EntityStore.h"
+#include "FrustumCulling.h"
+#include "InstanceBatcher.h"
+#include "IndexPacking.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MeshBvh.h"
+#include "MeshData.h"
+#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ObjParser.h"
+#include "OcclusionCuller.h"
+#include "PackedVertex.h"
+#include "Picking.h"
+#include "RenderCommandList.h"
+#include "ResourcePool.h"
+#include "SceneBvh.h"
+#include "StateObjectCache.h"
+#include "Transform.h"
+#include "TransformSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	double SecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+
+	// Finds every .obj file in a directory, sorted by name
+	std::vector<std::filesystem::path> FindObjFiles(const std::string& meshDirectory)
+	{
+		std::vector<std::filesystem::path> paths;
+		std::error_code error;
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(meshDirectory, error))
+		{
+			if (entry.is_regular_file() && entry.path().extension() == ".obj")
+				paths.push_back(entry.path());
+		}
+		std::sort(paths.begin(), paths.end());
+		return paths;
+	}
+
+	// Writes an OBJ file for a flat grid of quads, with uvs and normals
+	std::string GenerateGridObj(unsigned int gridSize)
+	{
+		std::string obj;
+		obj.reserve((size_t)(gridSize + 1) * (gridSize + 1) * 80 + (size_t)gridSize * gridSize * 60);
+
+		char line[128];
+		for (unsigned int y = 0; y <= gridSize; y++)
+		{
+			for (unsigned int x = 0; x <= gridSize; x++)
+			{
+				float u = (float)x / gridSize;
+				float v = (float)y / gridSize;
+				int length = snprintf(line, sizeof(line), "v %f 0.000000 %f\nvt %f %f\nvn 0.000000 1.000000 0.000000\n", u * 100.0f, v * 100.0f, u, v);
+				obj.append(line, length);
+			}
+		}
+
+		for (unsigned int y = 0; y < gridSize; y++)
+		{
+			for (unsigned int x = 0; x < gridSize; x++)
+			{
+				unsigned int i0 = y * (gridSize + 1) + x + 1;
+				unsigned int i1 = i0 + 1;
+				unsigned int i2 = i1 + gridSize + 1;
+				unsigned int i3 = i0 + gridSize + 1;
+				int length = snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", i0, i0, i0, i1, i1, i1, i2, i2, i2, i3, i3, i3);
+				obj.append(line, length);
+			}
+		}
+
+		return obj;
+	}
+
+	bool SameObjData(const ObjData& a, const ObjData& b)
+	{
+		return a.positions.size() == b.positions.size() &&
+			a.uvs.size() == b.uvs.size() &&
+			a.normals.size() == b.normals.size() &&
+			a.corners.size() == b.corners.size() &&
+			memcmp(a.positions.data(), b.positions.data(), a.positions.size() * sizeof(a.positions[0])) == 0 &&
+			memcmp(a.uvs.data(), b.uvs.data(), a.uvs.size() * sizeof(a.uvs[0])) == 0 &&
+			memcmp(a.normals.data(), b.normals.data(), a.normals.size() * sizeof(a.normals[0])) == 0 &&
+			memcmp(a.corners.data(), b.corners.data(), a.corners.size() * sizeof(a.corners[0])) == 0;
+	}
+
+	// Angle between two directions, in degrees
+	// - Returns 0 if either one is degenerate (nothing to compare)
+	float AngleBetweenDegrees(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		XMVECTOR va = XMLoadFloat3(&a);
+		XMVECTOR vb = XMLoadFloat3(&b);
+		float lengths = XMVectorGetX(XMVector3Length(va)) * XMVectorGetX(XMVector3Length(vb));
+		if (!(lengths > 1e-12f) || !std::isfinite(lengths))
+			return 0.0f;
+
+		// atan2 stays precise for tiny angles, where acos doesn't
+		float sine = XMVectorGetX(XMVector3Length(XMVector3Cross(va, vb)));
+		float cosine = XMVectorGetX(XMVector3Dot(va, vb));
+		return XMConvertToDegrees(atan2f(sine, cosine));
+	}
+
+	// Distance from a point to the closest point on a triangle
+	// - Real-Time Collision Detection (Ericson), section 5.1.5
+	float DistanceToTriangle(XMVECTOR p, XMVECTOR a, XMVECTOR b, XMVECTOR c)
+	{
+		XMVECTOR ab = XMVectorSubtract(b, a);
+		XMVECTOR ac = XMVectorSubtract(c, a);
+		XMVECTOR closest;
+
+		// In vertex region outside a?
+		XMVECTOR ap = XMVectorSubtract(p, a);
+		float d1 = XMVectorGetX(XMVector3Dot(ab, ap));
+		float d2 = XMVectorGetX(XMVector3Dot(ac, ap));
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			return XMVectorGetX(XMVector3Length(ap));
+
+		// In vertex region outside b?
+		XMVECTOR bp = XMVectorSubtract(p, b);
+		float d3 = XMVectorGetX(XMVector3Dot(ab, bp));
+		float d4 = XMVectorGetX(XMVector3Dot(ac, bp));
+		if (d3 >= 0.0f && d4 <= d3)
+			return XMVectorGetX(XMVector3Length(bp));
+
+		// In vertex region outside c?
+		XMVECTOR cp = XMVectorSubtract(p, c);
+		float d5 = XMVectorGetX(XMVector3Dot(ab, cp));
+		float d6 = XMVectorGetX(XMVector3Dot(ac, cp));
+		if (d6 >= 0.0f && d5 <= d6)
+			return XMVectorGetX(XMVector3Length(cp));
+
+		// In one of the edge regions, or inside the face?
+		float vc = d1 * d4 - d3 * d2;
+		float vb = d5 * d2 - d1 * d6;
+		float va = d3 * d6 - d5 * d4;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			closest = XMVectorAdd(a, XMVectorScale(ab, d1 / (d1 - d3)));
+		else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			closest = XMVectorAdd(a, XMVectorScale(ac, d2 / (d2 - d6)));
+		else if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+			closest = XMVectorAdd(b, XMVectorScale(XMVectorSubtract(c, b), (d4 - d3) / ((d4 - d3) + (d5 - d6))));
+		else
+		{
+			float denominator = 1.0f / (va + vb + vc);
+			closest = XMVectorAdd(a, XMVectorAdd(XMVectorScale(ab, vb * denominator), XMVectorScale(ac, vc * denominator)));
+		}
+
+		return XMVectorGetX(XMVector3Length(XMVectorSubtract(p, closest)));
+	}
+
+	// Everything Mesh does on the CPU when there's no cache: map, hash,
+	// parse, weld, tangents, optimize, build LODs and (optionally) write the cache
+	// - The final copy stands in for the upload done by CreateBuffer
+	void LoadThroughObj(const std::string& objPath, const std::string& cachePath, bool writeCache, MeshData& data, std::vector<char>& upload)
+	{
+		MappedFile obj(objPath.c_str());
+		unsigned long long sourceHash = MeshCache::HashBytes(obj.GetData(), obj.GetSize());
+		MeshLoader::LoadObj(obj.GetData(), obj.GetSize(), data, std::thread::hardware_concurrency());
+		MeshOptimizer::Optimize(data);
+		MeshSimplifier::BuildLods(data);
+		if (writeCache)
+			MeshCache::Write(cachePath, sourceHash, data);
+
+		size_t vertexBytes = data.vertices.size() * sizeof(Vertex);
+		size_t indexBytes = data.indices.size() * sizeof(unsigned int);
+		upload.resize(vertexBytes + indexBytes);
+		memcpy(upload.data(), data.vertices.data(), vertexBytes);
+		memcpy(upload.data() + vertexBytes, data.indices.data(), indexBytes);
+	}
+
+	// Everything Mesh does on the CPU with a valid cache: map both files,
+	// hash the source, validate the cache and "upload" straight from it
+	bool LoadThroughCache(const std::string& objPath, const std::string& cachePath, std::vector<char>& upload)
+	{
+		MappedFile obj(objPath.c_str());
+		unsigned long long sourceHash = MeshCache::HashBytes(obj.GetData(), obj.GetSize());
+
+		MappedFile cache(cachePath.c_str());
+		MeshCacheView view;
+		if (!cache.IsOpen() || !MeshCache::Read(cache.GetData(), cache.GetSize(), sourceHash, view))
+			return false;
+
+		size_t vertexBytes = view.VertexCount * sizeof(Vertex);
+		size_t indexBytes = view.IndexCount * sizeof(unsigned int);
+		upload.resize(vertexBytes + indexBytes);
+		memcpy(upload.data(), view.Vertices, vertexBytes);
+		memcpy(upload.data() + vertexBytes, view.Indices, indexBytes);
+		return true;
+	}
+
+	// The parts of Transform a camera used before rotations were kept as
+	// quaternions: every relative move and every change of direction
+	// vectors built a new quaternion from pitch, yaw and roll
+	struct PitchYawRollCamera
+	{
+		XMFLOAT3 pitchYawRoll;
+		XMFLOAT3 translation;
+		XMFLOAT3 right;
+		XMFLOAT3 up;
+		XMFLOAT3 forward;
+		bool rotationHasChanged;
+
+		void MoveRelative(XMFLOAT3 offset)
+		{
+			XMVECTOR rotationQuaternion = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
+			XMStoreFloat3(&translation, XMVectorAdd(XMLoadFloat3(&translation), XMVector3Rotate(XMLoadFloat3(&offset), rotationQuaternion)));
+		}
+
+		XMFLOAT3 GetForward()
+		{
+			if (rotationHasChanged)
+			{
+				XMVECTOR rotationQuaternion = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
+				XMStoreFloat3(&right, XMVector3Rotate(XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), rotationQuaternion));
+				XMStoreFloat3(&up, XMVector3Rotate(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), rotationQuaternion));
+				XMStoreFloat3(&forward, XMVector3Rotate(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), rotationQuaternion));
+				rotationHasChanged = false;
+			}
+			return forward;
+		}
+	};
+
+	// A cube from -1 to 1 on each axis, with clockwise (front facing) triangles
+	// seen from outside
+	OccluderMesh MakeCubeOccluder()
+	{
+		OccluderMesh cube;
+		for (unsigned int corner = 0; corner < 8; corner++)
+			cube.positions.push_back(XMFLOAT3((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f));
+
+		for (unsigned int axis = 0; axis < 3; axis++)
+		{
+			// Bits of the two axes across the face, and of the face's own axis
+			unsigned int u = 1 << ((axis + 1) % 3);
+			unsigned int v = 1 << ((axis + 2) % 3);
+			for (unsigned int side = 0; side < 2; side++)
+			{
+				unsigned int base = side ? (1 << axis) : 0;
+				unsigned int quad[4] = { base, base | v, base | u | v, base | u };
+
+				// Going from u to v turns towards -axis, so the positive side goes the other way
+				if (side)
+					std::swap(quad[1], quad[3]);
+
+				cube.indices.insert(cube.indices.end(), { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] });
+			}
+		}
+		return cube;
+	}
+
+	// Does the segment from start to end pass through (or end inside) the box?
+	bool SegmentHitsBox(XMFLOAT3 start, XMFLOAT3 end, XMFLOAT3 boxMin, XMFLOAT3 boxMax)
+	{
+		float starts[3] = { start.x, start.y, start.z };
+		float ends[3] = { end.x, end.y, end.z };
+		float mins[3] = { boxMin.x, boxMin.y, boxMin.z };
+		float maxes[3] = { boxMax.x, boxMax.y, boxMax.z };
+
+		float enter = 0.0f;
+		float exit = 1.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float direction = ends[axis] - starts[axis];
+			if (fabsf(direction) < 1e-8f)
+			{
+				if (starts[axis] < mins[axis] || starts[axis] > maxes[axis])
+					return false;
+				continue;
+			}
+
+			float t0 = (mins[axis] - starts[axis]) / direction;
+			float t1 = (maxes[axis] - starts[axis]) / direction;
+			enter = std::max(enter, std::min(t0, t1));
+			exit = std::min(exit, std::max(t0, t1));
+			if (enter > exit)
+				return false;
+		}
+		return true;
+	}
+
+	// Stand-ins for Mesh and Material, which need a D3D device
+	struct PointerLayoutMesh
+	{
+		XMFLOAT3 boundsMin;
+		XMFLOAT3 boundsMax;
+		MeshHandle handle;
+	};
+
+	struct PointerLayoutMaterial
+	{
+		MaterialHandle handle;
+	};
+
+	// How Game kept entities before EntityStore (as GameEntity): one heap
+	// object per entity, reached through a shared_ptr, holding shared_ptrs
+	// to its parts that are copied out by every getter
+	class PointerLayoutEntity
+	{
+	public:
+		PointerLayoutEntity(std::shared_ptr<PointerLayoutMesh> mesh, std::shared_ptr<PointerLayoutMaterial> material, TransformSystem& transformSystem) :
+			mesh{ mesh },
+			material{ material },
+			transform{ std::make_shared<Transform>(transformSystem) }
+		{
+		}
+
+		std::shared_ptr<PointerLayoutMesh> GetMesh() { return mesh; }
+		std::shared_ptr<PointerLayoutMaterial> GetMaterial() { return material; }
+		std::shared_ptr<Transform> GetTransform() { return transform; }
+
+	private:
+		std::shared_ptr<PointerLayoutMesh> mesh;
+		std::shared_ptr<PointerLayoutMaterial> material;
+		std::shared_ptr<Transform> transform;
+	};
+
+	// What the draw loop needs from each entity
+	struct DrawListItem
+	{
+		MeshHandle mesh;
+		MaterialHandle material;
+		XMFLOAT4X4 world;
+		XMFLOAT4X4 worldInverseTranspose;
+	};
+
+	// Stand-ins for shaders and texture views, which need a D3D device
+	// - Copying a shared_ptr to one costs about what the AddRef() and
+	//    Release() of copying a ComPtr do
+	struct LookupView
+	{
+		unsigned int id;
+	};
+
+	struct LookupMesh
+	{
+		unsigned int indexCount;
+	};
+
+	// Material as it was: shaders returned as (reference counted) copies
+	struct SharedLookupMaterial
+	{
+		std::shared_ptr<LookupView> vertexShader;
+		std::shared_ptr<LookupView> pixelShader;
+		std::unordered_map<unsigned int, std::shared_ptr<LookupView>> textures;
+
+		std::shared_ptr<LookupView> GetVertexShader() { return vertexShader; }
+		std::shared_ptr<LookupView> GetPixelShader() { return pixelShader; }
+	};
+
+	// Material as it is now: raw shaders, and textures by handle
+	struct PooledLookupMaterial
+	{
+		std::shared_ptr<LookupView> vertexShader;
+		std::shared_ptr<LookupView> pixelShader;
+		std::unordered_map<unsigned int, ResourceHandle<LookupView>> textures;
+
+		LookupView* GetVertexShader() { return vertexShader.get(); }
+		LookupView* GetPixelShader() { return pixelShader.get(); }
+	};
+
+	// An entity the way GameEntity kept one, getters and all
+	class SharedLookupEntity
+	{
+	public:
+		SharedLookupEntity(std::shared_ptr<LookupMesh> mesh, std::shared_ptr<SharedLookupMaterial> material) :
+			mesh{ mesh },
+			material{ material }
+		{
+		}
+
+		std::shared_ptr<LookupMesh> GetMesh() { return mesh; }
+		std::shared_ptr<SharedLookupMaterial> GetMaterial() { return material; }
+
+	private:
+		std::shared_ptr<LookupMesh> mesh;
+		std::shared_ptr<SharedLookupMaterial> material;
+	};
+
+	// Everything ResourcePool promises about handles, on a small pool
+	bool CheckResourcePoolHandles()
+	{
+		bool passed = true;
+		ResourcePool<std::shared_ptr<unsigned int>> pool(2);
+		using Handle = ResourcePool<std::shared_ptr<unsigned int>>::Handle;
+
+		// Null handles find nothing
+		passed &= pool.Get(Handle{}) == nullptr && !pool.IsValid(Handle{});
+
+		// Released handles go stale straight away, but the resource lives
+		// on until two frames have ended
+		Handle first = pool.Add(std::make_shared<unsigned int>(1u));
+		std::weak_ptr<unsigned int> firstResource = *pool.Get(first);
+		pool.Release(first);
+		passed &= pool.Get(first) == nullptr && pool.GetCount() == 0 && pool.GetPendingCount() == 1;
+		pool.EndFrame();
+		passed &= !firstResource.expired();
+		pool.EndFrame();
+		passed &= firstResource.expired() && pool.GetPendingCount() == 0;
+
+		// Releasing twice does nothing the second time
+		pool.Release(first);
+		passed &= pool.GetPendingCount() == 0;
+
+		// A reused slot gets a new generation, so the old handle stays stale
+		Handle second = pool.Add(std::make_shared<unsigned int>(2u));
+		passed &= second.GetIndex() == first.GetIndex() && second != first;
+		passed &= pool.Get(first) == nullptr && pool.Get(second) && **pool.Get(second) == 2;
+		pool.Release(second);
+
+		// Destroying resources moves others around without breaking their handles
+		std::vector<Handle> handles;
+		for (unsigned int i = 0; i < 100; i++)
+			handles.push_back(pool.Add(std::make_shared<unsigned int>(i)));
+		for (unsigned int i = 0; i < 100; i += 2)
+			pool.Release(handles[i]);
+		pool.EndFrame();
+		pool.EndFrame();
+		for (unsigned int i = 0; i < 100; i++)
+		{
+			const std::shared_ptr<unsigned int>* resource = pool.Get(handles[i]);
+			passed &= i % 2 ? resource && **resource == i : resource == nullptr;
+		}
+
+		unsigned int visited = 0;
+		pool.ForEach([&](Handle handle, std::shared_ptr<unsigned int>& resource)
+			{
+				passed &= pool.Get(handle) == &resource && *resource % 2 == 1;
+				visited++;
+			});
+		passed &= visited == 50 && pool.GetCount() == 50;
+
+		// Generations wrap around without ever making a null handle
+		Handle reused = pool.Add(std::make_shared<unsigned int>(0u));
+		for (unsigned int i = 0; i <= Handle::MaxGeneration; i++)
+		{
+			pool.Release(reused);
+			pool.EndFrame();
+			pool.EndFrame();
+			reused = pool.Add(std::make_shared<unsigned int>(0u));
+			passed &= !reused.IsNull() && pool.IsValid(reused);
+		}
+
+		return passed;
+	}
+
+	// Everything InstanceBatcher promises about grouping, on a few draws
+	bool CheckInstanceBatcher()
+	{
+		bool passed = true;
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+		// Only draws next to each other are grouped, so a mesh that comes
+		// back later starts a new batch
+		InstanceBatcher batcher;
+		batcher.Add(1, 1, 0, identity, identity);
+		batcher.Add(1, 1, 0, identity, identity);
+		batcher.Add(2, 1, 0, identity, identity);
+		batcher.Add(1, 1, 0, identity, identity);
+		const std::vector<InstanceBatch>& batches = batcher.GetBatches();
+		passed &= batches.size() == 3 && batches[0].InstanceCount == 2 && batches[1].Mesh == 2 && batches[2].FirstInstance == 3;
+
+		// A different material or LOD is a different batch too
+		batcher.Clear();
+		batcher.Add(1, 1, 0, identity, identity);
+		batcher.Add(1, 2, 0, identity, identity);
+		batcher.Add(1, 2, 1, identity, identity);
+		passed &= batcher.GetBatches().size() == 3 && batcher.GetInstances().size() == 3;
+
+		// Full batches are split, and each keeps its own range of instances
+		InstanceBatcher limited(2);
+		for (unsigned int i = 0; i < 5; i++)
+			limited.Add(1, 1, 0, identity, identity);
+		const std::vector<InstanceBatch>& split = limited.GetBatches();
+		passed &= split.size() == 3 &&
+			split[0].FirstInstance == 0 && split[0].InstanceCount == 2 &&
+			split[1].FirstInstance == 2 && split[1].InstanceCount == 2 &&
+			split[2].FirstInstance == 4 && split[2].InstanceCount == 1;
+
+		// Matrices are packed in the order they were added
+		batcher.Clear();
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			XMFLOAT4X4 world = identity;
+			XMFLOAT4X4 inverseTranspose = identity;
+			world._41 = (float)i;
+			inverseTranspose._14 = (float)i;
+			batcher.Add(i / 2, 1, 0, world, inverseTranspose);
+		}
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			const InstanceData& instance = batcher.GetInstances()[i];
+			passed &= instance.world._41 == (float)i && instance.worldInvTranspose._14 == (float)i;
+		}
+		passed &= batcher.GetBatches().size() == 2;
+
+		// Clearing starts over
+		batcher.Clear();
+		passed &= batcher.GetBatches().empty() && batcher.GetInstances().empty();
+
+		return passed;
+	}
+}
+
+// --------------------------------------------------------
+// Times ObjParser::Parse + BuildVertices on each .obj file
+// in the given directory
+// - Files are mapped once up front and parsed once before
+//    timing starts, so this measures parsing rather than
+//    disk reads
+// --------------------------------------------------------
+std::vector<ObjParseBenchmarkResult> Benchmarks::ObjParseThroughput(const std::string& meshDirectory, int iterations)
+{
+	std::vector<ObjParseBenchmarkResult> results;
+	iterations = std::max(iterations, 1);
+
+	// Gather the files first so the results come back in a stable order
+	std::vector<std::filesystem::path> paths = FindObjFiles(meshDirectory);
+
+	ObjParseBenchmarkResult total = {};
+	total.fileName = "All files";
+	double totalSeconds = 0.0;
+
+	// Reused between iterations, just like a real load would
+	ObjData objData;
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+
+	for (const std::filesystem::path& path : paths)
+	{
+		MappedFile file(path.string().c_str());
+		if (!file.IsOpen())
+			continue;
+
+		// Warm up (and fault in the mapped pages)
+		ObjParser::Parse(file.GetData(), file.GetSize(), objData);
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			ObjParser::Parse(file.GetData(), file.GetSize(), objData);
+			ObjParser::BuildVertices(objData, verts, indices);
+		}
+		double seconds = SecondsSince(start);
+
+		ObjParseBenchmarkResult result = {};
+		result.fileName = path.filename().string();
+		result.fileSizeInBytes = file.GetSize();
+		result.triangleCount = (unsigned int)(indices.size() / 3);
+		result.millisecondsPerParse = seconds * 1000.0 / iterations;
+		result.megabytesPerSecond = seconds > 0.0 ? (double)file.GetSize() * iterations / (1024.0 * 1024.0) / seconds : 0.0;
+		results.push_back(result);
+
+		total.fileSizeInBytes += result.fileSizeInBytes;
+		total.triangleCount += result.triangleCount;
+		total.millisecondsPerParse += result.millisecondsPerParse;
+		totalSeconds += seconds;
+	}
+
+	total.megabytesPerSecond = totalSeconds > 0.0 ? (double)total.fileSizeInBytes * iterations / (1024.0 * 1024.0) / totalSeconds : 0.0;
+	results.push_back(total);
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Times ObjParser::Parse at every thread count from 1 up to
+// the number of hardware threads
+// - "Shipped" throughput covers all .obj files in the
+//    directory; they're small, so they mostly show the
+//    overhead of spinning up threads
+// - The generated grid has gridSize^2 quads, which is where
+//    chunked parsing should actually scale
+// - Each parse is also compared against the 1-thread output
+// --------------------------------------------------------
+std::vector<ObjParseScalingResult> Benchmarks::ObjParseScaling(const std::string& meshDirectory, unsigned int largeGridSize, int iterations)
+{
+	std::vector<ObjParseScalingResult> results;
+	iterations = std::max(iterations, 1);
+
+	// Keep every shipped file mapped for the whole benchmark
+	std::vector<std::unique_ptr<MappedFile>> shippedFiles;
+	size_t shippedBytes = 0;
+	for (const std::filesystem::path& path : FindObjFiles(meshDirectory))
+	{
+		std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>(path.string().c_str());
+		if (!file->IsOpen())
+			continue;
+
+		shippedBytes += file->GetSize();
+		shippedFiles.push_back(std::move(file));
+	}
+
+	std::string largeObj = GenerateGridObj(largeGridSize);
+
+	// Serial results to compare everything else against
+	std::vector<ObjData> serialShipped(shippedFiles.size());
+	for (size_t f = 0; f < shippedFiles.size(); f++)
+		ObjParser::Parse(shippedFiles[f]->GetData(), shippedFiles[f]->GetSize(), serialShipped[f], 1);
+	ObjData serialLarge;
+	ObjParser::Parse(largeObj.data(), largeObj.size(), serialLarge, 1);
+
+	unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	ObjData objData;
+	for (unsigned int threads = 1; threads <= maxThreads; threads++)
+	{
+		ObjParseScalingResult result = {};
+		result.threadCount = threads;
+		result.matchesSerial = true;
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			for (size_t f = 0; f < shippedFiles.size(); f++)
+			{
+				ObjParser::Parse(shippedFiles[f]->GetData(), shippedFiles[f]->GetSize(), objData, threads);
+				if (i == 0)
+					result.matchesSerial &= SameObjData(objData, serialShipped[f]);
+			}
+		}
+		double shippedSeconds = SecondsSince(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			ObjParser::Parse(largeObj.data(), largeObj.size(), objData, threads);
+		}
+		double largeSeconds = SecondsSince(start);
+		result.matchesSerial &= SameObjData(objData, serialLarge);
+
+		result.shippedMegabytesPerSecond = shippedSeconds > 0.0 ? (double)shippedBytes * iterations / (1024.0 * 1024.0) / shippedSeconds : 0.0;
+		result.largeMegabytesPerSecond = largeSeconds > 0.0 ? (double)largeObj.size() * iterations / (1024.0 * 1024.0) / largeSeconds : 0.0;
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Loads each .obj file and runs MeshOptimizer on it
+// - Only Optimize() itself is timed, and that includes
+//    measuring the before and after stats
+// --------------------------------------------------------
+std::vector<MeshOptimizationBenchmarkResult> Benchmarks::MeshOptimization(const std::string& meshDirectory)
+{
+	std::vector<MeshOptimizationBenchmarkResult> results;
+
+	MeshData data;
+	for (const std::filesystem::path& path : FindObjFiles(meshDirectory))
+	{
+		MappedFile file(path.string().c_str());
+		if (!file.IsOpen())
+			continue;
+
+		MeshLoader::LoadObj(file.GetData(), file.GetSize(), data);
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		MeshOptimizer::Optimize(data);
+
+		MeshOptimizationBenchmarkResult result = {};
+		result.milliseconds = SecondsSince(start) * 1000.0;
+		result.fileName = path.filename().string();
+		result.triangleCount = (unsigned int)(data.indices.size() / 3);
+		result.stats = data.optimizationStats;
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Times each version of tangent generation on every mesh,
+// and compares the SIMD tangents against the scalar ones
+// - Tangents the scalar version left as NaN (triangles with
+//    no uv area) aren't compared, since that's the bug the
+//    SIMD version fixes
+// --------------------------------------------------------
+std::vector<TangentGenerationResult> Benchmarks::TangentGeneration(const std::string& meshDirectory, unsigned int largeGridSize, int iterations)
+{
+	std::vector<TangentGenerationResult> results;
+
+	// Every shipped mesh, then the large one
+	std::vector<std::pair<std::string, std::string>> objFiles;
+	for (const std::filesystem::path& path : FindObjFiles(meshDirectory))
+	{
+		MappedFile file(path.string().c_str());
+		if (file.IsOpen())
+			objFiles.emplace_back(path.filename().string(), std::string(file.GetData(), file.GetSize()));
+	}
+	objFiles.emplace_back("grid" + std::to_string(largeGridSize) + ".obj", GenerateGridObj(largeGridSize));
+
+	unsigned int threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	MeshData data;
+	for (const std::pair<std::string, std::string>& objFile : objFiles)
+	{
+		MeshLoader::LoadObj(objFile.second.data(), objFile.second.size(), data, threadCount);
+		std::vector<Vertex> scalar = data.vertices;
+		std::vector<Vertex> simd = data.vertices;
+		std::vector<Vertex> threaded = data.vertices;
+		int vertexCount = (int)data.vertices.size();
+		int indexCount = (int)data.indices.size();
+
+		TangentGenerationResult result = {};
+		result.fileName = objFile.first;
+		result.vertexCount = (unsigned int)vertexCount;
+		result.triangleCount = (unsigned int)(indexCount / 3);
+		result.threadCount = threadCount;
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++)
+			MeshLoader::CalculateTangentsScalar(scalar.data(), vertexCount, data.indices.data(), indexCount);
+		result.scalarMilliseconds = SecondsSince(start) * 1000.0 / iterations;
+
+		start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++)
+			MeshLoader::CalculateTangents(simd.data(), vertexCount, data.indices.data(), indexCount, 1);
+		result.simdMilliseconds = SecondsSince(start) * 1000.0 / iterations;
+
+		start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++)
+			MeshLoader::CalculateTangents(threaded.data(), vertexCount, data.indices.data(), indexCount, threadCount);
+		result.threadedMilliseconds = SecondsSince(start) * 1000.0 / iterations;
+
+		result.allFinite = true;
+		for (int v = 0; v < vertexCount; v++)
+		{
+			const XMFLOAT3& expected = scalar[v].Tangent;
+			for (const XMFLOAT3& actual : { simd[v].Tangent, threaded[v].Tangent })
+			{
+				result.allFinite &= std::isfinite(actual.x) && std::isfinite(actual.y) && std::isfinite(actual.z);
+				if (std::isfinite(expected.x) && std::isfinite(expected.y) && std::isfinite(expected.z))
+				{
+					result.maxDifference = std::max({ result.maxDifference,
+						fabsf(actual.x - expected.x), fabsf(actual.y - expected.y), fabsf(actual.z - expected.z) });
+				}
+			}
+		}
+
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Checks both packed formats against the float vertices
+// of each shipped mesh
+// - Positions: half a UNORM16 step of the mesh's extent
+//    (quantized) or exact (float)
+// - UVs: half a half-float step at the UV's magnitude
+// - Normals and tangents: 0.01 degrees, comfortably above
+//    the worst case for 16-bit octahedral encoding
+// --------------------------------------------------------
+std::vector<PackedVertexAccuracyResult> Benchmarks::PackedVertexAccuracy(const std::string& meshDirectory)
+{
+	std::vector<PackedVertexAccuracyResult> results;
+
+	MeshData data;
+	std::vector<PackedVertex> packed;
+	std::vector<PackedVertexFloatPosition> packedFloatPosition;
+	std::vector<Vertex> unpacked;
+	for (const std::filesystem::path& path : FindObjFiles(meshDirectory))
+	{
+		MappedFile file(path.string().c_str());
+		if (!file.IsOpen())
+			continue;
+
+		MeshLoader::LoadObj(file.GetData(), file.GetSize(), data);
+		size_t count = data.vertices.size();
+		unpacked.resize(count);
+
+		VertexFormat formats[] = { VertexFormat::Packed, VertexFormat::PackedFloatPosition };
+		for (VertexFormat format : formats)
+		{
+			PackedVertexDequantize dequantize = VertexPacking::GetDequantize(format, data.boundsMin, data.boundsMax);
+
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			if (format == VertexFormat::Packed)
+			{
+				packed.resize(count);
+				VertexPacking::Pack(data.vertices.data(), count, dequantize, packed.data());
+			}
+			else
+			{
+				packedFloatPosition.resize(count);
+				VertexPacking::Pack(data.vertices.data(), count, packedFloatPosition.data());
+			}
+			double seconds = SecondsSince(start);
+
+			if (format == VertexFormat::Packed)
+				VertexPacking::Unpack(packed.data(), count, dequantize, unpacked.data());
+			else
+				VertexPacking::Unpack(packedFloatPosition.data(), count, unpacked.data());
+
+			PackedVertexAccuracyResult result = {};
+			result.fileName = path.filename().string();
+			result.format = format;
+			result.fullBytes = count * sizeof(Vertex);
+			result.packedBytes = count * VertexPacking::GetStride(format);
+			result.packMilliseconds = seconds * 1000.0;
+			result.withinBounds = true;
+
+			for (size_t v = 0; v < count; v++)
+			{
+				const Vertex& original = data.vertices[v];
+				const Vertex& decoded = unpacked[v];
+
+				const float* originalPosition = &original.Position.x;
+				const float* decodedPosition = &decoded.Position.x;
+				const float* extent = &dequantize.Scale.x;
+				const float* offset = &dequantize.Offset.x;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					// Leave room for float rounding in the dequantize math itself
+					float error = fabsf(decodedPosition[axis] - originalPosition[axis]);
+					float floatSlop = 4.0f * FLT_EPSILON * (fabsf(originalPosition[axis]) + fabsf(offset[axis]) + extent[axis]);
+					float allowed = format == VertexFormat::Packed ? extent[axis] * (0.5f / 65535.0f) + floatSlop : 0.0f;
+					if (extent[axis] > 0.0f && format == VertexFormat::Packed)
+						result.maxPositionError = std::max(result.maxPositionError, error / extent[axis]);
+					result.withinBounds &= error <= allowed;
+				}
+
+				const float* originalUV = &original.UV.x;
+				const float* decodedUV = &decoded.UV.x;
+				for (int c = 0; c < 2; c++)
+				{
+					float error = fabsf(decodedUV[c] - originalUV[c]);
+					result.maxUVError = std::max(result.maxUVError, error);
+					result.withinBounds &= error <= fabsf(originalUV[c]) * (1.0f / 2048.0f) + (1.0f / 16777216.0f);
+				}
+
+				float normalError = AngleBetweenDegrees(original.Normal, decoded.Normal);
+				float tangentError = AngleBetweenDegrees(original.Tangent, decoded.Tangent);
+				result.maxNormalErrorDegrees = std::max(result.maxNormalErrorDegrees, normalError);
+				result.maxTangentErrorDegrees = std::max(result.maxTangentErrorDegrees, tangentError);
+				result.withinBounds &= normalError <= 0.01f && tangentError <= 0.01f;
+			}
+
+			results.push_back(result);
+		}
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Runs each mesh through the same steps as Mesh (load,
+// optimize, then IndexPacking::Pack16) and reports the
+// index memory saved
+// - Each result is also checked by mapping every 16-bit
+//    index back through its range to the source vertex
+// --------------------------------------------------------
+std::vector<IndexBufferSavingsResult> Benchmarks::IndexBufferSavings(const std::string& meshDirectory, unsigned int largeGridSize)
+{
+	std::vector<IndexBufferSavingsResult> results;
+
+	// The shipped meshes all fit in a single range, so also
+	// try a mesh that doesn't
+	std::vector<std::pair<std::string, std::string>> objs;
+	for (const std::filesystem::path& path : FindObjFiles(meshDirectory))
+	{
+		MappedFile file(path.string().c_str());
+		if (file.IsOpen())
+			objs.push_back({ path.filename().string(), std::string(file.GetData(), file.GetSize()) });
+	}
+	objs.push_back({ "grid" + std::to_string(largeGridSize) + " (generated)", GenerateGridObj(largeGridSize) });
+
+	MeshData data;
+	std::vector<unsigned short> indices16;
+	std::vector<IndexRange> ranges;
+	std::vector<unsigned int> vertexOrder;
+	for (const std::pair<std::string, std::string>& obj : objs)
+	{
+		MeshLoader::LoadObj(obj.second.data(), obj.second.size(), data, std::thread::hardware_concurrency());
+		MeshOptimizer::Optimize(data);
+		IndexPacking::Pack16(data.indices.data(), data.indices.size(), data.vertices.size(), indices16, ranges, vertexOrder);
+
+		IndexBufferSavingsResult result = {};
+		result.fileName = obj.first;
+		result.vertexCount = (unsigned int)data.vertices.size();
+		result.indexCount = (unsigned int)data.indices.size();
+		result.rangeCount = (unsigned int)ranges.size();
+		result.duplicatedVertexCount = vertexOrder.empty() ? 0 : (unsigned int)(vertexOrder.size() - data.vertices.size());
+		result.bytes32 = data.indices.size() * sizeof(unsigned int);
+		result.bytes16 = indices16.size() * sizeof(unsigned short);
+		result.savedBytes = (long long)result.bytes32 - (long long)result.bytes16 - (long long)result.duplicatedVertexCount * sizeof(Vertex);
+
+		// Every index should still lead to the same source vertex
+		result.matchesOriginal = true;
+		for (const IndexRange& range : ranges)
+		{
+			for (unsigned int i = range.StartIndex; i < range.StartIndex + range.IndexCount; i++)
+			{
+				unsigned int vertex = range.BaseVertex + indices16[i];
+				unsigned int source = vertexOrder.empty() ? vertex : vertexOrder[vertex];
+				result.matchesOriginal &= source == data.indices[i];
+			}
+		}
+
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Builds meshlets the same way Mesh does (after loading and
+// optimizing), then culls them from each camera
+// - Every triangle in a cone culled meshlet is checked
+//    against the camera, to make sure none of them faced it
+// --------------------------------------------------------
+std::vector<MeshletCullingResult> Benchmarks::MeshletCulling(const std::string& meshDirectory, const std::vector<std::shared_ptr<Camera>>& cameras)
+{
+	std::vector<MeshletCullingResult> results;
+
+	MeshData data;
+	MeshletData meshlets;
+	for (const std::filesystem::path& path : FindObjFiles(meshDirectory))
+	{
+		MappedFile file(path.string().c_str());
+		if (!file.IsOpen())
+			continue;
+
+		MeshLoader::LoadObj(file.GetData(), file.GetSize(), data, std::thread::hardware_concurrency());
+		MeshOptimizer::Optimize(data);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		MeshletBuilder::Build(data.vertices.data(), data.vertices.size(), data.indices.data(), data.indices.size(), meshlets);
+		double buildMilliseconds = SecondsSince(start) * 1000.0;
+
+		for (size_t c = 0; c < cameras.size(); c++)
+		{
+			Frustum frustum = cameras[c]->GetFrustum();
+			XMFLOAT3 viewPosition = cameras[c]->GetTranslation();
+			XMVECTOR view = XMLoadFloat3(&viewPosition);
+
+			MeshletCullingResult result = {};
+			result.fileName = path.filename().string();
+			result.cameraIndex = (unsigned int)c;
+			result.meshletCount = (unsigned int)meshlets.meshlets.size();
+			result.triangleCount = (unsigned int)(data.indices.size() / 3);
+			result.buildMilliseconds = buildMilliseconds;
+			result.conesConservative = true;
+
+			for (const Meshlet& meshlet : meshlets.meshlets)
+			{
+				MeshletVisibility visibility = MeshletBuilder::Test(meshlet, frustum, viewPosition);
+				if (visibility == MeshletVisibility::OutsideFrustum)
+					result.frustumCulledTriangles += meshlet.TriangleCount;
+				else if (visibility == MeshletVisibility::Backfacing)
+					result.backfaceCulledTriangles += meshlet.TriangleCount;
+
+				for (unsigned int t = 0; t < meshlet.TriangleCount; t++)
+				{
+					const unsigned char* triangle = &meshlets.triangles[(size_t)(meshlet.TriangleOffset + t) * 3];
+					XMVECTOR p0 = XMLoadFloat3(&data.vertices[meshlets.vertices[meshlet.VertexOffset + triangle[0]]].Position);
+					XMVECTOR p1 = XMLoadFloat3(&data.vertices[meshlets.vertices[meshlet.VertexOffset + triangle[1]]].Position);
+					XMVECTOR p2 = XMLoadFloat3(&data.vertices[meshlets.vertices[meshlet.VertexOffset + triangle[2]]].Position);
+					XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+
+					// Same test as the rasterizer: facing away if the viewer is behind its plane
+					bool backfacing = XMVectorGetX(XMVector3Dot(normal, XMVectorSubtract(p0, view))) >= 0.0f;
+					result.backfacingTriangles += backfacing;
+					if (visibility == MeshletVisibility::Backfacing && !backfacing)
+						result.conesConservative = false;
+				}
+			}
+
+			result.culledPercent = 100.0f * (result.frustumCulledTriangles + result.backfaceCulledTriangles) / std::max(result.triangleCount, 1u);
+			results.push_back(result);
+		}
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Loads and optimizes a few curved meshes the same way Mesh
+// does, then builds their LODs together on separate threads
+// - The error of each LOD is measured as the farthest any
+//    full detail vertex is from the LOD's surface, relative
+//    to the largest extent of the mesh (like the simplifier)
+// --------------------------------------------------------
+std::vector<LodSimplificationResult> Benchmarks::LodSimplification(const std::string& meshDirectory)
+{
+	std::vector<LodSimplificationResult> results;
+
+	const char* fileNames[] = { "sphere.obj", "torus.obj", "helix.obj" };
+	std::vector<MeshData> data;
+	std::vector<std::string> loadedNames;
+	for (const char* fileName : fileNames)
+	{
+		MappedFile file((meshDirectory + fileName).c_str());
+		if (!file.IsOpen())
+			continue;
+
+		data.emplace_back();
+		MeshLoader::LoadObj(file.GetData(), file.GetSize(), data.back(), std::thread::hardware_concurrency());
+		MeshOptimizer::Optimize(data.back());
+		loadedNames.push_back(fileName);
+	}
+
+	std::vector<MeshData*> meshes;
+	for (MeshData& mesh : data)
+		meshes.push_back(&mesh);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	MeshSimplifier::BuildLods(meshes, (unsigned int)meshes.size());
+	double milliseconds = SecondsSince(start) * 1000.0;
+
+	for (size_t m = 0; m < data.size(); m++)
+	{
+		const MeshData& mesh = data[m];
+		float extent = std::max({ mesh.boundsMax.x - mesh.boundsMin.x, mesh.boundsMax.y - mesh.boundsMin.y, mesh.boundsMax.z - mesh.boundsMin.z });
+		unsigned int fullTriangles = mesh.lods[0].IndexCount / 3;
+
+		for (size_t l = 1; l < mesh.lods.size(); l++)
+		{
+			const MeshLod& lod = mesh.lods[l];
+
+			// Farthest any full detail vertex is from its closest LOD triangle
+			float farthest = 0.0f;
+			for (unsigned int i = 0; i < mesh.lods[0].IndexCount; i++)
+			{
+				XMVECTOR p = XMLoadFloat3(&mesh.vertices[mesh.indices[i]].Position);
+				float closest = FLT_MAX;
+				for (unsigned int t = lod.StartIndex; t < lod.StartIndex + lod.IndexCount; t += 3)
+				{
+					closest = std::min(closest, DistanceToTriangle(p,
+						XMLoadFloat3(&mesh.vertices[mesh.indices[t + 0]].Position),
+						XMLoadFloat3(&mesh.vertices[mesh.indices[t + 1]].Position),
+						XMLoadFloat3(&mesh.vertices[mesh.indices[t + 2]].Position)));
+				}
+				farthest = std::max(farthest, closest);
+			}
+
+			LodSimplificationResult result = {};
+			result.fileName = loadedNames[m];
+			result.lod = (unsigned int)l;
+			result.targetRatio = MeshSimplifier::DefaultLodRatios[l - 1];
+			result.targetTriangles = (unsigned int)(fullTriangles * result.targetRatio);
+			result.triangleCount = lod.IndexCount / 3;
+			result.reportedError = lod.Error;
+			result.measuredError = extent > 0.0f ? farthest / extent : 0.0f;
+			result.maxError = MeshSimplifier::DefaultMaxError;
+			result.milliseconds = milliseconds;
+			result.meetsTarget = result.triangleCount <= result.targetTriangles;
+			result.withinErrorBound = result.measuredError <= result.maxError;
+			results.push_back(result);
+		}
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Updates a 4-way branching tree of transforms, with the same
+// random nodes changed each frame for both kinds of update
+// - Changes near the root dirty big subtrees, so the saving
+//    depends on where changes land, like it would in a game
+// --------------------------------------------------------
+std::vector<TransformHierarchyResult> Benchmarks::TransformHierarchyUpdate(unsigned int nodeCount, float changedFraction, int frames)
+{
+	std::vector<TransformHierarchyResult> results;
+	if (nodeCount == 0)
+		return results;
+
+	// A deque never moves its elements, since children point at their parents
+	TransformSystem system;
+	std::deque<Transform> transforms;
+	for (unsigned int i = 0; i < nodeCount; i++)
+		transforms.emplace_back(system);
+	for (unsigned int i = 1; i < nodeCount; i++)
+	{
+		transforms[i].SetParent(&transforms[(i - 1) / 4]);
+		transforms[i].SetTranslation((float)(i % 7), (float)(i % 5), 1.0f);
+	}
+
+	TransformHierarchyResult result = {};
+	result.nodeCount = nodeCount;
+	result.changedPerFrame = std::max((unsigned int)(nodeCount * changedFraction), 1u);
+
+	// Changes the same nodes the same way for both runs
+	auto changeNodes = [&](std::mt19937& random, int frame)
+		{
+			std::uniform_int_distribution<unsigned int> pick(0, nodeCount - 1);
+			for (unsigned int c = 0; c < result.changedPerFrame; c++)
+			{
+				Transform& node = transforms[pick(random)];
+				node.Rotate(0.0f, 0.01f, 0.0f);
+				node.SetTranslation((float)(frame % 3), 1.0f, (float)c);
+			}
+		};
+
+	// Only what changed
+	std::mt19937 random(1234);
+	system.RecalculateAllWorldMatrices();
+	std::vector<XMFLOAT4X4> dirtyWorlds(nodeCount);
+	double seconds = 0.0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		changeNodes(random, frame);
+		auto start = std::chrono::high_resolution_clock::now();
+		system.UpdateWorldMatrices();
+		seconds += SecondsSince(start);
+	}
+	result.dirtyMilliseconds = seconds * 1000.0 / std::max(frames, 1);
+	for (unsigned int i = 0; i < nodeCount; i++)
+		dirtyWorlds[i] = transforms[i].GetWorldMatrix();
+
+	// Everything, after putting every node back where it started
+	for (unsigned int i = 0; i < nodeCount; i++)
+	{
+		transforms[i].SetPitchYawRoll(0.0f, 0.0f, 0.0f);
+		transforms[i].SetTranslation((float)(i % 7), (float)(i % 5), 1.0f);
+	}
+	transforms[0].SetTranslation(0.0f, 0.0f, 0.0f);
+
+	random.seed(1234);
+	system.RecalculateAllWorldMatrices();
+	seconds = 0.0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		changeNodes(random, frame);
+		auto start = std::chrono::high_resolution_clock::now();
+		system.RecalculateAllWorldMatrices();
+		seconds += SecondsSince(start);
+	}
+	result.fullMilliseconds = seconds * 1000.0 / std::max(frames, 1);
+
+	result.matchesFull = true;
+	for (unsigned int i = 0; i < nodeCount; i++)
+	{
+		XMFLOAT4X4 world = transforms[i].GetWorldMatrix();
+		result.matchesFull &= memcmp(&world, &dirtyWorlds[i], sizeof(XMFLOAT4X4)) == 0;
+	}
+
+	results.push_back(result);
+	return results;
+}
+
+// --------------------------------------------------------
+// Compares the system's batched world matrices against the
+// way Transform used to calculate them, one at a time:
+// separate scale, rotation and translation matrices, three
+// multiplies and a general inverse
+// - Both use the same random scales, rotations and
+//    translations, and no parents
+// --------------------------------------------------------
+std::vector<TransformSystemResult> Benchmarks::TransformSystemUpdate(const std::vector<unsigned int>& transformCounts)
+{
+	std::vector<TransformSystemResult> results;
+
+	for (unsigned int transformCount : transformCounts)
+	{
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> scales(0.5f, 2.0f);
+		std::uniform_real_distribution<float> angles(-XM_PI, XM_PI);
+		std::uniform_real_distribution<float> positions(-100.0f, 100.0f);
+
+		TransformSystem system;
+		std::deque<Transform> transforms;
+		std::vector<XMFLOAT3> scale(transformCount), pitchYawRoll(transformCount), translation(transformCount);
+		for (unsigned int i = 0; i < transformCount; i++)
+		{
+			scale[i] = XMFLOAT3(scales(random), scales(random), scales(random));
+			pitchYawRoll[i] = XMFLOAT3(angles(random), angles(random), angles(random));
+			translation[i] = XMFLOAT3(positions(random), positions(random), positions(random));
+
+			Transform& transform = transforms.emplace_back(system);
+			transform.SetScale(scale[i]);
+			transform.SetPitchYawRoll(pitchYawRoll[i]);
+			transform.SetTranslation(translation[i]);
+		}
+
+		TransformSystemResult result = {};
+		result.transformCount = transformCount;
+
+		// The old way
+		std::vector<XMFLOAT4X4> worlds(transformCount), worldInverseTransposes(transformCount);
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < transformCount; i++)
+		{
+			XMMATRIX s = XMMatrixScalingFromVector(XMLoadFloat3(&scale[i]));
+			XMMATRIX r = XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll[i]));
+			XMMATRIX t = XMMatrixTranslationFromVector(XMLoadFloat3(&translation[i]));
+			XMMATRIX w = XMMatrixMultiply(XMMatrixMultiply(XMMatrixMultiply(XMMatrixIdentity(), s), r), t);
+			XMStoreFloat4x4(&worlds[i], w);
+			XMStoreFloat4x4(&worldInverseTransposes[i], XMMatrixInverse(0, XMMatrixTranspose(w)));
+		}
+		result.oneAtATimeMilliseconds = SecondsSince(start) * 1000.0;
+
+		// All at once
+		start = std::chrono::high_resolution_clock::now();
+		system.RecalculateAllWorldMatrices();
+		result.systemMilliseconds = SecondsSince(start) * 1000.0;
+
+		for (unsigned int i = 0; i < transformCount; i++)
+		{
+			XMFLOAT4X4 world = transforms[i].GetWorldMatrix();
+			XMFLOAT4X4 worldInverseTranspose = transforms[i].GetWorldInvTranspose();
+			for (int e = 0; e < 16; e++)
+			{
+				result.maxWorldDifference = std::max(result.maxWorldDifference, fabsf((&world._11)[e] - (&worlds[i]._11)[e]));
+				result.maxInverseTransposeDifference = std::max(result.maxInverseTransposeDifference, fabsf((&worldInverseTranspose._11)[e] - (&worldInverseTransposes[i]._11)[e]));
+			}
+		}
+
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Builds world bounds for many boxes the way Game does for
+// its entities, and culls them against each camera
+// - Every culled box's eight corners are checked against
+//    the frustum, to make sure all of them were behind the
+//    same plane
+// --------------------------------------------------------
+std::vector<EntityCullingResult> Benchmarks::EntityCulling(unsigned int entityCount, const std::vector<std::shared_ptr<Camera>>& cameras, int iterations)
+{
+	std::vector<EntityCullingResult> results;
+	iterations = std::max(iterations, 1);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> sizes(0.1f, 1.0f);
+	std::uniform_real_distribution<float> scales(0.5f, 2.0f);
+	std::uniform_real_distribution<float> angles(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> positions(-200.0f, 200.0f);
+
+	// Boxes of a few sizes, standing in for meshes
+	TransformSystem system;
+	std::deque<Transform> transforms;
+	std::vector<XMFLOAT3> localMins(entityCount), localMaxes(entityCount);
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		localMaxes[i] = XMFLOAT3(sizes(random), sizes(random), sizes(random));
+		localMins[i] = XMFLOAT3(-localMaxes[i].x, -localMaxes[i].y, -localMaxes[i].z);
+
+		Transform& transform = transforms.emplace_back(system);
+		transform.SetScale(scales(random), scales(random), scales(random));
+		transform.SetPitchYawRoll(angles(random), angles(random), angles(random));
+		transform.SetTranslation(positions(random), positions(random), positions(random));
+	}
+	system.UpdateWorldMatrices();
+
+	std::vector<XMFLOAT4X4> worlds(entityCount);
+	for (unsigned int i = 0; i < entityCount; i++)
+		worlds[i] = transforms[i].GetWorldMatrix();
+
+	WorldBounds bounds;
+	FrustumCulling::Resize(bounds, entityCount);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		for (unsigned int i = 0; i < entityCount; i++)
+			FrustumCulling::SetFromLocalBox(bounds, i, localMins[i], localMaxes[i], worlds[i]);
+	}
+	double boundsMicroseconds = SecondsSince(start) * 1000000.0 / iterations;
+
+	std::vector<unsigned int> visible, visibleScalar;
+	for (unsigned int c = 0; c < cameras.size(); c++)
+	{
+		Frustum frustum = cameras[c]->GetFrustum();
+
+		EntityCullingResult result = {};
+		result.cameraIndex = c;
+		result.entityCount = entityCount;
+		result.boundsMicroseconds = boundsMicroseconds;
+
+		start = std::chrono::high_resolution_clock::now();
+		for (int iteration = 0; iteration < iterations; iteration++)
+			result.visibleCount = FrustumCulling::Cull(bounds, frustum, visible);
+		result.cullMicroseconds = SecondsSince(start) * 1000000.0 / iterations;
+
+		start = std::chrono::high_resolution_clock::now();
+		for (int iteration = 0; iteration < iterations; iteration++)
+			FrustumCulling::CullScalar(bounds, frustum, visibleScalar);
+		result.scalarCullMicroseconds = SecondsSince(start) * 1000000.0 / iterations;
+
+		result.matchesScalar = visible == visibleScalar;
+
+		// Every box that isn't in the (sorted) visible list should be entirely behind one plane
+		result.conservative = true;
+		size_t nextVisible = 0;
+		for (unsigned int i = 0; i < entityCount && result.conservative; i++)
+		{
+			if (nextVisible < visible.size() && visible[nextVisible] == i)
+			{
+				nextVisible++;
+				continue;
+			}
+
+			XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+			bool behindOnePlane = false;
+			for (int p = 0; p < 6 && !behindOnePlane; p++)
+			{
+				XMVECTOR plane = XMLoadFloat4(&frustum.Planes[p]);
+				behindOnePlane = true;
+				for (int corner = 0; corner < 8; corner++)
+				{
+					XMVECTOR local = XMVectorSet(
+						(corner & 1) ? localMaxes[i].x : localMins[i].x,
+						(corner & 2) ? localMaxes[i].y : localMins[i].y,
+						(corner & 4) ? localMaxes[i].z : localMins[i].z,
+						1.0f);
+					if (XMVectorGetX(XMVector4Dot(plane, XMVector4Transform(local, world))) >= 0.0f)
+					{
+						behindOnePlane = false;
+						break;
+					}
+				}
+			}
+			result.conservative = behindOnePlane;
+		}
+
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Runs the same frames of camera movement through the old
+// pitch/yaw/roll path and through Transform's Quaternion
+// mode, each followed by a view matrix like Camera's
+// - Once just moving, and once also looking around with the
+//    mouse, far enough to hit the clamp at straight up and
+//    down, so both clamps are compared too
+// --------------------------------------------------------
+std::vector<CameraMovementResult> Benchmarks::CameraMovement(unsigned int frames)
+{
+	std::vector<CameraMovementResult> results;
+
+	// Turning back and forth keeps the old angles small, so adding
+	// up float angles doesn't lose precision of its own
+	const float step = 0.01f;
+	auto lookX = [](unsigned int frame) { return (frame / 1000) % 2 == 0 ? 0.003f : -0.003f; };
+	auto lookY = [](unsigned int frame) { return (frame / 250) % 2 == 0 ? 0.01f : -0.01f; };
+
+	XMFLOAT3 worldUp(0.0f, 1.0f, 0.0f);
+	std::vector<XMFLOAT4X4> oldViews(frames), newViews(frames);
+
+	for (bool looking : { false, true })
+	{
+		CameraMovementResult result = {};
+		result.frames = frames;
+		result.looking = looking;
+
+		// The old way, as Camera::Update used to do it
+		PitchYawRollCamera oldCamera = {};
+		oldCamera.pitchYawRoll = XMFLOAT3(0.3f, 0.5f, 0.0f);
+		oldCamera.rotationHasChanged = true;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int frame = 0; frame < frames; frame++)
+		{
+			oldCamera.MoveRelative(XMFLOAT3(0.0f, 0.0f, step));
+			oldCamera.MoveRelative(XMFLOAT3(step, 0.0f, 0.0f));
+			oldCamera.translation.y += step;
+
+			if (looking)
+			{
+				oldCamera.pitchYawRoll.x = std::clamp(oldCamera.pitchYawRoll.x + lookY(frame), XMConvertToRadians(-90.0f), XMConvertToRadians(90.0f));
+				oldCamera.pitchYawRoll.y += lookX(frame);
+				oldCamera.pitchYawRoll.z = 0.0f;
+				oldCamera.rotationHasChanged = true;
+			}
+
+			XMFLOAT3 forward = oldCamera.GetForward();
+			XMStoreFloat4x4(&oldViews[frame], XMMatrixLookToLH(XMLoadFloat3(&oldCamera.translation), XMLoadFloat3(&forward), XMLoadFloat3(&worldUp)));
+		}
+		result.pitchYawRollMilliseconds = SecondsSince(start) * 1000.0;
+
+		// The new way, matching Camera::Update
+		TransformSystem system;
+		Transform newCamera(system);
+		newCamera.SetRotationMode(Transform::RotationMode::Quaternion);
+		newCamera.SetPitchYawRoll(0.3f, 0.5f, 0.0f);
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int frame = 0; frame < frames; frame++)
+		{
+			newCamera.MoveRelative(XMFLOAT3(0.0f, 0.0f, step));
+			newCamera.MoveRelative(XMFLOAT3(step, 0.0f, 0.0f));
+			newCamera.MoveAbsolute(XMFLOAT3(0.0f, step, 0.0f));
+
+			if (looking)
+			{
+				float currentPitch = atan2f(-newCamera.GetForward().y, newCamera.GetUp().y);
+				float newPitch = std::clamp(currentPitch + lookY(frame), XMConvertToRadians(-90.0f), XMConvertToRadians(90.0f));
+				newCamera.RotateAxisAngle(newCamera.GetRight(), newPitch - currentPitch);
+				newCamera.RotateAxisAngle(worldUp, lookX(frame));
+			}
+
+			XMFLOAT3 forward = newCamera.GetForward();
+			XMFLOAT3 translation = newCamera.GetTranslation();
+			XMStoreFloat4x4(&newViews[frame], XMMatrixLookToLH(XMLoadFloat3(&translation), XMLoadFloat3(&forward), XMLoadFloat3(&worldUp)));
+		}
+		result.quaternionMilliseconds = SecondsSince(start) * 1000.0;
+
+		// Only the rotation part, since positions grow as the camera keeps moving
+		for (unsigned int frame = 0; frame < frames; frame++)
+		{
+			for (int row = 0; row < 3; row++)
+			{
+				for (int column = 0; column < 3; column++)
+					result.maxRotationDifference = std::max(result.maxRotationDifference, fabsf(oldViews[frame].m[row][column] - newViews[frame].m[row][column]));
+			}
+		}
+
+		XMFLOAT3 finalTranslation = newCamera.GetTranslation();
+		XMStoreFloat(&result.finalPositionDifference, XMVector3Length(XMVectorSubtract(XMLoadFloat3(&oldCamera.translation), XMLoadFloat3(&finalTranslation))));
+
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Occlusion culls boxes scattered through the streets of
+// a grid of buildings, from a camera at street level
+// - Each configuration measures the same view; with
+//    reprojection, a frame from slightly further back is
+//    drawn first so there's something to reproject
+// - A culled box counts as wrongly culled if the camera can
+//    see its center, or a point just inside any of its
+//    corners, past every building (and inside the frustum)
+// - Coverage is only sampled at pixel centers, so a few
+//    boxes peeking out from less than a pixel past an edge
+//    are expected to be culled at this resolution
+// --------------------------------------------------------
+std::vector<OcclusionCullingResult> Benchmarks::OcclusionCulling(unsigned int boxCount, int iterations)
+{
+	std::vector<OcclusionCullingResult> results;
+	iterations = std::max(iterations, 1);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> heights(10.0f, 40.0f);
+	std::uniform_real_distribution<float> positions(-120.0f, 120.0f);
+	std::uniform_real_distribution<float> sizes(0.25f, 1.0f);
+	std::uniform_real_distribution<float> boxHeights(0.5f, 3.0f);
+
+	// 12 x 12 blocks, each a 14 x 14 building with 6 unit wide streets between them
+	const unsigned int blocksPerSide = 12;
+	const float blockSpacing = 20.0f;
+	const float buildingHalfWidth = 7.0f;
+	OccluderMesh cube = MakeCubeOccluder();
+	std::vector<XMFLOAT3> buildingMins, buildingMaxes;
+	std::vector<XMFLOAT4X4> buildingWorlds;
+	for (unsigned int z = 0; z < blocksPerSide; z++)
+	{
+		for (unsigned int x = 0; x < blocksPerSide; x++)
+		{
+			float height = heights(random);
+			XMFLOAT3 center((x - (blocksPerSide - 1) * 0.5f) * blockSpacing, height * 0.5f, (z - (blocksPerSide - 1) * 0.5f) * blockSpacing);
+			buildingMins.push_back(XMFLOAT3(center.x - buildingHalfWidth, 0.0f, center.z - buildingHalfWidth));
+			buildingMaxes.push_back(XMFLOAT3(center.x + buildingHalfWidth, height, center.z + buildingHalfWidth));
+
+			XMFLOAT4X4 world;
+			XMStoreFloat4x4(&world, XMMatrixMultiply(
+				XMMatrixScaling(buildingHalfWidth, height * 0.5f, buildingHalfWidth),
+				XMMatrixTranslation(center.x, center.y, center.z)));
+			buildingWorlds.push_back(world);
+		}
+	}
+
+	WorldBounds buildingBounds;
+	FrustumCulling::Resize(buildingBounds, buildingWorlds.size());
+	for (unsigned int i = 0; i < buildingWorlds.size(); i++)
+		FrustumCulling::SetFromLocalBox(buildingBounds, i, XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), buildingWorlds[i]);
+
+	// Small boxes out in the streets, never inside a building
+	std::vector<XMFLOAT3> boxMins, boxMaxes;
+	WorldBounds boxBounds;
+	FrustumCulling::Resize(boxBounds, boxCount);
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	while (boxMins.size() < boxCount)
+	{
+		XMFLOAT3 center(positions(random), boxHeights(random), positions(random));
+		float size = sizes(random);
+
+		bool inBuilding = false;
+		for (size_t b = 0; b < buildingMins.size() && !inBuilding; b++)
+		{
+			inBuilding =
+				center.x + size > buildingMins[b].x && center.x - size < buildingMaxes[b].x &&
+				center.z + size > buildingMins[b].z && center.z - size < buildingMaxes[b].z;
+		}
+		if (inBuilding)
+			continue;
+
+		boxMins.push_back(XMFLOAT3(center.x - size, center.y - size, center.z - size));
+		boxMaxes.push_back(XMFLOAT3(center.x + size, center.y + size, center.z + size));
+		FrustumCulling::SetFromLocalBox(boxBounds, (unsigned int)boxMins.size() - 1, boxMins.back(), boxMaxes.back(), identity);
+	}
+
+	// Standing in a street, looking diagonally across the blocks, after a step forward
+	Camera camera(XMFLOAT3(0.0f, 2.0f, -112.0f), 2.0f, 60.0f);
+	XMFLOAT3 previousPosition(0.0f, 2.0f, -112.5f);
+	XMFLOAT3 previousRotation(0.0f, 0.38f, 0.0f);
+	XMFLOAT3 position(0.0f, 2.0f, -112.0f);
+	XMFLOAT3 rotation(0.0f, 0.4f, 0.0f);
+
+	auto viewProjectionOf = [&camera]()
+		{
+			XMFLOAT4X4 view = camera.GetViewMatrix();
+			XMFLOAT4X4 projection = camera.GetProjectionMatrix();
+			XMFLOAT4X4 viewProjection;
+			XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+			return viewProjection;
+		};
+
+	// Frustum culling first, as Game does
+	std::vector<unsigned int> occluders, candidates, visible;
+	auto cullFrom = [&](OcclusionCuller& culler, XMFLOAT3 from, XMFLOAT3 facing)
+		{
+			camera.SetTranslation(from);
+			camera.SetPitchYawRoll(facing);
+			Frustum frustum = camera.GetFrustum();
+			FrustumCulling::Cull(buildingBounds, frustum, occluders);
+			FrustumCulling::Cull(boxBounds, frustum, candidates);
+
+			culler.BeginFrame(viewProjectionOf());
+			for (unsigned int b : occluders)
+				culler.AddOccluder(cube, buildingWorlds[b]);
+			culler.FinishOccluders();
+			culler.Cull(boxBounds, candidates, visible);
+		};
+
+	struct Configuration { unsigned int threadCount; bool reprojection; };
+	unsigned int allThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	Configuration configurations[] = { { 1, false }, { allThreads, false }, { allThreads, true } };
+
+	for (const Configuration& configuration : configurations)
+	{
+		OcclusionCuller culler(256, 128, configuration.threadCount);
+		culler.SetReprojection(configuration.reprojection);
+
+		OcclusionCullingResult result = {};
+		result.threadCount = configuration.threadCount;
+		result.reprojection = configuration.reprojection;
+
+		for (int iteration = 0; iteration < iterations; iteration++)
+		{
+			if (configuration.reprojection)
+				cullFrom(culler, previousPosition, previousRotation);
+
+			cullFrom(culler, position, rotation);
+			OcclusionStats stats = culler.GetStats();
+			result.rasterMilliseconds += stats.rasterMilliseconds / iterations;
+			result.testMilliseconds += stats.testMilliseconds / iterations;
+			result.occluderTriangles = stats.occluderTriangles;
+			result.testedCount = stats.testedCount;
+			result.culledPercent = stats.testedCount == 0 ? 0.0f : 100.0f * stats.culledCount / stats.testedCount;
+		}
+
+		// Check every culled box (the candidates and visible lists are both sorted)
+		Frustum frustum = camera.GetFrustum();
+		size_t nextVisible = 0;
+		for (unsigned int i : candidates)
+		{
+			if (nextVisible < visible.size() && visible[nextVisible] == i)
+			{
+				nextVisible++;
+				continue;
+			}
+
+			XMVECTOR boxMin = XMLoadFloat3(&boxMins[i]);
+			XMVECTOR boxMax = XMLoadFloat3(&boxMaxes[i]);
+			XMVECTOR center = XMVectorScale(XMVectorAdd(boxMin, boxMax), 0.5f);
+			bool seen = false;
+			for (int sample = 0; sample < 9 && !seen; sample++)
+			{
+				XMVECTOR point = center;
+				if (sample < 8)
+				{
+					XMVECTOR corner = XMVectorSelect(boxMin, boxMax, XMVectorSelectControl(sample & 1, (sample >> 1) & 1, (sample >> 2) & 1, 0));
+					point = XMVectorLerp(center, corner, 0.9f);
+				}
+
+				bool inFrustum = true;
+				for (int p = 0; p < 6 && inFrustum; p++)
+					inFrustum = XMVectorGetX(XMVector4Dot(XMLoadFloat4(&frustum.Planes[p]), XMVectorSetW(point, 1.0f))) >= 0.0f;
+				if (!inFrustum)
+					continue;
+
+				XMFLOAT3 target;
+				XMStoreFloat3(&target, point);
+				seen = true;
+				for (size_t b = 0; b < buildingMins.size() && seen; b++)
+					seen = !SegmentHitsBox(position, target, buildingMins[b], buildingMaxes[b]);
+			}
+
+			if (seen)
+				result.wronglyCulled++;
+		}
+
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Spreads boxes through a cube that grows with the count
+// (so they're about as crowded at every size), then moves
+// some of them each frame
+// - They move fast (up to twice their spacing each frame),
+//    so the tree gets worse quickly enough to be rebuilt
+//    in a short run
+// - Every query's results on the last frame are checked
+//    against testing each box on its own
+// --------------------------------------------------------
+std::vector<EntityBvhResult> Benchmarks::EntityBvh(const std::vector<unsigned int>& entityCounts, const std::vector<float>& movingFractions, unsigned int frames)
+{
+	std::vector<EntityBvhResult> results;
+	frames = std::max(frames, 1u);
+	unsigned int threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	const unsigned int queryCount = 100;
+
+	for (unsigned int entityCount : entityCounts)
+	{
+		for (float movingFraction : movingFractions)
+		{
+			std::mt19937 random(1234);
+			float halfSize = 10.0f * cbrtf((float)entityCount);
+			std::uniform_real_distribution<float> positions(-halfSize, halfSize);
+			std::uniform_real_distribution<float> extents(0.5f, 2.0f);
+			std::uniform_real_distribution<float> steps(-20.0f, 20.0f);
+			std::uniform_real_distribution<float> directions(-1.0f, 1.0f);
+			std::uniform_int_distribution<unsigned int> entities(0, entityCount - 1);
+
+			WorldBounds bounds;
+			FrustumCulling::Resize(bounds, entityCount);
+			for (unsigned int i = 0; i < entityCount; i++)
+			{
+				bounds.CenterX[i] = positions(random);
+				bounds.CenterY[i] = positions(random);
+				bounds.CenterZ[i] = positions(random);
+				bounds.ExtentX[i] = extents(random);
+				bounds.ExtentY[i] = extents(random);
+				bounds.ExtentZ[i] = extents(random);
+				bounds.Radius[i] = sqrtf(bounds.ExtentX[i] * bounds.ExtentX[i] + bounds.ExtentY[i] * bounds.ExtentY[i] + bounds.ExtentZ[i] * bounds.ExtentZ[i]);
+			}
+
+			EntityBvhResult result = {};
+			result.entityCount = entityCount;
+			result.movingCount = (unsigned int)(entityCount * movingFraction);
+
+			SceneBvh bvh(threadCount);
+			bvh.Build(bounds);
+			result.buildMilliseconds = bvh.GetStats().buildMilliseconds;
+
+			// Looking in from one side of the cube
+			Camera camera(XMFLOAT3(0.0f, 0.0f, -halfSize * 1.2f), 16.0f / 9.0f, 60.0f, 1.0f, 0.005f, halfSize * 2.0f, 0.1f);
+			Frustum frustum = camera.GetFrustum();
+
+			std::vector<unsigned int> moved, found, expected;
+			bool matches = true;
+			for (unsigned int frame = 0; frame < frames; frame++)
+			{
+				// Some entities may be picked twice, which is fine for a refit
+				moved.clear();
+				for (unsigned int m = 0; m < result.movingCount; m++)
+				{
+					unsigned int i = entities(random);
+					bounds.CenterX[i] += steps(random);
+					bounds.CenterY[i] += steps(random);
+					bounds.CenterZ[i] += steps(random);
+					moved.push_back(i);
+				}
+
+				bvh.Refit(bounds, moved);
+				SceneBvhStats stats = bvh.GetStats();
+				result.refitMilliseconds += stats.refitMilliseconds / frames;
+				result.rebuiltSubtrees += stats.rebuiltSubtrees;
+				result.fullRebuilds += stats.fullRebuild ? 1 : 0;
+				result.costRatio = stats.costRatio;
+
+				bool lastFrame = frame + 1 == frames;
+				auto checkAgainst = [&](auto passes)
+					{
+						if (!lastFrame)
+							return;
+						expected.clear();
+						for (unsigned int i = 0; i < entityCount; i++)
+						{
+							if (passes(i))
+								expected.push_back(i);
+						}
+						std::sort(found.begin(), found.end());
+						matches = matches && found == expected;
+					};
+
+				auto start = std::chrono::high_resolution_clock::now();
+				bvh.QueryFrustum(frustum, found);
+				result.frustumMicroseconds += SecondsSince(start) * 1000000.0 / frames;
+				checkAgainst([&](unsigned int i)
+					{
+						return frustum.IntersectsBox(XMFLOAT3(bounds.CenterX[i], bounds.CenterY[i], bounds.CenterZ[i]), XMFLOAT3(bounds.ExtentX[i], bounds.ExtentY[i], bounds.ExtentZ[i]));
+					});
+
+				start = std::chrono::high_resolution_clock::now();
+				FrustumCulling::Cull(bounds, frustum, expected);
+				result.linearFrustumMicroseconds += SecondsSince(start) * 1000000.0 / frames;
+
+				for (unsigned int q = 0; q < queryCount; q++)
+				{
+					XMFLOAT3 center(positions(random), positions(random), positions(random));
+					float radius = 20.0f;
+
+					start = std::chrono::high_resolution_clock::now();
+					bvh.QuerySphere(center, radius, found);
+					result.sphereMicroseconds += SecondsSince(start) * 1000000.0 / frames / queryCount;
+					if (q == 0)
+					{
+						checkAgainst([&](unsigned int i)
+							{
+								float x = center.x - std::clamp(center.x, bounds.CenterX[i] - bounds.ExtentX[i], bounds.CenterX[i] + bounds.ExtentX[i]);
+								float y = center.y - std::clamp(center.y, bounds.CenterY[i] - bounds.ExtentY[i], bounds.CenterY[i] + bounds.ExtentY[i]);
+								float z = center.z - std::clamp(center.z, bounds.CenterZ[i] - bounds.ExtentZ[i], bounds.CenterZ[i] + bounds.ExtentZ[i]);
+								return x * x + y * y + z * z <= radius * radius;
+							});
+					}
+
+					XMFLOAT3 boxMin(center.x - radius, center.y - radius, center.z - radius);
+					XMFLOAT3 boxMax(center.x + radius, center.y + radius, center.z + radius);
+					start = std::chrono::high_resolution_clock::now();
+					bvh.QueryBox(boxMin, boxMax, found);
+					result.boxMicroseconds += SecondsSince(start) * 1000000.0 / frames / queryCount;
+					if (q == 0)
+					{
+						checkAgainst([&](unsigned int i)
+							{
+								return fabsf(bounds.CenterX[i] - center.x) <= bounds.ExtentX[i] + radius &&
+									fabsf(bounds.CenterY[i] - center.y) <= bounds.ExtentY[i] + radius &&
+									fabsf(bounds.CenterZ[i] - center.z) <= bounds.ExtentZ[i] + radius;
+							});
+					}
+
+					XMFLOAT3 direction(directions(random), directions(random), directions(random));
+					BvhRayHit hit = {};
+					start = std::chrono::high_resolution_clock::now();
+					bool hitSomething = bvh.Raycast(center, direction, halfSize, hit);
+					result.rayMicroseconds += SecondsSince(start) * 1000000.0 / frames / queryCount;
+
+					// Compare distances, since two boxes can be entered at the same point
+					if (lastFrame && q < 10)
+					{
+						XMFLOAT3 normalized;
+						XMStoreFloat3(&normalized, XMVector3Normalize(XMLoadFloat3(&direction)));
+						float closest = FLT_MAX;
+						for (unsigned int i = 0; i < entityCount; i++)
+						{
+							float enter = 0.0f;
+							float exit = halfSize;
+							const float origins[3] = { center.x, center.y, center.z };
+							const float rayDirection[3] = { normalized.x, normalized.y, normalized.z };
+							const float centers[3] = { bounds.CenterX[i], bounds.CenterY[i], bounds.CenterZ[i] };
+							const float halfSizes[3] = { bounds.ExtentX[i], bounds.ExtentY[i], bounds.ExtentZ[i] };
+							for (int axis = 0; axis < 3 && enter <= exit; axis++)
+							{
+								if (rayDirection[axis] == 0.0f)
+								{
+									if (fabsf(origins[axis] - centers[axis]) > halfSizes[axis])
+										exit = -1.0f;
+									continue;
+								}
+								float t0 = (centers[axis] - halfSizes[axis] - origins[axis]) / rayDirection[axis];
+								float t1 = (centers[axis] + halfSizes[axis] - origins[axis]) / rayDirection[axis];
+								enter = std::max(enter, std::min(t0, t1));
+								exit = std::min(exit, std::max(t0, t1));
+							}
+							if (enter <= exit)
+								closest = std::min(closest, enter);
+						}
+
+						bool expectedHit = closest != FLT_MAX;
+						matches = matches && hitSomething == expectedHit && (!expectedHit || fabsf(hit.Distance - closest) <= 1e-3f * std::max(closest, 1.0f));
+					}
+				}
+			}
+
+			result.matchesLinear = matches;
+			results.push_back(result);
+		}
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Rays start on a sphere around each mesh (or the scene)
+// and aim at a random point in its box, so most of them
+// hit something
+// - Brute force is far slower, so it only checks the first
+//    few rays, which are also what's compared
+// - Scene brute force still uses each mesh's BVH, but has
+//    to try every instance
+// --------------------------------------------------------
+std::vector<RayPickingResult> Benchmarks::RayPicking(const std::string& meshDirectory, unsigned int rayCount, unsigned int instanceCount)
+{
+	std::vector<RayPickingResult> results;
+	rayCount = std::max(rayCount, 1u);
+	unsigned int bruteForceRayCount = std::min(rayCount, 1000u);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::normal_distribution<float> normal(0.0f, 1.0f);
+
+	// Random rays from around a box, toward somewhere inside it
+	auto makeRays = [&](XMFLOAT3 boxMin, XMFLOAT3 boxMax, std::vector<XMFLOAT3>& origins, std::vector<XMFLOAT3>& directions)
+		{
+			XMVECTOR minimum = XMLoadFloat3(&boxMin);
+			XMVECTOR size = XMVectorSubtract(XMLoadFloat3(&boxMax), minimum);
+			XMVECTOR center = XMVectorMultiplyAdd(size, XMVectorReplicate(0.5f), minimum);
+			float radius = std::max(XMVectorGetX(XMVector3Length(size)), 0.001f);
+
+			origins.resize(rayCount);
+			directions.resize(rayCount);
+			for (unsigned int i = 0; i < rayCount; i++)
+			{
+				XMVECTOR around = XMVector3Normalize(XMVectorSet(normal(random), normal(random), normal(random), 0.0f));
+				XMVECTOR origin = XMVectorMultiplyAdd(around, XMVectorReplicate(radius), center);
+				XMVECTOR target = XMVectorMultiplyAdd(size, XMVectorSet(unit(random), unit(random), unit(random), 0.0f), minimum);
+				XMStoreFloat3(&origins[i], origin);
+				XMStoreFloat3(&directions[i], XMVector3Normalize(XMVectorSubtract(target, origin)));
+			}
+		};
+
+	// Both must miss, or hit at the same distance (rather than the same
+	// triangle, as a ray through an edge can hit either side of it)
+	auto sameHit = [](bool hitA, float distanceA, bool hitB, float distanceB)
+		{
+			return hitA == hitB && (!hitA || std::abs(distanceA - distanceB) <= 1e-4f * std::max(1.0f, distanceA));
+		};
+
+	std::vector<MeshData> data;
+	std::vector<std::string> names;
+	for (const std::filesystem::path& path : FindObjFiles(meshDirectory))
+	{
+		MappedFile file(path.string().c_str());
+		if (!file.IsOpen())
+			continue;
+
+		data.emplace_back();
+		MeshLoader::LoadObj(file.GetData(), file.GetSize(), data.back(), std::thread::hardware_concurrency());
+		MeshOptimizer::Optimize(data.back());
+		names.push_back(path.filename().string());
+	}
+
+	std::vector<MeshBvh> meshBvhs(data.size());
+	std::vector<XMFLOAT3> origins, directions;
+	for (size_t m = 0; m < data.size(); m++)
+	{
+		const MeshData& mesh = data[m];
+
+		RayPickingResult result = {};
+		result.name = names[m];
+		result.instanceCount = 1;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		meshBvhs[m].Build(mesh.vertices.data(), mesh.indices.data(), (unsigned int)mesh.indices.size());
+		result.buildMilliseconds = SecondsSince(start) * 1000.0;
+		result.triangleCount = meshBvhs[m].GetTriangleCount();
+
+		makeRays(mesh.boundsMin, mesh.boundsMax, origins, directions);
+		std::vector<TriangleRayHit> hits(rayCount);
+		std::vector<char> hit(rayCount);
+
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < rayCount; i++)
+			hit[i] = meshBvhs[m].Raycast(origins[i], directions[i], FLT_MAX, hits[i]);
+		result.raysPerSecond = rayCount / std::max(SecondsSince(start), 1e-9);
+
+		result.matchesBruteForce = true;
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < bruteForceRayCount; i++)
+		{
+			TriangleRayHit bruteForceHit = {};
+			bool bruteForce = meshBvhs[m].RaycastAllTriangles(origins[i], directions[i], FLT_MAX, bruteForceHit);
+			if (!sameHit(hit[i], hits[i].Distance, bruteForce, bruteForceHit.Distance))
+				result.matchesBruteForce = false;
+		}
+		result.bruteForceRaysPerSecond = bruteForceRayCount / std::max(SecondsSince(start), 1e-9);
+
+		result.hitPercent = 100.0f * std::count(hit.begin(), hit.end(), 1) / rayCount;
+		results.push_back(result);
+	}
+
+	if (data.empty() || instanceCount == 0)
+		return results;
+
+	// Instances of every mesh, randomly turned and scaled, spread through
+	// a cube that grows with the count
+	RayPickingResult result = {};
+	result.name = "Scene";
+	result.instanceCount = instanceCount;
+
+	float halfSize = 3.0f * cbrtf((float)instanceCount);
+	std::vector<const MeshBvh*> instanceMeshes(instanceCount);
+	std::vector<XMFLOAT4X4> worldMatrices(instanceCount);
+	WorldBounds bounds;
+	FrustumCulling::Resize(bounds, instanceCount);
+	for (unsigned int i = 0; i < instanceCount; i++)
+	{
+		size_t m = i % data.size();
+		XMMATRIX world = XMMatrixScaling(0.5f + unit(random) * 1.5f, 0.5f + unit(random) * 1.5f, 0.5f + unit(random) * 1.5f) *
+			XMMatrixRotationRollPitchYaw(unit(random) * XM_2PI, unit(random) * XM_2PI, unit(random) * XM_2PI) *
+			XMMatrixTranslation((unit(random) * 2.0f - 1.0f) * halfSize, (unit(random) * 2.0f - 1.0f) * halfSize, (unit(random) * 2.0f - 1.0f) * halfSize);
+		XMStoreFloat4x4(&worldMatrices[i], world);
+		instanceMeshes[i] = &meshBvhs[m];
+		FrustumCulling::SetFromLocalBox(bounds, i, data[m].boundsMin, data[m].boundsMax, worldMatrices[i]);
+		result.triangleCount += meshBvhs[m].GetTriangleCount();
+	}
+
+	SceneBvh instanceBvh;
+	auto start = std::chrono::high_resolution_clock::now();
+	instanceBvh.Build(bounds);
+	result.buildMilliseconds = SecondsSince(start) * 1000.0;
+
+	makeRays(XMFLOAT3(-halfSize, -halfSize, -halfSize), XMFLOAT3(halfSize, halfSize, halfSize), origins, directions);
+	std::vector<PickHit> hits(rayCount);
+	std::vector<char> hit(rayCount);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < rayCount; i++)
+		hit[i] = Picking::Raycast(instanceBvh, instanceMeshes, worldMatrices, origins[i], directions[i], FLT_MAX, hits[i]);
+	result.raysPerSecond = rayCount / std::max(SecondsSince(start), 1e-9);
+
+	result.matchesBruteForce = true;
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < bruteForceRayCount; i++)
+	{
+		XMVECTOR origin = XMLoadFloat3(&origins[i]);
+		XMVECTOR direction = XMLoadFloat3(&directions[i]);
+		float closest = FLT_MAX;
+		bool found = false;
+		for (unsigned int j = 0; j < instanceCount; j++)
+		{
+			XMMATRIX inverseWorld = XMMatrixInverse(nullptr, XMLoadFloat4x4(&worldMatrices[j]));
+			XMFLOAT3 localOrigin, localDirection;
+			XMStoreFloat3(&localOrigin, XMVector3Transform(origin, inverseWorld));
+			XMStoreFloat3(&localDirection, XMVector3TransformNormal(direction, inverseWorld));
+
+			TriangleRayHit instanceHit;
+			if (instanceMeshes[j]->Raycast(localOrigin, localDirection, closest, instanceHit))
+			{
+				closest = instanceHit.Distance;
+				found = true;
+			}
+		}
+		if (!sameHit(hit[i], hits[i].Distance, found, closest))
+			result.matchesBruteForce = false;
+	}
+	result.bruteForceRaysPerSecond = bruteForceRayCount / std::max(SecondsSince(start), 1e-9);
+
+	result.hitPercent = 100.0f * std::count(hit.begin(), hit.end(), 1) / rayCount;
+	results.push_back(result);
+	return results;
+}
+
+// --------------------------------------------------------
+// Every entity spins a little each frame, then has its
+// world bounds and draw list item built, as Game does
+// before culling
+// - Half are occluders, so the store has two archetypes
+// - Both layouts are created the same way, in one go, so
+//    the pointer layout's heap objects are about as close
+//    together as they'll ever be
+// --------------------------------------------------------
+std::vector<EntityStorageResult> Benchmarks::EntityStorage(const std::vector<unsigned int>& entityCounts, unsigned int frames)
+{
+	std::vector<EntityStorageResult> results;
+	frames = std::max(frames, 1u);
+	const float deltaTime = 1.0f / 60.0f;
+	const unsigned int meshCount = 7;
+
+	std::vector<std::shared_ptr<PointerLayoutMesh>> meshes;
+	std::vector<std::shared_ptr<PointerLayoutMaterial>> materials;
+	for (unsigned int i = 0; i < meshCount; i++)
+	{
+		meshes.push_back(std::make_shared<PointerLayoutMesh>(PointerLayoutMesh{ XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f + i, 1.0f), MeshHandle{ i } }));
+		materials.push_back(std::make_shared<PointerLayoutMaterial>(PointerLayoutMaterial{ MaterialHandle{ i } }));
+	}
+
+	for (unsigned int entityCount : entityCounts)
+	{
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> positions(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> angles(-XM_PI, XM_PI);
+		std::uniform_real_distribution<float> scales(0.5f, 2.0f);
+
+		TransformSystem transformSystem;
+		std::vector<std::shared_ptr<PointerLayoutEntity>> pointerEntities;
+		EntityStore store;
+		for (unsigned int i = 0; i < entityCount; i++)
+		{
+			XMFLOAT3 translation(positions(random), positions(random), positions(random));
+			XMFLOAT3 pitchYawRoll(angles(random), angles(random), angles(random));
+			float scale = scales(random);
+			unsigned int mesh = i % meshCount;
+			unsigned int material = (i / meshCount) % meshCount;
+
+			pointerEntities.push_back(std::make_shared<PointerLayoutEntity>(meshes[mesh], materials[material], transformSystem));
+			std::shared_ptr<Transform> transform = pointerEntities.back()->GetTransform();
+			transform->SetTranslation(translation);
+			transform->SetPitchYawRoll(pitchYawRoll);
+			transform->SetScale(scale, scale, scale);
+
+			ComponentMask mask = Components::Transform | Components::Renderable | Components::Bounds | Components::Spin;
+			EntityId entity = store.Create(i % 2 ? mask | Components::Occluder : mask);
+			LocalTransform local = { translation, transform->GetRotation(), XMFLOAT3(scale, scale, scale) };
+			store.SetTransform(entity, local);
+			*store.GetRenderable(entity) = { MeshHandle{ mesh }, MaterialHandle{ material } };
+			*store.GetBounds(entity) = { meshes[mesh]->boundsMin, meshes[mesh]->boundsMax };
+			store.GetSpin(entity)->PitchYawRollPerSecond = XMFLOAT3(0.0f, 1.0f, 0.0f);
+		}
+
+		WorldBounds bounds;
+		FrustumCulling::Resize(bounds, entityCount);
+		std::vector<DrawListItem> pointerDrawList(entityCount);
+		std::vector<DrawListItem> storeDrawList(entityCount);
+		std::vector<unsigned int> storeEntityIndices(entityCount);
+
+		EntityStorageResult pointer = {};
+		pointer.layout = "shared_ptr entities";
+		pointer.entityCount = entityCount;
+		pointer.matchesPointerLayout = true;
+
+		EntityStorageResult archetypes = {};
+		archetypes.layout = "Archetype store";
+		archetypes.entityCount = entityCount;
+
+		for (unsigned int frame = 0; frame < frames; frame++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			for (const std::shared_ptr<PointerLayoutEntity>& entity : pointerEntities)
+				entity->GetTransform()->Rotate(0.0f, deltaTime, 0.0f);
+			transformSystem.UpdateWorldMatrices();
+			pointer.updateMilliseconds += SecondsSince(start) * 1000.0;
+
+			start = std::chrono::high_resolution_clock::now();
+			for (unsigned int i = 0; i < entityCount; i++)
+			{
+				std::shared_ptr<PointerLayoutMesh> mesh = pointerEntities[i]->GetMesh();
+				XMFLOAT4X4 world = pointerEntities[i]->GetTransform()->GetWorldMatrix();
+				FrustumCulling::SetFromLocalBox(bounds, i, mesh->boundsMin, mesh->boundsMax, world);
+				pointerDrawList[i] = { mesh->handle, pointerEntities[i]->GetMaterial()->handle, world, pointerEntities[i]->GetTransform()->GetWorldInvTranspose() };
+			}
+			pointer.drawListMilliseconds += SecondsSince(start) * 1000.0;
+
+			start = std::chrono::high_resolution_clock::now();
+			store.UpdateSpins(deltaTime);
+			store.UpdateWorldMatrices();
+			archetypes.updateMilliseconds += SecondsSince(start) * 1000.0;
+
+			start = std::chrono::high_resolution_clock::now();
+			unsigned int next = 0;
+			store.ForEach(Components::Transform | Components::Renderable | Components::Bounds, [&](EntityArchetype& archetype)
+				{
+					for (unsigned int row = 0; row < archetype.GetCount(); row++, next++)
+					{
+						FrustumCulling::SetFromLocalBox(bounds, next, archetype.Bounds[row].Min, archetype.Bounds[row].Max, archetype.Worlds[row]);
+						storeDrawList[next] = { archetype.Renderables[row].Mesh, archetype.Renderables[row].Material, archetype.Worlds[row], archetype.WorldInverseTransposes[row] };
+						storeEntityIndices[next] = archetype.Entities[row].Index;
+					}
+				});
+			archetypes.drawListMilliseconds += SecondsSince(start) * 1000.0;
+		}
+
+		// Same items, though the store lists them by archetype
+		archetypes.matchesPointerLayout = true;
+		for (unsigned int i = 0; i < entityCount; i++)
+		{
+			const DrawListItem& a = storeDrawList[i];
+			const DrawListItem& b = pointerDrawList[storeEntityIndices[i]];
+			bool same = a.mesh == b.mesh && a.material == b.material;
+			for (int row = 0; row < 4 && same; row++)
+			{
+				for (int column = 0; column < 4; column++)
+				{
+					same &= fabsf(a.world.m[row][column] - b.world.m[row][column]) <= 1e-3f * std::max(1.0f, fabsf(b.world.m[row][column]));
+					same &= fabsf(a.worldInverseTranspose.m[row][column] - b.worldInverseTranspose.m[row][column]) <= 1e-3f * std::max(1.0f, fabsf(b.worldInverseTranspose.m[row][column]));
+				}
+			}
+			if (!same)
+				archetypes.matchesPointerLayout = false;
+		}
+
+		pointer.updateMilliseconds /= frames;
+		pointer.drawListMilliseconds /= frames;
+		archetypes.updateMilliseconds /= frames;
+		archetypes.drawListMilliseconds /= frames;
+		results.push_back(pointer);
+		results.push_back(archetypes);
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Looks up each draw's mesh, material, shaders and four
+// textures, the way Game's draw loop does, once through
+// shared_ptrs held by each entity (as GameEntity did) and
+// once through handles into pools
+// - A checksum of everything found makes sure the two find
+//    the same resources, and that nothing is optimized away
+// --------------------------------------------------------
+std::vector<ResourceLookupResult> Benchmarks::ResourceLookups(unsigned int drawCount, unsigned int frames)
+{
+	const unsigned int meshCount = 16;
+	const unsigned int materialCount = 64;
+	const unsigned int texturesPerMaterial = 4;
+	frames = std::max(frames, 1u);
+
+	std::vector<std::shared_ptr<LookupView>> shaders;
+	for (unsigned int i = 0; i < 8; i++)
+		shaders.push_back(std::make_shared<LookupView>(LookupView{ i }));
+
+	// The same resources, both ways
+	std::vector<std::shared_ptr<LookupMesh>> sharedMeshes;
+	std::vector<std::shared_ptr<SharedLookupMaterial>> sharedMaterials;
+	ResourcePool<LookupMesh> meshPool;
+	ResourcePool<PooledLookupMaterial> materialPool;
+	ResourcePool<LookupView> texturePool;
+	std::vector<ResourceHandle<LookupMesh>> meshHandles;
+	std::vector<ResourceHandle<PooledLookupMaterial>> materialHandles;
+
+	for (unsigned int i = 0; i < meshCount; i++)
+	{
+		sharedMeshes.push_back(std::make_shared<LookupMesh>(LookupMesh{ 36 * (i + 1) }));
+		meshHandles.push_back(meshPool.Add({ 36 * (i + 1) }));
+	}
+
+	for (unsigned int i = 0; i < materialCount; i++)
+	{
+		std::shared_ptr<SharedLookupMaterial> shared = std::make_shared<SharedLookupMaterial>();
+		PooledLookupMaterial pooled;
+		shared->vertexShader = pooled.vertexShader = shaders[i % 2];
+		shared->pixelShader = pooled.pixelShader = shaders[2 + i % 6];
+		for (unsigned int slot = 0; slot < texturesPerMaterial; slot++)
+		{
+			unsigned int id = 100 + i * texturesPerMaterial + slot;
+			shared->textures[slot] = std::make_shared<LookupView>(LookupView{ id });
+			pooled.textures[slot] = texturePool.Add({ id });
+		}
+
+		sharedMaterials.push_back(shared);
+		materialHandles.push_back(materialPool.Add(std::move(pooled)));
+	}
+
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<unsigned int> meshIndices(0, meshCount - 1);
+	std::uniform_int_distribution<unsigned int> materialIndices(0, materialCount - 1);
+	std::vector<std::shared_ptr<SharedLookupEntity>> sharedEntities;
+	std::vector<ResourceHandle<LookupMesh>> drawMeshes;
+	std::vector<ResourceHandle<PooledLookupMaterial>> drawMaterials;
+	for (unsigned int i = 0; i < drawCount; i++)
+	{
+		unsigned int mesh = meshIndices(random);
+		unsigned int material = materialIndices(random);
+		sharedEntities.push_back(std::make_shared<SharedLookupEntity>(sharedMeshes[mesh], sharedMaterials[material]));
+		drawMeshes.push_back(meshHandles[mesh]);
+		drawMaterials.push_back(materialHandles[material]);
+	}
+
+	ResourceLookupResult shared = {};
+	shared.method = "shared_ptr and ComPtr copies";
+	shared.drawCount = drawCount;
+	shared.staleHandlesCaught = true;
+
+	ResourceLookupResult pooled = {};
+	pooled.method = "Pooled handles";
+	pooled.drawCount = drawCount;
+	pooled.staleHandlesCaught = CheckResourcePoolHandles();
+
+	unsigned long long sharedChecksum = 0;
+	unsigned long long pooledChecksum = 0;
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (const std::shared_ptr<SharedLookupEntity>& entity : sharedEntities)
+		{
+			std::shared_ptr<LookupMesh> mesh = entity->GetMesh();
+			std::shared_ptr<SharedLookupMaterial> material = entity->GetMaterial();
+			sharedChecksum += mesh->indexCount + material->GetVertexShader()->id + material->GetPixelShader()->id;
+			for (const auto& [slot, texture] : material->textures)
+				sharedChecksum += texture->id * (slot + 1);
+		}
+		shared.milliseconds += SecondsSince(start) * 1000.0;
+
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < drawCount; i++)
+		{
+			LookupMesh* mesh = meshPool.Get(drawMeshes[i]);
+			PooledLookupMaterial* material = materialPool.Get(drawMaterials[i]);
+			if (!mesh || !material)
+				continue;
+
+			pooledChecksum += mesh->indexCount + material->GetVertexShader()->id + material->GetPixelShader()->id;
+			for (const auto& [slot, handle] : material->textures)
+			{
+				const LookupView* texture = texturePool.Get(handle);
+				pooledChecksum += texture ? texture->id * (slot + 1) : 0;
+			}
+		}
+		pooled.milliseconds += SecondsSince(start) * 1000.0;
+	}
+
+	shared.milliseconds /= frames;
+	pooled.milliseconds /= frames;
+	shared.matchesSharedPointers = true;
+	pooled.matchesSharedPointers = pooledChecksum == sharedChecksum;
+	return { shared, pooled };
+}
+
+// --------------------------------------------------------
+// Draws use a few shaders, a couple of hundred materials
+// and fifty meshes, at random, with a fifth of them
+// transparent
+// - Every sort starts from the same unsorted list, and is
+//    checked against the original keys and std::sort
+// --------------------------------------------------------
+std::vector<DrawListSortResult> Benchmarks::DrawListSorting(unsigned int drawCount, int iterations)
+{
+	std::vector<DrawListSortResult> results;
+	iterations = std::max(iterations, 1);
+
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<unsigned int> shaders(0, 3);
+	std::uniform_int_distribution<unsigned int> materials(0, 199);
+	std::uniform_int_distribution<unsigned int> meshes(0, 49);
+	std::uniform_real_distribution<float> depths(0.5f, 500.0f);
+	std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+
+	std::vector<unsigned long long> keys(drawCount);
+	for (unsigned int i = 0; i < drawCount; i++)
+	{
+		DrawPass pass = chance(random) < 0.2f ? DrawPass::Transparent : DrawPass::Opaque;
+		keys[i] = DrawList::MakeKey(pass, shaders(random), materials(random), meshes(random), depths(random));
+	}
+
+	auto makeResult = [&](const char* method, unsigned int threadCount, double milliseconds, const std::vector<unsigned long long>& sorted)
+		{
+			DrawListSortResult result = {};
+			result.method = method;
+			result.drawCount = drawCount;
+			result.threadCount = threadCount;
+			result.milliseconds = milliseconds;
+			result.millionKeysPerSecond = milliseconds > 0.0 ? drawCount / (milliseconds * 1000.0) : 0.0;
+
+			DrawStateChanges changes = DrawList::CountStateChanges(sorted.data(), sorted.size());
+			result.shaderChanges = changes.shaders;
+			result.materialChanges = changes.materials;
+			result.meshChanges = changes.meshes;
+			return result;
+		};
+
+	DrawListSortResult unsorted = makeResult("Insertion order", 1, 0.0, keys);
+	unsorted.correct = true;
+	results.push_back(unsorted);
+
+	std::vector<unsigned long long> expected;
+	double milliseconds = 0.0;
+	for (int i = 0; i < iterations; i++)
+	{
+		expected = keys;
+		auto start = std::chrono::high_resolution_clock::now();
+		std::sort(expected.begin(), expected.end());
+		milliseconds += SecondsSince(start) * 1000.0;
+	}
+	DrawListSortResult standard = makeResult("std::sort", 1, milliseconds / iterations, expected);
+	standard.correct = std::is_sorted(expected.begin(), expected.end());
+	results.push_back(standard);
+
+	std::vector<unsigned int> threadCounts = { 1 };
+	if (std::thread::hardware_concurrency() > 1)
+		threadCounts.push_back(std::thread::hardware_concurrency());
+
+	for (unsigned int threads : threadCounts)
+	{
+		DrawList list(threads);
+		milliseconds = 0.0;
+		for (int i = 0; i < iterations; i++)
+		{
+			list.Clear();
+			for (unsigned int draw = 0; draw < drawCount; draw++)
+				list.Add(keys[draw], draw);
+
+			list.Sort();
+			milliseconds += list.GetStats().sortMilliseconds;
+		}
+
+		// Same keys as std::sort, each with the item it was added with, and
+		// equal keys still in the order they were added
+		const std::vector<unsigned long long>& sorted = list.GetKeys();
+		const std::vector<unsigned int>& items = list.GetItems();
+		bool correct = sorted == expected;
+		for (unsigned int draw = 0; draw < drawCount && correct; draw++)
+		{
+			correct = keys[items[draw]] == sorted[draw];
+			if (draw > 0 && sorted[draw] == sorted[draw - 1])
+				correct &= items[draw] > items[draw - 1];
+		}
+
+		DrawListSortResult radix = makeResult("Radix sort", list.GetStats().threadCount, milliseconds / iterations, sorted);
+		radix.correct = correct;
+		results.push_back(radix);
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// A grid of spheres (one mesh), each with one of a handful
+// of materials and a LOD from its distance, like the stress
+// scene in Game
+// - Both paths start from the same sorted draw list; one
+//    fills a constant buffer's worth of data per draw (as
+//    Game's draw loop does), the other groups draws and
+//    packs their matrices for an instance buffer
+// - Instances are checked against the matrices they came
+//    from, in draw list order
+// --------------------------------------------------------
+std::vector<InstanceBatchingResult> Benchmarks::InstanceBatching(unsigned int entityCount, unsigned int materialCount, int iterations)
+{
+	iterations = std::max(iterations, 1);
+	materialCount = std::max(materialCount, 1u);
+
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<unsigned int> materials(0, materialCount - 1);
+	std::uniform_real_distribution<float> angles(0.0f, XM_2PI);
+
+	// Stand in for the camera looking down the grid
+	unsigned int gridSize = (unsigned int)ceilf(sqrtf((float)entityCount));
+	std::vector<XMFLOAT4X4> worlds(entityCount);
+	std::vector<XMFLOAT4X4> inverseTransposes(entityCount);
+	std::vector<unsigned int> drawMaterials(entityCount);
+	std::vector<int> drawLods(entityCount);
+	DrawList list;
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		float depth = (float)(i / gridSize) + 2.0f;
+		XMMATRIX world = XMMatrixScaling(0.3f, 0.3f, 0.3f) *
+			XMMatrixRotationY(angles(random)) *
+			XMMatrixTranslation((float)(i % gridSize) - gridSize * 0.5f, -2.0f, depth);
+		XMStoreFloat4x4(&worlds[i], world);
+		XMStoreFloat4x4(&inverseTransposes[i], XMMatrixInverse(0, XMMatrixTranspose(world)));
+		drawMaterials[i] = materials(random);
+		drawLods[i] = std::min((int)(depth / 25.0f), 3);
+
+		list.Add(DrawList::MakeKey(DrawPass::Opaque, 0, drawMaterials[i], 0, depth), i);
+	}
+	list.Sort();
+	const std::vector<unsigned int>& order = list.GetItems();
+
+	InstanceBatchingResult perEntity = {};
+	perEntity.method = "One draw per entity";
+	perEntity.entityCount = entityCount;
+	perEntity.drawCalls = entityCount;
+	perEntity.correct = true;
+
+	InstanceBatchingResult instanced = {};
+	instanced.method = "Instanced";
+	instanced.entityCount = entityCount;
+	instanced.correct = CheckInstanceBatcher();
+
+	std::vector<VertexShaderExternalData> constantData(entityCount);
+
+	InstanceBatcher batcher;
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int draw = 0; draw < entityCount; draw++)
+		{
+			unsigned int i = order[draw];
+			constantData[draw] = { worlds[i], inverseTransposes[i] };
+		}
+		perEntity.milliseconds += SecondsSince(start) * 1000.0;
+
+		start = std::chrono::high_resolution_clock::now();
+		batcher.Clear();
+		for (unsigned int i : order)
+			batcher.Add(0, drawMaterials[i], drawLods[i], worlds[i], inverseTransposes[i]);
+		instanced.milliseconds += SecondsSince(start) * 1000.0;
+	}
+
+	// Every draw made it into a batch with its own material and LOD, and
+	// its matrices are where that batch says they are
+	const std::vector<InstanceBatch>& batches = batcher.GetBatches();
+	const std::vector<InstanceData>& instances = batcher.GetInstances();
+	unsigned int batchedInstances = 0;
+	for (const InstanceBatch& batch : batches)
+	{
+		instanced.correct &= batch.FirstInstance == batchedInstances;
+		for (unsigned int n = 0; n < batch.InstanceCount && instanced.correct; n++)
+		{
+			unsigned int i = order[batch.FirstInstance + n];
+			instanced.correct &=
+				drawMaterials[i] == batch.Material && drawLods[i] == batch.Lod &&
+				memcmp(&instances[batch.FirstInstance + n].world, &worlds[i], sizeof(XMFLOAT4X4)) == 0 &&
+				memcmp(&instances[batch.FirstInstance + n].worldInvTranspose, &inverseTransposes[i], sizeof(XMFLOAT4X4)) == 0;
+		}
+		batchedInstances += batch.InstanceCount;
+	}
+	instanced.correct &= batchedInstances == entityCount;
+	instanced.drawCalls = (unsigned int)batches.size();
+
+	perEntity.milliseconds /= iterations;
+	instanced.milliseconds /= iterations;
+	return { perEntity, instanced };
+}
+
+// --------------------------------------------------------
+// Each scenario has a number of draws per frame, each
+// allocating a constant buffer's worth (like Game does),
+// and how many frames the GPU lags behind
+// - Starts from a small ring, so it has to grow; when it
+//    runs out, it's replaced by one twice the size, just as
+//    Graphics::AllocateConstantBuffer() does
+// - Checked by marking which frame owns every 256 bytes of
+//    the ring, and freeing them as frames are retired
+// --------------------------------------------------------
+std::vector<ConstantBufferRingResult> Benchmarks::ConstantBufferRingFrames(unsigned int frames)
+{
+	struct Scenario
+	{
+		const char* name;
+		unsigned int minDraws;
+		unsigned int maxDraws;
+		unsigned int latency;	// Frames between a frame ending and the GPU finishing it
+		unsigned int spikeEvery;	// Every this many frames draws ten times as much (0 for never)
+	};
+	const Scenario scenarios[] = {
+		{ "Steady, 2 frames behind", 500, 1500, 2, 0 },
+		{ "Steady, 3 frames behind", 500, 1500, 3, 0 },
+		{ "Spikes, 2 frames behind", 200, 400, 2, 50 },
+		{ "Stress scene, 3 frames behind", 9000, 11000, 3, 0 },
+	};
+	const unsigned int startingCapacity = 64 * 1024;
+
+	std::vector<ConstantBufferRingResult> results;
+	for (const Scenario& scenario : scenarios)
+	{
+		ConstantBufferRingResult result = {};
+		result.scenario = scenario.name;
+		result.frames = frames;
+
+		// How many draws each frame has, and the size of each one's constants
+		std::mt19937 random(1234);
+		std::uniform_int_distribution<unsigned int> draws(scenario.minDraws, scenario.maxDraws);
+		std::uniform_int_distribution<unsigned int> sizes(16, 400);
+		std::vector<unsigned int> frameDraws(frames);
+		std::vector<unsigned int> drawSizes;
+		for (unsigned int frame = 0; frame < frames; frame++)
+		{
+			frameDraws[frame] = draws(random);
+			if (scenario.spikeEvery && frame % scenario.spikeEvery == scenario.spikeEvery - 1)
+				frameDraws[frame] *= 10;
+			for (unsigned int draw = 0; draw < frameDraws[frame]; draw++)
+				drawSizes.push_back(sizes(random));
+		}
+
+		// The same frames twice: once checked, then once timed
+		auto run = [&](bool check)
+			{
+				// Which frame owns each 256-byte block (-1 for none), and the
+				// blocks each frame in flight is holding on to
+				ConstantBufferRing ring(startingCapacity);
+				std::vector<long long> owners(startingCapacity / ConstantBufferRing::Alignment, -1);
+				std::deque<std::vector<unsigned int>> frameBlocks;
+				std::vector<unsigned int> currentBlocks;
+
+				bool correct = true;
+				unsigned int allocations = 0;
+				unsigned int grows = 0;
+				for (unsigned int frame = 0; frame < frames; frame++)
+				{
+					for (unsigned int draw = 0; draw < frameDraws[frame]; draw++)
+					{
+						unsigned int size = drawSizes[allocations];
+						unsigned int offset = 0;
+						if (!ring.Allocate(size, offset))
+						{
+							// Everything still in flight is in the old ring's buffer
+							ring.Reset(ring.GetCapacity() * 2);
+							correct &= ring.Allocate(size, offset);
+							grows++;
+
+							if (check)
+							{
+								owners.assign(ring.GetCapacity() / ConstantBufferRing::Alignment, -1);
+								frameBlocks.clear();
+								currentBlocks.clear();
+							}
+						}
+						allocations++;
+
+						if (check)
+						{
+							unsigned int first = offset / ConstantBufferRing::Alignment;
+							unsigned int last = first + (size + ConstantBufferRing::Alignment - 1) / ConstantBufferRing::Alignment;
+							correct &= offset % ConstantBufferRing::Alignment == 0 && last <= owners.size();
+							for (unsigned int block = first; block < last && block < owners.size(); block++)
+							{
+								correct &= owners[block] == -1;
+								owners[block] = frame;
+								currentBlocks.push_back(block);
+							}
+						}
+					}
+
+					ring.EndFrame();
+					if (check)
+					{
+						frameBlocks.push_back(std::move(currentBlocks));
+						currentBlocks.clear();
+					}
+
+					// The GPU finishes frames a few behind
+					if (frame >= scenario.latency)
+					{
+						ring.RetireFrame(frame - scenario.latency);
+						while (check && frameBlocks.size() > scenario.latency)
+						{
+							for (unsigned int block : frameBlocks.front())
+								owners[block] = -1;
+							frameBlocks.pop_front();
+						}
+					}
+				}
+
+				// Once the GPU catches up, the whole ring is free again
+				ring.RetireFrame(frames);
+				correct &= ring.GetUsedBytes() == 0 && ring.GetFramesInFlight() == 0;
+
+				result.allocations = allocations;
+				result.grows = grows;
+				result.finalCapacityKB = ring.GetCapacity() / 1024;
+				return correct;
+			};
+
+		result.correct = run(true);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		run(false);
+		double seconds = SecondsSince(start);
+		result.millionAllocationsPerSecond = seconds > 0.0 ? result.allocations / seconds / 1000000.0 : 0.0;
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Binds the way Game does: on a material change, its four
+// textures, its sampler and its constants; every draw, its
+// own constants
+// - Textures come from a smaller set than materials need,
+//    so some are shared, and every material uses the same
+//    sampler (like Game's)
+// - Pointers are stand-ins (just numbers); the calls go to
+//    a pretend device, checked against each draw's material
+//    after every flush
+// --------------------------------------------------------
+std::vector<StateTrackingResult> Benchmarks::StateTracking(unsigned int draws, unsigned int materialCount)
+{
+	const unsigned int TexturesPerMaterial = 4;
+	const unsigned int ResourceSlots = 128;
+	const unsigned int SamplerSlots = 16;
+	const unsigned int ConstantBufferSlots = 14;
+	materialCount = std::max(materialCount, 1u);
+
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<unsigned int> textureIndex(1, std::max(materialCount * TexturesPerMaterial / 2, 1u));
+	std::vector<unsigned int> materialTextures(materialCount * TexturesPerMaterial);
+	for (unsigned int& texture : materialTextures)
+		texture = textureIndex(random);
+
+	auto pretend = [](unsigned long long value) { return reinterpret_cast<const void*>((uintptr_t)value); };
+	const void* sharedSampler = pretend(0x5a);
+
+	// Sorted (like DrawList), and shuffled
+	std::vector<unsigned int> sortedOrder(draws);
+	for (unsigned int i = 0; i < draws; i++)
+		sortedOrder[i] = i * materialCount / std::max(draws, 1u);
+	std::vector<unsigned int> randomOrder = sortedOrder;
+	std::shuffle(randomOrder.begin(), randomOrder.end(), random);
+
+	auto run = [&](const char* scenario, const std::vector<unsigned int>& order)
+		{
+			StateTrackingResult result = {};
+			result.scenario = scenario;
+			result.draws = draws;
+			result.correct = true;
+
+			BindingSlots<const void*, ResourceSlots> resources;
+			BindingSlots<const void*, SamplerSlots> samplers;
+			BindingSlots<unsigned long long, ConstantBufferSlots> constantBuffers;
+
+			// What the pretend device has bound
+			std::vector<const void*> deviceResources(ResourceSlots, nullptr);
+			std::vector<const void*> deviceSamplers(SamplerSlots, nullptr);
+			std::vector<unsigned long long> deviceConstantBuffers(ConstantBufferSlots, 0);
+
+			unsigned long long constantOffset = 1;
+			unsigned long long materialOffset = 0;
+			unsigned int boundMaterial = UINT_MAX;
+			for (unsigned int draw = 0; draw < draws; draw++)
+			{
+				unsigned int material = order[draw];
+				if (draw == 0)
+				{
+					constantBuffers.Set(0, constantOffset++);	// Per-frame
+					result.requested++;
+				}
+
+				if (material != boundMaterial)
+				{
+					for (unsigned int t = 0; t < TexturesPerMaterial; t++)
+						resources.Set(t, pretend(materialTextures[material * TexturesPerMaterial + t]));
+					samplers.Set(0, sharedSampler);
+					materialOffset = constantOffset++;
+					constantBuffers.Set(1, materialOffset);
+					result.requested += TexturesPerMaterial + 2;
+					boundMaterial = material;
+				}
+
+				unsigned long long objectOffset = constantOffset++;
+				constantBuffers.Set(2, objectOffset);
+				result.requested++;
+
+				// Draw
+				result.issued += resources.Flush([&](unsigned int first, unsigned int count, const void* const* values)
+					{
+						std::copy(values, values + count, deviceResources.begin() + first);
+					});
+				result.issued += samplers.Flush([&](unsigned int first, unsigned int count, const void* const* values)
+					{
+						std::copy(values, values + count, deviceSamplers.begin() + first);
+					});
+				result.issued += constantBuffers.Flush([&](unsigned int first, unsigned int count, const unsigned long long* values)
+					{
+						std::copy(values, values + count, deviceConstantBuffers.begin() + first);
+					});
+
+				for (unsigned int t = 0; t < TexturesPerMaterial; t++)
+					result.correct &= deviceResources[t] == pretend(materialTextures[material * TexturesPerMaterial + t]);
+				result.correct &= deviceSamplers[0] == sharedSampler;
+				result.correct &= deviceConstantBuffers[0] == 1 && deviceConstantBuffers[1] == materialOffset && deviceConstantBuffers[2] == objectOffset;
+			}
+
+			// Forgetting what's bound sends everything again
+			resources.Invalidate();
+			resources.Set(0, deviceResources[0]);
+			result.correct &= resources.Flush([](unsigned int, unsigned int, const void* const*) {}) == 1;
+			return result;
+		};
+
+	std::vector<StateTrackingResult> results;
+	results.push_back(run("Material order", sortedOrder));
+	results.push_back(run("Random order", randomOrder));
+
+	// Descriptions with padding in them (like D3D11_DEPTH_STENCIL_DESC),
+	// zeroed first, as StateObjectCache asks
+	struct PaddedDesc
+	{
+		int Mode;
+		unsigned char Mask;
+		int Func;
+	};
+
+	StateTrackingResult cache = {};
+	cache.scenario = "State object cache";
+	cache.draws = draws;
+	cache.correct = true;
+
+	const unsigned int DistinctDescs = 8;
+	StateObjectCache<PaddedDesc, unsigned int> objects;
+	std::vector<unsigned int> firstObject(DistinctDescs, UINT_MAX);
+	std::uniform_int_distribution<unsigned int> descIndex(0, DistinctDescs - 1);
+	for (unsigned int i = 0; i < draws; i++)
+	{
+		unsigned int d = descIndex(random);
+		PaddedDesc desc = {};
+		desc.Mode = d % 2;
+		desc.Mask = (unsigned char)(d / 2 % 2);
+		desc.Func = d / 4;
+
+		unsigned int object = objects.Get(desc, [&](const PaddedDesc&) { return cache.issued++; });
+		cache.requested++;
+		if (firstObject[d] == UINT_MAX)
+			firstObject[d] = object;
+		cache.correct &= firstObject[d] == object;
+	}
+	cache.correct &= objects.GetCount() == cache.issued && objects.GetCount() <= DistinctDescs && objects.GetHits() == draws - cache.issued;
+	results.push_back(cache);
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Records a sorted frame of draws the way Game does when
+// it uses command lists: a pipeline and material bind where
+// they change, object constants every draw; split into a
+// chunk per thread, then joined in order
+// - Each chunk starts from what the draw before it leaves
+//    bound, so the joined list should be byte for byte what
+//    one thread records alone
+// - Checked by running it through NullCommandExecutor, and
+//    by making sure a draw before any bind is rejected
+// --------------------------------------------------------
+std::vector<CommandListResult> Benchmarks::CommandListRecording(unsigned int drawCount, unsigned int materialCount, int iterations)
+{
+	iterations = std::max(iterations, 1);
+	materialCount = std::max(materialCount, 1u);
+	const unsigned int MeshCount = 6;
+
+	// Sorted by material, then mesh, like the draw list
+	struct PretendDraw
+	{
+		unsigned int Material;
+		unsigned int Mesh;
+		VertexShaderExternalData Constants;
+	};
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> values(-100.0f, 100.0f);
+	std::vector<PretendDraw> draws(drawCount);
+	for (unsigned int i = 0; i < drawCount; i++)
+	{
+		draws[i].Material = i * materialCount / drawCount + 1;
+		draws[i].Mesh = (i * materialCount * MeshCount / drawCount) % MeshCount + 1;
+		XMStoreFloat4x4(&draws[i].Constants.worldMatrix, XMMatrixTranslation(values(random), values(random), values(random)));
+		draws[i].Constants.worldInvTranspose = draws[i].Constants.worldMatrix;
+	}
+
+	unsigned int materialChanges = 0;
+	for (unsigned int i = 0; i < drawCount; i++)
+		materialChanges += i == 0 || draws[i].Material != draws[i - 1].Material;
+
+	auto record = [&](RenderCommandList& list, unsigned int firstDraw, unsigned int endDraw)
+		{
+			unsigned int boundPipeline = UINT_MAX;
+			unsigned int boundMaterial = 0;
+			if (firstDraw > 0)
+			{
+				boundPipeline = draws[firstDraw - 1].Mesh % 3;
+				boundMaterial = draws[firstDraw - 1].Material;
+			}
+
+			for (unsigned int i = firstDraw; i < endDraw; i++)
+			{
+				const PretendDraw& draw = draws[i];
+				unsigned int pipeline = draw.Mesh % 3;
+				if (pipeline != boundPipeline || draw.Material != boundMaterial)
+					list.BindPipeline(pipeline, draw.Material);
+
+				if (draw.Material != boundMaterial)
+				{
+					MaterialExternalData materialData = {};
+					materialData.colorTint = XMFLOAT4(1, 1, 1, 1);
+					materialData.textureScale = XMFLOAT2((float)draw.Material, 1);
+					list.BindMaterial(draw.Material);
+					list.SetConstants(RenderShaderStage::Pixel, 1, &materialData, sizeof(MaterialExternalData));
+				}
+
+				boundPipeline = pipeline;
+				boundMaterial = draw.Material;
+
+				list.SetConstants(RenderShaderStage::Vertex, 2, &draw.Constants, sizeof(VertexShaderExternalData));
+				list.Draw(draw.Mesh, 0);
+			}
+		};
+
+	RenderCommandList reference;
+	record(reference, 0, drawCount);
+
+	// A draw with nothing bound, which validation has to catch
+	bool rejectsBadList;
+	{
+		RenderCommandList bad;
+		bad.Draw(1, 0);
+		NullCommandExecutor executor;
+		rejectsBadList = !executor.Execute(bad);
+	}
+
+	std::vector<CommandListResult> results;
+	unsigned int allThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	for (unsigned int threadCount : { 1u, allThreads })
+	{
+		if (threadCount == allThreads && allThreads == 1 && !results.empty())
+			break;
+
+		CommandListResult result = {};
+		result.method = threadCount == 1 ? "1 thread" : std::to_string(threadCount) + " threads";
+		result.drawCount = drawCount;
+		result.threadCount = threadCount;
+
+		std::vector<RenderCommandList> lists(threadCount);
+		RenderCommandList joined;
+		NullCommandExecutor executor;
+		bool valid = true;
+		for (int iteration = 0; iteration < iterations; iteration++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			auto work = [&](unsigned int job)
+				{
+					lists[job].Reset();
+					record(lists[job],
+						(unsigned int)((size_t)drawCount * job / threadCount),
+						(unsigned int)((size_t)drawCount * (job + 1) / threadCount));
+				};
+
+			std::vector<std::thread> workers;
+			for (unsigned int i = 1; i < threadCount; i++)
+				workers.emplace_back(work, i);
+			work(0);
+			for (std::thread& worker : workers)
+				worker.join();
+
+			joined.Reset();
+			for (const RenderCommandList& list : lists)
+				joined.Append(list);
+			result.recordMilliseconds += SecondsSince(start) * 1000.0;
+
+			start = std::chrono::high_resolution_clock::now();
+			executor.Reset();
+			valid &= executor.Execute(joined);
+			result.validateMilliseconds += SecondsSince(start) * 1000.0;
+		}
+
+		const RenderCommandCounts& counts = executor.GetCounts();
+		result.commandCount = joined.GetCommandCount();
+		result.kilobytes = (unsigned int)(joined.GetSize() / 1024);
+		result.recordMilliseconds /= iterations;
+		result.validateMilliseconds /= iterations;
+		result.correct = valid && rejectsBadList &&
+			counts.draws == drawCount &&
+			counts.materials == materialChanges &&
+			joined.GetCommandCount() == reference.GetCommandCount() &&
+			joined.GetSize() == reference.GetSize() &&
+			memcmp(joined.GetData(), reference.GetData(), reference.GetSize()) == 0;
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+// --------------------------------------------------------
+// Times startup loading of each mesh with and without its
+// .meshbin cache
+// - The OS file cache can't be flushed portably, so "cold"
+//    means the first load in this process rather than the
+//    first read from disk
+// - Each cache is also checked byte-for-byte against what
+//    the OBJ path produced
+// --------------------------------------------------------
+std::vector<MeshLoadBenchmarkResult> Benchmarks::MeshCacheStartup(const std::string& meshDirectory, unsigned int largeGridSize, int iterations)
+{
+	std::vector<MeshLoadBenchmarkResult> results;
+	iterations = std::max(iterations, 1);
+
+	// Keep the benchmark's caches away from the real ones
+	std::error_code error;
+	std::filesystem::path cacheDirectory = std::filesystem::temp_directory_path(error) / "meshbin-benchmark";
+	std::filesystem::create_directories(cacheDirectory, error);
+
+	std::vector<std::filesystem::path> paths = FindObjFiles(meshDirectory);
+
+	// Add a large generated mesh, since the shipped ones are all small
+	std::filesystem::path gridPath = cacheDirectory / ("grid" + std::to_string(largeGridSize) + ".obj");
+	{
+		std::string gridObj = GenerateGridObj(largeGridSize);
+		std::ofstream gridFile(gridPath, std::ios::binary | std::ios::trunc);
+		gridFile.write(gridObj.data(), gridObj.size());
+	}
+	paths.push_back(gridPath);
+
+	MeshLoadBenchmarkResult total = {};
+	total.fileName = "All files";
+	total.cacheMatches = true;
+
+	MeshData data;
+	std::vector<char> objUpload;
+	std::vector<char> cacheUpload;
+	for (const std::filesystem::path& path : paths)
+	{
+		std::string objPath = path.string();
+		std::string cachePath = MeshCache::GetCachePath((cacheDirectory / path.filename()).string().c_str());
+		std::filesystem::remove(cachePath, error);
+
+		MeshLoadBenchmarkResult result = {};
+		result.fileName = path.filename().string();
+		result.objSizeInBytes = std::filesystem::file_size(path, error);
+
+		// First load with no cache, which writes one
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		LoadThroughObj(objPath, cachePath, true, data, objUpload);
+		result.objColdMilliseconds = SecondsSince(start) * 1000.0;
+		result.cacheSizeInBytes = std::filesystem::file_size(cachePath, error);
+
+		// First load from the new cache
+		start = std::chrono::high_resolution_clock::now();
+		result.cacheMatches = LoadThroughCache(objPath, cachePath, cacheUpload);
+		result.cacheColdMilliseconds = SecondsSince(start) * 1000.0;
+		result.cacheMatches &= objUpload == cacheUpload;
+
+		// Repeated loads both ways
+		start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++)
+			LoadThroughObj(objPath, cachePath, false, data, objUpload);
+		result.objWarmMilliseconds = SecondsSince(start) * 1000.0 / iterations;
+
+		start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++)
+			LoadThroughCache(objPath, cachePath, cacheUpload);
+		result.cacheWarmMilliseconds = SecondsSince(start) * 1000.0 / iterations;
+
+		results.push_back(result);
+
+		total.objSizeInBytes += result.objSizeInBytes;
+		total.cacheSizeInBytes += result.cacheSizeInBytes;
+		total.objColdMilliseconds += result.objColdMilliseconds;
+		total.objWarmMilliseconds += result.objWarmMilliseconds;
+		total.cacheColdMilliseconds += result.cacheColdMilliseconds;
+		total.cacheWarmMilliseconds += result.cacheWarmMilliseconds;
+		total.cacheMatches &= result.cacheMatches;
+	}
+
+	results.push_back(total);
+
+	// Clean up after ourselves
+	std::filesystem::remove_all(cacheDirectory, error);
+
+	return results;
+}
@@ -0,0 +1,435 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MeshData.h"
+#include "PackedVertex.h"
+
+class Camera;
+
+// --------------------------------------------------------
+// Timing results for parsing a single OBJ file
+// --------------------------------------------------------
+struct ObjParseBenchmarkResult
+{
+	std::string fileName;
+	size_t fileSizeInBytes;
+	unsigned int triangleCount;
+	double millisecondsPerParse;
+	double megabytesPerSecond;
+};
+
+// --------------------------------------------------------
+// OBJ parsing throughput at a single thread count
+// --------------------------------------------------------
+struct ObjParseScalingResult
+{
+	unsigned int threadCount;
+	double shippedMegabytesPerSecond;	// All of the shipped .obj files
+	double largeMegabytesPerSecond;		// A large, generated grid mesh
+	bool matchesSerial;					// Was the output identical to a 1-thread parse?
+};
+
+// --------------------------------------------------------
+// Load times for one mesh through the OBJ path and the
+// .meshbin cache path, in milliseconds
+// - "Cold" is the first load (for the OBJ path, that's with
+//    no cache present, including writing it)
+// - "Warm" is the average of repeated loads afterwards
+// --------------------------------------------------------
+struct MeshLoadBenchmarkResult
+{
+	std::string fileName;
+	size_t objSizeInBytes;
+	size_t cacheSizeInBytes;
+	double objColdMilliseconds;
+	double objWarmMilliseconds;
+	double cacheColdMilliseconds;
+	double cacheWarmMilliseconds;
+	bool cacheMatches;	// Did the cache hold exactly what the OBJ path built?
+};
+
+// --------------------------------------------------------
+// What MeshOptimizer did to one mesh, and how long it took
+// --------------------------------------------------------
+struct MeshOptimizationBenchmarkResult
+{
+	std::string fileName;
+	unsigned int triangleCount;
+	MeshOptimizationStats stats;
+	double milliseconds;
+};
+
+// --------------------------------------------------------
+// Tangent generation times for one mesh, in milliseconds
+// --------------------------------------------------------
+struct TangentGenerationResult
+{
+	std::string fileName;
+	unsigned int vertexCount;
+	unsigned int triangleCount;
+	double scalarMilliseconds;			// CalculateTangentsScalar()
+	double simdMilliseconds;			// CalculateTangents() on one thread
+	double threadedMilliseconds;		// CalculateTangents() on every hardware thread
+	unsigned int threadCount;
+	float maxDifference;				// Largest component difference from the scalar tangents
+	bool allFinite;						// No NaN or infinite tangents from the SIMD version?
+};
+
+// --------------------------------------------------------
+// How closely a packed vertex format reproduces the full
+// float vertices of one mesh, and what it saves
+// - Errors are the worst case over every vertex
+// --------------------------------------------------------
+struct PackedVertexAccuracyResult
+{
+	std::string fileName;
+	VertexFormat format;
+	size_t fullBytes;
+	size_t packedBytes;
+	double packMilliseconds;
+	float maxPositionError;			// Largest error on any axis, relative to the mesh's extent on that axis
+	float maxUVError;
+	float maxNormalErrorDegrees;
+	float maxTangentErrorDegrees;
+	bool withinBounds;				// Were all of the above inside the format's expected error?
+};
+
+// --------------------------------------------------------
+// What switching one mesh to 16-bit indices saves
+// --------------------------------------------------------
+struct IndexBufferSavingsResult
+{
+	std::string fileName;
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int rangeCount;
+	unsigned int duplicatedVertexCount;	// Copied so every range can reach them
+	size_t bytes32;						// Index buffer with 32-bit indices
+	size_t bytes16;						// Index buffer with 16-bit indices
+	long long savedBytes;				// Index bytes saved, minus the duplicated (full) vertices
+	bool matchesOriginal;				// Do the ranges draw exactly the original triangles?
+};
+
+// --------------------------------------------------------
+// How much of one mesh meshlet culling skips from one camera
+// --------------------------------------------------------
+struct MeshletCullingResult
+{
+	std::string fileName;
+	unsigned int cameraIndex;
+	unsigned int meshletCount;
+	unsigned int triangleCount;
+	unsigned int frustumCulledTriangles;	// In meshlets outside the frustum
+	unsigned int backfaceCulledTriangles;	// In meshlets culled by their normal cone
+	unsigned int backfacingTriangles;		// Every back facing triangle (the best cones could do)
+	float culledPercent;
+	double buildMilliseconds;
+	bool conesConservative;					// Were only back facing triangles cone culled?
+};
+
+// --------------------------------------------------------
+// How closely one simplified LOD met its targets
+// --------------------------------------------------------
+struct LodSimplificationResult
+{
+	std::string fileName;
+	unsigned int lod;
+	float targetRatio;					// Of the full mesh's triangles
+	unsigned int targetTriangles;
+	unsigned int triangleCount;
+	float reportedError;				// What the simplifier said it reached
+	float measuredError;				// Farthest any full detail vertex is from the LOD
+	float maxError;
+	double milliseconds;				// Building every LOD of this mesh
+	bool meetsTarget;					// At or under targetTriangles?
+	bool withinErrorBound;				// measuredError no more than maxError?
+};
+
+// --------------------------------------------------------
+// Per-frame cost of updating a large transform hierarchy
+// when only some of it changes
+// --------------------------------------------------------
+struct TransformHierarchyResult
+{
+	unsigned int nodeCount;
+	unsigned int changedPerFrame;
+	double dirtyMilliseconds;			// Only changed subtrees, each frame
+	double fullMilliseconds;			// Every node, each frame
+	bool matchesFull;					// Same world matrices either way?
+};
+
+// --------------------------------------------------------
+// Time to calculate every world matrix of many transforms,
+// one at a time versus all at once in a TransformSystem
+// --------------------------------------------------------
+struct TransformSystemResult
+{
+	unsigned int transformCount;
+	double oneAtATimeMilliseconds;		// Separate S, R and T, 3 multiplies and a general inverse each
+	double systemMilliseconds;			// TransformSystem::RecalculateAllWorldMatrices()
+	float maxWorldDifference;			// Largest element difference between the two
+	float maxInverseTransposeDifference;
+};
+
+struct EntityCullingResult
+{
+	unsigned int cameraIndex;
+	unsigned int entityCount;
+	unsigned int visibleCount;
+	double boundsMicroseconds;		// World bounds from each local box and world matrix
+	double cullMicroseconds;		// FrustumCulling::Cull(), four at a time
+	double scalarCullMicroseconds;	// FrustumCulling::CullScalar(), one at a time
+	bool matchesScalar;
+	bool conservative;				// Was every culled entity entirely outside one plane?
+};
+
+struct CameraMovementResult
+{
+	unsigned int frames;
+	bool looking;						// Mouse look as well as moving
+	double pitchYawRollMilliseconds;	// Old camera: a quaternion rebuilt from the angles for every move
+	double quaternionMilliseconds;		// Transform in Quaternion mode, as Camera uses it now
+	float maxRotationDifference;		// Largest difference in the view matrices' rotations in any frame
+	float finalPositionDifference;		// How far apart the two cameras ended up
+};
+
+struct OcclusionCullingResult
+{
+	unsigned int threadCount;		// Threads rasterizing occluders
+	bool reprojection;				// Last frame's occluders reprojected into this one
+	unsigned int testedCount;		// Boxes left after frustum culling
+	unsigned int occluderTriangles;
+	double rasterMilliseconds;		// Everything up to and including FinishOccluders()
+	double testMilliseconds;
+	float culledPercent;			// Of the tested boxes
+	unsigned int wronglyCulled;		// Culled boxes with a sample point the camera can see (within a pixel of an edge)
+};
+
+struct EntityBvhResult
+{
+	unsigned int entityCount;
+	unsigned int movingCount;			// Entities moved each frame
+	double buildMilliseconds;
+	double refitMilliseconds;			// Average per frame, including rebuilds
+	unsigned int rebuiltSubtrees;		// Over every frame
+	unsigned int fullRebuilds;
+	float costRatio;					// Surface area cost after the last frame, relative to just after building
+	double frustumMicroseconds;			// Each query, on average
+	double linearFrustumMicroseconds;	// FrustumCulling::Cull() over every entity, for comparison
+	double sphereMicroseconds;
+	double boxMicroseconds;
+	double rayMicroseconds;
+	bool matchesLinear;					// Did every query find what checking each entity finds?
+};
+
+// --------------------------------------------------------
+// Ray casting speed against one mesh's triangle BVH, or
+// (for the last result) a scene of instances of them all
+// --------------------------------------------------------
+struct RayPickingResult
+{
+	std::string name;					// Mesh file, or "Scene" for the two-level test
+	unsigned int triangleCount;			// Over every instance
+	unsigned int instanceCount;
+	double buildMilliseconds;			// Of the BVH(s) the rays are cast against
+	double raysPerSecond;
+	double bruteForceRaysPerSecond;		// Every triangle (or, for the scene, every instance), for comparison
+	float hitPercent;
+	bool matchesBruteForce;				// Did every compared ray hit at the same distance?
+};
+
+// --------------------------------------------------------
+// Per-frame entity work with one way of storing entities
+// --------------------------------------------------------
+struct EntityStorageResult
+{
+	std::string layout;
+	unsigned int entityCount;
+	double updateMilliseconds;		// Spinning every entity and updating world matrices, per frame
+	double drawListMilliseconds;	// World bounds and a draw list item for every entity, per frame
+	bool matchesPointerLayout;		// Same draw list as the shared_ptr layout?
+};
+
+// --------------------------------------------------------
+// The draw loop's mesh, material, shader and texture
+// lookups with one way of sharing resources
+// --------------------------------------------------------
+struct ResourceLookupResult
+{
+	std::string method;
+	unsigned int drawCount;
+	double milliseconds;			// Looking up everything for every draw, per frame
+	bool matchesSharedPointers;		// Found the same resources as the shared_ptr way?
+	bool staleHandlesCaught;		// Did every stale handle check pass? (always true for shared_ptrs)
+};
+
+// --------------------------------------------------------
+// One way of ordering a draw list, and how many times the
+// shader, material and mesh change when drawing it
+// --------------------------------------------------------
+struct DrawListSortResult
+{
+	std::string method;
+	unsigned int drawCount;
+	unsigned int threadCount;
+	double milliseconds;			// Per sort
+	double millionKeysPerSecond;
+	unsigned int shaderChanges;
+	unsigned int materialChanges;
+	unsigned int meshChanges;
+	bool correct;					// Sorted, stable, and still the same draws?
+};
+
+struct InstanceBatchingResult
+{
+	std::string method;
+	unsigned int entityCount;
+	unsigned int drawCalls;
+	double milliseconds;			// CPU time to get every draw's data ready, per frame
+	bool correct;					// Grouping and packing checks passed?
+};
+
+struct ConstantBufferRingResult
+{
+	std::string scenario;
+	unsigned int frames;
+	unsigned int allocations;
+	unsigned int grows;				// Times the ring ran out and was replaced with one twice the size
+	unsigned int finalCapacityKB;
+	double millionAllocationsPerSecond;
+	bool correct;					// Never handed out space a frame in flight was still using?
+};
+
+struct CommandListResult
+{
+	std::string method;
+	unsigned int drawCount;
+	unsigned int threadCount;
+	unsigned int commandCount;
+	unsigned int kilobytes;
+	double recordMilliseconds;		// Recording every chunk and joining them, per frame
+	double validateMilliseconds;	// Running the joined list through NullCommandExecutor, per frame
+	bool correct;					// Valid, the expected draws, and the same bytes one thread records?
+};
+
+struct StateTrackingResult
+{
+	std::string scenario;
+	unsigned int draws;
+	unsigned int requested;			// Binds asked for (each was its own call before)
+	unsigned int issued;			// Calls actually made
+	bool correct;					// What's bound always matched what was asked for?
+};
+
+// --------------------------------------------------------
+// CPU-side benchmarks that can be run from the ImGui
+// window (or any other host - nothing here needs D3D)
+// --------------------------------------------------------
+namespace Benchmarks
+{
+	// Parses every .obj file in a directory several times and reports throughput
+	// - The last entry holds the combined totals for all files
+	std::vector<ObjParseBenchmarkResult> ObjParseThroughput(const std::string& meshDirectory, int iterations);
+
+	// Parses the shipped .obj files and a generated large mesh with 1 to N threads
+	std::vector<ObjParseScalingResult> ObjParseScaling(const std::string& meshDirectory, unsigned int largeGridSize, int iterations);
+
+	// Optimizes every .obj file in a directory, reporting the
+	// before/after stats and the time spent optimizing
+	std::vector<MeshOptimizationBenchmarkResult> MeshOptimization(const std::string& meshDirectory);
+
+	// Generates tangents for every .obj file (and a generated large mesh)
+	// with the scalar, SIMD and threaded SIMD versions
+	std::vector<TangentGenerationResult> TangentGeneration(const std::string& meshDirectory, unsigned int largeGridSize, int iterations);
+
+	// Packs every .obj file's vertices in each packed format, then
+	// unpacks and compares them against the original floats
+	std::vector<PackedVertexAccuracyResult> PackedVertexAccuracy(const std::string& meshDirectory);
+
+	// Converts every .obj file (and a generated large mesh, which needs
+	// several ranges) to 16-bit indices and reports the bytes saved
+	std::vector<IndexBufferSavingsResult> IndexBufferSavings(const std::string& meshDirectory, unsigned int largeGridSize);
+
+	// Splits every .obj file into meshlets and culls them against each
+	// camera, with the mesh placed at the origin
+	std::vector<MeshletCullingResult> MeshletCulling(const std::string& meshDirectory, const std::vector<std::shared_ptr<Camera>>& cameras);
+
+	// Builds LODs for sphere.obj, torus.obj and helix.obj (all at once, one
+	// thread each) and measures how far each one is from the full mesh
+	std::vector<LodSimplificationResult> LodSimplification(const std::string& meshDirectory);
+
+	// Builds a hierarchy of nodeCount transforms, changes a fraction of them
+	// each frame and compares updating only what changed against everything
+	std::vector<TransformHierarchyResult> TransformHierarchyUpdate(unsigned int nodeCount, float changedFraction, int frames);
+
+	// Calculates the world matrices of each count of randomly placed transforms
+	// the old way (one at a time) and in a TransformSystem
+	std::vector<TransformSystemResult> TransformSystemUpdate(const std::vector<unsigned int>& transformCounts);
+
+	// Scatters entityCount randomly placed, rotated and scaled boxes around
+	// the origin, then finds their world bounds and culls them against
+	// each camera
+	std::vector<EntityCullingResult> EntityCulling(unsigned int entityCount, const std::vector<std::shared_ptr<Camera>>& cameras, int iterations);
+
+	// Moves a camera the way Camera::Update does (with W, D and E held, with
+	// and without the mouse dragging) for a number of frames, with the old
+	// pitch/yaw/roll transform and with the quaternion one
+	std::vector<CameraMovementResult> CameraMovement(unsigned int frames);
+
+	// Builds a city block grid of buildings with small boxes scattered through
+	// the streets, and occlusion culls them from street level after frustum
+	// culling, with one thread, every thread, and reprojecting the previous
+	// frame's depth
+	std::vector<OcclusionCullingResult> OcclusionCulling(unsigned int boxCount, int iterations);
+
+	// Builds a SceneBvh over randomly placed boxes, then for a number of
+	// frames moves some of them, refits, and runs frustum, sphere, box and
+	// ray queries, for each entity count and fraction of entities moving
+	std::vector<EntityBvhResult> EntityBvh(const std::vector<unsigned int>& entityCounts, const std::vector<float>& movingFractions, unsigned int frames);
+
+	// Casts rayCount random rays at each shipped mesh's triangle BVH, then at
+	// instanceCount randomly placed instances of them through Picking::Raycast()
+	std::vector<RayPickingResult> RayPicking(const std::string& meshDirectory, unsigned int rayCount, unsigned int instanceCount);
+
+	// Runs frames of updates and draw list building over the same entities
+	// kept as shared_ptrs (as GameEntity did) and in an EntityStore
+	std::vector<EntityStorageResult> EntityStorage(const std::vector<unsigned int>& entityCounts, unsigned int frames);
+
+	// Checks that ResourcePool catches stale handles and keeps released
+	// resources for a few frames, then runs frames of draw loop lookups
+	// through shared_ptrs (as Game used to) and through pooled handles
+	std::vector<ResourceLookupResult> ResourceLookups(unsigned int drawCount, unsigned int frames);
+
+	// Sorts a mixed scene's draw list (mostly opaque, some transparent) with
+	// std::sort and with DrawList's radix sort on one and on every thread,
+	// and counts the state changes each order needs, unsorted first
+	std::vector<DrawListSortResult> DrawListSorting(unsigned int drawCount, int iterations);
+
+	// Checks InstanceBatcher's grouping and packing, then gets a sorted grid
+	// of spheres ready to draw one at a time and as instanced batches
+	std::vector<InstanceBatchingResult> InstanceBatching(unsigned int entityCount, unsigned int materialCount, int iterations);
+
+	// Runs frames of constant buffer allocations through a ConstantBufferRing
+	// with the GPU a few frames behind, growing it the way Graphics does,
+	// and checks that no allocation overlaps one from a frame in flight
+	std::vector<ConstantBufferRingResult> ConstantBufferRingFrames(unsigned int frames);
+
+	// Binds materials' textures, samplers and constant buffers for a frame
+	// of draws through BindingSlots, in material order and in random order,
+	// counting binds asked for against calls made; then checks that
+	// StateObjectCache makes one object per distinct description
+	std::vector<StateTrackingResult> StateTracking(unsigned int draws, unsigned int materialCount);
+
+	// Records a frame of draws into render command lists on one thread and
+	// on every thread, joins them, and checks the result with NullCommandExecutor
+	std::vector<CommandListResult> CommandListRecording(unsigned int drawCount, unsigned int materialCount, int iterations);
+
+	// Compares startup load times with and without .meshbin caches, for
+	// the shipped .obj files and a generated large mesh
+	// - Caches are written to a temporary folder, not next to the assets
+	// - The last entry holds the combined totals for all files
+	std::vector<MeshLoadBenchmarkResult> MeshCacheStartup(const std::string& meshDirectory, unsigned int largeGridSize, int iterations);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+
+// --------------------------------------------------------
+// Shadows one array of pipeline slots (like a stage's SRVs),
+// so binds that change nothing are never sent to D3D
+// - Set() only records what a slot should hold; Flush()
+//    sends every slot that differs from what's bound, one
+//    call per run of neighbouring slots
+// - A slot starts out (and goes back to, after Invalidate())
+//    unknown, so the first bind to it is always sent
+// - Nothing here touches D3D, so it can be checked (and
+//    timed) on its own
+// --------------------------------------------------------
+template<typename T, unsigned int SlotCount>
+class BindingSlots
+{
+public:
+	BindingSlots()
+	{
+		Invalidate();
+	}
+
+	// Returns true if the slot will be sent at the next Flush()
+	bool Set(unsigned int slot, const T& value)
+	{
+		if (slot >= SlotCount)
+			return false;
+
+		pending[slot] = value;
+		dirty[slot] = !known[slot] || !(bound[slot] == value);
+		if (dirty[slot])
+		{
+			dirtyFirst = std::min(dirtyFirst, slot);
+			dirtyEnd = std::max(dirtyEnd, slot + 1);
+		}
+		return dirty[slot];
+	}
+
+	// Calls issue(firstSlot, slotCount, values) for each run of changed
+	// slots, returning how many times it was called
+	template<typename Issue>
+	unsigned int Flush(Issue issue)
+	{
+		unsigned int calls = 0;
+		unsigned int slot = dirtyFirst;
+		while (slot < dirtyEnd)
+		{
+			if (!dirty[slot])
+			{
+				slot++;
+				continue;
+			}
+
+			unsigned int first = slot;
+			while (slot < dirtyEnd && dirty[slot])
+			{
+				bound[slot] = pending[slot];
+				known[slot] = true;
+				dirty[slot] = false;
+				slot++;
+			}
+
+			issue(first, slot - first, &pending[first]);
+			calls++;
+		}
+
+		dirtyFirst = SlotCount;
+		dirtyEnd = 0;
+		return calls;
+	}
+
+	// Forgets what's bound, for when something else has changed it
+	// - Anything Set() but not flushed yet is dropped
+	void Invalidate()
+	{
+		std::fill(known, known + SlotCount, false);
+		std::fill(dirty, dirty + SlotCount, false);
+		dirtyFirst = SlotCount;
+		dirtyEnd = 0;
+	}
+
+	// What the slot holds as of the last Flush(), if it's known
+	bool GetBound(unsigned int slot, T& value) const
+	{
+		if (slot >= SlotCount || !known[slot])
+			return false;
+
+		value = bound[slot];
+		return true;
+	}
+
+private:
+	T bound[SlotCount] = {};
+	T pending[SlotCount] = {};
+	bool known[SlotCount];
+	bool dirty[SlotCount];
+
+	// Every dirty slot is in [dirtyFirst, dirtyEnd)
+	unsigned int dirtyFirst;
+	unsigned int dirtyEnd;
+};
@@ -2,22 +2,59 @@
 #include <DirectXMath.h>
 #include "Lights.h"
 
-struct VertexShaderExternalData
+// Set once per frame, and bound to both the vertex and pixel shaders
+// - Should match PerFrame in ShaderIncludes.hlsli
+struct FrameExternalData
 {
-	DirectX::XMFLOAT4X4 worldMatrix;
-	DirectX::XMFLOAT4X4 projectionMatrix;
-	DirectX::XMFLOAT4X4 viewMatrix;
-	DirectX::XMFLOAT4X4 worldInvTranspose;
+	DirectX::XMFLOAT4X4 viewProjectionMatrix;	// View * projection, so shaders don't multiply them per vertex
+	DirectX::XMFLOAT3 cameraPos;
+	float totalTime;
+	Light lights[5];
 };
 
-struct PixelShaderExternalData
+// Set whenever the material changes
+// - Should match PerMaterial in ShaderIncludes.hlsli
+struct MaterialExternalData
 {
 	DirectX::XMFLOAT4 colorTint;
 	DirectX::XMFLOAT2 textureScale;
 	DirectX::XMFLOAT2 textureOffset;
-	float totalTime;
-	DirectX::XMFLOAT3 cameraPos;
-	Light lights[5];
+};
+
+// Set for every object drawn
+// - Should match PerObject in VertexShader.hlsl
+struct VertexShaderExternalData
+{
+	DirectX::XMFLOAT4X4 worldMatrix;
+	DirectX::XMFLOAT4X4 worldInvTranspose;
+};
+
+struct PackedVertexShaderExternalData
+{
+	DirectX::XMFLOAT4X4 worldMatrix;
+	DirectX::XMFLOAT4X4 worldInvTranspose;
+	DirectX::XMFLOAT3 positionScale;	// See PackedVertexDequantize
+	float padding0;
+	DirectX::XMFLOAT3 positionOffset;
+	float padding1;
+};
+
+// Everything that changes per instance, read from the instance buffer
+// - Should match InstanceData in ShaderIncludes.hlsli
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 world;
+	DirectX::XMFLOAT4X4 worldInvTranspose;
+};
+
+// Same as PackedVertexShaderExternalData, without what each instance brings
+// - Full vertices need nothing per batch beyond the per-frame data
+struct InstancedPackedVertexShaderExternalData
+{
+	DirectX::XMFLOAT3 positionScale;	// See PackedVertexDequantize
+	float padding0;
+	DirectX::XMFLOAT3 positionOffset;
+	float padding1;
 };
 
 struct SkyboxVertexShaderExternalData
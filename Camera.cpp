@@ -1,6 +1,7 @@
 #include "Camera.h"
 
 #include <algorithm>
+#include <cmath>
 
 using namespace DirectX;
 
@@ -14,8 +15,10 @@ Camera::Camera(DirectX::XMFLOAT3 initialPosition,
 	projectionMatrixHasChanged { false },
 	viewMatrixHasChanged { false }
 {
+	// Mouse look turns the quaternion directly, rather than rebuilding it from angles
+	myTransform.SetRotationMode(Transform::RotationMode::Quaternion);
+
 	// Initialize transform with starting position
-	myTransform = Transform();
 	myTransform.SetTranslation(initialPosition);
 
 	fieldOfViewRadians = XMConvertToRadians(fieldOfViewDegrees);
@@ -61,14 +64,30 @@ float Camera::GetFovDegrees()
 	return XMConvertToDegrees(fieldOfViewRadians);
 }
 
+// --------------------------------------------------------
+// World-space planes of everything this camera can see,
+// for culling on the CPU
+// --------------------------------------------------------
+Frustum Camera::GetFrustum()
+{
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(XMLoadFloat4x4(&viewMatrix), XMLoadFloat4x4(&projectionMatrix)));
+
+	return Frustum::FromMatrix(viewProjection);
+}
+
 void Camera::SetPitchYawRoll(XMFLOAT3 input)
 {
 	myTransform.SetPitchYawRoll(input);
+
+	// Keep the view matrix (and frustum) valid before the next Update()
+	UpdateViewMatrix();
 }
 
 void Camera::SetTranslation(XMFLOAT3 input)
 {
 	myTransform.SetTranslation(input);
+	UpdateViewMatrix();
 }
 
 void Camera::Update(float deltaTime)
@@ -92,12 +111,14 @@ void Camera::Update(float deltaTime)
 		float cursorMovementX = Input::GetMouseXDelta() * mouseLookSpeed;
 		float cursorMovementY = Input::GetMouseYDelta() * mouseLookSpeed;
 		
-		myTransform.Rotate(cursorMovementY, cursorMovementX, 0.0f);
-
-		float currentPitch = std::clamp(myTransform.GetPitchYawRoll().x, XMConvertToRadians(-90.0f), XMConvertToRadians(90.0f));
-		float currentYaw = myTransform.GetPitchYawRoll().y;
-		
-		myTransform.SetPitchYawRoll(currentPitch, currentYaw, 0.0f);
+		// Pitch around the camera's own right vector (keeping it between straight
+		// up and straight down), then yaw around the world's up, so it never rolls
+		// - With no roll, forward.y is -sin(pitch) and up.y is cos(pitch)
+		float currentPitch = atan2f(-myTransform.GetForward().y, myTransform.GetUp().y);
+		float newPitch = std::clamp(currentPitch + cursorMovementY, XMConvertToRadians(-90.0f), XMConvertToRadians(90.0f));
+
+		myTransform.RotateAxisAngle(myTransform.GetRight(), newPitch - currentPitch);
+		myTransform.RotateAxisAngle(XMFLOAT3(0.0f, 1.0f, 0.0f), cursorMovementX);
 	}
 
 	UpdateViewMatrix();
@@ -1,5 +1,5 @@
 #pragma once
-#include "Camera.h"
+#include "Frustum.h"
 #include "Input.h"
 #include "Transform.h"
 
@@ -23,6 +23,7 @@ public:
 	DirectX::XMFLOAT3 GetTranslation();
 	DirectX::XMFLOAT3 GetPitchYawRoll();
 	float GetFovDegrees();
+	Frustum GetFrustum();
 
 	void SetTranslation(DirectX::XMFLOAT3);
 	void SetPitchYawRoll(DirectX::XMFLOAT3);
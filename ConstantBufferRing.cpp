@@ -0,0 +1,120 @@
+#include "ConstantBufferRing.h"
+
+ConstantBufferRing::ConstantBufferRing(unsigned int capacityInBytes) :
+	capacity(capacityInBytes / Alignment * Alignment),
+	head(0),
+	tail(0),
+	used(0),
+	currentFrameBytes(0),
+	currentFrame(0)
+{
+}
+
+ConstantBufferRing::~ConstantBufferRing()
+{
+}
+
+// --------------------------------------------------------
+// Free space is either one run from head to tail, or (when
+// head is past tail) a run to the end of the buffer and
+// another from the start up to tail
+// - A piece never wraps around the end; if it doesn't fit
+//    there, what's left at the end is skipped, and counts
+//    as used by this frame until it's retired
+// --------------------------------------------------------
+bool ConstantBufferRing::Allocate(unsigned int sizeInBytes, unsigned int& offset)
+{
+	unsigned int size = (sizeInBytes + Alignment - 1) / Alignment * Alignment;
+	if (size == 0)
+		size = Alignment;
+	if (size > capacity || used == capacity)
+		return false;
+
+	// Nothing in use, so start from the beginning
+	// - Only once every frame has retired, even ones that allocated
+	//    nothing: RetireFrame() moves tail to where each one ended,
+	//    which would mean nothing after a rewind
+	if (used == 0 && frames.empty())
+		head = tail = 0;
+
+	unsigned int skipped = 0;
+	if (head >= tail)
+	{
+		if (capacity - head >= size)
+			offset = head;
+		else if (tail >= size)
+		{
+			skipped = capacity - head;
+			offset = 0;
+		}
+		else
+			return false;
+	}
+	else
+	{
+		if (tail - head < size)
+			return false;
+		offset = head;
+	}
+
+	head = offset + size;
+	if (head == capacity)
+		head = 0;
+
+	used += size + skipped;
+	currentFrameBytes += size + skipped;
+	return true;
+}
+
+unsigned long long ConstantBufferRing::EndFrame()
+{
+	frames.push_back({ currentFrame, head, currentFrameBytes });
+	currentFrameBytes = 0;
+	return currentFrame++;
+}
+
+void ConstantBufferRing::RetireFrame(unsigned long long frame)
+{
+	// Frames end in order, so they're retired in order too
+	while (!frames.empty() && frames.front().Frame <= frame)
+	{
+		tail = frames.front().End;
+		used -= frames.front().Bytes;
+		frames.pop_front();
+	}
+}
+
+void ConstantBufferRing::Reset(unsigned int capacityInBytes)
+{
+	capacity = capacityInBytes / Alignment * Alignment;
+	head = 0;
+	tail = 0;
+	used = 0;
+	currentFrameBytes = 0;
+	frames.clear();
+}
+
+unsigned int ConstantBufferRing::GetCapacity() const
+{
+	return capacity;
+}
+
+unsigned int ConstantBufferRing::GetUsedBytes() const
+{
+	return used;
+}
+
+unsigned int ConstantBufferRing::GetCurrentFrameBytes() const
+{
+	return currentFrameBytes;
+}
+
+unsigned long long ConstantBufferRing::GetCurrentFrame() const
+{
+	return currentFrame;
+}
+
+unsigned int ConstantBufferRing::GetFramesInFlight() const
+{
+	return (unsigned int)frames.size();
+}
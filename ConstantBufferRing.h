@@ -0,0 +1,65 @@
+#pragma once
+
+#include <deque>
+
+// --------------------------------------------------------
+// Hands out pieces of one big buffer, a frame at a time,
+// without touching any piece the GPU might still be reading
+// - Only keeps track of offsets; whoever owns the buffer
+//    does the actual mapping and binding (see Graphics)
+// - Pieces are handed out in order, wrapping around to the
+//    start when they reach the end; everything allocated in
+//    a frame stays in use until that frame is retired
+// - Allocate() fails when the only free space belongs to a
+//    frame the GPU hasn't finished, so the owner can make a
+//    bigger buffer instead of waiting (or overwriting it)
+// --------------------------------------------------------
+class ConstantBufferRing
+{
+public:
+	// Constant buffer offsets must be multiples of 256 bytes
+	static constexpr unsigned int Alignment = 256;
+
+	ConstantBufferRing(unsigned int capacityInBytes = 0);
+	~ConstantBufferRing();
+
+	// Finds room for sizeInBytes (rounded up to the alignment), setting
+	// offset to where it starts, or returns false if there isn't any
+	bool Allocate(unsigned int sizeInBytes, unsigned int& offset);
+
+	// Closes the current frame, returning its number; anything allocated
+	// from now on belongs to the next one
+	unsigned long long EndFrame();
+
+	// The GPU is done with this frame (and any before it), so their
+	// space can be handed out again
+	void RetireFrame(unsigned long long frame);
+
+	// Starts over with an empty buffer of a new size
+	// - Frames already ended are forgotten, since their pieces are in
+	//    the old buffer; frame numbers carry on from where they were
+	void Reset(unsigned int capacityInBytes);
+
+	unsigned int GetCapacity() const;
+	unsigned int GetUsedBytes() const;				// Including space skipped when wrapping
+	unsigned int GetCurrentFrameBytes() const;
+	unsigned long long GetCurrentFrame() const;
+	unsigned int GetFramesInFlight() const;			// Ended, but not retired
+
+private:
+
+	struct FrameRecord
+	{
+		unsigned long long Frame;
+		unsigned int End;		// Where the next frame's first piece would go
+		unsigned int Bytes;		// Including space skipped when wrapping
+	};
+
+	unsigned int capacity;
+	unsigned int head;			// Where the next piece goes
+	unsigned int tail;			// Start of the oldest piece still in use
+	unsigned int used;
+	unsigned int currentFrameBytes;
+	unsigned long long currentFrame;
+	std::deque<FrameRecord> frames;
+};
@@ -0,0 +1,175 @@
+#include "D3D11CommandExecutor.h"
+
+#include <cstring>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Calls visit(header) for each command in each list, in order
+	// - A malformed command ends its list there (the same place
+	//    on every pass, so constants still line up with their
+	//    SetConstants commands)
+	template<typename Visit>
+	void ForEachCommand(const std::vector<RenderCommandList>& lists, Visit visit)
+	{
+		for (const RenderCommandList& list : lists)
+		{
+			const unsigned char* data = list.GetData();
+			for (size_t offset = 0; offset < list.GetSize();)
+			{
+				const RenderCommandHeader* header = RenderCommandList::ReadCommand(data, list.GetSize(), offset);
+				if (!header)
+					break;
+
+				visit(header);
+				offset += header->Size;
+			}
+		}
+	}
+
+	D3D11_SHADER_TYPE ToShaderType(RenderShaderStage stage)
+	{
+		return stage == RenderShaderStage::Vertex ? D3D11_VERTEX_SHADER : D3D11_PIXEL_SHADER;
+	}
+}
+
+D3D11CommandExecutor::D3D11CommandExecutor(ResourcePool<Mesh>& meshes, ResourcePool<Material>& materials, TexturePool& textures) :
+	meshes(meshes),
+	materials(materials),
+	textures(textures),
+	drawCalls(0),
+	shaderChanges(0),
+	materialChanges(0)
+{
+}
+
+D3D11CommandExecutor::~D3D11CommandExecutor()
+{
+}
+
+void D3D11CommandExecutor::SetPipeline(unsigned int pipeline, D3D11CommandPipeline description)
+{
+	if (pipeline >= pipelines.size())
+		pipelines.resize(pipeline + 1, {});
+	pipelines[pipeline] = description;
+}
+
+void D3D11CommandExecutor::Execute(const std::vector<RenderCommandList>& lists)
+{
+	WriteConstants(lists);
+	Submit(lists);
+}
+
+void D3D11CommandExecutor::WriteConstants(const std::vector<RenderCommandList>& lists)
+{
+	constants.clear();
+	ForEachCommand(lists, [&](const RenderCommandHeader* header)
+		{
+			if (header->Type != RenderCommandType::SetConstants)
+				return;
+
+			const SetConstantsCommand* command = reinterpret_cast<const SetConstantsCommand*>(header);
+			Graphics::ConstantBufferAllocation allocation = Graphics::AllocateConstantBuffer(command->DataSize);
+			memcpy(allocation.Data, RenderCommandList::GetConstantsData(command), command->DataSize);
+			constants.push_back(allocation);
+		});
+}
+
+void D3D11CommandExecutor::Submit(const std::vector<RenderCommandList>& lists)
+{
+	drawCalls = 0;
+	shaderChanges = 0;
+	materialChanges = 0;
+	unsigned int nextConstants = 0;
+
+	// What the commands so far have bound, to count real changes
+	// - Until a BindPipeline succeeds, there's nothing valid to draw
+	//    with, so draws are skipped rather than made with whatever
+	//    was bound before
+	bool pipelineBound = false;
+	ID3D11InputLayout* boundInputLayout = nullptr;
+	ID3D11VertexShader* boundVertexShader = nullptr;
+	ID3D11PixelShader* boundPixelShader = nullptr;
+	Material* boundMaterial = nullptr;
+
+	ForEachCommand(lists, [&](const RenderCommandHeader* header)
+		{
+			switch (header->Type)
+			{
+			case RenderCommandType::BindPipeline:
+			{
+				const BindPipelineCommand* command = reinterpret_cast<const BindPipelineCommand*>(header);
+				Material* material = materials.Get(ResourceHandle<Material>{ command->Material });
+				pipelineBound = material && command->Pipeline < pipelines.size();
+				if (!pipelineBound)
+					break;
+
+				const D3D11CommandPipeline& pipeline = pipelines[command->Pipeline];
+				ID3D11VertexShader* vertexShader = pipeline.VertexShader ? pipeline.VertexShader : material->GetVertexShader();
+				if (pipeline.InputLayout != boundInputLayout || vertexShader != boundVertexShader || material->GetPixelShader() != boundPixelShader)
+				{
+					Graphics::State->SetInputLayout(pipeline.InputLayout);
+					Graphics::State->SetVertexShader(vertexShader);
+					Graphics::State->SetPixelShader(material->GetPixelShader());
+					boundInputLayout = pipeline.InputLayout;
+					boundVertexShader = vertexShader;
+					boundPixelShader = material->GetPixelShader();
+					shaderChanges++;
+				}
+				break;
+			}
+
+			case RenderCommandType::BindMaterial:
+			{
+				const BindMaterialCommand* command = reinterpret_cast<const BindMaterialCommand*>(header);
+				Material* material = materials.Get(ResourceHandle<Material>{ command->Material });
+				if (material && material != boundMaterial)
+				{
+					material->BindTexturesAndSamplers(textures);
+					boundMaterial = material;
+					materialChanges++;
+				}
+				break;
+			}
+
+			case RenderCommandType::SetConstants:
+			{
+				const SetConstantsCommand* command = reinterpret_cast<const SetConstantsCommand*>(header);
+				if (nextConstants < constants.size())
+					Graphics::BindConstantBuffer(constants[nextConstants++], ToShaderType(command->Stage), command->Slot);
+				break;
+			}
+
+			case RenderCommandType::Draw:
+			{
+				const DrawCommand* command = reinterpret_cast<const DrawCommand*>(header);
+				Mesh* mesh = meshes.Get(ResourceHandle<Mesh>{ command->Mesh });
+				if (!mesh || !pipelineBound)
+					break;
+
+				if (command->InstanceCount == 1 && command->StartInstance == 0)
+					mesh->Draw(command->Lod);
+				else
+					mesh->DrawInstanced(command->InstanceCount, command->StartInstance, command->Lod);
+				drawCalls++;
+				break;
+			}
+			}
+		});
+}
+
+unsigned int D3D11CommandExecutor::GetDrawCalls() const
+{
+	return drawCalls;
+}
+
+unsigned int D3D11CommandExecutor::GetShaderChanges() const
+{
+	return shaderChanges;
+}
+
+unsigned int D3D11CommandExecutor::GetMaterialChanges() const
+{
+	return materialChanges;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <d3d11.h>
+#include <vector>
+
+#include "Graphics.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "RenderCommandList.h"
+#include "ResourcePool.h"
+
+// --------------------------------------------------------
+// The vertex half of a pipeline a BindPipeline command can
+// name; the pixel shader comes from the command's material
+// - A null vertex shader means the material's own
+// --------------------------------------------------------
+struct D3D11CommandPipeline
+{
+	ID3D11InputLayout* InputLayout;
+	ID3D11VertexShader* VertexShader;
+};
+
+// --------------------------------------------------------
+// Runs render command lists on Graphics::Context, from one
+// thread, in the order they're given
+// - Mesh and material IDs are handle values into the pools
+//    given to the constructor; commands naming a stale one
+//    are skipped, along with any draws after a skipped
+//    BindPipeline (until the next one that isn't)
+// - Every SetConstants command's data is written into the
+//    constant buffer heap first (WriteConstants()), so the
+//    whole frame shares one Map(), and only bound as Submit()
+//    reaches it
+// - Binds go through Graphics::State, so ones that change
+//    nothing (like a chunk rebinding the material the chunk
+//    before it ended with) are never sent
+// --------------------------------------------------------
+class D3D11CommandExecutor
+{
+public:
+	D3D11CommandExecutor(ResourcePool<Mesh>& meshes, ResourcePool<Material>& materials, TexturePool& textures);
+	~D3D11CommandExecutor();
+
+	void SetPipeline(unsigned int pipeline, D3D11CommandPipeline description);
+
+	// Writes every list's constants, then submits them all
+	void Execute(const std::vector<RenderCommandList>& lists);
+
+	// The two halves of Execute(), for when something else (like the
+	// frame's own constants) needs binding in between
+	void WriteConstants(const std::vector<RenderCommandList>& lists);
+	void Submit(const std::vector<RenderCommandList>& lists);
+
+	// Draw calls, shader changes and material changes made by the last Submit()
+	unsigned int GetDrawCalls() const;
+	unsigned int GetShaderChanges() const;
+	unsigned int GetMaterialChanges() const;
+
+private:
+	ResourcePool<Mesh>& meshes;
+	ResourcePool<Material>& materials;
+	TexturePool& textures;
+	std::vector<D3D11CommandPipeline> pipelines;
+
+	// Where each SetConstants command's data went, in the order they appear
+	std::vector<Graphics::ConstantBufferAllocation> constants;
+	unsigned int drawCalls;
+	unsigned int shaderChanges;
+	unsigned int materialChanges;
+};
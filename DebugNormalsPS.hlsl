@@ -1,16 +1,7 @@
 #include "ShaderIncludes.hlsli"
 // Debug pixel shader. Returns color based on surface normals.
 
-cbuffer ExternalData : register(b0)
-{
-    float4 colorTint;
-    float2 textureScale;
-    float2 textureOffset;
-    float totalTime;
-    float3 cameraPos;
-    float roughness;
-    float3 backgroundColor;
-}
+// Constant data comes from PerFrame and PerMaterial (see ShaderIncludes.hlsli)
 
 // --------------------------------------------------------
 // The entry point (main method) for our pixel shader
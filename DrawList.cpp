@@ -0,0 +1,258 @@
+#include "DrawList.h"
+
+#include <algorithm>
+#include <barrier>
+#include <chrono>
+#include <cstring>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+
+	unsigned long long Field(unsigned long long value, unsigned int bits)
+	{
+		return value & ((1ull << bits) - 1);
+	}
+
+	// Positive floats sort the same as their bits do, so the top bits of
+	// the float are a depth that keeps its precision close up
+	unsigned long long QuantizeDepth(float depth)
+	{
+		unsigned int bits;
+		float clamped = depth > 0.0f ? depth : 0.0f;
+		memcpy(&bits, &clamped, sizeof(bits));
+		return bits >> (32 - 1 - DrawList::DepthBits);
+	}
+
+	// Bit positions of each field, from the bottom
+	constexpr unsigned int PassShift = 64 - DrawList::PassBits;
+	constexpr unsigned int OpaqueShaderShift = PassShift - DrawList::ShaderBits;
+	constexpr unsigned int OpaqueMaterialShift = OpaqueShaderShift - DrawList::MaterialBits;
+	constexpr unsigned int OpaqueMeshShift = OpaqueMaterialShift - DrawList::MeshBits;
+	constexpr unsigned int TransparentDepthShift = PassShift - DrawList::DepthBits;
+	constexpr unsigned int TransparentShaderShift = TransparentDepthShift - DrawList::ShaderBits;
+	constexpr unsigned int TransparentMaterialShift = TransparentShaderShift - DrawList::MaterialBits;
+	constexpr unsigned int TransparentMeshShift = TransparentMaterialShift - DrawList::MeshBits;
+	static_assert(OpaqueMeshShift == DrawList::DepthBits && TransparentMeshShift == 0, "Key fields must fill 64 bits");
+}
+
+unsigned long long DrawList::MakeKey(DrawPass pass, unsigned int shader, unsigned int material, unsigned int mesh, float depth)
+{
+	unsigned long long key = Field((unsigned long long)pass, PassBits) << PassShift;
+	unsigned long long quantized = QuantizeDepth(depth);
+
+	if (pass == DrawPass::Transparent)
+	{
+		// Farthest first
+		key |= Field(~quantized, DepthBits) << TransparentDepthShift;
+		key |= Field(shader, ShaderBits) << TransparentShaderShift;
+		key |= Field(material, MaterialBits) << TransparentMaterialShift;
+		key |= Field(mesh, MeshBits) << TransparentMeshShift;
+	}
+	else
+	{
+		key |= Field(shader, ShaderBits) << OpaqueShaderShift;
+		key |= Field(material, MaterialBits) << OpaqueMaterialShift;
+		key |= Field(mesh, MeshBits) << OpaqueMeshShift;
+		key |= quantized;
+	}
+	return key;
+}
+
+DrawPass DrawList::GetPass(unsigned long long key)
+{
+	return (DrawPass)(key >> PassShift);
+}
+
+unsigned int DrawList::GetShader(unsigned long long key)
+{
+	unsigned int shift = GetPass(key) == DrawPass::Transparent ? TransparentShaderShift : OpaqueShaderShift;
+	return (unsigned int)Field(key >> shift, ShaderBits);
+}
+
+unsigned int DrawList::GetMaterial(unsigned long long key)
+{
+	unsigned int shift = GetPass(key) == DrawPass::Transparent ? TransparentMaterialShift : OpaqueMaterialShift;
+	return (unsigned int)Field(key >> shift, MaterialBits);
+}
+
+unsigned int DrawList::GetMesh(unsigned long long key)
+{
+	unsigned int shift = GetPass(key) == DrawPass::Transparent ? TransparentMeshShift : OpaqueMeshShift;
+	return (unsigned int)Field(key >> shift, MeshBits);
+}
+
+DrawStateChanges DrawList::CountStateChanges(const unsigned long long* keys, size_t count)
+{
+	DrawStateChanges changes = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		bool first = i == 0;
+		changes.shaders += first || GetShader(keys[i]) != GetShader(keys[i - 1]);
+		changes.materials += first || GetMaterial(keys[i]) != GetMaterial(keys[i - 1]);
+		changes.meshes += first || GetMesh(keys[i]) != GetMesh(keys[i - 1]);
+	}
+	return changes;
+}
+
+DrawList::DrawList(std::shared_ptr<WorkerPool> workers) :
+	workers{ workers },
+	stats{}
+{
+}
+
+DrawList::~DrawList()
+{
+}
+
+void DrawList::Clear()
+{
+	keys.clear();
+	items.clear();
+}
+
+void DrawList::Add(unsigned long long key, unsigned int item)
+{
+	keys.push_back(key);
+	items.push_back(item);
+}
+
+// --------------------------------------------------------
+// LSB radix sort, a byte at a time, with each thread
+// owning a contiguous chunk of the keys
+// - Each pass, every thread counts the digits in its chunk,
+//    works out where its keys with each digit start (after
+//    every smaller digit, and the same digit in any earlier
+//    chunk, which keeps the sort stable), then scatters
+// - Bytes that are the same in every key (like the pass,
+//    in a list that's all opaque) are skipped
+// --------------------------------------------------------
+void DrawList::Sort()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	size_t count = keys.size();
+	unsigned int threadCount = workers ? workers->GetThreadCount() : 1;
+	unsigned int jobCount = (unsigned int)std::clamp<size_t>(count / MinimumKeysPerThread, 1, threadCount);
+	scratchKeys.resize(count);
+	scratchItems.resize(count);
+	histograms.assign((size_t)jobCount * 256, 0);
+
+	// Bits that differ from the first key, per thread
+	std::vector<unsigned long long> varyingBits(jobCount, 0);
+	unsigned int passes = 0;
+	bool sortedIntoScratch = false;
+
+	std::barrier sync(jobCount);
+	auto work = [&](unsigned int job)
+		{
+			size_t begin = count * job / jobCount;
+			size_t end = count * (job + 1) / jobCount;
+
+			unsigned long long varying = 0;
+			for (size_t i = begin; i < end; i++)
+				varying |= keys[i] ^ keys[0];
+			varyingBits[job] = varying;
+			sync.arrive_and_wait();
+
+			varying = 0;
+			for (unsigned long long bits : varyingBits)
+				varying |= bits;
+
+			unsigned long long* sourceKeys = keys.data();
+			unsigned int* sourceItems = items.data();
+			unsigned long long* destinationKeys = scratchKeys.data();
+			unsigned int* destinationItems = scratchItems.data();
+			unsigned int* histogram = &histograms[(size_t)job * 256];
+			unsigned int offsets[256];
+			unsigned int jobPasses = 0;
+
+			for (unsigned int shift = 0; shift < 64; shift += 8)
+			{
+				if (((varying >> shift) & 0xFF) == 0)
+					continue;
+
+				memset(histogram, 0, 256 * sizeof(unsigned int));
+				for (size_t i = begin; i < end; i++)
+					histogram[(sourceKeys[i] >> shift) & 0xFF]++;
+				sync.arrive_and_wait();
+
+				unsigned int offset = 0;
+				for (unsigned int digit = 0; digit < 256; digit++)
+				{
+					for (unsigned int other = 0; other < jobCount; other++)
+					{
+						if (other == job)
+							offsets[digit] = offset;
+						offset += histograms[(size_t)other * 256 + digit];
+					}
+				}
+
+				// Nobody may start counting the next pass until everyone has
+				// their offsets from this one
+				sync.arrive_and_wait();
+
+				for (size_t i = begin; i < end; i++)
+				{
+					unsigned int destination = offsets[(sourceKeys[i] >> shift) & 0xFF]++;
+					destinationKeys[destination] = sourceKeys[i];
+					destinationItems[destination] = sourceItems[i];
+				}
+				sync.arrive_and_wait();
+
+				std::swap(sourceKeys, destinationKeys);
+				std::swap(sourceItems, destinationItems);
+				jobPasses++;
+			}
+
+			if (job == 0)
+			{
+				passes = jobPasses;
+				sortedIntoScratch = jobPasses % 2 == 1;
+			}
+		};
+
+	// Every job waits on the others at each barrier, so they all need a
+	// thread at once, which Run() gives them
+	if (count > 0 && jobCount > 1)
+		workers->Run(jobCount, work);
+	else if (count > 0)
+		work(0);
+
+	if (sortedIntoScratch)
+	{
+		keys.swap(scratchKeys);
+		items.swap(scratchItems);
+	}
+
+	stats.drawCount = (unsigned int)count;
+	stats.radixPasses = passes;
+	stats.threadCount = jobCount;
+	stats.sortMilliseconds = MillisecondsSince(start);
+}
+
+unsigned int DrawList::GetCount() const
+{
+	return (unsigned int)keys.size();
+}
+
+const std::vector<unsigned long long>& DrawList::GetKeys() const
+{
+	return keys;
+}
+
+const std::vector<unsigned int>& DrawList::GetItems() const
+{
+	return items;
+}
+
+DrawListStats DrawList::GetStats() const
+{
+	return stats;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "WorkerPool.h"
+
+// --------------------------------------------------------
+// Which pass a draw is in; passes are drawn in this order
+// --------------------------------------------------------
+enum class DrawPass : unsigned int
+{
+	Opaque = 0,
+	Transparent = 1
+};
+
+// --------------------------------------------------------
+// How many times the shader, material or mesh changed
+// from one draw to the next (the first draw counts as a
+// change of each)
+// --------------------------------------------------------
+struct DrawStateChanges
+{
+	unsigned int shaders;
+	unsigned int materials;
+	unsigned int meshes;
+};
+
+// --------------------------------------------------------
+// What the last Sort() did
+// --------------------------------------------------------
+struct DrawListStats
+{
+	unsigned int drawCount;
+	unsigned int radixPasses;	// Of 8; a pass is skipped when every key has the same byte there
+	unsigned int threadCount;	// Actually used, which is fewer for short lists
+	double sortMilliseconds;
+};
+
+// --------------------------------------------------------
+// A list of draws, each with a 64-bit key that sorts it
+// into the order it should be drawn in
+// - Opaque keys are, from the top bit down: pass, shader,
+//    material, mesh, view depth; so draws sharing a shader
+//    and material are together, front to back within each
+//    mesh to make the most of early depth rejection
+// - Transparent keys put (reversed) depth straight after
+//    the pass, so they're drawn back to front for blending
+// - Shader, material and mesh are small IDs; only their low
+//    bits are kept, which only makes grouping worse if two
+//    share them, never changes which draws are made
+// - Sorted with an LSB radix sort, 8 bits per pass, with
+//    the keys split between the worker pool's threads (or
+//    just the calling thread without one); it's stable, so
+//    draws with the same key stay in the order they were added
+// --------------------------------------------------------
+class DrawList
+{
+public:
+
+	static constexpr unsigned int PassBits = 2;
+	static constexpr unsigned int ShaderBits = 10;
+	static constexpr unsigned int MaterialBits = 14;
+	static constexpr unsigned int MeshBits = 14;
+	static constexpr unsigned int DepthBits = 24;
+
+	// Fewest keys worth giving a thread of its own
+	static constexpr unsigned int MinimumKeysPerThread = 16384;
+
+	// depth is the distance in front of the camera (anything behind it counts as 0)
+	static unsigned long long MakeKey(DrawPass pass, unsigned int shader, unsigned int material, unsigned int mesh, float depth);
+
+	static DrawPass GetPass(unsigned long long key);
+	static unsigned int GetShader(unsigned long long key);
+	static unsigned int GetMaterial(unsigned long long key);
+	static unsigned int GetMesh(unsigned long long key);
+
+	// Counts the changes from one key to the next, in the order given
+	static DrawStateChanges CountStateChanges(const unsigned long long* keys, size_t count);
+
+	DrawList(std::shared_ptr<WorkerPool> workers = nullptr);
+	~DrawList();
+
+	void Clear();
+
+	// item is whatever the caller uses to find the draw again, like an
+	// index into its list of visible entities
+	void Add(unsigned long long key, unsigned int item);
+
+	// Sorts every draw added since Clear() by key
+	void Sort();
+
+	unsigned int GetCount() const;
+	const std::vector<unsigned long long>& GetKeys() const;
+	const std::vector<unsigned int>& GetItems() const;
+	DrawListStats GetStats() const;
+
+private:
+
+	std::shared_ptr<WorkerPool> workers;
+
+	std::vector<unsigned long long> keys;
+	std::vector<unsigned int> items;
+
+	// Where each radix pass scatters to, before swapping with the above
+	std::vector<unsigned long long> scratchKeys;
+	std::vector<unsigned int> scratchItems;
+
+	// 256 digit counts per thread, for the current pass
+	std::vector<unsigned int> histograms;
+
+	DrawListStats stats;
+};
@@ -0,0 +1,552 @@
+#include "EntityStore.h"
+#include "TransformSystem.h"
+
+#include <algorithm>
+#include <climits>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Removes an element by moving the last one into its place
+	// - Does nothing to arrays the archetype doesn't use
+	template<typename T>
+	void SwapRemove(std::vector<T>& values, unsigned int row)
+	{
+		if (values.empty())
+			return;
+
+		values[row] = values.back();
+		values.pop_back();
+	}
+
+	// --------------------------------------------------------
+	// Builds the local world and inverse transpose matrices of
+	// up to four transforms at once, with the same math as
+	// TransformSystem (so results match exactly)
+	// - Repeats the last transform to fill any leftover lanes
+	// --------------------------------------------------------
+	void CalculateLocalMatrices(const LocalTransform* const* transforms, XMFLOAT4X4* const* worlds, XMFLOAT4X4* const* inverseTransposes, size_t count)
+	{
+		const LocalTransform* lane[4];
+		XMFLOAT4X4* laneWorlds[4];
+		XMFLOAT4X4* laneInverseTransposes[4];
+		for (size_t i = 0; i < 4; i++)
+		{
+			size_t used = std::min(i, count - 1);
+			lane[i] = transforms[used];
+			laneWorlds[i] = worlds[used];
+			laneInverseTransposes[i] = inverseTransposes[used];
+		}
+
+		TransformSystem::Lanes lanes;
+		lanes.ScaleX = XMVectorSet(lane[0]->Scale.x, lane[1]->Scale.x, lane[2]->Scale.x, lane[3]->Scale.x);
+		lanes.ScaleY = XMVectorSet(lane[0]->Scale.y, lane[1]->Scale.y, lane[2]->Scale.y, lane[3]->Scale.y);
+		lanes.ScaleZ = XMVectorSet(lane[0]->Scale.z, lane[1]->Scale.z, lane[2]->Scale.z, lane[3]->Scale.z);
+		lanes.RotationX = XMVectorSet(lane[0]->Rotation.x, lane[1]->Rotation.x, lane[2]->Rotation.x, lane[3]->Rotation.x);
+		lanes.RotationY = XMVectorSet(lane[0]->Rotation.y, lane[1]->Rotation.y, lane[2]->Rotation.y, lane[3]->Rotation.y);
+		lanes.RotationZ = XMVectorSet(lane[0]->Rotation.z, lane[1]->Rotation.z, lane[2]->Rotation.z, lane[3]->Rotation.z);
+		lanes.RotationW = XMVectorSet(lane[0]->Rotation.w, lane[1]->Rotation.w, lane[2]->Rotation.w, lane[3]->Rotation.w);
+		lanes.TranslationX = XMVectorSet(lane[0]->Translation.x, lane[1]->Translation.x, lane[2]->Translation.x, lane[3]->Translation.x);
+		lanes.TranslationY = XMVectorSet(lane[0]->Translation.y, lane[1]->Translation.y, lane[2]->Translation.y, lane[3]->Translation.y);
+		lanes.TranslationZ = XMVectorSet(lane[0]->Translation.z, lane[1]->Translation.z, lane[2]->Translation.z, lane[3]->Translation.z);
+		TransformSystem::CalculateMatrices(lanes, count, laneWorlds, laneInverseTransposes);
+	}
+}
+
+EntityStore::EntityStore() :
+	count{ 0 },
+	structureVersion{ 0 }
+{
+}
+
+EntityStore::~EntityStore()
+{
+}
+
+EntityId EntityStore::Create(ComponentMask mask)
+{
+	unsigned int index;
+	if (!freeIndices.empty())
+	{
+		index = freeIndices.back();
+		freeIndices.pop_back();
+	}
+	else
+	{
+		index = (unsigned int)slots.size();
+		slots.push_back({ 0, 0, 0, false });
+	}
+
+	// Skip generation 0 when wrapping around, so null stays null
+	EntitySlot& slot = slots[index];
+	slot.Generation = slot.Generation + 1 == 0 ? 1 : slot.Generation + 1;
+	slot.Alive = true;
+
+	EntityId entity = { index, slot.Generation };
+	slot.Archetype = FindArchetype(mask);
+	slot.Row = AddRow(slot.Archetype, entity);
+
+	count++;
+	structureVersion++;
+	return entity;
+}
+
+void EntityStore::Destroy(EntityId entity)
+{
+	if (!IsAlive(entity))
+		return;
+
+	EntitySlot& slot = slots[entity.Index];
+	RemoveRow(slot.Archetype, slot.Row);
+	slot.Alive = false;
+	freeIndices.push_back(entity.Index);
+
+	count--;
+	structureVersion++;
+
+	// Don't leave any children pointing at it
+	std::vector<EntityId> orphans;
+	ForEach(Components::Parent, [&](EntityArchetype& archetype)
+		{
+			for (unsigned int row = 0; row < archetype.GetCount(); row++)
+			{
+				if (archetype.Parents[row].Entity == entity)
+					orphans.push_back(archetype.Entities[row]);
+			}
+		});
+	for (EntityId orphan : orphans)
+		SetParent(orphan, {});
+}
+
+bool EntityStore::IsAlive(EntityId entity) const
+{
+	return FindSlot(entity) != nullptr;
+}
+
+// --------------------------------------------------------
+// Copies every component both archetypes have into a new
+// row, then removes the old one
+// --------------------------------------------------------
+void EntityStore::SetComponents(EntityId entity, ComponentMask mask)
+{
+	if (!IsAlive(entity) || slots[entity.Index].Archetype == FindArchetype(mask))
+		return;
+
+	// Finding the archetype may have added one, so look them up after
+	unsigned int fromIndex = slots[entity.Index].Archetype;
+	unsigned int fromRow = slots[entity.Index].Row;
+	unsigned int toIndex = FindArchetype(mask);
+	unsigned int toRow = AddRow(toIndex, entity);
+
+	EntityArchetype& from = archetypes[fromIndex];
+	EntityArchetype& to = archetypes[toIndex];
+	ComponentMask shared = from.Mask & to.Mask;
+	if (shared & Components::Transform)
+	{
+		to.Transforms[toRow] = from.Transforms[fromRow];
+		to.Worlds[toRow] = from.Worlds[fromRow];
+		to.WorldInverseTransposes[toRow] = from.WorldInverseTransposes[fromRow];
+		to.TransformChanged[toRow] = from.TransformChanged[fromRow];
+		to.WorldChanged[toRow] = from.WorldChanged[fromRow];
+	}
+	if (shared & Components::Renderable)
+		to.Renderables[toRow] = from.Renderables[fromRow];
+	if (shared & Components::Bounds)
+		to.Bounds[toRow] = from.Bounds[fromRow];
+	if (shared & Components::Spin)
+		to.Spins[toRow] = from.Spins[fromRow];
+	if (shared & Components::Parent)
+		to.Parents[toRow] = from.Parents[fromRow];
+
+	RemoveRow(fromIndex, fromRow);
+	slots[entity.Index].Archetype = toIndex;
+	slots[entity.Index].Row = toRow;
+	structureVersion++;
+}
+
+ComponentMask EntityStore::GetComponents(EntityId entity) const
+{
+	const EntitySlot* slot = FindSlot(entity);
+	return slot ? archetypes[slot->Archetype].Mask : 0;
+}
+
+LocalTransform EntityStore::GetTransform(EntityId entity) const
+{
+	const EntitySlot* slot = FindSlot(entity);
+	if (!slot || !(archetypes[slot->Archetype].Mask & Components::Transform))
+		return { XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 1.0f) };
+
+	return archetypes[slot->Archetype].Transforms[slot->Row];
+}
+
+void EntityStore::SetTransform(EntityId entity, const LocalTransform& transform)
+{
+	const EntitySlot* slot = FindSlot(entity);
+	if (!slot || !(archetypes[slot->Archetype].Mask & Components::Transform))
+		return;
+
+	EntityArchetype& archetype = archetypes[slot->Archetype];
+	archetype.Transforms[slot->Row] = transform;
+
+	// Rotations must stay unit length for the matrix math
+	XMStoreFloat4(&archetype.Transforms[slot->Row].Rotation, XMQuaternionNormalize(XMLoadFloat4(&transform.Rotation)));
+	archetype.TransformChanged[slot->Row] = 1;
+}
+
+Renderable* EntityStore::GetRenderable(EntityId entity)
+{
+	const EntitySlot* slot = FindSlot(entity);
+	if (!slot || !(archetypes[slot->Archetype].Mask & Components::Renderable))
+		return nullptr;
+
+	return &archetypes[slot->Archetype].Renderables[slot->Row];
+}
+
+LocalBounds* EntityStore::GetBounds(EntityId entity)
+{
+	const EntitySlot* slot = FindSlot(entity);
+	if (!slot || !(archetypes[slot->Archetype].Mask & Components::Bounds))
+		return nullptr;
+
+	return &archetypes[slot->Archetype].Bounds[slot->Row];
+}
+
+Spin* EntityStore::GetSpin(EntityId entity)
+{
+	const EntitySlot* slot = FindSlot(entity);
+	if (!slot || !(archetypes[slot->Archetype].Mask & Components::Spin))
+		return nullptr;
+
+	return &archetypes[slot->Archetype].Spins[slot->Row];
+}
+
+void EntityStore::SetParent(EntityId child, EntityId parent)
+{
+	ComponentMask mask = GetComponents(child);
+	if (!(mask & Components::Transform) || parent == child)
+		return;
+
+	// A null parent just detaches the child
+	if (parent == EntityId{})
+	{
+		if (!(mask & Components::Parent))
+			return;
+
+		SetComponents(child, mask & ~Components::Parent);
+	}
+	else
+	{
+		if (!(GetComponents(parent) & Components::Transform) || GetParent(child) == parent)
+			return;
+
+		// Can't become a child of one of its own children
+		for (EntityId ancestor = parent; ancestor != EntityId{}; ancestor = GetParent(ancestor))
+		{
+			if (ancestor == child)
+				return;
+		}
+
+		SetComponents(child, mask | Components::Parent);
+		const EntitySlot* slot = FindSlot(child);
+		archetypes[slot->Archetype].Parents[slot->Row].Entity = parent;
+	}
+
+	// Local values are kept, so the world matrix has to change
+	const EntitySlot* slot = FindSlot(child);
+	archetypes[slot->Archetype].TransformChanged[slot->Row] = 1;
+}
+
+EntityId EntityStore::GetParent(EntityId entity) const
+{
+	const EntitySlot* slot = FindSlot(entity);
+	if (!slot || !(archetypes[slot->Archetype].Mask & Components::Parent))
+		return {};
+
+	return archetypes[slot->Archetype].Parents[slot->Row].Entity;
+}
+
+EntityLocation EntityStore::GetLocation(EntityId entity) const
+{
+	const EntitySlot* slot = FindSlot(entity);
+	return slot ? EntityLocation{ slot->Archetype, slot->Row } : EntityLocation{ UINT_MAX, UINT_MAX };
+}
+
+EntityArchetype& EntityStore::GetArchetype(unsigned int index)
+{
+	return archetypes[index];
+}
+
+unsigned int EntityStore::GetArchetypeCount() const
+{
+	return (unsigned int)archetypes.size();
+}
+
+void EntityStore::GetLocations(ComponentMask required, std::vector<EntityLocation>& locations) const
+{
+	locations.clear();
+	for (unsigned int i = 0; i < archetypes.size(); i++)
+	{
+		if ((archetypes[i].Mask & required) != required)
+			continue;
+
+		for (unsigned int row = 0; row < archetypes[i].GetCount(); row++)
+			locations.push_back({ i, row });
+	}
+}
+
+// --------------------------------------------------------
+// Rotates each spinning entity after its current rotation,
+// so around its parent's (here, the world's) axes, the
+// same as Transform::Rotate() with a quaternion
+// --------------------------------------------------------
+void EntityStore::UpdateSpins(float deltaTime)
+{
+	ForEach(Components::Transform | Components::Spin, [&](EntityArchetype& archetype)
+		{
+			for (unsigned int row = 0; row < archetype.GetCount(); row++)
+			{
+				XMVECTOR angles = XMVectorScale(XMLoadFloat3(&archetype.Spins[row].PitchYawRollPerSecond), deltaTime);
+				if (XMVector3Equal(angles, XMVectorZero()))
+					continue;
+
+				XMFLOAT4& rotation = archetype.Transforms[row].Rotation;
+				XMVECTOR turned = XMQuaternionMultiply(XMLoadFloat4(&rotation), XMQuaternionRotationRollPitchYawFromVector(angles));
+				XMStoreFloat4(&rotation, XMQuaternionNormalize(turned));
+				archetype.TransformChanged[row] = 1;
+			}
+		});
+}
+
+// --------------------------------------------------------
+// Gathers changed rows four at a time, for the same math
+// TransformSystem uses (so results match exactly)
+// - Entities without a parent go first, then children
+// --------------------------------------------------------
+void EntityStore::UpdateWorldMatrices()
+{
+	ForEach(Components::Transform, [](EntityArchetype& archetype)
+		{
+			std::fill(archetype.WorldChanged.begin(), archetype.WorldChanged.end(), (unsigned char)0);
+			if (archetype.Mask & Components::Parent)
+				return;
+
+			const LocalTransform* transforms[4];
+			XMFLOAT4X4* worlds[4];
+			XMFLOAT4X4* inverseTransposes[4];
+			size_t rowCount = 0;
+			for (unsigned int row = 0; row < archetype.GetCount(); row++)
+			{
+				if (!archetype.TransformChanged[row])
+					continue;
+
+				archetype.TransformChanged[row] = 0;
+				archetype.WorldChanged[row] = 1;
+				transforms[rowCount] = &archetype.Transforms[row];
+				worlds[rowCount] = &archetype.Worlds[row];
+				inverseTransposes[rowCount] = &archetype.WorldInverseTransposes[row];
+				if (++rowCount == 4)
+				{
+					CalculateLocalMatrices(transforms, worlds, inverseTransposes, rowCount);
+					rowCount = 0;
+				}
+			}
+			if (rowCount > 0)
+				CalculateLocalMatrices(transforms, worlds, inverseTransposes, rowCount);
+		});
+
+	UpdateChildWorldMatrices();
+}
+
+// --------------------------------------------------------
+// Sorts every child by how many parents are above it, then
+// recalculates a level at a time, so each parent's world
+// matrix (and WorldChanged) is final before its children
+// look at it
+// - A child is recalculated if it changed or its parent's
+//    world matrix did: its local matrices four at a time,
+//    then each times its parent's
+// --------------------------------------------------------
+void EntityStore::UpdateChildWorldMatrices()
+{
+	children.clear();
+	childDepths.clear();
+	unsigned int maxDepth = 0;
+	for (unsigned int i = 0; i < archetypes.size(); i++)
+	{
+		const EntityArchetype& archetype = archetypes[i];
+		if ((archetype.Mask & (Components::Transform | Components::Parent)) != (Components::Transform | Components::Parent))
+			continue;
+
+		for (unsigned int row = 0; row < archetype.GetCount(); row++)
+		{
+			unsigned int depth = 1;
+			for (EntityId ancestor = GetParent(archetype.Parents[row].Entity); ancestor != EntityId{}; ancestor = GetParent(ancestor))
+				depth++;
+
+			children.push_back({ i, row });
+			childDepths.push_back(depth);
+			maxDepth = std::max(maxDepth, depth);
+		}
+	}
+	if (children.empty())
+		return;
+
+	// Counting sort by depth
+	depthStarts.assign(maxDepth + 2, 0);
+	for (unsigned int depth : childDepths)
+		depthStarts[depth + 1]++;
+	for (unsigned int d = 1; d < depthStarts.size(); d++)
+		depthStarts[d] += depthStarts[d - 1];
+
+	std::vector<EntityLocation> sorted(children.size());
+	std::vector<unsigned int> levelEnds(depthStarts.begin() + 1, depthStarts.end());
+	for (size_t i = 0; i < children.size(); i++)
+		sorted[depthStarts[childDepths[i]]++] = children[i];
+	children.swap(sorted);
+
+	// Where a child's parent's matrices are, or null if the parent has lost
+	// its Transform (leaving the child relative to the world)
+	auto findParent = [&](const EntityLocation& child) -> const EntitySlot*
+		{
+			const EntitySlot* parent = FindSlot(archetypes[child.Archetype].Parents[child.Row].Entity);
+			return parent && (archetypes[parent->Archetype].Mask & Components::Transform) ? parent : nullptr;
+		};
+
+	size_t levelStart = 0;
+	for (unsigned int depth = 1; depth <= maxDepth; depth++)
+	{
+		size_t levelEnd = levelEnds[depth];
+
+		changedChildren.clear();
+		for (size_t i = levelStart; i < levelEnd; i++)
+		{
+			const EntitySlot* parent = findParent(children[i]);
+			if (archetypes[children[i].Archetype].TransformChanged[children[i].Row] ||
+				(parent && archetypes[parent->Archetype].WorldChanged[parent->Row]))
+				changedChildren.push_back(children[i]);
+		}
+		levelStart = levelEnd;
+
+		for (size_t first = 0; first < changedChildren.size(); first += 4)
+		{
+			const LocalTransform* transforms[4];
+			XMFLOAT4X4* worlds[4];
+			XMFLOAT4X4* inverseTransposes[4];
+			size_t laneCount = std::min<size_t>(4, changedChildren.size() - first);
+			for (size_t lane = 0; lane < laneCount; lane++)
+			{
+				EntityArchetype& archetype = archetypes[changedChildren[first + lane].Archetype];
+				unsigned int row = changedChildren[first + lane].Row;
+				transforms[lane] = &archetype.Transforms[row];
+				worlds[lane] = &archetype.Worlds[row];
+				inverseTransposes[lane] = &archetype.WorldInverseTransposes[row];
+			}
+			CalculateLocalMatrices(transforms, worlds, inverseTransposes, laneCount);
+		}
+
+		for (const EntityLocation& child : changedChildren)
+		{
+			EntityArchetype& archetype = archetypes[child.Archetype];
+			const EntitySlot* parentSlot = findParent(child);
+			if (parentSlot)
+			{
+				const EntityArchetype& parent = archetypes[parentSlot->Archetype];
+				XMFLOAT4X4& world = archetype.Worlds[child.Row];
+				XMFLOAT4X4& inverseTranspose = archetype.WorldInverseTransposes[child.Row];
+				XMStoreFloat4x4(&world, XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&parent.Worlds[parentSlot->Row])));
+				XMStoreFloat4x4(&inverseTranspose, XMMatrixMultiply(XMLoadFloat4x4(&inverseTranspose), XMLoadFloat4x4(&parent.WorldInverseTransposes[parentSlot->Row])));
+			}
+			archetype.TransformChanged[child.Row] = 0;
+			archetype.WorldChanged[child.Row] = 1;
+		}
+	}
+}
+
+unsigned int EntityStore::GetCount() const
+{
+	return count;
+}
+
+unsigned int EntityStore::GetStructureVersion() const
+{
+	return structureVersion;
+}
+
+unsigned int EntityStore::FindArchetype(ComponentMask mask)
+{
+	for (unsigned int i = 0; i < archetypes.size(); i++)
+	{
+		if (archetypes[i].Mask == mask)
+			return i;
+	}
+
+	archetypes.emplace_back();
+	archetypes.back().Mask = mask;
+	return (unsigned int)archetypes.size() - 1;
+}
+
+// --------------------------------------------------------
+// Adds a row with default values for every component the
+// archetype has
+// --------------------------------------------------------
+unsigned int EntityStore::AddRow(unsigned int archetypeIndex, EntityId entity)
+{
+	EntityArchetype& archetype = archetypes[archetypeIndex];
+	archetype.Entities.push_back(entity);
+
+	if (archetype.Mask & Components::Transform)
+	{
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		archetype.Transforms.push_back({ XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 1.0f) });
+		archetype.Worlds.push_back(identity);
+		archetype.WorldInverseTransposes.push_back(identity);
+		archetype.TransformChanged.push_back(0);
+		archetype.WorldChanged.push_back(0);
+	}
+	if (archetype.Mask & Components::Renderable)
+		archetype.Renderables.push_back({});
+	if (archetype.Mask & Components::Bounds)
+		archetype.Bounds.push_back({});
+	if (archetype.Mask & Components::Spin)
+		archetype.Spins.push_back({});
+	if (archetype.Mask & Components::Parent)
+		archetype.Parents.push_back({});
+
+	return archetype.GetCount() - 1;
+}
+
+// --------------------------------------------------------
+// Moves the archetype's last row into this one, and points
+// the moved entity's slot at its new row
+// --------------------------------------------------------
+void EntityStore::RemoveRow(unsigned int archetypeIndex, unsigned int row)
+{
+	EntityArchetype& archetype = archetypes[archetypeIndex];
+	unsigned int last = archetype.GetCount() - 1;
+	if (row != last)
+		slots[archetype.Entities[last].Index].Row = row;
+
+	SwapRemove(archetype.Entities, row);
+	SwapRemove(archetype.Transforms, row);
+	SwapRemove(archetype.Worlds, row);
+	SwapRemove(archetype.WorldInverseTransposes, row);
+	SwapRemove(archetype.TransformChanged, row);
+	SwapRemove(archetype.WorldChanged, row);
+	SwapRemove(archetype.Renderables, row);
+	SwapRemove(archetype.Bounds, row);
+	SwapRemove(archetype.Spins, row);
+	SwapRemove(archetype.Parents, row);
+}
+
+const EntityStore::EntitySlot* EntityStore::FindSlot(EntityId entity) const
+{
+	if (entity.Index >= slots.size())
+		return nullptr;
+
+	const EntitySlot& slot = slots[entity.Index];
+	return slot.Alive && slot.Generation == entity.Generation ? &slot : nullptr;
+}
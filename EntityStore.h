@@ -0,0 +1,220 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "ResourcePool.h"
+
+class Mesh;
+class Material;
+
+// --------------------------------------------------------
+// Identifies one entity in an EntityStore
+// - Index is its slot in the store, which is reused once
+//    it's destroyed; Generation counts those reuses, so an
+//    old ID never finds the entity that took its slot
+// - Generation 0 is never used, so a zeroed ID is null
+// --------------------------------------------------------
+struct EntityId
+{
+	unsigned int Index;
+	unsigned int Generation;
+
+	bool operator==(const EntityId& other) const = default;
+};
+
+// Meshes and materials in the game's resource pools
+using MeshHandle = ResourceHandle<Mesh>;
+using MaterialHandle = ResourceHandle<Material>;
+
+// --------------------------------------------------------
+// Which components an entity has, one bit each
+// --------------------------------------------------------
+using ComponentMask = unsigned int;
+
+namespace Components
+{
+	constexpr ComponentMask Transform = 1 << 0;		// LocalTransform, plus its world matrices
+	constexpr ComponentMask Renderable = 1 << 1;
+	constexpr ComponentMask Bounds = 1 << 2;		// LocalBounds
+	constexpr ComponentMask Spin = 1 << 3;
+	constexpr ComponentMask Occluder = 1 << 4;		// No data, just hides what's behind it when culling
+	constexpr ComponentMask Parent = 1 << 5;		// Transform is relative to another entity's
+}
+
+// World = scale * rotation (a unit quaternion) * translation
+struct LocalTransform
+{
+	DirectX::XMFLOAT3 Translation;
+	DirectX::XMFLOAT4 Rotation;
+	DirectX::XMFLOAT3 Scale;
+};
+
+struct Renderable
+{
+	MeshHandle Mesh;
+	MaterialHandle Material;
+};
+
+// Local-space box, usually the mesh's
+struct LocalBounds
+{
+	DirectX::XMFLOAT3 Min;
+	DirectX::XMFLOAT3 Max;
+};
+
+// Turns the entity a little every update, after its current rotation
+struct Spin
+{
+	DirectX::XMFLOAT3 PitchYawRollPerSecond;
+};
+
+// The entity whose world matrix this one's local transform is relative to
+// - Set through EntityStore::SetParent(), which keeps out cycles
+struct Parent
+{
+	EntityId Entity;
+};
+
+// --------------------------------------------------------
+// Every entity with exactly the same components, each kept
+// in its own array with one element per entity (row)
+// - Arrays for components the archetype doesn't have are
+//    left empty
+// - Writing Transforms directly means also setting that
+//    row's TransformChanged, so its world matrices are
+//    recalculated
+// - WorldChanged marks the rows whose world matrices the
+//    last UpdateWorldMatrices() recalculated, whether they
+//    or one of their parents changed
+// --------------------------------------------------------
+struct EntityArchetype
+{
+	ComponentMask Mask;
+	std::vector<EntityId> Entities;
+
+	std::vector<LocalTransform> Transforms;
+	std::vector<DirectX::XMFLOAT4X4> Worlds;
+	std::vector<DirectX::XMFLOAT4X4> WorldInverseTransposes;
+	std::vector<unsigned char> TransformChanged;
+	std::vector<unsigned char> WorldChanged;
+
+	std::vector<Renderable> Renderables;
+	std::vector<LocalBounds> Bounds;
+	std::vector<Spin> Spins;
+	std::vector<Parent> Parents;
+
+	unsigned int GetCount() const { return (unsigned int)Entities.size(); }
+};
+
+// Where an entity's components are in the store
+struct EntityLocation
+{
+	unsigned int Archetype;
+	unsigned int Row;
+};
+
+// --------------------------------------------------------
+// Entities and their components, grouped by archetype so
+// systems walk contiguous arrays instead of following a
+// pointer per entity (and per component)
+// - Destroying an entity moves the last one in its
+//    archetype into its row, so rows (unlike IDs) aren't
+//    stable; GetStructureVersion() changes whenever any
+//    entity moves, is created or is destroyed
+// - An entity with a Parent has its world matrix built on
+//    its parent's, as Transform does: local values are kept
+//    when the parent changes, and destroying a parent
+//    leaves its children relative to the world instead
+// --------------------------------------------------------
+class EntityStore
+{
+public:
+	EntityStore();
+	~EntityStore();
+
+	// New entities start with an identity transform and zeroed components
+	EntityId Create(ComponentMask mask);
+	void Destroy(EntityId entity);
+	bool IsAlive(EntityId entity) const;
+
+	// Moves the entity to the archetype for its new set of components,
+	// keeping the values of any it still has
+	void SetComponents(EntityId entity, ComponentMask mask);
+	ComponentMask GetComponents(EntityId entity) const;
+
+	// Component access by ID, for anything that isn't a whole system
+	// - Pointers are null if the entity is gone or lacks the component,
+	//    and only valid until the next structural change
+	LocalTransform GetTransform(EntityId entity) const;
+	void SetTransform(EntityId entity, const LocalTransform& transform);
+	Renderable* GetRenderable(EntityId entity);
+	LocalBounds* GetBounds(EntityId entity);
+	Spin* GetSpin(EntityId entity);
+
+	// Parents and children
+	// - A null parent makes the entity relative to the world again
+	// - Both need a Transform, and an entity can't become a child
+	//    of one of its own children
+	void SetParent(EntityId child, EntityId parent);
+	EntityId GetParent(EntityId entity) const;
+
+	EntityLocation GetLocation(EntityId entity) const;
+	EntityArchetype& GetArchetype(unsigned int index);
+	unsigned int GetArchetypeCount() const;
+
+	// Calls system once for each archetype with at least the required
+	// components (and any entities), always in the same order
+	template<typename System>
+	void ForEach(ComponentMask required, System&& system)
+	{
+		for (EntityArchetype& archetype : archetypes)
+		{
+			if ((archetype.Mask & required) == required && !archetype.Entities.empty())
+				system(archetype);
+		}
+	}
+
+	// Fills locations with where every entity with at least the required
+	// components is, in the same order as ForEach()
+	void GetLocations(ComponentMask required, std::vector<EntityLocation>& locations) const;
+
+	// Systems
+	// - UpdateWorldMatrices() does every entity without a parent
+	//    first, then children a level at a time, so parents are
+	//    always done before their children
+	void UpdateSpins(float deltaTime);
+	void UpdateWorldMatrices();
+
+	unsigned int GetCount() const;
+	unsigned int GetStructureVersion() const;
+
+private:
+
+	// Every index ever handed out, alive or not
+	struct EntitySlot
+	{
+		unsigned int Generation;
+		unsigned int Archetype;
+		unsigned int Row;
+		bool Alive;
+	};
+
+	std::vector<EntitySlot> slots;
+	std::vector<unsigned int> freeIndices;
+	std::vector<EntityArchetype> archetypes;
+	unsigned int count;
+	unsigned int structureVersion;
+
+	// Scratch space for updating children, kept to avoid reallocating
+	std::vector<EntityLocation> children;
+	std::vector<unsigned int> childDepths;
+	std::vector<unsigned int> depthStarts;
+	std::vector<EntityLocation> changedChildren;
+
+	unsigned int FindArchetype(ComponentMask mask);
+	unsigned int AddRow(unsigned int archetypeIndex, EntityId entity);
+	void RemoveRow(unsigned int archetypeIndex, unsigned int row);
+	const EntitySlot* FindSlot(EntityId entity) const;
+	void UpdateChildWorldMatrices();
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cmath>
+
+#define FRUSTUM_PLANE_LEFT 0
+#define FRUSTUM_PLANE_RIGHT 1
+#define FRUSTUM_PLANE_BOTTOM 2
+#define FRUSTUM_PLANE_TOP 3
+#define FRUSTUM_PLANE_NEAR 4
+#define FRUSTUM_PLANE_FAR 5
+
+// --------------------------------------------------------
+// The six planes bounding what a camera can see
+// - Each plane is (normal.xyz, distance) with the normal
+//    pointing inward, so dot(normal, point) + distance is
+//    negative for points outside
+// --------------------------------------------------------
+struct Frustum
+{
+	DirectX::XMFLOAT4 Planes[6];	// Indexed by FRUSTUM_PLANE_* above
+
+	// Extracts the planes from a (world *) view * projection matrix
+	// - The planes end up in whatever space the matrix transforms from,
+	//    so passing world * view * projection gives local-space planes
+	// - Assumes D3D clip space (0 <= z <= w)
+	inline static Frustum FromMatrix(DirectX::XMFLOAT4X4 m)
+	{
+		Frustum result = {};
+		result.Planes[FRUSTUM_PLANE_LEFT] = DirectX::XMFLOAT4(m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41);
+		result.Planes[FRUSTUM_PLANE_RIGHT] = DirectX::XMFLOAT4(m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41);
+		result.Planes[FRUSTUM_PLANE_BOTTOM] = DirectX::XMFLOAT4(m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42);
+		result.Planes[FRUSTUM_PLANE_TOP] = DirectX::XMFLOAT4(m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42);
+		result.Planes[FRUSTUM_PLANE_NEAR] = DirectX::XMFLOAT4(m._13, m._23, m._33, m._43);
+		result.Planes[FRUSTUM_PLANE_FAR] = DirectX::XMFLOAT4(m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43);
+
+		// Normalize so distances to the planes are in world units
+		for (DirectX::XMFLOAT4& plane : result.Planes)
+			DirectX::XMStoreFloat4(&plane, DirectX::XMPlaneNormalize(DirectX::XMLoadFloat4(&plane)));
+
+		return result;
+	}
+
+	// Is any part of the sphere inside (or touching) all six planes?
+	inline bool IntersectsSphere(DirectX::XMFLOAT3 center, float radius) const
+	{
+		for (const DirectX::XMFLOAT4& plane : Planes)
+		{
+			if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+				return false;
+		}
+		return true;
+	}
+
+	// Is any part of the box (given by its center and half size) inside
+	// (or touching) all six planes?
+	// - Conservative near the frustum's corners, like the sphere test
+	inline bool IntersectsBox(DirectX::XMFLOAT3 center, DirectX::XMFLOAT3 extents) const
+	{
+		for (const DirectX::XMFLOAT4& plane : Planes)
+		{
+			float radius = fabsf(plane.x) * extents.x + fabsf(plane.y) * extents.y + fabsf(plane.z) * extents.z;
+			if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+				return false;
+		}
+		return true;
+	}
+};
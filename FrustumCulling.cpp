@@ -0,0 +1,162 @@
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+using namespace DirectX;
+
+void FrustumCulling::Resize(WorldBounds& bounds, size_t count)
+{
+	bounds.CenterX.resize(count);
+	bounds.CenterY.resize(count);
+	bounds.CenterZ.resize(count);
+	bounds.ExtentX.resize(count);
+	bounds.ExtentY.resize(count);
+	bounds.ExtentZ.resize(count);
+	bounds.Radius.resize(count);
+}
+
+// --------------------------------------------------------
+// Transforms a local-space box into world space
+// - The box's center goes through the matrix like any other
+//    point, and each world extent is the sum of the local
+//    extents times the absolute values of the matrix's
+//    rows (Arvo, "Transforming Axis-Aligned Bounding Boxes")
+// - The sphere is the local box's half diagonal, scaled by
+//    the longest of the matrix's rows, which is tighter than
+//    a sphere around the world box when rotated
+// --------------------------------------------------------
+void FrustumCulling::SetFromLocalBox(WorldBounds& bounds, size_t index,
+	XMFLOAT3 localMin, XMFLOAT3 localMax, const XMFLOAT4X4& world)
+{
+	XMVECTOR minimum = XMLoadFloat3(&localMin);
+	XMVECTOR maximum = XMLoadFloat3(&localMax);
+	XMVECTOR localCenter = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+	XMVECTOR localExtents = XMVectorScale(XMVectorSubtract(maximum, minimum), 0.5f);
+
+	XMMATRIX matrix = XMLoadFloat4x4(&world);
+	XMVECTOR center = XMVector3Transform(localCenter, matrix);
+	XMVECTOR extents = XMVectorMultiply(XMVectorSplatX(localExtents), XMVectorAbs(matrix.r[0]));
+	extents = XMVectorMultiplyAdd(XMVectorSplatY(localExtents), XMVectorAbs(matrix.r[1]), extents);
+	extents = XMVectorMultiplyAdd(XMVectorSplatZ(localExtents), XMVectorAbs(matrix.r[2]), extents);
+
+	float maxScaleSquared = std::max({
+		XMVectorGetX(XMVector3LengthSq(matrix.r[0])),
+		XMVectorGetX(XMVector3LengthSq(matrix.r[1])),
+		XMVectorGetX(XMVector3LengthSq(matrix.r[2])) });
+
+	XMFLOAT3 c, e;
+	XMStoreFloat3(&c, center);
+	XMStoreFloat3(&e, extents);
+	bounds.CenterX[index] = c.x;
+	bounds.CenterY[index] = c.y;
+	bounds.CenterZ[index] = c.z;
+	bounds.ExtentX[index] = e.x;
+	bounds.ExtentY[index] = e.y;
+	bounds.ExtentZ[index] = e.z;
+	bounds.Radius[index] = XMVectorGetX(XMVector3Length(localExtents)) * sqrtf(maxScaleSquared);
+}
+
+// --------------------------------------------------------
+// Outside a plane if the center is further behind it than
+// the smaller of the sphere's radius and the box's extent
+// along the plane's normal
+// --------------------------------------------------------
+bool FrustumCulling::Test(const WorldBounds& bounds, size_t index, const Frustum& frustum)
+{
+	XMFLOAT3 center(bounds.CenterX[index], bounds.CenterY[index], bounds.CenterZ[index]);
+	XMFLOAT3 extents(bounds.ExtentX[index], bounds.ExtentY[index], bounds.ExtentZ[index]);
+	return frustum.IntersectsSphere(center, bounds.Radius[index]) && frustum.IntersectsBox(center, extents);
+}
+
+// --------------------------------------------------------
+// Same test as Test(), with four objects per vector (one
+// per lane) and each plane's components splatted across
+// all four lanes
+// - A group stops testing planes once all four are outside
+// - Anything left over after the last group of four goes
+//    through Test() on its own
+// --------------------------------------------------------
+unsigned int FrustumCulling::Cull(const WorldBounds& bounds, const Frustum& frustum, std::vector<unsigned int>& visible)
+{
+	visible.clear();
+
+	size_t count = bounds.Radius.size();
+	size_t groupedCount = count & ~(size_t)3;
+
+	// Each plane's components, splatted once up front
+	XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6], planeAbsX[6], planeAbsY[6], planeAbsZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		XMVECTOR plane = XMLoadFloat4(&frustum.Planes[p]);
+		planeX[p] = XMVectorSplatX(plane);
+		planeY[p] = XMVectorSplatY(plane);
+		planeZ[p] = XMVectorSplatZ(plane);
+		planeW[p] = XMVectorSplatW(plane);
+		planeAbsX[p] = XMVectorAbs(planeX[p]);
+		planeAbsY[p] = XMVectorAbs(planeY[p]);
+		planeAbsZ[p] = XMVectorAbs(planeZ[p]);
+	}
+
+	for (size_t first = 0; first < groupedCount; first += 4)
+	{
+		XMVECTOR cx = XMLoadFloat4((const XMFLOAT4*)&bounds.CenterX[first]);
+		XMVECTOR cy = XMLoadFloat4((const XMFLOAT4*)&bounds.CenterY[first]);
+		XMVECTOR cz = XMLoadFloat4((const XMFLOAT4*)&bounds.CenterZ[first]);
+		XMVECTOR ex = XMLoadFloat4((const XMFLOAT4*)&bounds.ExtentX[first]);
+		XMVECTOR ey = XMLoadFloat4((const XMFLOAT4*)&bounds.ExtentY[first]);
+		XMVECTOR ez = XMLoadFloat4((const XMFLOAT4*)&bounds.ExtentZ[first]);
+		XMVECTOR radius = XMLoadFloat4((const XMFLOAT4*)&bounds.Radius[first]);
+
+		XMVECTOR inside = XMVectorTrueInt();
+		for (int p = 0; p < 6; p++)
+		{
+			// Signed distance from each center to the plane, summed in the same
+			// order as Frustum's tests so both give the same answers
+			XMVECTOR distance = XMVectorMultiply(cx, planeX[p]);
+			distance = XMVectorMultiplyAdd(cy, planeY[p], distance);
+			distance = XMVectorMultiplyAdd(cz, planeZ[p], distance);
+			distance = XMVectorAdd(distance, planeW[p]);
+
+			// How far each box reaches toward the plane, capped by the sphere
+			XMVECTOR reach = XMVectorMultiply(ex, planeAbsX[p]);
+			reach = XMVectorMultiplyAdd(ey, planeAbsY[p], reach);
+			reach = XMVectorMultiplyAdd(ez, planeAbsZ[p], reach);
+			reach = XMVectorMin(reach, radius);
+
+			inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(distance, XMVectorNegate(reach)));
+			if (XMVector4EqualInt(inside, XMVectorZero()))
+				break;
+		}
+
+		uint32_t lanes[4];
+		XMStoreInt4(lanes, inside);
+		for (unsigned int lane = 0; lane < 4; lane++)
+		{
+			if (lanes[lane])
+				visible.push_back((unsigned int)(first + lane));
+		}
+	}
+
+	for (size_t i = groupedCount; i < count; i++)
+	{
+		if (Test(bounds, i, frustum))
+			visible.push_back((unsigned int)i);
+	}
+
+	return (unsigned int)visible.size();
+}
+
+unsigned int FrustumCulling::CullScalar(const WorldBounds& bounds, const Frustum& frustum, std::vector<unsigned int>& visible)
+{
+	visible.clear();
+
+	for (size_t i = 0; i < bounds.Radius.size(); i++)
+	{
+		if (Test(bounds, i, frustum))
+			visible.push_back((unsigned int)i);
+	}
+
+	return (unsigned int)visible.size();
+}
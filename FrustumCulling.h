@@ -0,0 +1,41 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Frustum.h"
+
+// --------------------------------------------------------
+// World-space bounds of many objects, with one array per
+// component so they can be culled four at a time
+// - Each object has both a box and a sphere around the
+//    same center, and is culled if either is outside
+// --------------------------------------------------------
+struct WorldBounds
+{
+	std::vector<float> CenterX, CenterY, CenterZ;
+	std::vector<float> ExtentX, ExtentY, ExtentZ;	// Half the size of the box
+	std::vector<float> Radius;
+};
+
+namespace FrustumCulling
+{
+	// Sets how many objects the bounds hold
+	void Resize(WorldBounds& bounds, size_t count);
+
+	// Transforms a local-space box (like a Mesh's bounds) by a world
+	// matrix, and fits the world-space box and sphere around it
+	void SetFromLocalBox(WorldBounds& bounds, size_t index,
+		DirectX::XMFLOAT3 localMin, DirectX::XMFLOAT3 localMax, const DirectX::XMFLOAT4X4& world);
+
+	// Tests one object's box and sphere against the frustum
+	bool Test(const WorldBounds& bounds, size_t index, const Frustum& frustum);
+
+	// Fills visible with the index of every object that passes Test(),
+	// checking four objects against each plane at once
+	// - Returns how many there are
+	unsigned int Cull(const WorldBounds& bounds, const Frustum& frustum, std::vector<unsigned int>& visible);
+
+	// Same as Cull(), one object at a time, for comparison
+	unsigned int CullScalar(const WorldBounds& bounds, const Frustum& frustum, std::vector<unsigned int>& visible);
+}
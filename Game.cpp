@@ -13,7 +13,15 @@
 #include "WICTextureLoader.h"
 
 #include <DirectXMath.h>
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <chrono>
+#include <future>
+#include <iterator>
 #include <memory>
+#include <random>
+#include <thread>
 #include <d3d11shadertracing.h>
 
 // Needed for a helper function to load pre-compiled shader files
@@ -45,9 +53,22 @@ Game::Game()
 	//  - You'll be expanding and/or replacing these later
 	LoadShaders();
 	CreateGameEntities();
-	CreateStartingCameras();
+	cameras = CreateStartingCameras();
 	CreateInitialLights();
 
+	// Occlusion culling rasterizes on every core, the BVH builds and refits on them,
+	// and the draw list sorts on them
+	occlusionCuller = std::make_shared<OcclusionCuller>(256, 128, std::thread::hardware_concurrency());
+	workers = std::make_shared<WorkerPool>(std::thread::hardware_concurrency());
+	entityBvh = std::make_shared<SceneBvh>(workers);
+	drawList = std::make_shared<DrawList>(workers);
+
+	// Recorded entity commands name their pipeline by vertex format
+	commandExecutor = std::make_shared<D3D11CommandExecutor>(meshes, materials, textures);
+	commandExecutor->SetPipeline((unsigned int)VertexFormat::Full, { inputLayout.Get(), nullptr });
+	commandExecutor->SetPipeline((unsigned int)VertexFormat::Packed, { packedInputLayout.Get(), packedVertexShader.Get() });
+	commandExecutor->SetPipeline((unsigned int)VertexFormat::PackedFloatPosition, { packedFloatPositionInputLayout.Get(), packedVertexShader.Get() });
+
 	// Set initial graphics API state
 	//  - These settings persist until we change them
 	//  - Some of these, like the primitive topology & input layout, probably won't change
@@ -61,7 +82,7 @@ Game::Game()
 		// Ensure the pipeline knows how to interpret all the numbers stored in
 		// the vertex buffer. For this course, all of your vertices will probably
 		// have the same layout, so we can just set this once at startup.
-		Graphics::Context->IASetInputLayout(inputLayout.Get());
+		Graphics::State->SetInputLayout(inputLayout.Get());
 	}
 }
 
@@ -97,6 +118,9 @@ void Game::LoadShaders()
 	// - Literally just a big array of bytes read from a file
 	ID3DBlob* pixelShaderBlob;
 	ID3DBlob* vertexShaderBlob;
+	ID3DBlob* packedVertexShaderBlob;
+	ID3DBlob* instancedVertexShaderBlob;
+	ID3DBlob* instancedPackedVertexShaderBlob;
 
 	// Loading shaders
 	//  - Visual Studio will compile our shaders at build time
@@ -109,6 +133,24 @@ void Game::LoadShaders()
 		// - Note the "L" before the string - this tells the compiler the string uses wide characters
 		D3DReadFileToBlob(FixPath(L"PixelShader.cso").c_str(), &pixelShaderBlob);
 		D3DReadFileToBlob(FixPath(L"VertexShader.cso").c_str(), &vertexShaderBlob);
+		D3DReadFileToBlob(FixPath(L"PackedVertexShader.cso").c_str(), &packedVertexShaderBlob);
+		D3DReadFileToBlob(FixPath(L"InstancedVertexShader.cso").c_str(), &instancedVertexShaderBlob);
+		D3DReadFileToBlob(FixPath(L"InstancedPackedVertexShader.cso").c_str(), &instancedPackedVertexShaderBlob);
+	}
+
+	// Per-instance elements, added after the per-vertex ones in each instanced layout
+	//  - Two matrices (see InstanceData), a row at a time, from vertex buffer slot 1
+	//  - The step rate of 1 moves on to the next instance's matrices after each instance
+	D3D11_INPUT_ELEMENT_DESC instanceElements[8] = {};
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		instanceElements[i].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;		// 4x 32-bit floats
+		instanceElements[i].SemanticName = i < 4 ? "WORLD" : "WORLDINVTRANSPOSE";
+		instanceElements[i].SemanticIndex = i % 4;
+		instanceElements[i].InputSlot = 1;
+		instanceElements[i].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
+		instanceElements[i].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+		instanceElements[i].InstanceDataStepRate = 1;
 	}
 
 	// Create an input layout 
@@ -146,6 +188,97 @@ void Game::LoadShaders()
 			vertexShaderBlob->GetBufferPointer(),	// Pointer to the code of a shader that uses this layout
 			vertexShaderBlob->GetBufferSize(),		// Size of the shader code that uses this layout
 			inputLayout.GetAddressOf());			// Address of the resulting ID3D11InputLayout pointer
+
+		// Same vertices, plus the instance's matrices
+		D3D11_INPUT_ELEMENT_DESC instancedElements[12] = {};
+		std::copy(inputElements, inputElements + 4, instancedElements);
+		std::copy(instanceElements, instanceElements + 8, instancedElements + 4);
+
+		Graphics::Device->CreateInputLayout(
+			instancedElements,
+			12,
+			instancedVertexShaderBlob->GetBufferPointer(),
+			instancedVertexShaderBlob->GetBufferSize(),
+			instancedInputLayout.GetAddressOf());
+
+		Graphics::Device->CreateVertexShader(
+			instancedVertexShaderBlob->GetBufferPointer(),
+			instancedVertexShaderBlob->GetBufferSize(),
+			0,
+			instancedVertexShader.GetAddressOf());
+	}
+
+	// Create the input layouts for packed vertices (see PackedVertex.h)
+	//  - Both formats share a vertex shader, which just sees a float4 position
+	//  - The only difference is how that position is stored
+	{
+		D3D11_INPUT_ELEMENT_DESC inputElements[3] = {};
+
+		// Position (w is padding), 0-1 within the mesh's bounds
+		inputElements[0].Format = DXGI_FORMAT_R16G16B16A16_UNORM;			// 4x 16-bit normalized unsigned integers
+		inputElements[0].SemanticName = "POSITION";
+		inputElements[0].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
+
+		// UV coordinate
+		inputElements[1].Format = DXGI_FORMAT_R16G16_FLOAT;					// 2x 16-bit floats
+		inputElements[1].SemanticName = "TEXCOORD";
+		inputElements[1].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
+
+		// Octahedral normal and tangent
+		inputElements[2].Format = DXGI_FORMAT_R16G16B16A16_SNORM;			// 4x 16-bit normalized signed integers
+		inputElements[2].SemanticName = "NORMAL";
+		inputElements[2].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
+
+		Graphics::Device->CreateInputLayout(
+			inputElements,
+			3,
+			packedVertexShaderBlob->GetBufferPointer(),
+			packedVertexShaderBlob->GetBufferSize(),
+			packedInputLayout.GetAddressOf());
+
+		// Same thing with full float positions
+		inputElements[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;			// 3x 32-bit floats
+
+		Graphics::Device->CreateInputLayout(
+			inputElements,
+			3,
+			packedVertexShaderBlob->GetBufferPointer(),
+			packedVertexShaderBlob->GetBufferSize(),
+			packedFloatPositionInputLayout.GetAddressOf());
+
+		// And both again with the instance's matrices
+		D3D11_INPUT_ELEMENT_DESC instancedElements[11] = {};
+		std::copy(inputElements, inputElements + 3, instancedElements);
+		std::copy(instanceElements, instanceElements + 8, instancedElements + 3);
+
+		Graphics::Device->CreateInputLayout(
+			instancedElements,
+			11,
+			instancedPackedVertexShaderBlob->GetBufferPointer(),
+			instancedPackedVertexShaderBlob->GetBufferSize(),
+			instancedPackedFloatPositionInputLayout.GetAddressOf());
+
+		instancedElements[0].Format = DXGI_FORMAT_R16G16B16A16_UNORM;
+
+		Graphics::Device->CreateInputLayout(
+			instancedElements,
+			11,
+			instancedPackedVertexShaderBlob->GetBufferPointer(),
+			instancedPackedVertexShaderBlob->GetBufferSize(),
+			instancedPackedInputLayout.GetAddressOf());
+
+		// We already have the byte code, so make the shader now too
+		Graphics::Device->CreateVertexShader(
+			packedVertexShaderBlob->GetBufferPointer(),
+			packedVertexShaderBlob->GetBufferSize(),
+			0,
+			packedVertexShader.GetAddressOf());
+
+		Graphics::Device->CreateVertexShader(
+			instancedPackedVertexShaderBlob->GetBufferPointer(),
+			instancedPackedVertexShaderBlob->GetBufferSize(),
+			0,
+			instancedPackedVertexShader.GetAddressOf());
 	}
 }
 
@@ -210,76 +343,55 @@ void Game::CreateGameEntities()
 	XMFLOAT4 greenTint(0.5f, 1.0f, 0.5f, 1.0f);
 	XMFLOAT4 blueTint(0.5f, 0.5f, 1.0f, 1.0f);
 
-	// Load textures with Shader Resource Views (SRVs)
+	// Load textures with Shader Resource Views (SRVs) into the texture pool
+	auto loadTexture = [&](const wchar_t* path)
+		{
+			Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+			CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), path, nullptr, srv.GetAddressOf());
+			return textures.Add(srv);
+		};
+
 	// Bronze
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/bronze_albedo.png", nullptr, bronzeSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeNormalsSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/bronze_normals.png", nullptr, bronzeNormalsSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeMetalSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/bronze_metal.png", nullptr, bronzeMetalSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeRoughnessSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/bronze_roughness.png", nullptr, bronzeRoughnessSRV.GetAddressOf());
+	TextureHandle bronzeSRV = loadTexture(L"Assets/Textures/bronze_albedo.png");
+	TextureHandle bronzeNormalsSRV = loadTexture(L"Assets/Textures/bronze_normals.png");
+	TextureHandle bronzeMetalSRV = loadTexture(L"Assets/Textures/bronze_metal.png");
+	TextureHandle bronzeRoughnessSRV = loadTexture(L"Assets/Textures/bronze_roughness.png");
 
 	// Cobblestone
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobblestoneSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/cobblestone_albedo.png", nullptr, cobblestoneSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobblestoneNormalsSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/cobblestone_normals.png", nullptr, cobblestoneNormalsSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobblestoneMetalSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/cobblestone_metal.png", nullptr, cobblestoneMetalSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobblestoneRoughnessSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/cobblestone_roughness.png", nullptr, cobblestoneRoughnessSRV.GetAddressOf());
+	TextureHandle cobblestoneSRV = loadTexture(L"Assets/Textures/cobblestone_albedo.png");
+	TextureHandle cobblestoneNormalsSRV = loadTexture(L"Assets/Textures/cobblestone_normals.png");
+	TextureHandle cobblestoneMetalSRV = loadTexture(L"Assets/Textures/cobblestone_metal.png");
+	TextureHandle cobblestoneRoughnessSRV = loadTexture(L"Assets/Textures/cobblestone_roughness.png");
 
 	// Floor
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/floor_albedo.png", nullptr, floorSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorNormalsSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/floor_normals.png", nullptr, floorNormalsSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorMetalSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/floor_metal.png", nullptr, floorMetalSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorRoughnessSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/floor_roughness.png", nullptr, floorRoughnessSRV.GetAddressOf());
+	TextureHandle floorSRV = loadTexture(L"Assets/Textures/floor_albedo.png");
+	TextureHandle floorNormalsSRV = loadTexture(L"Assets/Textures/floor_normals.png");
+	TextureHandle floorMetalSRV = loadTexture(L"Assets/Textures/floor_metal.png");
+	TextureHandle floorRoughnessSRV = loadTexture(L"Assets/Textures/floor_roughness.png");
 	
 	// Paint
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/paint_albedo.png", nullptr, paintSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintNormalsSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/paint_normals.png", nullptr, paintNormalsSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintMetalSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/paint_metal.png", nullptr, paintMetalSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintRoughnessSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/paint_roughness.png", nullptr, paintRoughnessSRV.GetAddressOf());
+	TextureHandle paintSRV = loadTexture(L"Assets/Textures/paint_albedo.png");
+	TextureHandle paintNormalsSRV = loadTexture(L"Assets/Textures/paint_normals.png");
+	TextureHandle paintMetalSRV = loadTexture(L"Assets/Textures/paint_metal.png");
+	TextureHandle paintRoughnessSRV = loadTexture(L"Assets/Textures/paint_roughness.png");
 
 	// Rough
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/rough_albedo.png", nullptr, roughSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughNormalsSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/rough_normals.png", nullptr, roughNormalsSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughMetalSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/rough_metal.png", nullptr, roughMetalSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughRoughnessSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/rough_roughness.png", nullptr, roughRoughnessSRV.GetAddressOf());
+	TextureHandle roughSRV = loadTexture(L"Assets/Textures/rough_albedo.png");
+	TextureHandle roughNormalsSRV = loadTexture(L"Assets/Textures/rough_normals.png");
+	TextureHandle roughMetalSRV = loadTexture(L"Assets/Textures/rough_metal.png");
+	TextureHandle roughRoughnessSRV = loadTexture(L"Assets/Textures/rough_roughness.png");
 
 	// Scratched
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/scratched_albedo.png", nullptr, scratchedSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedNormalsSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/scratched_normals.png", nullptr, scratchedNormalsSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedMetalSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/scratched_metal.png", nullptr, scratchedMetalSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedRoughnessSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/scratched_roughness.png", nullptr, scratchedRoughnessSRV.GetAddressOf());
+	TextureHandle scratchedSRV = loadTexture(L"Assets/Textures/scratched_albedo.png");
+	TextureHandle scratchedNormalsSRV = loadTexture(L"Assets/Textures/scratched_normals.png");
+	TextureHandle scratchedMetalSRV = loadTexture(L"Assets/Textures/scratched_metal.png");
+	TextureHandle scratchedRoughnessSRV = loadTexture(L"Assets/Textures/scratched_roughness.png");
 
 	// Wood
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/wood_albedo.png", nullptr, woodSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodNormalsSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/wood_normals.png", nullptr, woodNormalsSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodMetalSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/wood_metal.png", nullptr, woodMetalSRV.GetAddressOf());
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodRoughnessSRV;
-	CreateWICTextureFromFile(Graphics::Device.Get(), Graphics::Context.Get(), L"Assets/Textures/wood_roughness.png", nullptr, woodRoughnessSRV.GetAddressOf());
+	TextureHandle woodSRV = loadTexture(L"Assets/Textures/wood_albedo.png");
+	TextureHandle woodNormalsSRV = loadTexture(L"Assets/Textures/wood_normals.png");
+	TextureHandle woodMetalSRV = loadTexture(L"Assets/Textures/wood_metal.png");
+	TextureHandle woodRoughnessSRV = loadTexture(L"Assets/Textures/wood_roughness.png");
 
 	// Create a sampler state
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> basicSamplerState;
@@ -293,99 +405,129 @@ void Game::CreateGameEntities()
 	basicSamplerDescription.MaxLOD = D3D11_FLOAT32_MAX; // Allow mipmapping at any range
 
 	// Create the sampler state with the description above
-	Graphics::Device->CreateSamplerState(&basicSamplerDescription, basicSamplerState.GetAddressOf());
+	// - Shared with anything else asking for the same description
+	basicSamplerState = Graphics::State->GetSamplerState(basicSamplerDescription);
 
 	// Create materials
 	// Bronze
-	std::shared_ptr<Material> bronzeMaterial = std::make_shared<Material>(whiteTint, vertexShader, basicPixelShader);
-	bronzeMaterial->AddTextureSRV(0, bronzeSRV);
-	bronzeMaterial->AddTextureSRV(1, bronzeNormalsSRV);
-	bronzeMaterial->AddTextureSRV(2, bronzeMetalSRV);
-	bronzeMaterial->AddTextureSRV(3, bronzeRoughnessSRV);
-	bronzeMaterial->AddSamplerState(0, basicSamplerState);
+	Material bronzeMaterial(whiteTint, vertexShader, basicPixelShader);
+	bronzeMaterial.AddTextureSRV(0, bronzeSRV);
+	bronzeMaterial.AddTextureSRV(1, bronzeNormalsSRV);
+	bronzeMaterial.AddTextureSRV(2, bronzeMetalSRV);
+	bronzeMaterial.AddTextureSRV(3, bronzeRoughnessSRV);
+	bronzeMaterial.AddSamplerState(0, basicSamplerState);
 
 	// Cobblestone
-	std::shared_ptr<Material> cobblestoneMaterial = std::make_shared<Material>(whiteTint, vertexShader, basicPixelShader);
-	cobblestoneMaterial->AddTextureSRV(0, cobblestoneSRV);
-	cobblestoneMaterial->AddTextureSRV(1, cobblestoneNormalsSRV);
-	cobblestoneMaterial->AddTextureSRV(2, cobblestoneMetalSRV);
-	cobblestoneMaterial->AddTextureSRV(3, cobblestoneRoughnessSRV);
-	cobblestoneMaterial->AddSamplerState(0, basicSamplerState);
+	Material cobblestoneMaterial(whiteTint, vertexShader, basicPixelShader);
+	cobblestoneMaterial.AddTextureSRV(0, cobblestoneSRV);
+	cobblestoneMaterial.AddTextureSRV(1, cobblestoneNormalsSRV);
+	cobblestoneMaterial.AddTextureSRV(2, cobblestoneMetalSRV);
+	cobblestoneMaterial.AddTextureSRV(3, cobblestoneRoughnessSRV);
+	cobblestoneMaterial.AddSamplerState(0, basicSamplerState);
 
 	// Floor
-	std::shared_ptr<Material> floorMaterial = std::make_shared<Material>(whiteTint, vertexShader, basicPixelShader);
-	floorMaterial->AddTextureSRV(0, floorSRV);
-	floorMaterial->AddTextureSRV(1, floorNormalsSRV);
-	floorMaterial->AddTextureSRV(2, floorMetalSRV);
-	floorMaterial->AddTextureSRV(3, floorRoughnessSRV);
-	floorMaterial->AddSamplerState(0, basicSamplerState);
+	Material floorMaterial(whiteTint, vertexShader, basicPixelShader);
+	floorMaterial.AddTextureSRV(0, floorSRV);
+	floorMaterial.AddTextureSRV(1, floorNormalsSRV);
+	floorMaterial.AddTextureSRV(2, floorMetalSRV);
+	floorMaterial.AddTextureSRV(3, floorRoughnessSRV);
+	floorMaterial.AddSamplerState(0, basicSamplerState);
 
 	// Paint
-	std::shared_ptr<Material> paintMaterial = std::make_shared<Material>(whiteTint, vertexShader, basicPixelShader);
-	paintMaterial->AddTextureSRV(0, paintSRV);
-	paintMaterial->AddTextureSRV(1, paintNormalsSRV);
-	paintMaterial->AddTextureSRV(2, paintMetalSRV);
-	paintMaterial->AddTextureSRV(3, paintRoughnessSRV);
-	paintMaterial->AddSamplerState(0, basicSamplerState);
+	Material paintMaterial(whiteTint, vertexShader, basicPixelShader);
+	paintMaterial.AddTextureSRV(0, paintSRV);
+	paintMaterial.AddTextureSRV(1, paintNormalsSRV);
+	paintMaterial.AddTextureSRV(2, paintMetalSRV);
+	paintMaterial.AddTextureSRV(3, paintRoughnessSRV);
+	paintMaterial.AddSamplerState(0, basicSamplerState);
 
 	// Rough
-	std::shared_ptr<Material> roughMaterial = std::make_shared<Material>(whiteTint, vertexShader, basicPixelShader);
-	roughMaterial->AddTextureSRV(0, roughSRV);
-	roughMaterial->AddTextureSRV(1, roughNormalsSRV);
-	roughMaterial->AddTextureSRV(2, roughMetalSRV);
-	roughMaterial->AddTextureSRV(3, roughRoughnessSRV);
-	roughMaterial->AddSamplerState(0, basicSamplerState);
+	Material roughMaterial(whiteTint, vertexShader, basicPixelShader);
+	roughMaterial.AddTextureSRV(0, roughSRV);
+	roughMaterial.AddTextureSRV(1, roughNormalsSRV);
+	roughMaterial.AddTextureSRV(2, roughMetalSRV);
+	roughMaterial.AddTextureSRV(3, roughRoughnessSRV);
+	roughMaterial.AddSamplerState(0, basicSamplerState);
 
 	// Scratched
-	std::shared_ptr<Material> scratchedMaterial = std::make_shared<Material>(whiteTint, vertexShader, basicPixelShader);
-	scratchedMaterial->AddTextureSRV(0, scratchedSRV);
-	scratchedMaterial->AddTextureSRV(1, scratchedNormalsSRV);
-	scratchedMaterial->AddTextureSRV(2, scratchedMetalSRV);
-	scratchedMaterial->AddTextureSRV(3, scratchedRoughnessSRV);
-	scratchedMaterial->AddSamplerState(0, basicSamplerState);
+	Material scratchedMaterial(whiteTint, vertexShader, basicPixelShader);
+	scratchedMaterial.AddTextureSRV(0, scratchedSRV);
+	scratchedMaterial.AddTextureSRV(1, scratchedNormalsSRV);
+	scratchedMaterial.AddTextureSRV(2, scratchedMetalSRV);
+	scratchedMaterial.AddTextureSRV(3, scratchedRoughnessSRV);
+	scratchedMaterial.AddSamplerState(0, basicSamplerState);
 
 	// Wood
-	std::shared_ptr<Material> woodMaterial = std::make_shared<Material>(whiteTint, vertexShader, basicPixelShader);
-	woodMaterial->AddTextureSRV(0, woodSRV);
-	woodMaterial->AddTextureSRV(1, woodNormalsSRV);
-	woodMaterial->AddTextureSRV(2, woodMetalSRV);
-	woodMaterial->AddTextureSRV(3, woodRoughnessSRV);
-	woodMaterial->AddSamplerState(0, basicSamplerState);
-
-	// Create a Mesh for each .obj file, and add them to meshes
+	Material woodMaterial(whiteTint, vertexShader, basicPixelShader);
+	woodMaterial.AddTextureSRV(0, woodSRV);
+	woodMaterial.AddTextureSRV(1, woodNormalsSRV);
+	woodMaterial.AddTextureSRV(2, woodMetalSRV);
+	woodMaterial.AddTextureSRV(3, woodRoughnessSRV);
+	woodMaterial.AddSamplerState(0, basicSamplerState);
+
+	// Create a Mesh for each .obj file, and add them to the mesh pool
+	// - Everything but the cube uses packed vertices, which are less than half the size
+	// - The sky draws the cube with its own vertex shader, which expects full Vertex data,
+	//    and keeps its own copy of it, since it holds on to a shared_ptr
+	// - Each loads on its own thread, since building LODs for a mesh without a cache
+	//    takes a while (the D3D11 device is free-threaded, so creating buffers is fine)
+	// - They share the cores for parsing, rather than each starting a thread per
+	//    core, which would have many times more threads than cores
+	std::vector<MeshHandle> meshHandles;
+	std::shared_ptr<Mesh> skyCube;
 	{
-		meshes.push_back(std::make_shared<Mesh>(FixPath("../../Assets/Meshes/cube.obj").c_str(), "Cube")); // Cube
-		meshes.push_back(std::make_shared<Mesh>(FixPath("../../Assets/Meshes/cylinder.obj").c_str(), "Cylinder")); // Cylinder
-		meshes.push_back(std::make_shared<Mesh>(FixPath("../../Assets/Meshes/helix.obj").c_str(), "Helix")); // Helix
-		meshes.push_back(std::make_shared<Mesh>(FixPath("../../Assets/Meshes/sphere.obj").c_str(), "Sphere")); // Sphere
-		meshes.push_back(std::make_shared<Mesh>(FixPath("../../Assets/Meshes/torus.obj").c_str(), "Torus")); // Torus
-		meshes.push_back(std::make_shared<Mesh>(FixPath("../../Assets/Meshes/quad.obj").c_str(), "Quad")); // Quad
-		meshes.push_back(std::make_shared<Mesh>(FixPath("../../Assets/Meshes/quad_double_sided.obj").c_str(), "Double-Sided Quad")); // Double-Sided Quad
+		struct MeshFile
+		{
+			const char* path;
+			const char* name;
+			VertexFormat format;
+		};
+		const MeshFile files[] = {
+			{ "../../Assets/Meshes/cube.obj", "Cube", VertexFormat::Full },
+			{ "../../Assets/Meshes/cylinder.obj", "Cylinder", VertexFormat::Packed },
+			{ "../../Assets/Meshes/helix.obj", "Helix", VertexFormat::Packed },
+			{ "../../Assets/Meshes/sphere.obj", "Sphere", VertexFormat::Packed },
+			{ "../../Assets/Meshes/torus.obj", "Torus", VertexFormat::Packed },
+			{ "../../Assets/Meshes/quad.obj", "Quad", VertexFormat::Packed },
+			{ "../../Assets/Meshes/quad_double_sided.obj", "Double-Sided Quad", VertexFormat::Packed } };
+
+		unsigned int parseThreads = std::max(std::thread::hardware_concurrency() / (unsigned int)std::size(files), 1u);
+		std::vector<std::future<Mesh>> loads;
+		for (const MeshFile& file : files)
+			loads.push_back(std::async(std::launch::async, [=]() { return Mesh(FixPath(file.path).c_str(), file.name, file.format, parseThreads); }));
+
+		// Keep the same order as above, so meshHandles lines up with it
+		for (std::future<Mesh>& load : loads)
+			meshHandles.push_back(meshes.Add(load.get()));
+
+		// Only once the pool's cube is done, so the two don't both write its cache
+		skyCube = std::make_shared<Mesh>(FixPath("../../Assets/Meshes/cube.obj").c_str(), "Sky Cube", VertexFormat::Full);
 	}
 
-	// Create 7 GameEntities with different Meshes
+	// Every material gets a sphere, in a row along x
+	// - Each spins, and is solid, so it can hide the others
+	std::vector<MaterialHandle> materialHandles = {
+		materials.Add(std::move(bronzeMaterial)),
+		materials.Add(std::move(cobblestoneMaterial)),
+		materials.Add(std::move(floorMaterial)),
+		materials.Add(std::move(paintMaterial)),
+		materials.Add(std::move(roughMaterial)),
+		materials.Add(std::move(scratchedMaterial)),
+		materials.Add(std::move(woodMaterial)) };
+	MeshHandle sphere = meshHandles[3];
+	for (unsigned int i = 0; i < materialHandles.size(); i++)
 	{
+		EntityId entity = entities.Create(Components::Transform | Components::Renderable | Components::Bounds | Components::Spin | Components::Occluder);
 
-		gameEntities.push_back(std::make_shared<GameEntity>(meshes[3], bronzeMaterial)); // Sphere
-		gameEntities.push_back(std::make_shared<GameEntity>(meshes[3], cobblestoneMaterial)); // Sphere
-		gameEntities.push_back(std::make_shared<GameEntity>(meshes[3], floorMaterial)); // Sphere
-		gameEntities.push_back(std::make_shared<GameEntity>(meshes[3], paintMaterial)); // Sphere
-		gameEntities.push_back(std::make_shared<GameEntity>(meshes[3], roughMaterial)); // Sphere
-		gameEntities.push_back(std::make_shared<GameEntity>(meshes[3], scratchedMaterial)); // Sphere
-		gameEntities.push_back(std::make_shared<GameEntity>(meshes[3], woodMaterial)); // Sphere
-		gameEntities[0]->GetTransform()->SetTranslation(-3.0f, 0.0f, 0.0f);
-		gameEntities[1]->GetTransform()->SetTranslation(-2.0f, 0.0f, 0.0f);
-		gameEntities[2]->GetTransform()->SetTranslation(-1.0f, 0.0f, 0.0f);
-		gameEntities[3]->GetTransform()->SetTranslation(0.0f, 0.0f, 0.0f);
-		gameEntities[4]->GetTransform()->SetTranslation(1.0f, 0.0f, 0.0f);
-		gameEntities[5]->GetTransform()->SetTranslation(2.0f, 0.0f, 0.0f);
-		gameEntities[6]->GetTransform()->SetTranslation(3.0f, 0.0f, 0.0f);
-	}
-
-	// Make the entities smaller, so they aren't huge (for now)
-	for (unsigned int i = 0; i < gameEntities.size(); i++)
-	{
-		gameEntities[i]->GetTransform()->SetScale(0.3f, 0.3f, 0.3f);
+		// Make the entities smaller, so they aren't huge (for now)
+		LocalTransform transform = entities.GetTransform(entity);
+		transform.Translation = XMFLOAT3(i - 3.0f, 0.0f, 0.0f);
+		transform.Scale = XMFLOAT3(0.3f, 0.3f, 0.3f);
+		entities.SetTransform(entity, transform);
+
+		*entities.GetRenderable(entity) = { sphere, materialHandles[i] };
+		*entities.GetBounds(entity) = { meshes.Get(sphere)->GetBoundsMin(), meshes.Get(sphere)->GetBoundsMax() };
+		entities.GetSpin(entity)->PitchYawRollPerSecond = XMFLOAT3(0.0f, 1.0f, 0.0f);
 	}
 
 	// Create skybox object
@@ -393,7 +535,7 @@ void Game::CreateGameEntities()
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> skyboxVertexShader = LoadVertexShader(L"SkyboxVS.cso");
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> skyboxPixelShader = LoadPixelShader(L"SkyboxPS.cso");
 
-	skybox = std::make_shared<Sky>(meshes[0],
+	skybox = std::make_shared<Sky>(skyCube,
 		basicSamplerState,
 		skyboxVertexShader,
 		skyboxPixelShader,
@@ -409,14 +551,19 @@ void Game::CreateGameEntities()
 
 // -----------------------------------------------
 // Create two cameras for the user to swap between
+// - Also used by benchmarks that need the default views
 // -----------------------------------------------
-void Game::CreateStartingCameras()
+std::vector<std::shared_ptr<Camera>> Game::CreateStartingCameras()
 {
+	std::vector<std::shared_ptr<Camera>> startingCameras;
+
 	// First camera: set back from starting scene, standard FOV
-	cameras.push_back(std::make_shared<Camera>(XMFLOAT3(0.0f, 1.5f, 5.0f), Window::AspectRatio()));
-	cameras[0]->SetPitchYawRoll(XMFLOAT3(0.3f, DirectX::XMConvertToRadians(180.0f), 0.0f));
+	startingCameras.push_back(std::make_shared<Camera>(XMFLOAT3(0.0f, 1.5f, 5.0f), Window::AspectRatio()));
+	startingCameras[0]->SetPitchYawRoll(XMFLOAT3(0.3f, DirectX::XMConvertToRadians(180.0f), 0.0f));
 	// Second camera: further back from the starting scene, narrower FOV
-	cameras.push_back(std::make_shared<Camera>(XMFLOAT3(1.0f, 0.0f, -10.0f), Window::AspectRatio(), 30.0f));
+	startingCameras.push_back(std::make_shared<Camera>(XMFLOAT3(1.0f, 0.0f, -10.0f), Window::AspectRatio(), 30.0f));
+
+	return startingCameras;
 }
 
 void Game::CreateInitialLights()
@@ -437,13 +584,19 @@ void Game::Update(float deltaTime, float totalTime)
 	if (Input::KeyDown(VK_ESCAPE))
 		Window::Quit();
 
-	for (unsigned int i = 0; i < gameEntities.size(); i++)
-	{
-		gameEntities[i]->GetTransform()->Rotate(0.0f, 1.0f * deltaTime, 0.0f);
-	}
+	entities.UpdateSpins(deltaTime);
+
+	// Update the world matrices of everything that moved, all at once
+	// - Entities' are updated just before they're needed, in UpdateEntityBounds()
+	TransformSystem::Default().UpdateWorldMatrices();
 
 	UpdateCameras(deltaTime);
 
+	// Right click selects whatever's under the mouse
+	// - Left dragging is already mouse look
+	if (Input::MouseRightPress())
+		PickEntity();
+
 	StartImGuiUpdate(deltaTime);
 
 	BuildCustomUI(deltaTime);
@@ -460,6 +613,36 @@ void Game::UpdateCameras(float deltaTime)
 }
 
 
+// --------------------------------------------------------
+// Casts a ray from the active camera through the mouse and
+// selects the closest entity it hits, testing the actual
+// triangles of only the entities whose boxes it enters
+// --------------------------------------------------------
+void Game::PickEntity()
+{
+	UpdateEntityBounds();
+
+	XMFLOAT3 origin, direction;
+	Picking::ScreenRay(*cameras[currentCameraIndex], (float)Input::GetMouseX(), (float)Input::GetMouseY(),
+		(float)Window::Width(), (float)Window::Height(), origin, direction);
+
+	std::vector<const MeshBvh*> entityMeshes(entityLocations.size());
+	std::vector<XMFLOAT4X4> worldMatrices(entityLocations.size());
+	for (unsigned int i = 0; i < entityLocations.size(); i++)
+	{
+		const EntityArchetype& archetype = entities.GetArchetype(entityLocations[i].Archetype);
+		Mesh* mesh = meshes.Get(archetype.Renderables[entityLocations[i].Row].Mesh);
+		entityMeshes[i] = mesh ? &mesh->GetTriangleBvh() : nullptr;
+		worldMatrices[i] = archetype.Worlds[entityLocations[i].Row];
+	}
+
+	pickedEntity = {};
+	if (Picking::Raycast(*entityBvh, entityMeshes, worldMatrices, origin, direction, FLT_MAX, pickHit))
+		pickedEntity = entities.GetArchetype(entityLocations[pickHit.Instance].Archetype).Entities[entityLocations[pickHit.Instance].Row];
+	openPickedEntity = entities.IsAlive(pickedEntity);
+}
+
+
 // -----------------------------------------------------
 // Does all basic ImGui-related tasks for Game::Update()
 // -----------------------------------------------------
@@ -519,84 +702,124 @@ void Game::BuildCustomUI(float deltaTime)
 		if (ImGui::TreeNode("Mesh Info"))
 		{
 			// Tree node for each Mesh's info
-			for (unsigned int i = 0; i < meshes.size(); i++)
-			{
-				std::shared_ptr<Mesh> currentMesh = meshes[i];
-				const char* currentMeshName = currentMesh->meshName.c_str();
-
-				ImGui::PushID(i);
-
-				if (ImGui::TreeNode("Mesh: %s", currentMeshName))
+			meshes.ForEach([&](MeshHandle handle, Mesh& mesh)
 				{
-					unsigned int numVertices = currentMesh->GetVertexCount();
-					unsigned int numIndices = currentMesh->GetIndexCount();
-					unsigned int numTriangles = numIndices / 3;
+					Mesh* currentMesh = &mesh;
+					const char* currentMeshName = currentMesh->meshName.c_str();
 
-					ImGui::Text("Triangles: %i", numTriangles);
-					ImGui::Text("Vertices: %i", numVertices);
-					ImGui::Text("Indicies: %i", numIndices);
+					ImGui::PushID((int)handle.Value);
 
-					// Has to be done at the end of each tree node!
-					ImGui::TreePop();
-				}
+					if (ImGui::TreeNode("Mesh: %s", currentMeshName))
+					{
+						unsigned int numVertices = currentMesh->GetVertexCount();
+						unsigned int numUnweldedVertices = currentMesh->GetUnweldedVertexCount();
+						unsigned int numIndices = currentMesh->GetIndexCount();
+						unsigned int numTriangles = currentMesh->GetLodIndexCount(0) / 3;
+
+						ImGui::Text("Triangles: %i", numTriangles);
+						ImGui::Text("Vertices: %i (%i before welding)", numVertices, numUnweldedVertices);
+						ImGui::Text("Indicies: %i", numIndices);
+						ImGui::Text("Vertex Buffer: %u bytes (%u bytes as full vertices)", currentMesh->GetVertexBufferSize(), numVertices * (unsigned int)sizeof(Vertex));
+						ImGui::Text("Index Buffer: %u bytes, 16-bit (saves %u bytes over 32-bit)", currentMesh->GetIndexBufferSize(), numIndices * (unsigned int)sizeof(unsigned int) - currentMesh->GetIndexBufferSize());
+						if (currentMesh->GetIndexRangeCount() > 1)
+							ImGui::Text("Index Ranges: %i (%i vertices duplicated)", currentMesh->GetIndexRangeCount(), currentMesh->GetDuplicatedVertexCount());
+						for (int lod = 1; lod < currentMesh->GetLodCount(); lod++)
+							ImGui::Text("LOD %i: %i triangles (error %.4f)", lod, currentMesh->GetLodIndexCount(lod) / 3, currentMesh->GetLodError(lod));
+						ImGui::Text("Meshlets: %zu (up to %u vertices, %u triangles each)", currentMesh->GetMeshlets().meshlets.size(), MeshletBuilder::MaxVertices, MeshletBuilder::MaxTriangles);
+						ImGui::Text("Loaded in %.2f ms (%s)", currentMesh->GetLoadTime(), currentMesh->WasLoadedFromCache() ? "from .meshbin cache" : "from OBJ");
+
+						MeshOptimizationStats stats = currentMesh->GetOptimizationStats();
+						if (stats.ACMRBefore > 0.0f)
+						{
+							ImGui::Text("ACMR: %.3f -> %.3f", stats.ACMRBefore, stats.ACMRAfter);
+							ImGui::Text("ATVR: %.3f -> %.3f", stats.ATVRBefore, stats.ATVRAfter);
+							ImGui::Text("Overdraw: %.3f -> %.3f", stats.OverdrawBefore, stats.OverdrawAfter);
+						}
 
-				ImGui::PopID();
-			}
+						// Has to be done at the end of each tree node!
+						ImGui::TreePop();
+					}
+
+					ImGui::PopID();
+				});
 
 			// Has to be done at the end of each tree node!
 			ImGui::TreePop();
 		}
 
+		// A new pick opens its entity's node (once, so it can still be closed)
+		if (openPickedEntity)
+			ImGui::SetNextItemOpen(true);
+
 		if (ImGui::TreeNode("Entity Info"))
 		{
-			for (unsigned int i = 0; i < gameEntities.size(); i++)
+			ImGui::Text("Right click an entity to select it");
+			if (entities.IsAlive(pickedEntity))
 			{
-				std::shared_ptr<GameEntity> currentEntity = gameEntities[i];
-				const char* currentEntityMeshName = currentEntity->GetMesh()->meshName.c_str();
-				std::shared_ptr<Transform> currentTransform = currentEntity->GetTransform();
-				std::shared_ptr<Material> currentMaterial = currentEntity->GetMaterial();
-
-				ImGui::PushID(i);
+				Mesh* pickedMesh = meshes.Get(entities.GetRenderable(pickedEntity)->Mesh);
+				ImGui::Text("Picked: %s, triangle %u, %.2f units away", pickedMesh ? pickedMesh->meshName.c_str() : "Released Mesh", pickHit.Triangle, pickHit.Distance);
+				ImGui::Text("Barycentrics: (%.3f, %.3f)  Hit: (%.2f, %.2f, %.2f)", pickHit.Barycentrics.x, pickHit.Barycentrics.y, pickHit.Position.x, pickHit.Position.y, pickHit.Position.z);
+			}
 
-				if (ImGui::TreeNode("Entity: %s", currentEntityMeshName))
+			entities.ForEach(Components::Transform | Components::Renderable, [&](EntityArchetype& archetype)
 				{
-					XMFLOAT3 currentTranslation = currentTransform->GetTranslation();
-					XMFLOAT3 currentRotation = currentTransform->GetPitchYawRoll();
-					XMFLOAT3 currentScale = currentTransform->GetScale();
-
-					ImGui::DragFloat3("Position", &currentTranslation.x, 0.1f);
-					ImGui::DragFloat3("Rotation", &currentRotation.x, 0.1f);
-					ImGui::DragFloat3("Scale", &currentScale.x, 0.1f);
-
-					currentTransform->SetTranslation(currentTranslation);
-					currentTransform->SetPitchYawRoll(currentRotation);
-					currentTransform->SetScale(currentScale);
-
-					if (ImGui::TreeNode("Material"))
+					for (unsigned int row = 0; row < archetype.GetCount(); row++)
 					{
-						XMFLOAT2 currentTextureScale = currentMaterial->GetTextureScale();
-						XMFLOAT2 currentTextureOffset = currentMaterial->GetTextureOffset();
-
-						ImGui::DragFloat2("Scale", &currentTextureScale.x, 0.1f);
-						ImGui::DragFloat2("Offset", &currentTextureOffset.x, 0.1f);
-
-						currentMaterial->SetTextureScale(currentTextureScale);
-						currentMaterial->SetTextureOffset(currentTextureOffset);
-
-						// Has to be done at the end of each tree node!
-						ImGui::TreePop();
+						EntityId entity = archetype.Entities[row];
+						Mesh* currentMesh = meshes.Get(archetype.Renderables[row].Mesh);
+						const char* currentEntityMeshName = currentMesh ? currentMesh->meshName.c_str() : "Released Mesh";
+						Material* currentMaterial = materials.Get(archetype.Renderables[row].Material);
+
+						ImGui::PushID((int)entity.Index);
+
+						if (openPickedEntity && entity == pickedEntity)
+							ImGui::SetNextItemOpen(true);
+
+						if (ImGui::TreeNode("Entity: %s", currentEntityMeshName))
+						{
+							// Only written back when changed, since angles don't survive
+							// the trip through a quaternion exactly
+							LocalTransform currentTransform = archetype.Transforms[row];
+							XMFLOAT3 currentRotation = Transform::PitchYawRollFromQuaternion(currentTransform.Rotation);
+
+							bool changed = ImGui::DragFloat3("Position", &currentTransform.Translation.x, 0.1f);
+							if (ImGui::DragFloat3("Rotation", &currentRotation.x, 0.1f))
+							{
+								XMStoreFloat4(&currentTransform.Rotation, XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&currentRotation)));
+								changed = true;
+							}
+							changed |= ImGui::DragFloat3("Scale", &currentTransform.Scale.x, 0.1f);
+
+							if (changed)
+								entities.SetTransform(entity, currentTransform);
+
+							if (currentMaterial && ImGui::TreeNode("Material"))
+							{
+								XMFLOAT2 currentTextureScale = currentMaterial->GetTextureScale();
+								XMFLOAT2 currentTextureOffset = currentMaterial->GetTextureOffset();
+
+								ImGui::DragFloat2("Scale", &currentTextureScale.x, 0.1f);
+								ImGui::DragFloat2("Offset", &currentTextureOffset.x, 0.1f);
+
+								currentMaterial->SetTextureScale(currentTextureScale);
+								currentMaterial->SetTextureOffset(currentTextureOffset);
+
+								// Has to be done at the end of each tree node!
+								ImGui::TreePop();
+							}
+
+							// Has to be done at the end of each tree node!
+							ImGui::TreePop();
+						}
+
+						ImGui::PopID();
 					}
-
-					// Has to be done at the end of each tree node!
-					ImGui::TreePop();
-				}
-
-				ImGui::PopID();
-			}
+				});
 
 			// Has to be done at the end of each tree node!
 			ImGui::TreePop();
 		}
+		openPickedEntity = false;
 
 		// Dropdown for active camera info
 		if (ImGui::TreeNode("Active Camera"))
@@ -619,6 +842,105 @@ void Game::BuildCustomUI(float deltaTime)
 			ImGui::Text("Pitch, Yaw, Roll: (%f, %f, %f)", cameraRot.x, cameraRot.y, cameraRot.z);
 			ImGui::Text("FOV (Degrees): %f", cameraFov);
 
+			ImGui::Checkbox("Use LODs", &useLods);
+			ImGui::SliderFloat("LOD Pixel Error", &lodPixelError, 0.25f, 16.0f);
+
+			ImGui::Checkbox("Frustum Culling", &useFrustumCulling);
+			ImGui::Checkbox("Occlusion Culling", &useOcclusionCulling);
+			ImGui::Checkbox("Reproject Last Frame's Occluders", &useOcclusionReprojection);
+			ImGui::Text("Entities Drawn: %u / %u", (unsigned int)visibleEntities.size(), (unsigned int)entityLocations.size());
+			DrawListStats drawListStats = drawList->GetStats();
+			ImGui::Text("Draw list: %u draws sorted in %.3f ms (%u radix passes, %u threads)",
+				drawListStats.drawCount,
+				drawListStats.sortMilliseconds,
+				drawListStats.radixPasses,
+				drawListStats.threadCount);
+			ImGui::Text("State changes: %u shader, %u material", drawStateChanges.shaders, drawStateChanges.materials);
+			ImGui::Checkbox("Instancing", &useInstancing);
+			if (!useInstancing)
+			{
+				ImGui::Checkbox("Record Command Lists In Parallel", &useCommandLists);
+				if (useCommandLists)
+				{
+					size_t commandBytes = 0;
+					for (const RenderCommandList& list : entityCommandLists)
+						commandBytes += list.GetSize();
+					ImGui::Text("Command lists: %u recorded in %.3f ms, %u KB",
+						commandListsRecorded,
+						commandRecordMilliseconds,
+						(unsigned int)(commandBytes / 1024));
+				}
+			}
+			ImGui::Text("Entity draw calls: %u (%u batches), CPU %.3f ms",
+				entityDrawCalls,
+				useInstancing ? (unsigned int)instanceBatcher.GetBatches().size() : 0u,
+				entityDrawMilliseconds);
+			ImGui::Text("Uploaded last frame: %u constant bytes, %u instance bytes",
+				constantBytesUploaded,
+				instanceBytesUploaded);
+			ImGui::Text("Constant buffer heap: %u KB, %u maps last frame, grown %u times",
+				Graphics::cbHeapSizeInBytes / 1024,
+				constantBufferMaps,
+				Graphics::cbHeapGrowCount);
+
+			// Binds asked for last frame, and how many D3D calls they took
+			if (ImGui::TreeNode("Binds (requested / issued)"))
+			{
+				ImGui::Text("Shaders and layouts: %u / %u", stateBindCounts.Shaders.Requested, stateBindCounts.Shaders.Issued);
+				ImGui::Text("Textures: %u / %u", stateBindCounts.ShaderResources.Requested, stateBindCounts.ShaderResources.Issued);
+				ImGui::Text("Samplers: %u / %u", stateBindCounts.Samplers.Requested, stateBindCounts.Samplers.Issued);
+				ImGui::Text("Constant buffers: %u / %u", stateBindCounts.ConstantBuffers.Requested, stateBindCounts.ConstantBuffers.Issued);
+				ImGui::Text("Render states: %u / %u", stateBindCounts.States.Requested, stateBindCounts.States.Issued);
+				ImGui::Text("Cached state objects: %u", Graphics::State->GetCachedStateCount());
+				ImGui::TreePop();
+			}
+
+			// A grid of spheres sharing one mesh, with a random material each,
+			// for comparing draw calls and CPU time with and without instancing
+			if (stressEntities.empty() && ImGui::Button("Add 10k Sphere Stress Scene"))
+			{
+				MeshHandle sphere = {};
+				meshes.ForEach([&](MeshHandle handle, Mesh& mesh) { if (mesh.meshName == "Sphere") sphere = handle; });
+				std::vector<MaterialHandle> stressMaterials;
+				materials.ForEach([&](MaterialHandle handle, Material&) { stressMaterials.push_back(handle); });
+
+				Mesh* sphereMesh = meshes.Get(sphere);
+				if (sphereMesh && !stressMaterials.empty())
+				{
+					std::mt19937 random(1234);
+					for (unsigned int i = 0; i < 10000; i++)
+					{
+						EntityId entity = entities.Create(Components::Transform | Components::Renderable | Components::Bounds);
+
+						LocalTransform transform = entities.GetTransform(entity);
+						transform.Translation = XMFLOAT3((i % 100) - 49.5f, -2.0f, (i / 100) + 2.0f);
+						transform.Scale = XMFLOAT3(0.3f, 0.3f, 0.3f);
+						entities.SetTransform(entity, transform);
+
+						*entities.GetRenderable(entity) = { sphere, stressMaterials[random() % stressMaterials.size()] };
+						*entities.GetBounds(entity) = { sphereMesh->GetBoundsMin(), sphereMesh->GetBoundsMax() };
+						stressEntities.push_back(entity);
+					}
+				}
+			}
+			else if (!stressEntities.empty() && ImGui::Button("Remove Stress Scene"))
+			{
+				for (EntityId entity : stressEntities)
+					entities.Destroy(entity);
+				stressEntities.clear();
+			}
+			if (useOcclusionCulling)
+			{
+				OcclusionStats stats = occlusionCuller->GetStats();
+				ImGui::Text("Occluders: %u (%u triangles), raster %.3f ms, test %.3f ms, %u / %u culled",
+					stats.occluderCount,
+					stats.occluderTriangles,
+					stats.rasterMilliseconds,
+					stats.testMilliseconds,
+					stats.culledCount,
+					stats.testedCount);
+			}
+
 			// Has to be done at the end of each tree node!
 			ImGui::TreePop();
 		}
@@ -688,6 +1010,420 @@ void Game::BuildCustomUI(float deltaTime)
 			ImGui::TreePop();
 		}
 
+		// CPU-side benchmarks, run on demand
+		if (ImGui::TreeNode("Benchmarks"))
+		{
+			if (ImGui::Button("Run OBJ Parse Benchmark"))
+			{
+				objParseBenchmarkResults = Benchmarks::ObjParseThroughput(FixPath("../../Assets/Meshes/"), 20);
+			}
+
+			for (unsigned int i = 0; i < objParseBenchmarkResults.size(); i++)
+			{
+				const ObjParseBenchmarkResult& result = objParseBenchmarkResults[i];
+				ImGui::Text("%s: %.3f ms, %.1f MB/s", result.fileName.c_str(), result.millisecondsPerParse, result.megabytesPerSecond);
+			}
+
+			if (ImGui::Button("Run OBJ Parse Scaling Benchmark"))
+			{
+				objParseScalingResults = Benchmarks::ObjParseScaling(FixPath("../../Assets/Meshes/"), 512, 3);
+			}
+
+			for (unsigned int i = 0; i < objParseScalingResults.size(); i++)
+			{
+				const ObjParseScalingResult& result = objParseScalingResults[i];
+				ImGui::Text("%u thread(s): shipped %.1f MB/s, large %.1f MB/s%s",
+					result.threadCount,
+					result.shippedMegabytesPerSecond,
+					result.largeMegabytesPerSecond,
+					result.matchesSerial ? "" : " (MISMATCH)");
+			}
+
+			if (ImGui::Button("Run Mesh Optimization Benchmark"))
+			{
+				meshOptimizationBenchmarkResults = Benchmarks::MeshOptimization(FixPath("../../Assets/Meshes/"));
+			}
+
+			for (unsigned int i = 0; i < meshOptimizationBenchmarkResults.size(); i++)
+			{
+				const MeshOptimizationBenchmarkResult& result = meshOptimizationBenchmarkResults[i];
+				ImGui::Text("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, overdraw %.3f -> %.3f, %.2f ms",
+					result.fileName.c_str(),
+					result.stats.ACMRBefore, result.stats.ACMRAfter,
+					result.stats.ATVRBefore, result.stats.ATVRAfter,
+					result.stats.OverdrawBefore, result.stats.OverdrawAfter,
+					result.milliseconds);
+			}
+
+			if (ImGui::Button("Run Tangent Generation Benchmark"))
+			{
+				tangentGenerationResults = Benchmarks::TangentGeneration(FixPath("../../Assets/Meshes/"), 1024, 5);
+			}
+
+			for (unsigned int i = 0; i < tangentGenerationResults.size(); i++)
+			{
+				const TangentGenerationResult& result = tangentGenerationResults[i];
+				ImGui::Text("%s: scalar %.3f ms, SIMD %.3f ms, %u threads %.3f ms, max difference %g%s",
+					result.fileName.c_str(),
+					result.scalarMilliseconds,
+					result.simdMilliseconds,
+					result.threadCount,
+					result.threadedMilliseconds,
+					result.maxDifference,
+					result.allFinite ? "" : " (NON-FINITE)");
+			}
+
+			if (ImGui::Button("Run Packed Vertex Accuracy Test"))
+			{
+				packedVertexAccuracyResults = Benchmarks::PackedVertexAccuracy(FixPath("../../Assets/Meshes/"));
+			}
+
+			for (unsigned int i = 0; i < packedVertexAccuracyResults.size(); i++)
+			{
+				const PackedVertexAccuracyResult& result = packedVertexAccuracyResults[i];
+				ImGui::Text("%s (%s): %zu -> %zu bytes, position %.2g, uv %.2g, normal %.4f deg, tangent %.4f deg%s",
+					result.fileName.c_str(),
+					result.format == VertexFormat::Packed ? "quantized" : "float position",
+					result.fullBytes,
+					result.packedBytes,
+					result.maxPositionError,
+					result.maxUVError,
+					result.maxNormalErrorDegrees,
+					result.maxTangentErrorDegrees,
+					result.withinBounds ? "" : " (OUT OF BOUNDS)");
+			}
+
+			if (ImGui::Button("Run 16-bit Index Savings Report"))
+			{
+				indexBufferSavingsResults = Benchmarks::IndexBufferSavings(FixPath("../../Assets/Meshes/"), 512);
+			}
+
+			for (unsigned int i = 0; i < indexBufferSavingsResults.size(); i++)
+			{
+				const IndexBufferSavingsResult& result = indexBufferSavingsResults[i];
+				ImGui::Text("%s: %zu -> %zu bytes, %u range(s), %u duplicated vertices, %lld bytes saved%s",
+					result.fileName.c_str(),
+					result.bytes32,
+					result.bytes16,
+					result.rangeCount,
+					result.duplicatedVertexCount,
+					result.savedBytes,
+					result.matchesOriginal ? "" : " (MISMATCH)");
+			}
+
+			if (ImGui::Button("Run Meshlet Culling Benchmark"))
+			{
+				// Fresh copies of the starting cameras, wherever the real ones have moved to
+				meshletCullingResults = Benchmarks::MeshletCulling(FixPath("../../Assets/Meshes/"), CreateStartingCameras());
+			}
+
+			for (unsigned int i = 0; i < meshletCullingResults.size(); i++)
+			{
+				const MeshletCullingResult& result = meshletCullingResults[i];
+				ImGui::Text("%s, camera %u: %u meshlets, %.1f%% of %u triangles culled (%u frustum, %u backface of %u back facing)%s",
+					result.fileName.c_str(),
+					result.cameraIndex,
+					result.meshletCount,
+					result.culledPercent,
+					result.triangleCount,
+					result.frustumCulledTriangles,
+					result.backfaceCulledTriangles,
+					result.backfacingTriangles,
+					result.conesConservative ? "" : " (CULLED FRONT FACES)");
+			}
+
+			if (ImGui::Button("Run LOD Simplification Benchmark"))
+			{
+				lodSimplificationResults = Benchmarks::LodSimplification(FixPath("../../Assets/Meshes/"));
+			}
+
+			for (unsigned int i = 0; i < lodSimplificationResults.size(); i++)
+			{
+				const LodSimplificationResult& result = lodSimplificationResults[i];
+				ImGui::Text("%s LOD %u: %u triangles (target %u), error %.4f measured / %.4f reported (max %.2f), %.2f ms%s%s",
+					result.fileName.c_str(),
+					result.lod,
+					result.triangleCount,
+					result.targetTriangles,
+					result.measuredError,
+					result.reportedError,
+					result.maxError,
+					result.milliseconds,
+					result.meetsTarget ? "" : " (couldn't reach target)",
+					result.withinErrorBound ? "" : " (OVER ERROR BOUND)");
+			}
+
+			if (ImGui::Button("Run Transform Hierarchy Benchmark"))
+			{
+				transformHierarchyResults = Benchmarks::TransformHierarchyUpdate(100000, 0.01f, 60);
+			}
+
+			for (unsigned int i = 0; i < transformHierarchyResults.size(); i++)
+			{
+				const TransformHierarchyResult& result = transformHierarchyResults[i];
+				ImGui::Text("%u nodes, %u changed per frame: dirty %.3f ms, full %.3f ms per frame%s",
+					result.nodeCount,
+					result.changedPerFrame,
+					result.dirtyMilliseconds,
+					result.fullMilliseconds,
+					result.matchesFull ? "" : " (MISMATCH)");
+			}
+
+			if (ImGui::Button("Run Transform System Benchmark"))
+			{
+				transformSystemResults = Benchmarks::TransformSystemUpdate({ 10000, 100000, 1000000 });
+			}
+
+			for (unsigned int i = 0; i < transformSystemResults.size(); i++)
+			{
+				const TransformSystemResult& result = transformSystemResults[i];
+				ImGui::Text("%u transforms: one at a time %.3f ms, system %.3f ms (max difference %g world, %g inverse transpose)",
+					result.transformCount,
+					result.oneAtATimeMilliseconds,
+					result.systemMilliseconds,
+					result.maxWorldDifference,
+					result.maxInverseTransposeDifference);
+			}
+
+			if (ImGui::Button("Run Entity Culling Benchmark"))
+			{
+				entityCullingResults = Benchmarks::EntityCulling(100000, CreateStartingCameras(), 20);
+			}
+
+			for (unsigned int i = 0; i < entityCullingResults.size(); i++)
+			{
+				const EntityCullingResult& result = entityCullingResults[i];
+				ImGui::Text("Camera %u: %u / %u visible, bounds %.1f us, cull %.1f us (one at a time %.1f us)%s%s",
+					result.cameraIndex,
+					result.visibleCount,
+					result.entityCount,
+					result.boundsMicroseconds,
+					result.cullMicroseconds,
+					result.scalarCullMicroseconds,
+					result.matchesScalar ? "" : " (MISMATCH)",
+					result.conservative ? "" : " (CULLED VISIBLE)");
+			}
+
+			if (ImGui::Button("Run Occlusion Culling Benchmark"))
+			{
+				occlusionCullingResults = Benchmarks::OcclusionCulling(20000, 5);
+			}
+
+			for (unsigned int i = 0; i < occlusionCullingResults.size(); i++)
+			{
+				const OcclusionCullingResult& result = occlusionCullingResults[i];
+				ImGui::Text("%s (%u threads): %u occluder triangles, raster %.3f ms, test %.3f ms, %.1f%% of %u culled%s",
+					result.reprojection ? "Reprojected" : "Rasterized",
+					result.threadCount,
+					result.occluderTriangles,
+					result.rasterMilliseconds,
+					result.testMilliseconds,
+					result.culledPercent,
+					result.testedCount,
+					result.wronglyCulled == 0 ? "" : " (CULLED VISIBLE)");
+			}
+
+			if (ImGui::Button("Run Scene BVH Benchmark"))
+			{
+				entityBvhResults = Benchmarks::EntityBvh({ 10000, 100000, 1000000 }, { 0.01f, 0.1f }, 20);
+			}
+
+			for (unsigned int i = 0; i < entityBvhResults.size(); i++)
+			{
+				const EntityBvhResult& result = entityBvhResults[i];
+				ImGui::Text("%u entities, %u moving: build %.2f ms, refit %.3f ms (%u subtree / %u full rebuilds, cost x%.2f), frustum %.1f us (linear %.1f us), sphere %.2f us, box %.2f us, ray %.2f us%s",
+					result.entityCount,
+					result.movingCount,
+					result.buildMilliseconds,
+					result.refitMilliseconds,
+					result.rebuiltSubtrees,
+					result.fullRebuilds,
+					result.costRatio,
+					result.frustumMicroseconds,
+					result.linearFrustumMicroseconds,
+					result.sphereMicroseconds,
+					result.boxMicroseconds,
+					result.rayMicroseconds,
+					result.matchesLinear ? "" : " (MISMATCH)");
+			}
+
+			if (ImGui::Button("Run Ray Picking Benchmark"))
+			{
+				rayPickingResults = Benchmarks::RayPicking(FixPath("../../Assets/Meshes/"), 100000, 10000);
+			}
+
+			for (unsigned int i = 0; i < rayPickingResults.size(); i++)
+			{
+				const RayPickingResult& result = rayPickingResults[i];
+				ImGui::Text("%s (%u instances, %u triangles): build %.2f ms, %.0f rays/sec (brute force %.0f), %.1f%% hit%s",
+					result.name.c_str(),
+					result.instanceCount,
+					result.triangleCount,
+					result.buildMilliseconds,
+					result.raysPerSecond,
+					result.bruteForceRaysPerSecond,
+					result.hitPercent,
+					result.matchesBruteForce ? "" : " (MISMATCH)");
+			}
+
+			if (ImGui::Button("Run Entity Storage Benchmark"))
+			{
+				entityStorageResults = Benchmarks::EntityStorage({ 10000, 100000 }, 20);
+			}
+
+			for (unsigned int i = 0; i < entityStorageResults.size(); i++)
+			{
+				const EntityStorageResult& result = entityStorageResults[i];
+				ImGui::Text("%s, %u entities: update %.3f ms, draw list %.3f ms%s",
+					result.layout.c_str(),
+					result.entityCount,
+					result.updateMilliseconds,
+					result.drawListMilliseconds,
+					result.matchesPointerLayout ? "" : " (MISMATCH)");
+			}
+
+			if (ImGui::Button("Run Resource Lookup Benchmark"))
+			{
+				resourceLookupResults = Benchmarks::ResourceLookups(100000, 20);
+			}
+
+			for (unsigned int i = 0; i < resourceLookupResults.size(); i++)
+			{
+				const ResourceLookupResult& result = resourceLookupResults[i];
+				ImGui::Text("%s, %u draws: %.3f ms%s%s",
+					result.method.c_str(),
+					result.drawCount,
+					result.milliseconds,
+					result.matchesSharedPointers ? "" : " (MISMATCH)",
+					result.staleHandlesCaught ? "" : " (STALE HANDLE CHECKS FAILED)");
+			}
+
+			if (ImGui::Button("Run Draw List Sorting Benchmark"))
+			{
+				drawListSortResults = Benchmarks::DrawListSorting(1000000, 5);
+			}
+
+			for (unsigned int i = 0; i < drawListSortResults.size(); i++)
+			{
+				const DrawListSortResult& result = drawListSortResults[i];
+				ImGui::Text("%s (%u threads), %u draws: %.3f ms (%.1f M keys/s), changes: %u shader, %u material, %u mesh%s",
+					result.method.c_str(),
+					result.threadCount,
+					result.drawCount,
+					result.milliseconds,
+					result.millionKeysPerSecond,
+					result.shaderChanges,
+					result.materialChanges,
+					result.meshChanges,
+					result.correct ? "" : " (WRONG ORDER)");
+			}
+
+			if (ImGui::Button("Run Instance Batching Benchmark"))
+			{
+				instanceBatchingResults = Benchmarks::InstanceBatching(10000, 7, 20);
+			}
+
+			for (unsigned int i = 0; i < instanceBatchingResults.size(); i++)
+			{
+				const InstanceBatchingResult& result = instanceBatchingResults[i];
+				ImGui::Text("%s, %u entities: %u draw calls, %.3f ms%s",
+					result.method.c_str(),
+					result.entityCount,
+					result.drawCalls,
+					result.milliseconds,
+					result.correct ? "" : " (CHECKS FAILED)");
+			}
+
+			if (ImGui::Button("Run Constant Buffer Ring Benchmark"))
+			{
+				constantBufferRingResults = Benchmarks::ConstantBufferRingFrames(1000);
+			}
+
+			for (unsigned int i = 0; i < constantBufferRingResults.size(); i++)
+			{
+				const ConstantBufferRingResult& result = constantBufferRingResults[i];
+				ImGui::Text("%s: %u allocations over %u frames, %u grows to %u KB, %.1f M/sec%s",
+					result.scenario.c_str(),
+					result.allocations,
+					result.frames,
+					result.grows,
+					result.finalCapacityKB,
+					result.millionAllocationsPerSecond,
+					result.correct ? "" : " (OVERWROTE A FRAME IN FLIGHT)");
+			}
+
+			if (ImGui::Button("Run State Tracking Benchmark"))
+			{
+				stateTrackingResults = Benchmarks::StateTracking(10000, 32);
+			}
+
+			for (unsigned int i = 0; i < stateTrackingResults.size(); i++)
+			{
+				const StateTrackingResult& result = stateTrackingResults[i];
+				ImGui::Text("%s, %u draws: %u binds requested, %u issued%s",
+					result.scenario.c_str(),
+					result.draws,
+					result.requested,
+					result.issued,
+					result.correct ? "" : " (WRONG STATE BOUND)");
+			}
+
+			if (ImGui::Button("Run Command List Recording Benchmark"))
+			{
+				commandListResults = Benchmarks::CommandListRecording(10000, 32, 20);
+			}
+
+			for (unsigned int i = 0; i < commandListResults.size(); i++)
+			{
+				const CommandListResult& result = commandListResults[i];
+				ImGui::Text("%s, %u draws: %u commands (%u KB), recorded in %.3f ms, validated in %.3f ms%s",
+					result.method.c_str(),
+					result.drawCount,
+					result.commandCount,
+					result.kilobytes,
+					result.recordMilliseconds,
+					result.validateMilliseconds,
+					result.correct ? "" : " (CHECKS FAILED)");
+			}
+
+			if (ImGui::Button("Run Camera Movement Benchmark"))
+			{
+				cameraMovementResults = Benchmarks::CameraMovement(100000);
+			}
+
+			for (unsigned int i = 0; i < cameraMovementResults.size(); i++)
+			{
+				const CameraMovementResult& result = cameraMovementResults[i];
+				ImGui::Text("%u frames %s: pitch/yaw/roll %.3f ms, quaternion %.3f ms (max rotation difference %g, final position difference %g)",
+					result.frames,
+					result.looking ? "moving and looking" : "moving",
+					result.pitchYawRollMilliseconds,
+					result.quaternionMilliseconds,
+					result.maxRotationDifference,
+					result.finalPositionDifference);
+			}
+
+			if (ImGui::Button("Run Mesh Cache Startup Benchmark"))
+			{
+				meshLoadBenchmarkResults = Benchmarks::MeshCacheStartup(FixPath("../../Assets/Meshes/"), 512, 5);
+			}
+
+			for (unsigned int i = 0; i < meshLoadBenchmarkResults.size(); i++)
+			{
+				const MeshLoadBenchmarkResult& result = meshLoadBenchmarkResults[i];
+				ImGui::Text("%s: OBJ %.2f / %.2f ms, cache %.2f / %.2f ms (cold / warm)%s",
+					result.fileName.c_str(),
+					result.objColdMilliseconds,
+					result.objWarmMilliseconds,
+					result.cacheColdMilliseconds,
+					result.cacheWarmMilliseconds,
+					result.cacheMatches ? "" : " (MISMATCH)");
+			}
+
+			// Has to be done at the end of each tree node!
+			ImGui::TreePop();
+		}
+
 		if (ImGui::Button("Show/Hide ImGui Demo Window"))
 		{
 			showImGuiDemoWindow = !showImGuiDemoWindow;
@@ -709,14 +1445,19 @@ void Game::Draw(float deltaTime, float totalTime)
 	// DRAW geometry
 	// - These steps are generally repeated for EACH object you draw
 	// - Other Direct3D calls will also be necessary to do more complex things
+	auto drawStart = std::chrono::high_resolution_clock::now();
 	DrawAllGameEntities(totalTime);
+	entityDrawMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - drawStart).count();
 
 	// AFTER geometry, draw the skybox.
 	// It goes after geometry so we don't waste time drawing stuff that'll be drawn over anyways!
 	skybox->Draw(cameras[currentCameraIndex]);
 
 	// Draw ImGui last, so it appears over everything else.
+	// - It sets (and restores) state without going through Graphics::State,
+	//    and doesn't restore constant buffer offsets, so forget what's bound
 	RenderImGui();
+	Graphics::State->Invalidate();
 
 	FrameEnd();
 }
@@ -738,55 +1479,558 @@ void Game::FrameStart()
 }
 
 
+// --------------------------------------------------------
+// Fits entityBounds around every entity where it is now,
+// and brings the BVH over them up to date
+// - Only entities whose world matrix changed in this update
+//    are refit; everything is rebuilt when entities are
+//    added, removed or change archetype
+// --------------------------------------------------------
+void Game::UpdateEntityBounds()
+{
+	entities.UpdateWorldMatrices();
+
+	auto fitBounds = [&](unsigned int i)
+		{
+			const EntityArchetype& archetype = entities.GetArchetype(entityLocations[i].Archetype);
+			const LocalBounds& bounds = archetype.Bounds[entityLocations[i].Row];
+			FrustumCulling::SetFromLocalBox(entityBounds, i, bounds.Min, bounds.Max, archetype.Worlds[entityLocations[i].Row]);
+		};
+
+	if (entityBvhVersion != entities.GetStructureVersion() || entityBvh->GetObjectCount() != entityLocations.size())
+	{
+		entities.GetLocations(Components::Transform | Components::Renderable | Components::Bounds, entityLocations);
+		FrustumCulling::Resize(entityBounds, entityLocations.size());
+		for (unsigned int i = 0; i < entityLocations.size(); i++)
+			fitBounds(i);
+
+		entityBvh->Build(entityBounds);
+		entityBvhVersion = entities.GetStructureVersion();
+		return;
+	}
+
+	movedEntities.clear();
+	for (unsigned int i = 0; i < entityLocations.size(); i++)
+	{
+		if (!entities.GetArchetype(entityLocations[i].Archetype).WorldChanged[entityLocations[i].Row])
+			continue;
+
+		fitBounds(i);
+		movedEntities.push_back(i);
+	}
+	entityBvh->Refit(entityBounds, movedEntities);
+}
+
+
 // ------------------------------------------------
 // Loops through the Meshes list and draws each one
 // ------------------------------------------------
 void Game::DrawAllGameEntities(float totalTime)
 {
-	for (unsigned int i = 0; i < gameEntities.size(); i++)
+	// Bring world matrices and bounds up to date, then skip anything
+	// entirely outside the camera's frustum
+	UpdateEntityBounds();
+	visibleEntities.clear();
+
+	if (useFrustumCulling)
+	{
+		// Only entities whose boxes the BVH finds in the frustum need the
+		// full test, and drawing stays in entity order
+		Frustum frustum = cameras[currentCameraIndex]->GetFrustum();
+		entityBvh->QueryFrustum(frustum, visibleEntities);
+		visibleEntities.erase(std::remove_if(visibleEntities.begin(), visibleEntities.end(),
+			[&](unsigned int i) { return !FrustumCulling::Test(entityBounds, i, frustum); }), visibleEntities.end());
+		std::sort(visibleEntities.begin(), visibleEntities.end());
+	}
+	else
+	{
+		for (unsigned int i = 0; i < entityLocations.size(); i++)
+			visibleEntities.push_back(i);
+	}
+
+	// Then skip anything hidden behind the occluders that are left
+	if (useOcclusionCulling)
 	{
-		// Set shaders from the Material
-		Graphics::Context->VSSetShader(gameEntities[i]->GetMaterial()->GetVertexShader().Get(), 0, 0);
-		Graphics::Context->PSSetShader(gameEntities[i]->GetMaterial()->GetPixelShader().Get(), 0, 0);
-
-		// Send vertex shader data to the constant buffer
-		// Construct our vertex shader data object
-		VertexShaderExternalData vsData{};
-		vsData.worldMatrix = gameEntities[i]->GetTransform()->GetWorldMatrix();
-		vsData.viewMatrix = cameras[currentCameraIndex]->GetViewMatrix();
-		vsData.projectionMatrix = cameras[currentCameraIndex]->GetProjectionMatrix();
-		vsData.worldInvTranspose = gameEntities[i]->GetTransform()->GetWorldInvTranspose();
-
-		// Send the data to the ring buffer using the function in Graphics
-		Graphics::FillAndBindNextConstantBuffer(
-			&vsData,
-			sizeof(VertexShaderExternalData),
-			D3D11_VERTEX_SHADER,
-			0);
-
-		// Send pixel shader data to the constant buffer
-		// Construct our pixel shader data object
-		PixelShaderExternalData psData{};
-		psData.colorTint = gameEntities[i]->GetMaterial()->GetColorTint();
-		psData.totalTime = totalTime;
-		psData.textureScale = gameEntities[i]->GetMaterial()->GetTextureScale();
-		psData.textureOffset = gameEntities[i]->GetMaterial()->GetTextureOffset();
-		psData.cameraPos = cameras[currentCameraIndex]->GetTranslation();
-		memcpy(&psData.lights, &lights[0], sizeof(Light) * (int)lights.size());
-
-		// Send the data to the ring buffer using the function in Graphics
-		Graphics::FillAndBindNextConstantBuffer(
-			&psData,
-			sizeof(PixelShaderExternalData),
-			D3D11_PIXEL_SHADER,
-			0);
-
-		// Bind texture shader resource views and samplers
-		gameEntities[i]->GetMaterial()->BindTexturesAndSamplers();
-
-		// Now that the shader has access to the correct world matrix, draw the entity's Mesh
-		gameEntities[i]->Draw();
+		XMFLOAT4X4 view = cameras[currentCameraIndex]->GetViewMatrix();
+		XMFLOAT4X4 projection = cameras[currentCameraIndex]->GetProjectionMatrix();
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+
+		occlusionCuller->SetReprojection(useOcclusionReprojection);
+		occlusionCuller->BeginFrame(viewProjection);
+		for (unsigned int i : visibleEntities)
+		{
+			const EntityArchetype& archetype = entities.GetArchetype(entityLocations[i].Archetype);
+			if (archetype.Mask & Components::Occluder)
+			{
+				unsigned int row = entityLocations[i].Row;
+				Mesh* mesh = meshes.Get(archetype.Renderables[row].Mesh);
+				if (mesh)
+					occlusionCuller->AddOccluder(mesh->GetOccluder(), archetype.Worlds[row]);
+			}
+		}
+		occlusionCuller->FinishOccluders();
+
+		occlusionCandidates = visibleEntities;
+		occlusionCuller->Cull(entityBounds, occlusionCandidates, visibleEntities);
 	}
+
+	// Sort what's left by shader, material and mesh, front to back within
+	// each, so draws sharing state are together
+	// - Skips anything whose mesh or material has been released
+	XMFLOAT4X4 view = cameras[currentCameraIndex]->GetViewMatrix();
+	XMMATRIX viewMatrix = XMLoadFloat4x4(&view);
+	drawList->Clear();
+	for (unsigned int i : visibleEntities)
+	{
+		const EntityArchetype& archetype = entities.GetArchetype(entityLocations[i].Archetype);
+		unsigned int row = entityLocations[i].Row;
+		const Renderable& renderable = archetype.Renderables[row];
+		Mesh* mesh = meshes.Get(renderable.Mesh);
+		if (!mesh || !materials.IsValid(renderable.Material))
+			continue;
+
+		const XMFLOAT4X4& world = archetype.Worlds[row];
+		float depth = XMVectorGetZ(XMVector3Transform(XMVectorSet(world._41, world._42, world._43, 1.0f), viewMatrix));
+		unsigned long long key = DrawList::MakeKey(DrawPass::Opaque, (unsigned int)mesh->GetVertexFormat(),
+			renderable.Material.GetIndex(), renderable.Mesh.GetIndex(), depth);
+		drawList->Add(key, i);
+	}
+	drawList->Sort();
+
+	drawStateChanges = {};
+	entityDrawCalls = 0;
+	instanceBytesUploaded = 0;
+
+	// Write the camera, time and lights once for the whole frame, where
+	// both shaders can see them (see PerFrame in ShaderIncludes.hlsli)
+	// - Written straight into the constant buffer heap; it's bound once
+	//    every other constant for the frame has been written too, so they
+	//    all share a single Map()
+	Graphics::ConstantBufferAllocation frameConstants = Graphics::AllocateConstantBuffer(sizeof(FrameExternalData));
+	{
+		XMFLOAT4X4 projection = cameras[currentCameraIndex]->GetProjectionMatrix();
+		FrameExternalData* frameData = (FrameExternalData*)frameConstants.Data;
+		XMStoreFloat4x4(&frameData->viewProjectionMatrix, XMMatrixMultiply(viewMatrix, XMLoadFloat4x4(&projection)));
+		frameData->cameraPos = cameras[currentCameraIndex]->GetTranslation();
+		frameData->totalTime = totalTime;
+
+		// The shaders always read every slot, so lights past the last one
+		// are left out, and any slot the scene doesn't fill gets a light
+		// that adds nothing (the heap isn't cleared between frames)
+		size_t lightCount = std::min(lights.size(), std::size(frameData->lights));
+		memcpy(frameData->lights, lights.data(), sizeof(Light) * lightCount);
+		for (size_t i = lightCount; i < std::size(frameData->lights); i++)
+			frameData->lights[i] = Light::Directional(XMFLOAT3(0.0f, -1.0f, 0.0f), 0.0f, XMFLOAT3(0.0f, 0.0f, 0.0f));
+	}
+
+	// Entities use the default render states, which the sky changes
+	Graphics::State->SetRasterizerState(nullptr);
+	Graphics::State->SetDepthStencilState(nullptr, 0);
+
+	// Either draw each run of entities sharing a mesh, material and LOD
+	// at once, or every entity on its own
+	if (useInstancing)
+	{
+		DrawEntityBatches(frameConstants);
+	}
+	else if (useCommandLists)
+	{
+		DrawEntityCommands(frameConstants);
+	}
+	else
+	{
+		// Write every draw's constants before drawing anything, and only
+		// bind them while drawing
+		// - Only what's each entity's own; the camera is already in PerFrame
+		// - Material data is only written where the material changes
+		const std::vector<unsigned int>& items = drawList->GetItems();
+		objectConstants.resize(items.size());
+		materialConstants.resize(items.size());
+		Material* writtenMaterial = nullptr;
+		for (unsigned int draw = 0; draw < items.size(); draw++)
+		{
+			const EntityArchetype& archetype = entities.GetArchetype(entityLocations[items[draw]].Archetype);
+			unsigned int row = entityLocations[items[draw]].Row;
+			Mesh* mesh = meshes.Get(archetype.Renderables[row].Mesh);
+			Material* material = materials.Get(archetype.Renderables[row].Material);
+
+			if (mesh->GetVertexFormat() == VertexFormat::Full)
+			{
+				objectConstants[draw] = Graphics::AllocateConstantBuffer(sizeof(VertexShaderExternalData));
+				VertexShaderExternalData* vsData = (VertexShaderExternalData*)objectConstants[draw].Data;
+				vsData->worldMatrix = archetype.Worlds[row];
+				vsData->worldInvTranspose = archetype.WorldInverseTransposes[row];
+			}
+			else
+			{
+				// Same data, plus how to unpack positions
+				objectConstants[draw] = Graphics::AllocateConstantBuffer(sizeof(PackedVertexShaderExternalData));
+				PackedVertexShaderExternalData* packedVSData = (PackedVertexShaderExternalData*)objectConstants[draw].Data;
+				packedVSData->worldMatrix = archetype.Worlds[row];
+				packedVSData->worldInvTranspose = archetype.WorldInverseTransposes[row];
+				packedVSData->positionScale = mesh->GetDequantize().Scale;
+				packedVSData->positionOffset = mesh->GetDequantize().Offset;
+			}
+
+			if (material != writtenMaterial)
+			{
+				materialConstants[draw] = WriteMaterialConstants(material);
+				writtenMaterial = material;
+			}
+		}
+
+		Graphics::BindConstantBuffer(frameConstants, D3D11_VERTEX_SHADER, 0);
+		Graphics::BindConstantBuffer(frameConstants, D3D11_PIXEL_SHADER, 0);
+
+		// Only set shaders and bind textures when they differ from the last draw's
+		ID3D11InputLayout* boundInputLayout = nullptr;
+		ID3D11VertexShader* boundVertexShader = nullptr;
+		ID3D11PixelShader* boundPixelShader = nullptr;
+		Material* boundMaterial = nullptr;
+
+		for (unsigned int draw = 0; draw < items.size(); draw++)
+		{
+			// Read straight from the entity's archetype, and look its mesh and
+			// material up in their pools, without touching any reference counts
+			const EntityArchetype& archetype = entities.GetArchetype(entityLocations[items[draw]].Archetype);
+			unsigned int row = entityLocations[items[draw]].Row;
+			Mesh* mesh = meshes.Get(archetype.Renderables[row].Mesh);
+			Material* material = materials.Get(archetype.Renderables[row].Material);
+			VertexFormat vertexFormat = mesh->GetVertexFormat();
+
+			// Set shaders from the Material
+			// - Meshes with packed vertices need their own vertex shader and input layout
+			ID3D11InputLayout* drawInputLayout = inputLayout.Get();
+			ID3D11VertexShader* drawVertexShader = material->GetVertexShader();
+			if (vertexFormat != VertexFormat::Full)
+			{
+				drawInputLayout = vertexFormat == VertexFormat::Packed ? packedInputLayout.Get() : packedFloatPositionInputLayout.Get();
+				drawVertexShader = packedVertexShader.Get();
+			}
+
+			if (drawInputLayout != boundInputLayout || drawVertexShader != boundVertexShader || material->GetPixelShader() != boundPixelShader)
+			{
+				Graphics::State->SetInputLayout(drawInputLayout);
+				Graphics::State->SetVertexShader(drawVertexShader);
+				Graphics::State->SetPixelShader(material->GetPixelShader());
+				boundInputLayout = drawInputLayout;
+				boundVertexShader = drawVertexShader;
+				boundPixelShader = material->GetPixelShader();
+				drawStateChanges.shaders++;
+			}
+
+			Graphics::BindConstantBuffer(objectConstants[draw], D3D11_VERTEX_SHADER, 2);
+
+			// Bind the material's data, textures and samplers only when it
+			// differs from the last draw's (where its data was written)
+			if (material != boundMaterial)
+			{
+				Graphics::BindConstantBuffer(materialConstants[draw], D3D11_PIXEL_SHADER, 1);
+				material->BindTexturesAndSamplers(textures);
+				boundMaterial = material;
+				drawStateChanges.materials++;
+			}
+
+			// Now that the shader has access to the correct world matrix, draw the entity's Mesh
+			mesh->Draw(ChooseEntityLod(archetype, row, mesh));
+			entityDrawCalls++;
+		}
+	}
+
+	// Put the default layout back for anything drawn afterwards (like the sky)
+	Graphics::State->SetInputLayout(inputLayout.Get());
+}
+
+
+// --------------------------------------------------------
+// Draws the sorted draw list with one instanced draw per
+// run of entities sharing a mesh, material and LOD
+// - Every instance's matrices are copied into instanceBuffer
+//    first, so batches only send their material's data (and
+//    how to unpack packed vertices) through constant buffers
+// - Runs are only as long as the draw list makes them, which
+//    groups by material and mesh before anything else
+// - frameConstants has been written, but not bound yet
+// --------------------------------------------------------
+void Game::DrawEntityBatches(const Graphics::ConstantBufferAllocation& frameConstants)
+{
+	instanceBatcher.Clear();
+	for (unsigned int i : drawList->GetItems())
+	{
+		const EntityArchetype& archetype = entities.GetArchetype(entityLocations[i].Archetype);
+		unsigned int row = entityLocations[i].Row;
+		const Renderable& renderable = archetype.Renderables[row];
+		Mesh* mesh = meshes.Get(renderable.Mesh);
+		instanceBatcher.Add(renderable.Mesh.Value, renderable.Material.Value, ChooseEntityLod(archetype, row, mesh),
+			archetype.Worlds[row], archetype.WorldInverseTransposes[row]);
+	}
+
+	const std::vector<InstanceData>& instances = instanceBatcher.GetInstances();
+	const std::vector<InstanceBatch>& batches = instanceBatcher.GetBatches();
+	if (instances.empty())
+		return;
+
+	// Make the instance buffer bigger if this frame's instances don't fit,
+	// with room to spare so it isn't remade every time another one appears
+	if (instances.size() > instanceBufferCapacity)
+	{
+		instanceBufferCapacity = std::max((unsigned int)instances.size(), instanceBufferCapacity * 2);
+
+		D3D11_BUFFER_DESC instanceBufferDesc = {};
+		instanceBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+		instanceBufferDesc.ByteWidth = sizeof(InstanceData) * instanceBufferCapacity;
+		instanceBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		instanceBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+		instanceBuffer.Reset();
+		Graphics::Device->CreateBuffer(&instanceBufferDesc, 0, instanceBuffer.GetAddressOf());
+	}
+
+	// Replace last frame's instances with this frame's, all at once
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	Graphics::Context->Map(instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+	memcpy(mapped.pData, instances.data(), sizeof(InstanceData) * instances.size());
+	Graphics::Context->Unmap(instanceBuffer.Get(), 0);
+	instanceBytesUploaded = sizeof(InstanceData) * (unsigned int)instances.size();
+
+	UINT instanceStride = sizeof(InstanceData);
+	UINT instanceOffset = 0;
+	Graphics::Context->IASetVertexBuffers(1, 1, instanceBuffer.GetAddressOf(), &instanceStride, &instanceOffset);
+
+	// Write every batch's constants before drawing anything, the same as
+	// DrawAllGameEntities() does
+	// - The world matrices are in the instance buffer and the camera's are
+	//    in PerFrame, so only packed vertices need anything per batch
+	objectConstants.resize(batches.size());
+	materialConstants.resize(batches.size());
+	Material* writtenMaterial = nullptr;
+	for (unsigned int b = 0; b < batches.size(); b++)
+	{
+		Mesh* mesh = meshes.Get(MeshHandle{ batches[b].Mesh });
+		Material* material = materials.Get(MaterialHandle{ batches[b].Material });
+
+		if (mesh->GetVertexFormat() != VertexFormat::Full)
+		{
+			objectConstants[b] = Graphics::AllocateConstantBuffer(sizeof(InstancedPackedVertexShaderExternalData));
+			InstancedPackedVertexShaderExternalData* packedVSData = (InstancedPackedVertexShaderExternalData*)objectConstants[b].Data;
+			packedVSData->positionScale = mesh->GetDequantize().Scale;
+			packedVSData->positionOffset = mesh->GetDequantize().Offset;
+		}
+
+		if (material != writtenMaterial)
+		{
+			materialConstants[b] = WriteMaterialConstants(material);
+			writtenMaterial = material;
+		}
+	}
+
+	Graphics::BindConstantBuffer(frameConstants, D3D11_VERTEX_SHADER, 0);
+	Graphics::BindConstantBuffer(frameConstants, D3D11_PIXEL_SHADER, 0);
+
+	// Only set shaders and bind textures when they differ from the last batch's
+	ID3D11InputLayout* boundInputLayout = nullptr;
+	ID3D11VertexShader* boundVertexShader = nullptr;
+	ID3D11PixelShader* boundPixelShader = nullptr;
+	Material* boundMaterial = nullptr;
+
+	for (unsigned int b = 0; b < batches.size(); b++)
+	{
+		const InstanceBatch& batch = batches[b];
+		Mesh* mesh = meshes.Get(MeshHandle{ batch.Mesh });
+		Material* material = materials.Get(MaterialHandle{ batch.Material });
+		VertexFormat vertexFormat = mesh->GetVertexFormat();
+
+		// Every material shares VertexShader.hlsl, so the instanced
+		// version of it stands in for the material's
+		ID3D11InputLayout* drawInputLayout = instancedInputLayout.Get();
+		ID3D11VertexShader* drawVertexShader = instancedVertexShader.Get();
+		if (vertexFormat != VertexFormat::Full)
+		{
+			drawInputLayout = vertexFormat == VertexFormat::Packed ? instancedPackedInputLayout.Get() : instancedPackedFloatPositionInputLayout.Get();
+			drawVertexShader = instancedPackedVertexShader.Get();
+		}
+
+		if (drawInputLayout != boundInputLayout || drawVertexShader != boundVertexShader || material->GetPixelShader() != boundPixelShader)
+		{
+			Graphics::State->SetInputLayout(drawInputLayout);
+			Graphics::State->SetVertexShader(drawVertexShader);
+			Graphics::State->SetPixelShader(material->GetPixelShader());
+			boundInputLayout = drawInputLayout;
+			boundVertexShader = drawVertexShader;
+			boundPixelShader = material->GetPixelShader();
+			drawStateChanges.shaders++;
+		}
+
+		if (vertexFormat != VertexFormat::Full)
+			Graphics::BindConstantBuffer(objectConstants[b], D3D11_VERTEX_SHADER, 2);
+
+		if (material != boundMaterial)
+		{
+			Graphics::BindConstantBuffer(materialConstants[b], D3D11_PIXEL_SHADER, 1);
+			material->BindTexturesAndSamplers(textures);
+			boundMaterial = material;
+			drawStateChanges.materials++;
+		}
+
+		mesh->DrawInstanced(batch.InstanceCount, batch.FirstInstance, batch.Lod);
+		entityDrawCalls++;
+	}
+}
+
+
+// --------------------------------------------------------
+// Draws the sorted draw list from command lists, recorded
+// over chunks of it on every core (by workers, so no
+// threads are made per frame), then run in order here
+// - Each list's constants are written before the frame's
+//    own are bound, so the frame still needs only one Map()
+// - frameConstants has been written, but not bound yet
+// --------------------------------------------------------
+void Game::DrawEntityCommands(const Graphics::ConstantBufferAllocation& frameConstants)
+{
+	// Fewest draws worth giving a thread of its own
+	const unsigned int MinimumDrawsPerThread = 1024;
+
+	const std::vector<unsigned int>& items = drawList->GetItems();
+	unsigned int jobCount = (unsigned int)std::clamp<size_t>(items.size() / MinimumDrawsPerThread, 1, workers->GetThreadCount());
+	if (entityCommandLists.size() < jobCount)
+		entityCommandLists.resize(jobCount);
+
+	auto recordStart = std::chrono::high_resolution_clock::now();
+	workers->Run(jobCount, [&](unsigned int job)
+		{
+			entityCommandLists[job].Reset();
+			RecordEntityCommands(entityCommandLists[job],
+				(unsigned int)(items.size() * job / jobCount),
+				(unsigned int)(items.size() * (job + 1) / jobCount));
+		});
+
+	// Lists left over from frames that used more threads have nothing to run
+	for (unsigned int i = jobCount; i < entityCommandLists.size(); i++)
+		entityCommandLists[i].Reset();
+
+	commandListsRecorded = jobCount;
+	commandRecordMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+
+	commandExecutor->WriteConstants(entityCommandLists);
+	Graphics::BindConstantBuffer(frameConstants, D3D11_VERTEX_SHADER, 0);
+	Graphics::BindConstantBuffer(frameConstants, D3D11_PIXEL_SHADER, 0);
+	commandExecutor->Submit(entityCommandLists);
+	entityDrawCalls += commandExecutor->GetDrawCalls();
+	drawStateChanges.shaders += commandExecutor->GetShaderChanges();
+	drawStateChanges.materials += commandExecutor->GetMaterialChanges();
+}
+
+
+// --------------------------------------------------------
+// Records draws [firstDraw, endDraw) of the sorted draw
+// list into list, binding what DrawAllGameEntities() would
+// - Only reads entities, meshes and materials, so several
+//    threads can record at once, each into its own list
+// - Starts from what the draw before firstDraw leaves bound,
+//    so chunks recorded apart and run in order are the same
+//    commands as the whole list recorded at once
+// --------------------------------------------------------
+void Game::RecordEntityCommands(RenderCommandList& list, unsigned int firstDraw, unsigned int endDraw)
+{
+	const std::vector<unsigned int>& items = drawList->GetItems();
+
+	unsigned int boundPipeline = UINT_MAX;
+	unsigned int boundMaterial = 0;
+	if (firstDraw > 0)
+	{
+		const EntityArchetype& archetype = entities.GetArchetype(entityLocations[items[firstDraw - 1]].Archetype);
+		const Renderable& renderable = archetype.Renderables[entityLocations[items[firstDraw - 1]].Row];
+		boundPipeline = (unsigned int)meshes.Get(renderable.Mesh)->GetVertexFormat();
+		boundMaterial = renderable.Material.Value;
+	}
+
+	for (unsigned int draw = firstDraw; draw < endDraw; draw++)
+	{
+		const EntityArchetype& archetype = entities.GetArchetype(entityLocations[items[draw]].Archetype);
+		unsigned int row = entityLocations[items[draw]].Row;
+		const Renderable& renderable = archetype.Renderables[row];
+		Mesh* mesh = meshes.Get(renderable.Mesh);
+		unsigned int pipeline = (unsigned int)mesh->GetVertexFormat();
+
+		if (pipeline != boundPipeline || renderable.Material.Value != boundMaterial)
+			list.BindPipeline(pipeline, renderable.Material.Value);
+
+		if (renderable.Material.Value != boundMaterial)
+		{
+			Material* material = materials.Get(renderable.Material);
+			MaterialExternalData materialData = {};
+			materialData.colorTint = material->GetColorTint();
+			materialData.textureScale = material->GetTextureScale();
+			materialData.textureOffset = material->GetTextureOffset();
+
+			list.BindMaterial(renderable.Material.Value);
+			list.SetConstants(RenderShaderStage::Pixel, 1, &materialData, sizeof(MaterialExternalData));
+		}
+
+		boundPipeline = pipeline;
+		boundMaterial = renderable.Material.Value;
+
+		if (mesh->GetVertexFormat() == VertexFormat::Full)
+		{
+			VertexShaderExternalData vsData = {};
+			vsData.worldMatrix = archetype.Worlds[row];
+			vsData.worldInvTranspose = archetype.WorldInverseTransposes[row];
+			list.SetConstants(RenderShaderStage::Vertex, 2, &vsData, sizeof(VertexShaderExternalData));
+		}
+		else
+		{
+			PackedVertexShaderExternalData packedVSData = {};
+			packedVSData.worldMatrix = archetype.Worlds[row];
+			packedVSData.worldInvTranspose = archetype.WorldInverseTransposes[row];
+			packedVSData.positionScale = mesh->GetDequantize().Scale;
+			packedVSData.positionOffset = mesh->GetDequantize().Offset;
+			list.SetConstants(RenderShaderStage::Vertex, 2, &packedVSData, sizeof(PackedVertexShaderExternalData));
+		}
+
+		list.Draw(renderable.Mesh.Value, ChooseEntityLod(archetype, row, mesh));
+	}
+}
+
+
+// --------------------------------------------------------
+// Writes a material's constants (see PerMaterial in
+// ShaderIncludes.hlsli) into the constant buffer heap,
+// without binding them
+// --------------------------------------------------------
+Graphics::ConstantBufferAllocation Game::WriteMaterialConstants(Material* material)
+{
+	Graphics::ConstantBufferAllocation allocation = Graphics::AllocateConstantBuffer(sizeof(MaterialExternalData));
+	MaterialExternalData* materialData = (MaterialExternalData*)allocation.Data;
+	materialData->colorTint = material->GetColorTint();
+	materialData->textureScale = material->GetTextureScale();
+	materialData->textureOffset = material->GetTextureOffset();
+	return allocation;
+}
+
+
+// --------------------------------------------------------
+// Picks a LOD of the entity's mesh whose error is under
+// lodPixelError pixels at its distance from the camera
+// - Always 0 (full detail) when LODs are turned off
+// --------------------------------------------------------
+int Game::ChooseEntityLod(const EntityArchetype& archetype, unsigned int row, Mesh* mesh)
+{
+	if (!useLods)
+		return 0;
+
+	// How many pixels one unit in the mesh's local space covers on screen
+	// - Uses the largest scale, so the error is never underestimated
+	XMFLOAT3 scale = archetype.Transforms[row].Scale;
+	XMFLOAT3 position = archetype.Transforms[row].Translation;
+	XMFLOAT3 cameraPosition = cameras[currentCameraIndex]->GetTranslation();
+	float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&position), XMLoadFloat3(&cameraPosition))));
+	float maxScale = std::max({ fabsf(scale.x), fabsf(scale.y), fabsf(scale.z) });
+	float halfFov = XMConvertToRadians(cameras[currentCameraIndex]->GetFovDegrees()) * 0.5f;
+	float pixelsPerUnit = maxScale * Window::Height() / (2.0f * std::max(distance, 0.001f) * tanf(halfFov));
+
+	return mesh->ChooseLod(pixelsPerUnit, lodPixelError);
 }
 
 
@@ -817,6 +2061,23 @@ void Game::FrameEnd()
 			1,
 			Graphics::BackBufferRTV.GetAddressOf(),
 			Graphics::DepthBufferDSV.Get());
+
+		// Destroy any resources released a few frames ago, now that
+		// nothing can still be using them
+		meshes.EndFrame();
+		materials.EndFrame();
+		textures.EndFrame();
+
+		// Free constant buffer heap space the GPU is done with
+		Graphics::EndConstantBufferFrame();
+
+		// Keep this frame's upload totals for the UI, and start counting again
+		constantBytesUploaded = Graphics::cbBytesUploaded;
+		constantBufferMaps = Graphics::cbMapCount;
+		Graphics::cbBytesUploaded = 0;
+		Graphics::cbMapCount = 0;
+		stateBindCounts = Graphics::State->GetCounts();
+		Graphics::State->ResetCounts();
 	}
 }
 
@@ -1,11 +1,24 @@
 #pragma once
 
 #include "Mesh.h"
+#include "Graphics.h"
 #include "BufferStructs.h"
-#include "GameEntity.h"
+#include "EntityStore.h"
+#include "Material.h"
+#include "ResourcePool.h"
 #include "Camera.h"
 #include "Lights.h"
 #include "Sky.h"
+#include "FrustumCulling.h"
+#include "OcclusionCuller.h"
+#include "SceneBvh.h"
+#include "DrawList.h"
+#include "InstanceBatcher.h"
+#include "RenderCommandList.h"
+#include "D3D11CommandExecutor.h"
+#include "Picking.h"
+#include "Benchmarks.h"
+#include "WorkerPool.h"
 
 #include <d3d11.h>
 #include <wrl/client.h>
@@ -33,17 +46,24 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> LoadVertexShader(const WCHAR* shaderPath);
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> LoadPixelShader(const WCHAR* shaderPath);
 	void CreateGameEntities();
-	void CreateStartingCameras();
+	std::vector<std::shared_ptr<Camera>> CreateStartingCameras();
 	void CreateInitialLights();
 
 	// Done in Update()
 	void UpdateCameras(float deltaTime);
+	void PickEntity();
 	void StartImGuiUpdate(float deltaTime);
 	void BuildCustomUI(float deltaTime);
 	
 	// Done in Draw()
 	void FrameStart();
+	void UpdateEntityBounds();
 	void DrawAllGameEntities(float totalTime);
+	void DrawEntityBatches(const Graphics::ConstantBufferAllocation& frameConstants);
+	void DrawEntityCommands(const Graphics::ConstantBufferAllocation& frameConstants);
+	void RecordEntityCommands(RenderCommandList& list, unsigned int firstDraw, unsigned int endDraw);
+	Graphics::ConstantBufferAllocation WriteMaterialConstants(Material* material);
+	int ChooseEntityLod(const EntityArchetype& archetype, unsigned int row, Mesh* mesh);
 	void RenderImGui();
 	void FrameEnd();
 
@@ -54,6 +74,110 @@ private:
 	DirectX::XMFLOAT3 defaultAmbientColor = DirectX::XMFLOAT3(0.227f, 0.153f, 0.212f);
 	DirectX::XMFLOAT3 ambientColor = defaultAmbientColor;
 	bool showImGuiDemoWindow = false;
+	bool useLods = true;
+	float lodPixelError = 1.0f;
+	bool useFrustumCulling = true;
+	bool useOcclusionCulling = true;
+	bool useOcclusionReprojection = false;
+	bool useInstancing = true;
+	bool useCommandLists = false;
+
+	// Results of benchmarks run from ImGui
+	std::vector<ObjParseBenchmarkResult> objParseBenchmarkResults;
+	std::vector<ObjParseScalingResult> objParseScalingResults;
+	std::vector<MeshLoadBenchmarkResult> meshLoadBenchmarkResults;
+	std::vector<MeshOptimizationBenchmarkResult> meshOptimizationBenchmarkResults;
+	std::vector<TangentGenerationResult> tangentGenerationResults;
+	std::vector<PackedVertexAccuracyResult> packedVertexAccuracyResults;
+	std::vector<IndexBufferSavingsResult> indexBufferSavingsResults;
+	std::vector<MeshletCullingResult> meshletCullingResults;
+	std::vector<LodSimplificationResult> lodSimplificationResults;
+	std::vector<TransformHierarchyResult> transformHierarchyResults;
+	std::vector<TransformSystemResult> transformSystemResults;
+	std::vector<CameraMovementResult> cameraMovementResults;
+	std::vector<EntityCullingResult> entityCullingResults;
+	std::vector<OcclusionCullingResult> occlusionCullingResults;
+	std::vector<EntityBvhResult> entityBvhResults;
+	std::vector<RayPickingResult> rayPickingResults;
+	std::vector<EntityStorageResult> entityStorageResults;
+	std::vector<ResourceLookupResult> resourceLookupResults;
+	std::vector<DrawListSortResult> drawListSortResults;
+	std::vector<InstanceBatchingResult> instanceBatchingResults;
+	std::vector<ConstantBufferRingResult> constantBufferRingResults;
+	std::vector<StateTrackingResult> stateTrackingResults;
+	std::vector<CommandListResult> commandListResults;
+
+	// World bounds of every entity that can be drawn, where each one's
+	// components are, and which ones the camera can see this frame,
+	// rebuilt at the start of DrawAllGameEntities() (and before each pick)
+	WorldBounds entityBounds;
+	std::vector<EntityLocation> entityLocations;
+	std::vector<unsigned int> visibleEntities;
+
+	// Threads shared by everything split up each frame (BVH refits,
+	// draw list sorts and command recording), made once up front
+	std::shared_ptr<WorkerPool> workers;
+
+	// Spatial index over entityBounds, refit every frame
+	// - movedEntities holds the entities whose world matrix changed in
+	//    the last UpdateWorldMatrices(), so a still scene refits nothing
+	// - Rebuilt whenever entities are added, removed or change archetype
+	std::shared_ptr<SceneBvh> entityBvh;
+	std::vector<unsigned int> movedEntities;
+	unsigned int entityBvhVersion = 0;
+
+	// The entity last clicked on (with the right mouse button), if any
+	EntityId pickedEntity = {};
+	PickHit pickHit = {};
+	bool openPickedEntity = false;	// Until the UI has opened its node
+
+	// Visible entities sorted into the order they're drawn in, and how
+	// often that order still had to change state last frame
+	std::shared_ptr<DrawList> drawList;
+	DrawStateChanges drawStateChanges = {};
+
+	// Groups the sorted draws into instanced batches, and the per-instance
+	// buffer (vertex buffer slot 1) they're copied into each frame
+	// - Grows to fit, and is never shrunk
+	InstanceBatcher instanceBatcher;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> instanceBuffer;
+	unsigned int instanceBufferCapacity = 0;
+
+	// Draw calls made for entities last frame, and how long
+	// DrawAllGameEntities() took on the CPU
+	unsigned int entityDrawCalls = 0;
+	double entityDrawMilliseconds = 0.0;
+
+	// Bytes of constant data (and instance data) sent to the GPU last frame
+	unsigned int constantBytesUploaded = 0;
+	unsigned int instanceBytesUploaded = 0;
+	unsigned int constantBufferMaps = 0;
+
+	// Binds asked of Graphics::State last frame, and how many it sent
+	StateTrackerCounts stateBindCounts = {};
+
+	// Where each draw's (or batch's) constants were written this frame,
+	// before they're bound for drawing
+	// - Material constants are only written where the material changes
+	std::vector<Graphics::ConstantBufferAllocation> objectConstants;
+	std::vector<Graphics::ConstantBufferAllocation> materialConstants;
+
+	// A command list per thread for the visible entities (when they're
+	// recorded rather than drawn straight away), and what runs them
+	// - Lists are kept and reused, so they stop allocating once they're
+	//    big enough
+	std::vector<RenderCommandList> entityCommandLists;
+	std::shared_ptr<D3D11CommandExecutor> commandExecutor;
+	unsigned int commandListsRecorded = 0;
+	double commandRecordMilliseconds = 0.0;
+
+	// Entities added by the stress scene button, so they can be removed again
+	std::vector<EntityId> stressEntities;
+
+	// Hides entities behind occluders, after frustum culling
+	// - Frustum culled entities are copied to occlusionCandidates first
+	std::shared_ptr<OcclusionCuller> occlusionCuller;
+	std::vector<unsigned int> occlusionCandidates;
 
 	// Note the usage of ComPtr below
 	//  - This is a smart pointer for objects that abide by the
@@ -62,13 +186,28 @@ private:
 
 	// Shaders and shader-related constructs
 	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+
+	// Vertex shader and input layouts for meshes with packed vertices
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> packedVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> packedInputLayout;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> packedFloatPositionInputLayout;
+
+	// Instanced versions of the above, which read world matrices
+	// from the instance buffer instead of a constant buffer
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> instancedVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> instancedPackedVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> instancedInputLayout;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> instancedPackedInputLayout;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> instancedPackedFloatPositionInputLayout;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexShaderConstantBuffer;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> pixelShaderConstantBuffer;
 
-	// Meshes
-	std::vector<std::shared_ptr<Mesh>> meshes;
-	// GameEntities
-	std::vector<std::shared_ptr<GameEntity>> gameEntities;
+	// Meshes, Materials and their textures, which are referred to by handle
+	ResourcePool<Mesh> meshes;
+	ResourcePool<Material> materials;
+	TexturePool textures;
+	// Entities and their components
+	EntityStore entities;
 	// Cameras
 	std::vector<std::shared_ptr<Camera>> cameras;
 	int currentCameraIndex = 0;
@@ -1,5 +1,8 @@
 #include "Graphics.h"
+#include <algorithm>
+#include <deque>
 #include <dxgi1_6.h>
+#include <vector>
 
 // Tell the drivers to use high-performance GPU in multi-GPU systems (like laptops)
 extern "C"
@@ -21,6 +24,99 @@ namespace Graphics
 
 		D3D_FEATURE_LEVEL featureLevel{};
 
+		// Which pieces of the constant buffer heap are in use, and where
+		// the heap is mapped to (null when it isn't)
+		ConstantBufferRing cbRing;
+		void* cbMappedData = nullptr;
+		bool cbHeapIsNew = false;
+
+		// Heaps replaced by bigger ones, kept until the GPU is done with
+		// the last frame that used them
+		struct RetiredHeap
+		{
+			Microsoft::WRL::ComPtr<ID3D11Buffer> Buffer;
+			unsigned long long LastFrame;
+			bool Mapped;
+		};
+		std::vector<RetiredHeap> retiredHeaps;
+
+		// An event query after each frame's commands, oldest first, which
+		// the GPU signals once it's finished that frame
+		struct FrameFence
+		{
+			Microsoft::WRL::ComPtr<ID3D11Query> Query;
+			unsigned long long Frame;
+		};
+		std::deque<FrameFence> frameFences;
+		std::vector<Microsoft::WRL::ComPtr<ID3D11Query>> spareQueries;
+
+	}
+
+	// Annonymous namespace to hold helpers
+	// only accessible in this file
+	namespace
+	{
+		// Makes a new, empty heap (replacing the current one)
+		void CreateConstantBufferHeap(unsigned int sizeInBytes)
+		{
+			cbHeapSizeInBytes = (sizeInBytes + 255) / 256 * 256; // Ensure 256-byte alignment
+
+			// Create a description of our ring buffer
+			D3D11_BUFFER_DESC constBufferDescription = {}; // Initialize to all zeroes
+			constBufferDescription.BindFlags = D3D11_BIND_CONSTANT_BUFFER; // What type of buffer are we creating?
+			constBufferDescription.ByteWidth = cbHeapSizeInBytes; // Large, arbitrary value (that is a multiple of 256)
+			constBufferDescription.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE; // We have to be able to access this from the CPU, and write to it
+			constBufferDescription.Usage = D3D11_USAGE_DYNAMIC; // This buffer can change
+
+			// Use the device to create the buffer with this description
+			constantBufferHeap.Reset();
+			Device->CreateBuffer(&constBufferDescription, 0, constantBufferHeap.GetAddressOf());
+
+			cbRing.Reset(cbHeapSizeInBytes);
+			cbHeapIsNew = true;
+		}
+
+		// Maps the current heap, if it isn't already
+		void* MapConstantBufferHeap()
+		{
+			if (cbMappedData)
+				return cbMappedData;
+
+			// Where we will copy our data to, representing physical memory on the GPU
+			// - Tell the GPU that we won't be overwriting any data in this buffer (at least, before it's used),
+			//    except the first time, when there's nothing there to keep
+			D3D11_MAPPED_SUBRESOURCE mappedBuffer{}; // Initialize to all zeroes
+			Context->Map(
+				constantBufferHeap.Get(),
+				0,
+				cbHeapIsNew ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE,
+				0,
+				&mappedBuffer);
+
+			cbHeapIsNew = false;
+			cbMappedData = mappedBuffer.pData;
+			cbMapCount++;
+			return cbMappedData;
+		}
+
+		// Unmaps every heap still mapped, so the GPU can access the data
+		void UnmapConstantBufferHeaps()
+		{
+			if (cbMappedData)
+			{
+				Context->Unmap(constantBufferHeap.Get(), 0);
+				cbMappedData = nullptr;
+			}
+
+			for (RetiredHeap& heap : retiredHeaps)
+			{
+				if (heap.Mapped)
+				{
+					Context->Unmap(heap.Buffer.Get(), 0);
+					heap.Mapped = false;
+				}
+			}
+		}
 	}
 }
 
@@ -164,6 +260,7 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 
 	// Set up a D3D11.1 version of the Context object
 	Context->QueryInterface<ID3D11DeviceContext1>(Context1.GetAddressOf());
+	State = std::make_shared<StateTracker>(Device, Context1);
 
 	// Initialize the large "ring" constant buffer
 	// Set up data for the constant buffer description
@@ -172,17 +269,10 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 	cbHeapSizeInBytes = numOfBuffers * minimumBufferSize; // Calculate our arbitrary buffer size
 	cbHeapSizeInBytes = (cbHeapSizeInBytes + 255) / 256 * 256; // Ensure 256-byte alignment in case the math above changes!
 
-	cbHeapOffsetInBytes = 0; // Always starts at zero
-
-	// Create a description of our ring buffer
-	D3D11_BUFFER_DESC constBufferDescription = {}; // Initialize to all zeroes
-	constBufferDescription.BindFlags = D3D11_BIND_CONSTANT_BUFFER; // What type of buffer are we creating?
-	constBufferDescription.ByteWidth = cbHeapSizeInBytes; // Large, arbitrary value (that is a multiple of 256)
-	constBufferDescription.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE; // We have to be able to access this from the CPU, and write to it
-	constBufferDescription.Usage = D3D11_USAGE_DYNAMIC; // This buffer can change
-
-	// Use the device to create the buffer with this description
-	Device->CreateBuffer(&constBufferDescription, 0, constantBufferHeap.GetAddressOf());
+	cbBytesUploaded = 0;
+	cbMapCount = 0;
+	cbHeapGrowCount = 0;
+	CreateConstantBufferHeap(cbHeapSizeInBytes);
 
 	return S_OK;
 }
@@ -287,61 +377,114 @@ void Graphics::ResizeBuffers(unsigned int width, unsigned int height)
 	SwapChain->GetFullscreenState(&isFullscreen, 0);
 }
 
+// --------------------------------------------------------
+// Copies data into the next piece of the constant buffer
+// heap, and binds that piece to the given shader stage
+// --------------------------------------------------------
 void Graphics::FillAndBindNextConstantBuffer(void* data, unsigned int dataSizeInBytes, D3D11_SHADER_TYPE shaderType, unsigned int registerSlot)
+{
+	ConstantBufferAllocation allocation = AllocateConstantBuffer(dataSizeInBytes);
+	memcpy(allocation.Data, data, dataSizeInBytes); // Here we use the size of the data, not the reservation -- we don't want to copy from beyond our actual data
+	BindConstantBuffer(allocation, shaderType, registerSlot);
+}
+
+// --------------------------------------------------------
+// Reserves room for dataSizeInBytes in the constant buffer
+// heap, returning a pointer to write the data straight to
+// - The heap stays mapped until something is bound, so any
+//    number of allocations in a row share a single Map()
+// - When the only free space is still in use by the GPU,
+//    the heap is replaced with one twice the size rather
+//    than overwriting it (or waiting); the old one is kept
+//    alive until the GPU is done with it
+// --------------------------------------------------------
+Graphics::ConstantBufferAllocation Graphics::AllocateConstantBuffer(unsigned int dataSizeInBytes)
 {
 	// Calculate reservation size - a multiple of 256 that's big enough to contain our data
-	unsigned int reservationSize = (dataSizeInBytes + 255) / 256 * 256;
+	unsigned int reservationSize = (dataSizeInBytes + ConstantBufferRing::Alignment - 1) / ConstantBufferRing::Alignment * ConstantBufferRing::Alignment;
+	reservationSize = std::max(reservationSize, ConstantBufferRing::Alignment);
 
-	// Does the reservation fit in the remaining space?
-	if (cbHeapOffsetInBytes + reservationSize >= cbHeapSizeInBytes)
+	unsigned int offset = 0;
+	if (!cbRing.Allocate(reservationSize, offset))
 	{
-		// If not, loop back to the start
-		cbHeapOffsetInBytes = 0;
-	}
+		retiredHeaps.push_back({ constantBufferHeap, cbRing.GetCurrentFrame(), cbMappedData != nullptr });
+		cbMappedData = nullptr;
 
-	// Where we will copy our data to, representing physical memory on the GPU
-	D3D11_MAPPED_SUBRESOURCE mappedBuffer{}; // Initialize to all zeroes
-	Context->Map(
-		constantBufferHeap.Get(),
-		0,
-		D3D11_MAP_WRITE_NO_OVERWRITE, // Tell the GPU that we won't be overwriting any data in this buffer (at least, before it's used)
-		0,
-		&mappedBuffer);
+		CreateConstantBufferHeap(std::max(cbHeapSizeInBytes * 2, reservationSize));
+		cbRing.Allocate(reservationSize, offset);
+		cbHeapGrowCount++;
+	}
 
 	// Write into the next unused portion of the buffer
-	void* uploadAddress = reinterpret_cast<void*>((UINT64)mappedBuffer.pData + cbHeapOffsetInBytes);
-	memcpy(uploadAddress, data, dataSizeInBytes); // Here we use the size of the data, not the reservation -- we don't want to copy from beyond our actual data
-
-	// Unmap as soon as we're done, so the GPU can access the data
-	Context->Unmap(constantBufferHeap.Get(), 0);
+	ConstantBufferAllocation allocation{};
+	allocation.Data = reinterpret_cast<void*>((UINT64)MapConstantBufferHeap() + offset);
+	allocation.Buffer = constantBufferHeap.Get();
 
 	// Calculate the binding offset and size, as measured in 16-byte chunks ("shader constants")
-	unsigned int firstShaderConstant = cbHeapOffsetInBytes / 16;
-	unsigned int numOfShaderConstants = reservationSize / 16;
+	allocation.FirstConstant = offset / 16;
+	allocation.ConstantCount = reservationSize / 16;
+
+	cbBytesUploaded += dataSizeInBytes;
+	return allocation;
+}
+
+// --------------------------------------------------------
+// Binds a piece of the constant buffer heap to the given
+// shader stage
+// - Unmaps the heap first, since the GPU can't use it while
+//    it's mapped; any allocation's Data is now out of date
+// - Goes through State, so it's only sent (along with any
+//    neighbouring slots) at the next draw, and only if it
+//    isn't bound already
+// --------------------------------------------------------
+void Graphics::BindConstantBuffer(const ConstantBufferAllocation& allocation, D3D11_SHADER_TYPE shaderType, unsigned int registerSlot)
+{
+	UnmapConstantBufferHeaps();
+	State->SetConstantBuffer(shaderType, registerSlot, allocation.Buffer, allocation.FirstConstant, allocation.ConstantCount);
+}
+
+// --------------------------------------------------------
+// Marks the end of a frame's constant data, then frees the
+// heap space of every frame the GPU has finished with
+// - Call once per frame, after Present()
+// - An event query after each frame tells us when the GPU
+//    is done with it; they're only polled, never waited on
+// --------------------------------------------------------
+void Graphics::EndConstantBufferFrame()
+{
+	UnmapConstantBufferHeaps();
+	unsigned long long frame = cbRing.EndFrame();
 
-	// Bind the buffer to the proper pipeline stage
-	switch (shaderType)
+	Microsoft::WRL::ComPtr<ID3D11Query> query;
+	if (!spareQueries.empty())
+	{
+		query = spareQueries.back();
+		spareQueries.pop_back();
+	}
+	else
 	{
-	case D3D11_VERTEX_SHADER:
-		Context1->VSSetConstantBuffers1(
-			registerSlot,
-			1,
-			constantBufferHeap.GetAddressOf(),
-			&firstShaderConstant,
-			&numOfShaderConstants);
-		break;
-	case D3D11_PIXEL_SHADER:
-		Context1->PSSetConstantBuffers1(
-			registerSlot,
-			1,
-			constantBufferHeap.GetAddressOf(),
-			&firstShaderConstant,
-			&numOfShaderConstants);
-		break;
+		D3D11_QUERY_DESC queryDesc = {};
+		queryDesc.Query = D3D11_QUERY_EVENT;
+		Device->CreateQuery(&queryDesc, query.GetAddressOf());
 	}
+	Context->End(query.Get());
+	frameFences.push_back({ query, frame });
 
-	// Offset for the next call
-	cbHeapOffsetInBytes += reservationSize;
+	// Frames finish in order, so stop at the first one that hasn't
+	while (!frameFences.empty())
+	{
+		BOOL finished = FALSE;
+		if (Context->GetData(frameFences.front().Query.Get(), &finished, sizeof(finished), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK || !finished)
+			break;
+
+		unsigned long long finishedFrame = frameFences.front().Frame;
+		cbRing.RetireFrame(finishedFrame);
+		retiredHeaps.erase(std::remove_if(retiredHeaps.begin(), retiredHeaps.end(),
+			[=](const RetiredHeap& heap) { return heap.LastFrame <= finishedFrame; }), retiredHeaps.end());
+
+		spareQueries.push_back(frameFences.front().Query);
+		frameFences.pop_front();
+	}
 }
 
 
@@ -3,10 +3,14 @@
 #include <Windows.h>
 #include <d3d11.h>
 #include <d3d11_1.h>
+#include <memory>
 #include <string>
 #include <wrl/client.h>
 #include <d3d11shadertracing.h>
 
+#include "ConstantBufferRing.h"
+#include "StateTracker.h"
+
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
 
@@ -20,14 +24,38 @@ namespace Graphics
 	inline Microsoft::WRL::ComPtr<ID3D11DeviceContext1> Context1;
 	inline Microsoft::WRL::ComPtr<IDXGISwapChain> SwapChain;
 
+	// Everything bound through here is only sent to Context when it
+	// changes what's bound (see StateTracker)
+	inline std::shared_ptr<StateTracker> State;
+
 	// Rendering buffers
 	inline Microsoft::WRL::ComPtr<ID3D11RenderTargetView> BackBufferRTV;
 	inline Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DepthBufferDSV;
 
 	// Constant buffer
+	// - One big dynamic buffer, handed out a piece at a time by a
+	//    ConstantBufferRing, and replaced with a bigger one whenever
+	//    a frame needs more than the GPU has finished with
 	inline Microsoft::WRL::ComPtr<ID3D11Buffer> constantBufferHeap;
 	inline unsigned int cbHeapSizeInBytes;
-	inline unsigned int cbHeapOffsetInBytes;
+
+	// Counters for the constant buffer heap
+	// - Nothing here resets the first two; whoever reads them decides how often
+	inline unsigned int cbBytesUploaded;	// Requested by allocations
+	inline unsigned int cbMapCount;			// Times the heap was mapped
+	inline unsigned int cbHeapGrowCount;	// Times the heap was replaced with a bigger one
+
+	// A piece of the constant buffer heap, ready to be written to
+	// - Data points straight into the mapped heap, and is only good until
+	//    the next time any constant buffer is bound (or the frame ends)
+	// - FirstConstant and ConstantCount are in 16-byte shader constants
+	struct ConstantBufferAllocation
+	{
+		void* Data;
+		ID3D11Buffer* Buffer;
+		unsigned int FirstConstant;
+		unsigned int ConstantCount;
+	};
 
 	// Debug Layer
 	inline Microsoft::WRL::ComPtr<ID3D11InfoQueue> InfoQueue;
@@ -46,6 +74,9 @@ namespace Graphics
 		unsigned int dataSizeInBytes,
 		D3D11_SHADER_TYPE shaderType,
 		unsigned int registerSlot);
+	ConstantBufferAllocation AllocateConstantBuffer(unsigned int dataSizeInBytes);
+	void BindConstantBuffer(const ConstantBufferAllocation& allocation, D3D11_SHADER_TYPE shaderType, unsigned int registerSlot);
+	void EndConstantBufferFrame();
 
 	// Debug Layer
 	void PrintDebugMessages();
@@ -0,0 +1,74 @@
+#include "IndexPacking.h"
+
+// --------------------------------------------------------
+// Greedily fills each range with triangles, in order, until
+// the next one would need a 65537th vertex
+// - Triangles are assumed to already be in a cache/fetch
+//    friendly order (see MeshOptimizer), so neighboring
+//    triangles share most of their vertices and very few
+//    end up duplicated at range boundaries
+// --------------------------------------------------------
+void IndexPacking::Pack16(const unsigned int* indices, size_t indexCount, size_t vertexCount,
+	std::vector<unsigned short>& indices16, std::vector<IndexRange>& ranges, std::vector<unsigned int>& vertexOrder)
+{
+	indices16.resize(indexCount);
+	ranges.clear();
+	vertexOrder.clear();
+
+	// Everything fits in one range, so just narrow the indices
+	if (vertexCount <= MaxVerticesPerRange)
+	{
+		for (size_t i = 0; i < indexCount; i++)
+			indices16[i] = (unsigned short)indices[i];
+
+		ranges.push_back({ 0, (unsigned int)indexCount, 0 });
+		return;
+	}
+
+	// Which range each source vertex was last added to (0 = none yet),
+	// and its index within that range
+	std::vector<unsigned int> rangeStamp(vertexCount, 0);
+	std::vector<unsigned short> localIndex(vertexCount);
+	vertexOrder.reserve(vertexCount + vertexCount / 16);
+
+	IndexRange current = { 0, 0, 0 };
+	unsigned int stamp = 1;
+	unsigned int localCount = 0;
+	for (size_t t = 0; t + 2 < indexCount; t += 3)
+	{
+		// How many of this triangle's vertices are new to the range?
+		unsigned int a = indices[t];
+		unsigned int b = indices[t + 1];
+		unsigned int c = indices[t + 2];
+		unsigned int newVertices =
+			(rangeStamp[a] != stamp) +
+			(rangeStamp[b] != stamp && b != a) +
+			(rangeStamp[c] != stamp && c != a && c != b);
+
+		// Start a new range if they won't fit
+		if (localCount + newVertices > MaxVerticesPerRange)
+		{
+			ranges.push_back(current);
+			current.StartIndex = (unsigned int)t;
+			current.IndexCount = 0;
+			current.BaseVertex = (unsigned int)vertexOrder.size();
+			stamp++;
+			localCount = 0;
+		}
+
+		for (size_t corner = 0; corner < 3; corner++)
+		{
+			unsigned int v = indices[t + corner];
+			if (rangeStamp[v] != stamp)
+			{
+				rangeStamp[v] = stamp;
+				localIndex[v] = (unsigned short)localCount++;
+				vertexOrder.push_back(v);
+			}
+			indices16[t + corner] = localIndex[v];
+		}
+		current.IndexCount += 3;
+	}
+
+	ranges.push_back(current);
+}
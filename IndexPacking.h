@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// --------------------------------------------------------
+// A run of 16-bit indices that's drawn with its own base
+// vertex, so it can address 65536 vertices starting there
+// --------------------------------------------------------
+struct IndexRange
+{
+	unsigned int StartIndex;	// First index in the index buffer
+	unsigned int IndexCount;
+	unsigned int BaseVertex;	// Added to every index in the range
+};
+
+namespace IndexPacking
+{
+	// Most vertices a single 16-bit range can reach
+	const unsigned int MaxVerticesPerRange = 65536;
+
+	// Converts 32-bit indices to 16-bit indices plus the ranges to draw them
+	// - Meshes with up to 65536 vertices get one range and keep their vertices as-is
+	// - Larger meshes are split into ranges of whole triangles; each range's
+	//    vertices are copied out contiguously, in the order given by vertexOrder
+	//    (source vertex index per output vertex), so vertices shared between
+	//    ranges are duplicated
+	// - vertexOrder is left empty when the vertices don't need to change
+	void Pack16(const unsigned int* indices, size_t indexCount, size_t vertexCount,
+		std::vector<unsigned short>& indices16, std::vector<IndexRange>& ranges, std::vector<unsigned int>& vertexOrder);
+}
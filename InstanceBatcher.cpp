@@ -0,0 +1,47 @@
+#include "InstanceBatcher.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+InstanceBatcher::InstanceBatcher(unsigned int maxInstancesPerBatch) :
+	maxInstancesPerBatch{ std::max(maxInstancesPerBatch, 1u) }
+{
+}
+
+InstanceBatcher::~InstanceBatcher()
+{
+}
+
+void InstanceBatcher::Clear()
+{
+	batches.clear();
+	instances.clear();
+}
+
+void InstanceBatcher::Add(unsigned int mesh, unsigned int material, int lod,
+	const XMFLOAT4X4& world, const XMFLOAT4X4& worldInvTranspose)
+{
+	bool joinsLast = !batches.empty() &&
+		batches.back().Mesh == mesh &&
+		batches.back().Material == material &&
+		batches.back().Lod == lod &&
+		batches.back().InstanceCount < maxInstancesPerBatch;
+
+	if (joinsLast)
+		batches.back().InstanceCount++;
+	else
+		batches.push_back({ mesh, material, lod, (unsigned int)instances.size(), 1 });
+
+	instances.push_back({ world, worldInvTranspose });
+}
+
+const std::vector<InstanceBatch>& InstanceBatcher::GetBatches() const
+{
+	return batches;
+}
+
+const std::vector<InstanceData>& InstanceBatcher::GetInstances() const
+{
+	return instances;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <climits>
+#include <vector>
+
+#include "BufferStructs.h"
+
+// --------------------------------------------------------
+// A run of instances drawn with one DrawIndexedInstanced()
+// - Mesh and Material are whatever IDs the caller added
+//    them with (like handle values)
+// --------------------------------------------------------
+struct InstanceBatch
+{
+	unsigned int Mesh;
+	unsigned int Material;
+	int Lod;
+	unsigned int FirstInstance;		// Into GetInstances(), and the instance buffer it's copied to
+	unsigned int InstanceCount;
+};
+
+// --------------------------------------------------------
+// Groups draws that share a mesh, material and LOD into
+// batches, packing each draw's matrices into one array
+// ready to copy into an instance buffer
+// - Draws are grouped as they're added: one that matches
+//    the draw before it joins its batch, anything else
+//    starts a new one, so add them in sorted order (as
+//    DrawList gives them) to get the fewest batches
+// - Nothing here touches D3D, so it can be checked (and
+//    timed) on its own
+// --------------------------------------------------------
+class InstanceBatcher
+{
+public:
+	InstanceBatcher(unsigned int maxInstancesPerBatch = UINT_MAX);
+	~InstanceBatcher();
+
+	void Clear();
+	void Add(unsigned int mesh, unsigned int material, int lod,
+		const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInvTranspose);
+
+	const std::vector<InstanceBatch>& GetBatches() const;
+	const std::vector<InstanceData>& GetInstances() const;
+
+private:
+	unsigned int maxInstancesPerBatch;
+	std::vector<InstanceBatch> batches;
+	std::vector<InstanceData> instances;
+};
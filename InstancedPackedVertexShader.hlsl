@@ -0,0 +1,43 @@
+#include "ShaderIncludes.hlsli"
+
+// Description of constant buffer data
+// - Same as PackedVertexShader.hlsl, minus the matrices that come with each instance
+cbuffer PerObject : register(b2)
+{
+    float3 positionScale;
+    float3 positionOffset;
+}
+
+// --------------------------------------------------------
+// Instanced version of PackedVertexShader.hlsl
+//
+// - World matrices come from the instance buffer instead of
+//   the constant buffer, so one draw covers many entities
+// --------------------------------------------------------
+VertexToPixel main( PackedVertexShaderInput input, InstanceData instance )
+{
+	// Set up output struct
+	VertexToPixel output;
+
+	// Back to local space (a no-op scale and offset for float positions)
+    float3 localPosition = input.localPosition.xyz * positionScale + positionOffset;
+    float3 normal = OctahedralDecode(input.NormalTangent.xy);
+    float3 tangent = OctahedralDecode(input.NormalTangent.zw);
+
+    matrix world = InstanceMatrix(instance.World0, instance.World1, instance.World2, instance.World3);
+    matrix worldInvTranspose = InstanceMatrix(instance.WorldInvTranspose0, instance.WorldInvTranspose1, instance.WorldInvTranspose2, instance.WorldInvTranspose3);
+
+	// Create a WPV (world, projection, view) matrix from the world matrix and the camera's view-projection
+	// Because our C++ matrices are left-handed and HLSL matrices are right-handed, multiply them in the opposite order (VPW)
+    matrix wpv = mul(viewProjection, world);
+
+    output.screenPosition = mul(wpv, float4(localPosition, 1.0f));
+
+	// Pass through UVs and surface normals
+    output.UV = input.UV;
+    output.Normal = mul((float3x3)worldInvTranspose, normal);
+    output.worldPosition = mul(world, float4(localPosition, 1)).xyz;
+    output.Tangent = mul((float3x3)world, tangent);
+
+	return output;
+}
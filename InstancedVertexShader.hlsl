@@ -0,0 +1,34 @@
+#include "ShaderIncludes.hlsli"
+
+// No constant buffer of its own
+// - The camera's matrices are in PerFrame (see ShaderIncludes.hlsli),
+//    and the world matrices come with each instance
+
+// --------------------------------------------------------
+// Instanced version of VertexShader.hlsl
+//
+// - World matrices come from the instance buffer instead of
+//   the constant buffer, so one draw covers many entities
+// --------------------------------------------------------
+VertexToPixel main( VertexShaderInput input, InstanceData instance )
+{
+	// Set up output struct
+	VertexToPixel output;
+
+    matrix world = InstanceMatrix(instance.World0, instance.World1, instance.World2, instance.World3);
+    matrix worldInvTranspose = InstanceMatrix(instance.WorldInvTranspose0, instance.WorldInvTranspose1, instance.WorldInvTranspose2, instance.WorldInvTranspose3);
+
+	// Create a WPV (world, projection, view) matrix from the world matrix and the camera's view-projection
+	// Because our C++ matrices are left-handed and HLSL matrices are right-handed, multiply them in the opposite order (VPW)
+    matrix wpv = mul(viewProjection, world);
+
+    output.screenPosition = mul(wpv, float4(input.localPosition, 1.0f));
+
+	// Pass through UVs and surface normals
+    output.UV = input.UV;
+    output.Normal = mul((float3x3)worldInvTranspose, input.Normal);
+    output.worldPosition = mul(world, float4(input.localPosition, 1)).xyz;
+    output.Tangent = mul((float3x3)world, input.Tangent);
+
+	return output;
+}
@@ -0,0 +1,110 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// --------------------------------------------------------
+// Opens and maps the given file for reading
+// - Check IsOpen() afterwards; a missing or unreadable
+//    file leaves the object in a closed state
+// - Empty files are "open" with a size of zero, since
+//    neither OS allows mapping zero bytes
+// --------------------------------------------------------
+MappedFile::MappedFile(const char* path) :
+	data{ nullptr },
+	size{ 0 },
+	isOpen{ false }
+{
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = nullptr;
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	fileHandle = file;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize))
+		return;
+
+	size = (size_t)fileSize.QuadPart;
+	if (size == 0)
+	{
+		isOpen = true;
+		return;
+	}
+
+	mappingHandle = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mappingHandle)
+		return;
+
+	data = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	isOpen = data != nullptr;
+#else
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+		return;
+
+	struct stat fileInfo = {};
+	if (fstat(file, &fileInfo) == 0)
+	{
+		size = (size_t)fileInfo.st_size;
+		if (size == 0)
+		{
+			isOpen = true;
+		}
+		else
+		{
+			void* mapped = mmap(0, size, PROT_READ, MAP_PRIVATE, file, 0);
+			if (mapped != MAP_FAILED)
+			{
+				// We'll be reading front to back
+				madvise(mapped, size, MADV_SEQUENTIAL);
+				data = (const char*)mapped;
+				isOpen = true;
+			}
+		}
+	}
+
+	// The mapping stays valid after the descriptor is closed
+	close(file);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	if (data)
+		UnmapViewOfFile(data);
+	if (mappingHandle)
+		CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+#else
+	if (data)
+		munmap((void*)data, size);
+#endif
+}
+
+bool MappedFile::IsOpen()
+{
+	return isOpen;
+}
+
+const char* MappedFile::GetData()
+{
+	return data;
+}
+
+size_t MappedFile::GetSize()
+{
+	return size;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+
+// --------------------------------------------------------
+// A read-only, memory-mapped view of an entire file
+//
+// - The file's bytes are available through GetData() for
+//    as long as this object is alive
+// - Works on Windows (file mapping objects) and on POSIX
+//    systems (mmap), so CPU-side loaders can run anywhere
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile(const char* path);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete; // Remove copy constructor
+	MappedFile& operator=(const MappedFile&) = delete; // Remove copy-assignment operator
+
+	bool IsOpen();
+	const char* GetData();
+	size_t GetSize();
+
+private:
+	const char* data;
+	size_t size;
+	bool isOpen;
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#endif
+};
@@ -27,9 +27,9 @@ void Material::SetColorTint(DirectX::XMFLOAT4 newColorTint)
 	myColorTint = newColorTint;
 }
 
-Microsoft::WRL::ComPtr<ID3D11VertexShader> Material::GetVertexShader()
+ID3D11VertexShader* Material::GetVertexShader()
 {
-	return myVertexShader;
+	return myVertexShader.Get();
 }
 
 void Material::SetVertexShader(Microsoft::WRL::ComPtr<ID3D11VertexShader> newVertexShader)
@@ -37,9 +37,9 @@ void Material::SetVertexShader(Microsoft::WRL::ComPtr<ID3D11VertexShader> newVer
 	myVertexShader = newVertexShader;
 }
 
-Microsoft::WRL::ComPtr<ID3D11PixelShader> Material::GetPixelShader()
+ID3D11PixelShader* Material::GetPixelShader()
 {
-	return myPixelShader;
+	return myPixelShader.Get();
 }
 
 void Material::SetPixelShader(Microsoft::WRL::ComPtr<ID3D11PixelShader> newPixelShader)
@@ -47,7 +47,7 @@ void Material::SetPixelShader(Microsoft::WRL::ComPtr<ID3D11PixelShader> newPixel
 	myPixelShader = newPixelShader;
 }
 
-void Material::AddTextureSRV(unsigned int slot, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textureSRV)
+void Material::AddTextureSRV(unsigned int slot, TextureHandle textureSRV)
 {
 	textureSRVs[slot] = textureSRV;
 }
@@ -57,16 +57,22 @@ void Material::AddSamplerState(unsigned int slot, Microsoft::WRL::ComPtr<ID3D11S
 	samplers[slot] = sampler;
 }
 
-void Material::BindTexturesAndSamplers()
+// --------------------------------------------------------
+// Binds through Graphics::State, so slots that already hold
+// the same thing are skipped, and the rest are sent together
+// at the next draw
+// --------------------------------------------------------
+void Material::BindTexturesAndSamplers(const TexturePool& textures)
 {
-	for (const auto& [slot, srv] : textureSRVs)
+	for (const auto& [slot, handle] : textureSRVs)
 	{
-		Graphics::Context->PSSetShaderResources(slot, 1, srv.GetAddressOf());
+		const Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* srv = textures.Get(handle);
+		Graphics::State->SetShaderResource(D3D11_PIXEL_SHADER, slot, srv ? srv->Get() : nullptr);
 	}
 
 	for (const auto& [slot, sampler] : samplers)
 	{
-		Graphics::Context->PSSetSamplers(slot, 1, sampler.GetAddressOf());
+		Graphics::State->SetSampler(D3D11_PIXEL_SHADER, slot, sampler.Get());
 	}
 }
 
@@ -4,6 +4,12 @@
 #include <d3d11.h>
 #include <unordered_map>
 
+#include "ResourcePool.h"
+
+// Textures live in a pool, and materials refer to them by handle
+using TextureHandle = ResourceHandle<ID3D11ShaderResourceView>;
+using TexturePool = ResourcePool<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>, ID3D11ShaderResourceView>;
+
 class Material
 {
 public:
@@ -12,20 +18,25 @@ public:
 		Microsoft::WRL::ComPtr<ID3D11VertexShader> vertexShader,
 		Microsoft::WRL::ComPtr<ID3D11PixelShader> pixelShader);
 	~Material();
+	Material(Material&&) = default;
+	Material& operator=(Material&&) = default;
 
 	DirectX::XMFLOAT4 GetColorTint();
 	void SetColorTint(DirectX::XMFLOAT4 newColorTint);
 
-	Microsoft::WRL::ComPtr<ID3D11VertexShader> GetVertexShader();
+	// Shaders are returned without adding a reference, since these are
+	// called for every draw
+	ID3D11VertexShader* GetVertexShader();
 	void SetVertexShader(Microsoft::WRL::ComPtr<ID3D11VertexShader> newVertexShader);
 
-	Microsoft::WRL::ComPtr<ID3D11PixelShader> GetPixelShader();
+	ID3D11PixelShader* GetPixelShader();
 	void SetPixelShader(Microsoft::WRL::ComPtr<ID3D11PixelShader> newPixelShader);
 
-	void AddTextureSRV(unsigned int slot, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textureSRV);
+	void AddTextureSRV(unsigned int slot, TextureHandle textureSRV);
 	void AddSamplerState(unsigned int slot, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler);
 
-	void BindTexturesAndSamplers();
+	// Textures whose handles have gone stale are unbound
+	void BindTexturesAndSamplers(const TexturePool& textures);
 
 	void SetTextureScale(DirectX::XMFLOAT2 scale);
 	DirectX::XMFLOAT2 GetTextureScale();
@@ -38,7 +49,7 @@ private:
 	DirectX::XMFLOAT4 myColorTint;
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> myVertexShader;
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> myPixelShader;
-	std::unordered_map<unsigned int, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs;
+	std::unordered_map<unsigned int, TextureHandle> textureSRVs;
 	std::unordered_map<unsigned int, Microsoft::WRL::ComPtr<ID3D11SamplerState>> samplers;
 	DirectX::XMFLOAT2 textureScale;
 	DirectX::XMFLOAT2 textureOffset;
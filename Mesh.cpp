@@ -1,9 +1,19 @@
 #include "Mesh.h"
 #include "Graphics.h"
-
+#include "IndexPacking.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MeshData.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "OcclusionCuller.h"
+#include "PackedVertex.h"
+
+#include <algorithm>
+#include <chrono>
 #include <string>
-#include <fstream>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 #include <DirectXMath.h>
 
@@ -14,329 +24,176 @@ Mesh::Mesh(Vertex* vertices, unsigned int* indices, unsigned int vertexCount, un
 	// Assign values to private fields
 	vertexBufferCount = vertexCount;
 	indexBufferCount = indexCount;
-
-	// Store mesh name
-	meshName = name;
-
-	// Create a VERTEX BUFFER
-	// - This holds the vertex data of triangles for a single object
-	// - This buffer is created on the GPU, which is where the data needs to
-	//    be if we want the GPU to act on it (as in: draw it to the screen)
+	unweldedVertexCount = vertexCount;
+	vertexFormat = VertexFormat::Full;
+	loadedFromCache = false;
+	loadTime = 0.0f;
+	optimizationStats = {};
+	lods.assign(1, { 0, indexCount, 0.0f });
+
+	// Find the local-space bounding box
+	XMVECTOR minimum = XMLoadFloat3(&vertices[0].Position);
+	XMVECTOR maximum = minimum;
+	for (unsigned int i = 1; i < vertexCount; i++)
 	{
-		// First, we need to describe the buffer we want Direct3D to make on the GPU
-		//  - Note that this variable is created on the stack since we only need it once
-		//  - After the buffer is created, this description variable is unnecessary
-		D3D11_BUFFER_DESC vbd = {};
-		vbd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		vbd.ByteWidth = sizeof(Vertex) * vertexBufferCount; // If Vertex is 7 bytes and we have 3 Vertices, ByteWidth should be 7 * 3 = 21 bytes
-		vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells Direct3D this is a vertex buffer
-		vbd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
-		vbd.MiscFlags = 0;
-		vbd.StructureByteStride = 0;
-
-		// Create the proper struct to hold the initial vertex data
-		// - This is how we initially fill the buffer with data
-		// - Essentially, we're specifying a pointer to the data to copy
-		D3D11_SUBRESOURCE_DATA initialVertexData = {};
-		initialVertexData.pSysMem = vertices; // pSysMem = Pointer to System Memory
-
-		// Actually create the buffer on the GPU with the initial data
-		// - Once we do this, we'll NEVER CHANGE DATA IN THE BUFFER AGAIN
-		Graphics::Device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
+		XMVECTOR position = XMLoadFloat3(&vertices[i].Position);
+		minimum = XMVectorMin(minimum, position);
+		maximum = XMVectorMax(maximum, position);
 	}
+	XMStoreFloat3(&boundsMin, minimum);
+	XMStoreFloat3(&boundsMax, maximum);
 
-	// Create an INDEX BUFFER
-	// - This holds indices to elements in the vertex buffer
-	// - This is most useful when vertices are shared among neighboring triangles
-	// - This buffer is created on the GPU, which is where the data needs to
-	//    be if we want the GPU to act on it (as in: draw it to the screen)
-	{
-		// Describe the buffer, as we did above, with two major differences
-		//  - Byte Width (x unsigned integers vs. y whole vertices)
-		//  - Bind Flag (used as an index buffer instead of a vertex buffer) 
-		D3D11_BUFFER_DESC ibd = {};
-		ibd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		ibd.ByteWidth = sizeof(unsigned int) * indexBufferCount; // We use sizeof() here even though uint size won't change, because it's more readable. NO MAGIC NUMBERS!
-		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;	// Tells Direct3D this is an index buffer
-		ibd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
-		ibd.MiscFlags = 0;
-		ibd.StructureByteStride = 0;
-
-		// Specify the initial data for this buffer, similar to above
-		D3D11_SUBRESOURCE_DATA initialIndexData = {};
-		initialIndexData.pSysMem = indices; // pSysMem = Pointer to System Memory
+	// Store mesh name
+	meshName = name;
 
-		// Actually create the buffer with the initial data
-		// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-		Graphics::Device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
-	}
+	MeshletBuilder::Build(vertices, vertexCount, indices, indexCount, meshlets);
+	OcclusionCuller::BuildOccluder(vertices, indices, lods.data(), lods.size(), occluder);
+	triangleBvh.Build(vertices, indices, indexCount);
+	CreateBuffers(vertices, indices);
 }
 
-Mesh::Mesh(const char* meshPath, std::string name)
+Mesh::Mesh(const char* meshPath, std::string name, VertexFormat format, unsigned int parseThreads)
 {
-	// Author: Chris Cascioli
-// Purpose: Basic .OBJ 3D model loading, supporting positions, uvs and normals
-// 
-// - You are allowed to directly copy/paste this into your code base
-//   for assignments, given that you clearly cite that this is not
-//   code of your own design.
-
-// *************************************
-//      IMPLEMENTATION NOTES (1/2)
-//
-//  - You'll need to #include both
-//      <fstream> and <stdexcept>
-//
-//  - You will need to integrate
-//      this code into a function or
-//      constructor of your own making
-//
-//  - There is MORE TO DO after pasting 
-//      this code in - see the bottom for
-//      what to do *after* including 
-//      this code in your mesh class
-//
-// *************************************
-
-// File input object
-	std::ifstream obj(meshPath);
+	auto loadStart = std::chrono::high_resolution_clock::now();
+
+	// Store mesh name and the layout its vertex buffer will use
+	meshName = name;
+	vertexFormat = format;
+
+	// Map the whole file into memory so it can be parsed in place,
+	// with no line buffer or per-line copies
+	MappedFile obj(meshPath);
 
 	// Check for successful open
-	if (!obj.is_open())
+	if (!obj.IsOpen())
 		throw std::invalid_argument("Error opening file: Invalid file path or file is inaccessible");
 
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;	// Positions from the file
-	std::vector<XMFLOAT3> normals;		// Normals from the file
-	std::vector<XMFLOAT2> uvs;		// UVs from the file
-	std::vector<Vertex> verts;		// Verts we're assembling
-	std::vector<UINT> indices;		// Indices of these verts
-	int vertCounter = 0;			// Count of vertices
-	int indexCounter = 0;			// Count of indices
-	char chars[100];			// String for line reading
-
-	// Still have data left?
-	while (obj.good())
-	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
+	// The cache is only trusted if it was built from these exact bytes
+	unsigned long long sourceHash = MeshCache::HashBytes(obj.GetData(), obj.GetSize());
+	std::string cachePath = MeshCache::GetCachePath(meshPath);
 
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
-		}
-		else if (chars[0] == 'f')
+	// Try the .meshbin cache first, which skips parsing, welding,
+	// optimizing and LOD simplification
+	// - The OBJ is still hashed to check the cache is current
+	// - Meshlets, the occluder, the triangle BVH and the packed
+	//    16-bit GPU buffers aren't cached; they're rebuilt here
+	//    from the mapped vertices and indices on every load
+	{
+		MappedFile cache(cachePath.c_str());
+		MeshCacheView view;
+		if (cache.IsOpen() && MeshCache::Read(cache.GetData(), cache.GetSize(), sourceHash, view))
 		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			unsigned int i[12];
-			int numbersRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// If we only got the first number, chances are the OBJ
-			// file has no UV coordinates.  This isn't great, but we
-			// still want to load the model without crashing, so we
-			// need to re-read a different pattern (in which we assume
-			// there are no UVs denoted for any of the vertices)
-			if (numbersRead == 1)
-			{
-				// Re-read with a different pattern
-				numbersRead = sscanf_s(
-					chars,
-					"f %d//%d %d//%d %d//%d %d//%d",
-					&i[0], &i[2],
-					&i[3], &i[5],
-					&i[6], &i[8],
-					&i[9], &i[11]);
-
-				// The following indices are where the UVs should 
-				// have been, so give them a valid value
-				i[1] = 1;
-				i[4] = 1;
-				i[7] = 1;
-				i[10] = 1;
-
-				// If we have no UVs, create a single UV coordinate
-				// that will be used for all vertices
-				if (uvs.size() == 0)
-					uvs.push_back(XMFLOAT2(0, 0));
-			}
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal's Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-			vertCounter += 3;
-
-			// Add three more indices
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-
-			// Was there a 4th face?
-			// - 12 numbers read means 4 faces WITH uv's
-			// - 8 numbers read means 4 faces WITHOUT uv's
-			if (numbersRead == 12 || numbersRead == 8)
-			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal's Z
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-				vertCounter += 3;
-
-				// Add three more indices
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-			}
+			vertexBufferCount = view.VertexCount;
+			indexBufferCount = view.IndexCount;
+			unweldedVertexCount = view.UnweldedVertexCount;
+			boundsMin = view.BoundsMin;
+			boundsMax = view.BoundsMax;
+			optimizationStats = view.OptimizationStats;
+			lods.assign(view.Lods, view.Lods + view.LodCount);
+			loadedFromCache = true;
+
+			MeshletBuilder::Build(view.Vertices, view.VertexCount, view.Indices, lods[0].IndexCount, meshlets);
+			OcclusionCuller::BuildOccluder(view.Vertices, view.Indices, view.Lods, view.LodCount, occluder);
+			triangleBvh.Build(view.Vertices, view.Indices, lods[0].IndexCount);
+			CreateBuffers(view.Vertices, view.Indices);
+
+			loadTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count();
+			return;
 		}
 	}
 
-	// Close the file and create the actual buffers
-	obj.close();
-
-	// *************************************
-	//      IMPLEMENTATION NOTES (2/2)
-	//
-	// - At this point, "verts" is a std::vector 
-	//     of Vertex structs, and can be used
-	//     to create your mesh's vertex buffer
-	//
-	// - NOTE: Use &verts[0] for the address of 
-	//     the first vertx, NOT JUST &verts
-	//
-	// - The vector "indices" is similar. It's 
-	//     a std::vector of unsigned ints and
-	//     can be used to create the index 
-	//     buffer (again, &indices[0] is the 
-	//     address of the first integer)
-	//
-	// - Make sure your mesh class actually SAVES
-	//     the number of vertices and indices, or
-	//     drawing may have unintended problems.
-	//     - "vertCounter" is the number of vertices
-	//     - "indexCounter" is the number of indices
-	//
-	// - If you dig into the code, you may notice 
-	//     that  "vertCounter" and "indexCounter" 
-	//     end up being the same.  Recall that OBJs 
-	//     do not index entire vertices, making
-	//     it complex to detect duplicate vertices.
-	//     This also means an index buffer isn't
-	//     doing much for us.  We could try to 
-	//     detect duplicate vertices ourselves, 
-	//     but at that point it would be better 
-	//     to use a more sophisticated mesh loading
-	//     library like TinyOBJLoader or 
-	//     The Open Asset Importer Library, both
-	//     of which are unnecessary for now.
-	//
-	// *************************************
+	// Missing or stale cache, so parse the OBJ
+	// - Large files are split into chunks parsed on parseThreads threads
+	MeshData data;
+	MeshLoader::LoadObj(obj.GetData(), obj.GetSize(), data, parseThreads > 0 ? parseThreads : std::thread::hardware_concurrency());
+
+	// Reorder triangles and vertices for the GPU's caches and
+	// to reduce overdraw (OBJ face order is arbitrary)
+	MeshOptimizer::Optimize(data);
+
+	// Add lower detail LODs after the full mesh's indices, all
+	// drawing from the same vertices
+	MeshSimplifier::BuildLods(data);
 
 	// Assign values to private fields
-	vertexBufferCount = vertCounter;
-	indexBufferCount = indexCounter;
+	vertexBufferCount = (unsigned int)data.vertices.size();
+	indexBufferCount = (unsigned int)data.indices.size();
+	unweldedVertexCount = data.unweldedVertexCount;
+	boundsMin = data.boundsMin;
+	boundsMax = data.boundsMax;
+	optimizationStats = data.optimizationStats;
+	lods = data.lods;
+	loadedFromCache = false;
+
+	// Save the results for next time
+	// - Failing to write (read-only folder, etc.) isn't an error,
+	//    we'll just parse again on the next run
+	MeshCache::Write(cachePath, sourceHash, data);
+
+	// Split into meshlets after optimizing, so they follow its triangle order
+	MeshletBuilder::Build(data.vertices.data(), data.vertices.size(), data.indices.data(), lods[0].IndexCount, meshlets);
+	OcclusionCuller::BuildOccluder(data.vertices.data(), data.indices.data(), data.lods.data(), data.lods.size(), occluder);
+	triangleBvh.Build(data.vertices.data(), data.indices.data(), lods[0].IndexCount);
+	CreateBuffers(&data.vertices[0], &data.indices[0]);
+
+	loadTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count();
+}
 
-	// Store mesh name
-	meshName = name;
+Mesh::~Mesh()
+{
+	// We don't need to do anything here (for now)!
+	// The only objects we'd care about deleting (vertexBuffer and indexBuffer) are managed by ComPtrs,
+	// which automatically release/delete their resources when they exit scope.
+	// But I'm still including this empty shell in case it's needed later!
+}
+
+// --------------------------------------------------------
+// Creates the GPU vertex and index buffers from CPU-side data
+// - vertexBufferCount, indexBufferCount, vertexFormat and the
+//    bounds must already be set
+// - Indices are narrowed to 16 bits, which may split very
+//    large meshes into ranges (duplicating a few vertices)
+// - Vertices are packed first if the mesh uses a packed format
+// --------------------------------------------------------
+void Mesh::CreateBuffers(const Vertex* vertices, const unsigned int* indices)
+{
+	std::vector<unsigned short> indices16;
+	std::vector<unsigned int> vertexOrder;
+	IndexPacking::Pack16(indices, indexBufferCount, vertexBufferCount, indices16, indexRanges, vertexOrder);
+
+	// Gather each range's vertices together if the mesh had to be split
+	std::vector<Vertex> rangeVertices;
+	duplicatedVertexCount = 0;
+	if (!vertexOrder.empty())
+	{
+		rangeVertices.resize(vertexOrder.size());
+		for (size_t i = 0; i < vertexOrder.size(); i++)
+			rangeVertices[i] = vertices[vertexOrder[i]];
+
+		duplicatedVertexCount = (unsigned int)vertexOrder.size() - vertexBufferCount;
+		vertexBufferCount = (unsigned int)vertexOrder.size();
+		vertices = rangeVertices.data();
+	}
 
-	// Calculate tangent vectors for each Vertex
-	Mesh::CalculateTangents(&verts[0], vertexBufferCount, &indices[0], indexBufferCount);
+	vertexStride = VertexPacking::GetStride(vertexFormat);
+	dequantize = VertexPacking::GetDequantize(vertexFormat, boundsMin, boundsMax);
+
+	// Only one of these is used, depending on the format
+	std::vector<PackedVertex> packed;
+	std::vector<PackedVertexFloatPosition> packedFloatPosition;
+	const void* vertexData = vertices;
+	if (vertexFormat == VertexFormat::Packed)
+	{
+		packed.resize(vertexBufferCount);
+		VertexPacking::Pack(vertices, vertexBufferCount, dequantize, packed.data());
+		vertexData = packed.data();
+	}
+	else if (vertexFormat == VertexFormat::PackedFloatPosition)
+	{
+		packedFloatPosition.resize(vertexBufferCount);
+		VertexPacking::Pack(vertices, vertexBufferCount, packedFloatPosition.data());
+		vertexData = packedFloatPosition.data();
+	}
 
 	// Create a VERTEX BUFFER
 	// - This holds the vertex data of triangles for a single object
@@ -348,7 +205,7 @@ Mesh::Mesh(const char* meshPath, std::string name)
 		//  - After the buffer is created, this description variable is unnecessary
 		D3D11_BUFFER_DESC vbd = {};
 		vbd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		vbd.ByteWidth = sizeof(Vertex) * vertexBufferCount; // If Vertex is 7 bytes and we have 3 Vertices, ByteWidth should be 7 * 3 = 21 bytes
+		vbd.ByteWidth = vertexStride * vertexBufferCount; // If Vertex is 7 bytes and we have 3 Vertices, ByteWidth should be 7 * 3 = 21 bytes
 		vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells Direct3D this is a vertex buffer
 		vbd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
 		vbd.MiscFlags = 0;
@@ -358,7 +215,7 @@ Mesh::Mesh(const char* meshPath, std::string name)
 		// - This is how we initially fill the buffer with data
 		// - Essentially, we're specifying a pointer to the data to copy
 		D3D11_SUBRESOURCE_DATA initialVertexData = {};
-		initialVertexData.pSysMem = &verts[0]; // pSysMem = Pointer to System Memory
+		initialVertexData.pSysMem = vertexData; // pSysMem = Pointer to System Memory
 
 		// Actually create the buffer on the GPU with the initial data
 		// - Once we do this, we'll NEVER CHANGE DATA IN THE BUFFER AGAIN
@@ -376,7 +233,7 @@ Mesh::Mesh(const char* meshPath, std::string name)
 		//  - Bind Flag (used as an index buffer instead of a vertex buffer) 
 		D3D11_BUFFER_DESC ibd = {};
 		ibd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		ibd.ByteWidth = sizeof(unsigned int) * indexBufferCount; // We use sizeof() here even though uint size won't change, because it's more readable. NO MAGIC NUMBERS!
+		ibd.ByteWidth = sizeof(unsigned short) * indexBufferCount; // We use sizeof() here even though ushort size won't change, because it's more readable. NO MAGIC NUMBERS!
 		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;	// Tells Direct3D this is an index buffer
 		ibd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
 		ibd.MiscFlags = 0;
@@ -384,7 +241,7 @@ Mesh::Mesh(const char* meshPath, std::string name)
 
 		// Specify the initial data for this buffer, similar to above
 		D3D11_SUBRESOURCE_DATA initialIndexData = {};
-		initialIndexData.pSysMem = &indices[0]; // pSysMem = Pointer to System Memory
+		initialIndexData.pSysMem = indices16.data(); // pSysMem = Pointer to System Memory
 
 		// Actually create the buffer with the initial data
 		// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
@@ -392,95 +249,33 @@ Mesh::Mesh(const char* meshPath, std::string name)
 	}
 }
 
-Mesh::~Mesh()
-{
-	// We don't need to do anything here (for now)!
-	// The only objects we'd care about deleting (vertexBuffer and indexBuffer) are managed by ComPtrs,
-	// which automatically release/delete their resources when they exit scope.
-	// But I'm still including this empty shell in case it's needed later!
-}
-
 // --------------------------------------------------------
 // Calculates the tangents of the vertices in a mesh
-// - Code originally adapted from: http://www.terathon.com/code/tangent.html
-// - Updated version found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
-// - See listing 7.4 in section 7.5 (page 9 of the PDF)
-//
-// - Note: For this code to work, your Vertex format must
-// contain an XMFLOAT3 called Tangent
-//
-// - Be sure to call this BEFORE creating your D3D vertex/index buffers
+// - See MeshLoader::CalculateTangents
 // --------------------------------------------------------
 void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
 {
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
-	{
-		verts[i].Tangent = XMFLOAT3(0, 0, 0);
-	}
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numIndices;)
-	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->UV.x - v1->UV.x;
-		float t1 = v2->UV.y - v1->UV.y;
-		float s2 = v3->UV.x - v1->UV.x;
-		float t2 = v3->UV.y - v1->UV.y;
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-		// Adjust tangents of each vert of the triangle
-		v1->Tangent.x += tx;
-		v1->Tangent.y += ty;
-		v1->Tangent.z += tz;
-		v2->Tangent.x += tx;
-		v2->Tangent.y += ty;
-		v2->Tangent.z += tz;
-		v3->Tangent.x += tx;
-		v3->Tangent.y += ty;
-		v3->Tangent.z += tz;
-	}
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
-	{
-		// Grab the two vectors
-		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
-		XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
-		// Use Gram-Schmidt orthonormalize to ensure
-		// the normal and tangent are exactly 90 degrees apart
-		tangent = XMVector3Normalize(
-			tangent - normal * XMVector3Dot(normal, tangent));
-		// Store the tangent
-		XMStoreFloat3(&verts[i].Tangent, tangent);
-	}
+	MeshLoader::CalculateTangents(verts, numVerts, indices, numIndices);
 }
 
 // ------------------------------------------------------------------------
 // Swaps vertex & index buffers, then draws. ONLY draw this Mesh's geometry
+// - lod picks which level of detail to draw (0 is full detail)
 // ------------------------------------------------------------------------
-void Mesh::Draw()
+void Mesh::Draw(int lod)
 {
+	const MeshLod& level = lods[std::clamp(lod, 0, (int)lods.size() - 1)];
+	unsigned int lodStart = level.StartIndex;
+	unsigned int lodEnd = level.StartIndex + level.IndexCount;
+
 	// Set buffers in the input assembler (IA) stage
-	UINT stride = sizeof(Vertex);
+	UINT stride = vertexStride;
 	UINT offset = 0;
 	Graphics::Context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-	Graphics::Context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	Graphics::Context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+
+	// Send any textures, samplers and constant buffers still waiting to be bound
+	Graphics::State->Flush();
 
 	// Tell Direct3D to draw
 	//  - Begins the rendering pipeline on the GPU
@@ -488,10 +283,54 @@ void Mesh::Draw()
 	//  - This will use all currently set Direct3D resources (shaders, buffers, etc)
 	//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
 	//     vertices in the currently set VERTEX BUFFER
-	Graphics::Context->DrawIndexed(
-		indexBufferCount,	// The number of indices to use (we could draw a subset if we wanted)
-		0,					// Offset to the first index we want to use
-		0);					// Offset to add to each index when looking up vertices
+	//  - Meshes with more than 65536 vertices need one draw per range
+	//  - Only the part of each range inside the LOD is drawn
+	for (const IndexRange& range : indexRanges)
+	{
+		unsigned int start = std::max(range.StartIndex, lodStart);
+		unsigned int end = std::min(range.StartIndex + range.IndexCount, lodEnd);
+		if (start >= end)
+			continue;
+
+		Graphics::Context->DrawIndexed(
+			end - start,		// The number of indices to use
+			start,				// Offset to the first index we want to use
+			range.BaseVertex);	// Offset to add to each index when looking up vertices
+	}
+}
+
+// ------------------------------------------------------------------------
+// Draws instanceCount copies of this Mesh in as few draws as possible
+// - Only binds vertex buffer slot 0; the instance buffer (slot 1) is
+//    up to the caller, starting at startInstance
+// ------------------------------------------------------------------------
+void Mesh::DrawInstanced(unsigned int instanceCount, unsigned int startInstance, int lod)
+{
+	const MeshLod& level = lods[std::clamp(lod, 0, (int)lods.size() - 1)];
+	unsigned int lodStart = level.StartIndex;
+	unsigned int lodEnd = level.StartIndex + level.IndexCount;
+
+	UINT stride = vertexStride;
+	UINT offset = 0;
+	Graphics::Context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
+	Graphics::Context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+	Graphics::State->Flush();
+
+	// Still one draw per index range, but each covers every instance
+	for (const IndexRange& range : indexRanges)
+	{
+		unsigned int start = std::max(range.StartIndex, lodStart);
+		unsigned int end = std::min(range.StartIndex + range.IndexCount, lodEnd);
+		if (start >= end)
+			continue;
+
+		Graphics::Context->DrawIndexedInstanced(
+			end - start,
+			instanceCount,
+			start,
+			range.BaseVertex,
+			startInstance);
+	}
 }
 
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer()
@@ -512,4 +351,111 @@ int Mesh::GetIndexCount()
 int Mesh::GetVertexCount()
 {
 	return vertexBufferCount;
-}
\ No newline at end of file
+}
+
+int Mesh::GetUnweldedVertexCount()
+{
+	return unweldedVertexCount;
+}
+
+DirectX::XMFLOAT3 Mesh::GetBoundsMin()
+{
+	return boundsMin;
+}
+
+DirectX::XMFLOAT3 Mesh::GetBoundsMax()
+{
+	return boundsMax;
+}
+
+bool Mesh::WasLoadedFromCache()
+{
+	return loadedFromCache;
+}
+
+float Mesh::GetLoadTime()
+{
+	return loadTime;
+}
+
+MeshOptimizationStats Mesh::GetOptimizationStats()
+{
+	return optimizationStats;
+}
+
+VertexFormat Mesh::GetVertexFormat()
+{
+	return vertexFormat;
+}
+
+PackedVertexDequantize Mesh::GetDequantize()
+{
+	return dequantize;
+}
+
+unsigned int Mesh::GetVertexBufferSize()
+{
+	return vertexStride * vertexBufferCount;
+}
+
+unsigned int Mesh::GetIndexBufferSize()
+{
+	return sizeof(unsigned short) * indexBufferCount;
+}
+
+int Mesh::GetIndexRangeCount()
+{
+	return (int)indexRanges.size();
+}
+
+int Mesh::GetDuplicatedVertexCount()
+{
+	return duplicatedVertexCount;
+}
+
+const MeshletData& Mesh::GetMeshlets()
+{
+	return meshlets;
+}
+
+const OccluderMesh& Mesh::GetOccluder()
+{
+	return occluder;
+}
+
+const MeshBvh& Mesh::GetTriangleBvh()
+{
+	return triangleBvh;
+}
+
+int Mesh::GetLodCount()
+{
+	return (int)lods.size();
+}
+
+int Mesh::GetLodIndexCount(int lod)
+{
+	return lods[std::clamp(lod, 0, (int)lods.size() - 1)].IndexCount;
+}
+
+float Mesh::GetLodError(int lod)
+{
+	return lods[std::clamp(lod, 0, (int)lods.size() - 1)].Error;
+}
+
+// --------------------------------------------------------
+// Picks the lowest detail LOD whose error would still be
+// smaller than maxPixelError on screen
+// - pixelsPerUnit is how many pixels one local-space unit
+//    of this mesh covers, where it's being drawn
+// --------------------------------------------------------
+int Mesh::ChooseLod(float pixelsPerUnit, float maxPixelError)
+{
+	float extent = std::max({ boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z });
+	for (int lod = (int)lods.size() - 1; lod > 0; lod--)
+	{
+		if (lods[lod].Error * extent * pixelsPerUnit <= maxPixelError)
+			return lod;
+	}
+	return 0;
+}
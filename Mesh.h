@@ -3,7 +3,14 @@
 #include <d3d11.h>
 #include <wrl/client.h>
 #include<string>
+#include <vector>
 
+#include "IndexPacking.h"
+#include "MeshBvh.h"
+#include "MeshData.h"
+#include "MeshletBuilder.h"
+#include "OcclusionCuller.h"
+#include "PackedVertex.h"
 #include "Vertex.h"
 
 // ---------------------------------------------------------------------
@@ -13,30 +20,96 @@ class Mesh
 {
 public:
 	Mesh(Vertex* vertices, unsigned int* indices, unsigned int vertexCount, unsigned int indexCount, std::string name = "Unnamed Mesh");
-	Mesh(const char* meshPath, std::string name = "Unnamed Mesh");
+	// parseThreads is how many threads a large OBJ is parsed on (0 for every
+	// core); meshes loaded side by side should split the cores between them
+	Mesh(const char* meshPath, std::string name = "Unnamed Mesh", VertexFormat format = VertexFormat::Full, unsigned int parseThreads = 0);
 	~Mesh();
+	Mesh(Mesh&&) = default;
+	Mesh& operator=(Mesh&&) = default;
 
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
 
-	void Draw();
+	void Draw(int lod = 0);
+	void DrawInstanced(unsigned int instanceCount, unsigned int startInstance, int lod = 0);
 
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
 
 	int GetIndexCount();
 	int GetVertexCount();
+	int GetUnweldedVertexCount();
+	DirectX::XMFLOAT3 GetBoundsMin();
+	DirectX::XMFLOAT3 GetBoundsMax();
+	bool WasLoadedFromCache();
+	float GetLoadTime();
+	MeshOptimizationStats GetOptimizationStats();
+	VertexFormat GetVertexFormat();
+	PackedVertexDequantize GetDequantize();
+	unsigned int GetVertexBufferSize();
+	unsigned int GetIndexBufferSize();
+	int GetIndexRangeCount();
+	int GetDuplicatedVertexCount();
+	const MeshletData& GetMeshlets();
+	const OccluderMesh& GetOccluder();
+	const MeshBvh& GetTriangleBvh();
+	int GetLodCount();
+	int GetLodIndexCount(int lod);
+	float GetLodError(int lod);
+	int ChooseLod(float pixelsPerUnit, float maxPixelError = 1.0f);
 
 	// Name for ImGUI display
 	std::string meshName;
 
 private:
+	void CreateBuffers(const Vertex* vertices, const unsigned int* indices);
+
 	// ComPointers to vertex and index buffer objects 
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
 
-	// How many vertices in the vertex buffer?
+	// How many vertices in the vertex buffer, and in what layout?
 	unsigned int vertexBufferCount;
+	VertexFormat vertexFormat;
+	unsigned int vertexStride;
+
+	// Turns packed positions back into local space (see PackedVertex.h)
+	PackedVertexDequantize dequantize;
 
 	// How many indices in the index buffer?
+	// - Always 16-bit; larger meshes are drawn in several ranges,
+	//    each with its own base vertex
 	unsigned int indexBufferCount;
+	std::vector<IndexRange> indexRanges;
+
+	// Where each level of detail is in the index buffer (LOD 0 first)
+	std::vector<MeshLod> lods;
+
+	// How many vertices were copied so that each range could reach them?
+	unsigned int duplicatedVertexCount;
+
+	// How many vertices were there before duplicates were welded together?
+	unsigned int unweldedVertexCount;
+
+	// Local-space bounding box
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+
+	// Was this mesh read from its .meshbin cache, and how
+	// long did loading take (in milliseconds)?
+	bool loadedFromCache;
+	float loadTime;
+
+	// How much MeshOptimizer improved this mesh
+	MeshOptimizationStats optimizationStats;
+
+	// Small clusters of triangles for culling on the CPU
+	// - Vertex indices refer to the mesh's vertices before any
+	//    were duplicated for 16-bit index ranges
+	MeshletData meshlets;
+
+	// Low detail copy of the surface for software occlusion culling
+	OccluderMesh occluder;
+
+	// Full detail triangles (LOD 0) for ray casts on the CPU
+	MeshBvh triangleBvh;
 };
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "MeshBvh.h"
+
+#include <climits>
+#include <cmath>
+
+using namespace DirectX;
+
+MeshBvh::MeshBvh()
+{
+}
+
+MeshBvh::~MeshBvh()
+{
+}
+
+// --------------------------------------------------------
+// Copies out just the positions the triangles use, then
+// builds the tree over each triangle's box
+// --------------------------------------------------------
+void MeshBvh::Build(const Vertex* vertices, const unsigned int* indices, unsigned int indexCount)
+{
+	positions.clear();
+	this->indices.clear();
+	this->indices.reserve(indexCount);
+
+	// Remap the vertices to a compact list of positions
+	std::vector<unsigned int> remap;
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		unsigned int vertex = indices[i];
+		if (vertex >= remap.size())
+			remap.resize(vertex + 1, UINT_MAX);
+
+		if (remap[vertex] == UINT_MAX)
+		{
+			remap[vertex] = (unsigned int)positions.size();
+			positions.push_back(vertices[vertex].Position);
+		}
+		this->indices.push_back(remap[vertex]);
+	}
+
+	// The triangles' boxes, for the tree to sort out
+	unsigned int triangleCount = GetTriangleCount();
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	WorldBounds bounds;
+	FrustumCulling::Resize(bounds, triangleCount);
+	for (unsigned int i = 0; i < triangleCount; i++)
+	{
+		XMVECTOR a = XMLoadFloat3(&positions[this->indices[i * 3]]);
+		XMVECTOR b = XMLoadFloat3(&positions[this->indices[i * 3 + 1]]);
+		XMVECTOR c = XMLoadFloat3(&positions[this->indices[i * 3 + 2]]);
+
+		XMFLOAT3 boxMin, boxMax;
+		XMStoreFloat3(&boxMin, XMVectorMin(a, XMVectorMin(b, c)));
+		XMStoreFloat3(&boxMax, XMVectorMax(a, XMVectorMax(b, c)));
+		FrustumCulling::SetFromLocalBox(bounds, i, boxMin, boxMax, identity);
+	}
+	bvh.Build(bounds);
+}
+
+bool MeshBvh::Raycast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, TriangleRayHit& hit) const
+{
+	XMVECTOR rayOrigin = XMLoadFloat3(&origin);
+	XMVECTOR rayDirection = XMLoadFloat3(&direction);
+
+	return bvh.Raycast(origin, direction, maxDistance, [&](unsigned int triangle, float boxDistance, float& closest)
+		{
+			float distance;
+			XMFLOAT2 barycentrics;
+			if (!RayHitsTriangle(rayOrigin, rayDirection, triangle, distance, barycentrics) || distance >= closest)
+				return false;
+
+			closest = distance;
+			hit.Triangle = triangle;
+			hit.Distance = distance;
+			hit.Barycentrics = barycentrics;
+			return true;
+		});
+}
+
+bool MeshBvh::RaycastAllTriangles(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, TriangleRayHit& hit) const
+{
+	XMVECTOR rayOrigin = XMLoadFloat3(&origin);
+	XMVECTOR rayDirection = XMLoadFloat3(&direction);
+
+	float closest = maxDistance;
+	bool found = false;
+	for (unsigned int i = 0; i < GetTriangleCount(); i++)
+	{
+		float distance;
+		XMFLOAT2 barycentrics;
+		if (RayHitsTriangle(rayOrigin, rayDirection, i, distance, barycentrics) && distance < closest)
+		{
+			closest = distance;
+			hit.Triangle = i;
+			hit.Distance = distance;
+			hit.Barycentrics = barycentrics;
+			found = true;
+		}
+	}
+	return found;
+}
+
+unsigned int MeshBvh::GetTriangleCount() const
+{
+	return (unsigned int)indices.size() / 3;
+}
+
+// --------------------------------------------------------
+// Möller-Trumbore: solves for the distance and barycentrics
+// at once, without needing the triangle's plane
+// - Both sides count as hits, since some meshes are seen
+//    from behind (and a pick from inside should still hit)
+// --------------------------------------------------------
+bool MeshBvh::RayHitsTriangle(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, unsigned int triangle,
+	float& distance, DirectX::XMFLOAT2& barycentrics) const
+{
+	XMVECTOR a = XMLoadFloat3(&positions[indices[triangle * 3]]);
+	XMVECTOR edge1 = XMLoadFloat3(&positions[indices[triangle * 3 + 1]]) - a;
+	XMVECTOR edge2 = XMLoadFloat3(&positions[indices[triangle * 3 + 2]]) - a;
+
+	// Parallel (or degenerate) triangles can't be hit
+	XMVECTOR p = XMVector3Cross(direction, edge2);
+	float determinant = XMVectorGetX(XMVector3Dot(edge1, p));
+	if (std::abs(determinant) < 1e-12f)
+		return false;
+	float inverseDeterminant = 1.0f / determinant;
+
+	XMVECTOR toOrigin = origin - a;
+	float u = XMVectorGetX(XMVector3Dot(toOrigin, p)) * inverseDeterminant;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+
+	XMVECTOR q = XMVector3Cross(toOrigin, edge1);
+	float v = XMVectorGetX(XMVector3Dot(direction, q)) * inverseDeterminant;
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+
+	distance = XMVectorGetX(XMVector3Dot(edge2, q)) * inverseDeterminant;
+	barycentrics = XMFLOAT2(u, v);
+	return distance >= 0.0f;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "SceneBvh.h"
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// The closest triangle a ray hit, from MeshBvh::Raycast()
+// --------------------------------------------------------
+struct TriangleRayHit
+{
+	unsigned int Triangle;				// Index of its first vertex index / 3
+	float Distance;						// In units of the ray direction's length
+	DirectX::XMFLOAT2 Barycentrics;		// Weights of its second and third vertices
+};
+
+// --------------------------------------------------------
+// A bounding volume hierarchy over a mesh's triangles, for
+// ray casts in the mesh's local space
+// - Keeps its own compact copy of the positions and
+//    indices, since the vertex and index buffers only
+//    live on the GPU
+// - Built once, as the mesh never changes shape
+// --------------------------------------------------------
+class MeshBvh
+{
+public:
+	MeshBvh();
+	~MeshBvh();
+
+	// Builds the tree over the first indexCount indices (usually LOD 0)
+	void Build(const Vertex* vertices, const unsigned int* indices, unsigned int indexCount);
+
+	// Finds the closest triangle the ray hits within maxDistance, from either side
+	// - direction isn't normalized, so distances are in units of its length
+	bool Raycast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, TriangleRayHit& hit) const;
+
+	// Same as Raycast(), but checks every triangle, for testing the tree against
+	bool RaycastAllTriangles(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, TriangleRayHit& hit) const;
+
+	unsigned int GetTriangleCount() const;
+
+private:
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<unsigned int> indices;
+	SceneBvh bvh;
+
+	bool RayHitsTriangle(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, unsigned int triangle,
+		float& distance, DirectX::XMFLOAT2& barycentrics) const;
+};
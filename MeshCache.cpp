@@ -0,0 +1,196 @@
+#include "MeshCache.h"
+
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+// The cache is a raw copy of memory, which is only portable
+// between machines that agree on byte order
+static_assert(std::endian::native == std::endian::little, ".meshbin files are little-endian");
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	const char Magic[4] = { 'M', 'B', 'I', 'N' };
+
+	// Bump this whenever the layout above or the steps that
+	// build MeshData change, so old caches are rebuilt
+	const unsigned int FormatVersion = 4;
+
+	// Blobs start on 16-byte boundaries so they're suitably
+	// aligned for SIMD loads straight out of the mapping
+	const unsigned long long BlobAlignment = 16;
+
+	unsigned long long AlignUp(unsigned long long value)
+	{
+		return (value + BlobAlignment - 1) & ~(BlobAlignment - 1);
+	}
+}
+
+// --------------------------------------------------------
+// The cache sits next to its source, with the extension
+// swapped (Assets/Meshes/cube.obj -> cube.meshbin)
+// --------------------------------------------------------
+std::string MeshCache::GetCachePath(const char* sourcePath)
+{
+	std::string path = sourcePath;
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+		path.erase(dot);
+	return path + ".meshbin";
+}
+
+// --------------------------------------------------------
+// FNV-1a, but consuming 8 bytes per step instead of one
+// - Not cryptographic; it only needs to notice that an
+//    OBJ was edited, and be quick on very large files
+// --------------------------------------------------------
+unsigned long long MeshCache::HashBytes(const char* data, size_t size)
+{
+	const unsigned long long prime = 0x100000001B3ull;
+	unsigned long long hash = 0xCBF29CE484222325ull ^ (unsigned long long)size;
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		unsigned long long word;
+		memcpy(&word, data + i, sizeof(word));
+		hash = (hash ^ word) * prime;
+		hash ^= hash >> 29;
+	}
+	for (; i < size; i++)
+		hash = (hash ^ (unsigned char)data[i]) * prime;
+
+	return hash;
+}
+
+// --------------------------------------------------------
+// Checks a mapped .meshbin and, if it's valid and matches
+// the source, points the view directly into the mapping
+// - No copies are made; the view borrows the file's memory
+// - Indices are range-checked against the vertex count
+// --------------------------------------------------------
+bool MeshCache::Read(const char* data, size_t size, unsigned long long sourceHash, MeshCacheView& view)
+{
+	if (!data || size < sizeof(MeshCacheHeader))
+		return false;
+
+	MeshCacheHeader header;
+	memcpy(&header, data, sizeof(header));
+
+	// Is this a cache we wrote, for this exact source file?
+	if (memcmp(header.Magic, Magic, sizeof(Magic)) != 0 ||
+		header.Version != FormatVersion ||
+		header.VertexStride != sizeof(Vertex) ||
+		header.SourceHash != sourceHash ||
+		header.VertexCount == 0 ||
+		header.IndexCount == 0 ||
+		header.LodCount == 0)
+		return false;
+
+	// Make sure every blob is aligned and actually inside the file
+	unsigned long long vertexBytes = (unsigned long long)header.VertexCount * sizeof(Vertex);
+	unsigned long long indexBytes = (unsigned long long)header.IndexCount * sizeof(unsigned int);
+	unsigned long long lodBytes = (unsigned long long)header.LodCount * sizeof(MeshLod);
+	if (header.VertexOffset % BlobAlignment != 0 ||
+		header.IndexOffset % BlobAlignment != 0 ||
+		header.LodOffset % BlobAlignment != 0 ||
+		header.VertexOffset < sizeof(MeshCacheHeader) ||
+		header.VertexOffset + vertexBytes > size ||
+		header.IndexOffset < header.VertexOffset + vertexBytes ||
+		header.IndexOffset + indexBytes > size ||
+		header.LodOffset < header.IndexOffset + indexBytes ||
+		header.LodOffset + lodBytes > size)
+		return false;
+
+	// Every LOD has to be a range of whole triangles inside the indices
+	const MeshLod* lods = (const MeshLod*)(data + header.LodOffset);
+	for (unsigned int i = 0; i < header.LodCount; i++)
+	{
+		if (lods[i].IndexCount % 3 != 0 ||
+			(unsigned long long)lods[i].StartIndex + lods[i].IndexCount > header.IndexCount)
+			return false;
+	}
+
+	// A corrupt index would read past the vertex buffer on
+	// the GPU, so every one has to name a real vertex
+	const unsigned int* indices = (const unsigned int*)(data + header.IndexOffset);
+	unsigned int maxIndex = 0;
+	for (unsigned int i = 0; i < header.IndexCount; i++)
+		maxIndex = indices[i] > maxIndex ? indices[i] : maxIndex;
+	if (maxIndex >= header.VertexCount)
+		return false;
+
+	view.Vertices = (const Vertex*)(data + header.VertexOffset);
+	view.Indices = indices;
+	view.Lods = lods;
+	view.VertexCount = header.VertexCount;
+	view.IndexCount = header.IndexCount;
+	view.LodCount = header.LodCount;
+	view.UnweldedVertexCount = header.UnweldedVertexCount;
+	view.BoundsMin = header.BoundsMin;
+	view.BoundsMax = header.BoundsMax;
+	view.OptimizationStats = header.OptimizationStats;
+	return true;
+}
+
+// --------------------------------------------------------
+// Writes the mesh to a temporary file and then renames it
+// into place, so a crash mid-write never leaves behind a
+// truncated cache that looks valid
+// --------------------------------------------------------
+bool MeshCache::Write(const std::string& path, unsigned long long sourceHash, const MeshData& mesh)
+{
+	MeshCacheHeader header = {};
+	memcpy(header.Magic, Magic, sizeof(Magic));
+	header.Version = FormatVersion;
+	header.SourceHash = sourceHash;
+	header.VertexStride = sizeof(Vertex);
+	header.VertexCount = (unsigned int)mesh.vertices.size();
+	header.IndexCount = (unsigned int)mesh.indices.size();
+	header.UnweldedVertexCount = mesh.unweldedVertexCount;
+	header.VertexOffset = AlignUp(sizeof(MeshCacheHeader));
+	header.IndexOffset = AlignUp(header.VertexOffset + mesh.vertices.size() * sizeof(Vertex));
+	header.LodCount = (unsigned int)mesh.lods.size();
+	header.LodOffset = AlignUp(header.IndexOffset + mesh.indices.size() * sizeof(unsigned int));
+	header.BoundsMin = mesh.boundsMin;
+	header.BoundsMax = mesh.boundsMax;
+	header.OptimizationStats = mesh.optimizationStats;
+
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		const char padding[BlobAlignment] = {};
+		file.write((const char*)&header, sizeof(header));
+		file.write(padding, header.VertexOffset - sizeof(header));
+		file.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+		file.write(padding, header.IndexOffset - (header.VertexOffset + mesh.vertices.size() * sizeof(Vertex)));
+		file.write((const char*)mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+		file.write(padding, header.LodOffset - (header.IndexOffset + mesh.indices.size() * sizeof(unsigned int)));
+		file.write((const char*)mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+
+		if (!file)
+		{
+			file.close();
+			std::error_code ignored;
+			std::filesystem::remove(tempPath, ignored);
+			return false;
+		}
+	}
+
+	// Replace any stale cache in one step
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
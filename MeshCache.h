@@ -0,0 +1,65 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+
+#include "MeshData.h"
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Header at the start of every .meshbin file
+// - Everything is little-endian and laid out exactly as
+//    it is in memory, so a mapped file can be used in place
+// - The vertex, index and LOD blobs follow at the given offsets
+// --------------------------------------------------------
+struct MeshCacheHeader
+{
+	char Magic[4];				// Always "MBIN"
+	unsigned int Version;		// Bumped whenever the format or mesh processing changes
+	unsigned long long SourceHash; // Hash of the source OBJ's bytes
+	unsigned int VertexStride;	// sizeof(Vertex) when written
+	unsigned int VertexCount;
+	unsigned int IndexCount;
+	unsigned int UnweldedVertexCount;
+	unsigned long long VertexOffset; // From the start of the file
+	unsigned long long IndexOffset;	 // From the start of the file
+	unsigned int LodCount;
+	unsigned long long LodOffset;	 // From the start of the file
+	DirectX::XMFLOAT3 BoundsMin;
+	DirectX::XMFLOAT3 BoundsMax;
+	MeshOptimizationStats OptimizationStats;
+};
+
+// --------------------------------------------------------
+// Pointers into a mapped .meshbin file
+// - Only valid while the MappedFile is alive
+// --------------------------------------------------------
+struct MeshCacheView
+{
+	const Vertex* Vertices;
+	const unsigned int* Indices;
+	const MeshLod* Lods;
+	unsigned int VertexCount;
+	unsigned int IndexCount;
+	unsigned int LodCount;
+	unsigned int UnweldedVertexCount;
+	DirectX::XMFLOAT3 BoundsMin;
+	DirectX::XMFLOAT3 BoundsMax;
+	MeshOptimizationStats OptimizationStats;
+};
+
+namespace MeshCache
+{
+	// Where the cache for a given source file lives
+	std::string GetCachePath(const char* sourcePath);
+
+	// Fast 64-bit hash used to detect a changed source file
+	unsigned long long HashBytes(const char* data, size_t size);
+
+	// Validates a mapped cache against the source's hash
+	// - Returns false (leaving the view untouched) if it's stale or malformed
+	bool Read(const char* data, size_t size, unsigned long long sourceHash, MeshCacheView& view);
+
+	// Writes a cache file, returning false if it couldn't be written
+	bool Write(const std::string& path, unsigned long long sourceHash, const MeshData& mesh);
+}
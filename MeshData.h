@@ -0,0 +1,71 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// How much work the GPU does to draw a mesh, before and
+// after MeshOptimizer reordered it
+// - All zeros if the mesh wasn't optimized
+// --------------------------------------------------------
+struct MeshOptimizationStats
+{
+	float ACMRBefore;		// Vertex shader runs per triangle
+	float ACMRAfter;
+	float ATVRBefore;		// Vertex shader runs per vertex
+	float ATVRAfter;
+	float OverdrawBefore;	// Pixels shaded per pixel covered
+	float OverdrawAfter;
+};
+
+// --------------------------------------------------------
+// One level of detail: a range of a mesh's indices, all
+// drawing from the same vertices
+// --------------------------------------------------------
+struct MeshLod
+{
+	unsigned int StartIndex;	// First index in MeshData::indices
+	unsigned int IndexCount;
+	float Error;				// How far the surface moved, relative to the largest extent of the bounds
+};
+
+// --------------------------------------------------------
+// CPU-side geometry for a single Mesh, before it's
+// uploaded to the GPU
+// --------------------------------------------------------
+struct MeshData
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+
+	// Levels of detail, from full detail down
+	// - LOD 0 is always the full mesh, at the start of indices
+	std::vector<MeshLod> lods;
+
+	// How many vertices were there before duplicates were welded together?
+	unsigned int unweldedVertexCount;
+
+	// Local-space bounding box of every vertex
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+
+	MeshOptimizationStats optimizationStats;
+};
+
+namespace MeshLoader
+{
+	// Parses, welds and calculates tangents for an in-memory OBJ file
+	void LoadObj(const char* data, size_t size, MeshData& out, unsigned int threadCount = 1);
+
+	// Fills in the local-space bounding box from the vertices
+	void CalculateBounds(MeshData& mesh);
+
+	// Fills in the Tangent of every vertex, based on positions and uvs
+	// - SIMD, and split across threads for large meshes
+	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices, unsigned int threadCount = 1);
+
+	// Same as above, one triangle and then one vertex at a time
+	void CalculateTangentsScalar(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+}
@@ -0,0 +1,342 @@
+#include "MeshData.h"
+#include "ObjParser.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Triangles whose uvs cover less area than this add no tangent
+	const float MinUVArea = 1e-20f;
+
+	// The (unnormalized) uv-space tangent of one triangle
+	// - The triangle's x, y and z are done together in one vector
+	// - Loads 4 floats at Position (x, y, z, u) and UV (u, v and two
+	//    of the normal), which both stay inside the Vertex
+	// - Zero (rather than infinite) when the uvs have no area
+	XMVECTOR TriangleTangent(const Vertex* verts, const unsigned int* triangle)
+	{
+		const Vertex& v1 = verts[triangle[0]];
+		const Vertex& v2 = verts[triangle[1]];
+		const Vertex& v3 = verts[triangle[2]];
+
+		// Calculate vectors relative to triangle positions and uvs
+		XMVECTOR p1 = XMLoadFloat4((const XMFLOAT4*)&v1.Position);
+		XMVECTOR e1 = XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)&v2.Position), p1);
+		XMVECTOR e2 = XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)&v3.Position), p1);
+		XMVECTOR uv1 = XMLoadFloat4((const XMFLOAT4*)&v1.UV);
+		XMVECTOR d1 = XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)&v2.UV), uv1);
+		XMVECTOR d2 = XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)&v3.UV), uv1);
+		XMVECTOR s1 = XMVectorSplatX(d1);
+		XMVECTOR t1 = XMVectorSplatY(d1);
+		XMVECTOR s2 = XMVectorSplatX(d2);
+		XMVECTOR t2 = XMVectorSplatY(d2);
+
+		XMVECTOR determinant = XMVectorSubtract(XMVectorMultiply(s1, t2), XMVectorMultiply(s2, t1));
+		XMVECTOR hasArea = XMVectorGreater(XMVectorAbs(determinant), XMVectorReplicate(MinUVArea));
+		XMVECTOR r = XMVectorSelect(XMVectorZero(), XMVectorDivide(XMVectorSplatOne(), determinant), hasArea);
+		return XMVectorMultiply(XMVectorSubtract(XMVectorMultiply(t2, e1), XMVectorMultiply(t1, e2)), r);
+	}
+
+	// Adds the tangent of every triangle to the sums of its three vertices
+	void AccumulateTangents(const Vertex* verts, const unsigned int* indices, size_t triangleCount, XMFLOAT4A* sums)
+	{
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			const unsigned int* triangle = &indices[t * 3];
+			XMVECTOR tangent = TriangleTangent(verts, triangle);
+
+			// Adjust tangents of each vert of the triangle
+			for (int corner = 0; corner < 3; corner++)
+			{
+				XMFLOAT4A* sum = &sums[triangle[corner]];
+				XMStoreFloat4A(sum, XMVectorAdd(XMLoadFloat4A(sum), tangent));
+			}
+		}
+	}
+
+	// Vertex-to-triangle adjacency, stored as one flat list
+	// - The triangles using vertex i are
+	//    Triangles[Offsets[i]] .. Triangles[Offsets[i + 1] - 1],
+	//    in increasing order
+	struct VertexTriangles
+	{
+		std::vector<unsigned int> Offsets;
+		std::vector<unsigned int> Triangles;
+	};
+
+	void BuildVertexTriangles(const unsigned int* indices, size_t triangleCount, size_t vertexCount, VertexTriangles& out)
+	{
+		// Count each vertex's corners, then turn the counts into offsets
+		out.Offsets.assign(vertexCount + 1, 0);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			out.Offsets[indices[i] + 1]++;
+		for (size_t i = 0; i < vertexCount; i++)
+			out.Offsets[i + 1] += out.Offsets[i];
+
+		// Fill, using a copy of the offsets as each vertex's write cursor
+		std::vector<unsigned int> cursors(out.Offsets.begin(), out.Offsets.end() - 1);
+		out.Triangles.resize(triangleCount * 3);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			out.Triangles[cursors[indices[i]]++] = (unsigned int)(i / 3);
+	}
+
+	// Sums the tangents of the triangles around each vertex in
+	// [first, last), in the same order AccumulateTangents() adds them
+	void GatherTangents(const VertexTriangles& adjacency, const XMFLOAT4A* triangleTangents, size_t first, size_t last, XMFLOAT4A* sums)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			XMVECTOR sum = XMVectorZero();
+			for (unsigned int a = adjacency.Offsets[i]; a < adjacency.Offsets[i + 1]; a++)
+				sum = XMVectorAdd(sum, XMLoadFloat4A(&triangleTangents[adjacency.Triangles[a]]));
+			XMStoreFloat4A(&sums[i], sum);
+		}
+	}
+
+	// Any unit vector perpendicular to a normal, for vertices with no tangent
+	XMVECTOR AnyPerpendicular(FXMVECTOR normal)
+	{
+		// Cross with whichever axis is least like the normal
+		XMVECTOR axis = fabsf(XMVectorGetX(normal)) < 0.9f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0);
+		return XMVector3Normalize(XMVector3Cross(axis, normal));
+	}
+
+	// Makes the summed tangent of each vertex in [first, last)
+	// perpendicular to its normal (Gram-Schmidt), normalizes it
+	// and stores it in the vertex
+	void OrthonormalizeTangents(Vertex* verts, const XMFLOAT4A* sums, size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
+			XMVECTOR tangent = XMLoadFloat4A(&sums[i]);
+			tangent = XMVector3Normalize(
+				tangent - normal * XMVector3Dot(normal, tangent));
+
+			// Nothing to go on (no uv area at all, or a tangent
+			// parallel to the normal), so pick any perpendicular
+			if (!(XMVectorGetX(XMVector3LengthSq(tangent)) > 0.5f))
+				tangent = AnyPerpendicular(normal);
+
+			XMStoreFloat3(&verts[i].Tangent, tangent);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Turns an in-memory OBJ file into welded vertices, indices,
+// tangents and bounds, ready for buffer creation
+// - Shared by Mesh and the load-time benchmarks, so both
+//    measure exactly the same work
+// --------------------------------------------------------
+void MeshLoader::LoadObj(const char* data, size_t size, MeshData& out, unsigned int threadCount)
+{
+	// Read positions, uvs, normals and (triangulated) faces
+	// - Large files are split into chunks parsed on several threads
+	ObjData objData;
+	ObjParser::Parse(data, size, objData, threadCount);
+
+	if (objData.corners.empty())
+		throw std::invalid_argument("Error loading OBJ: File contains no faces");
+
+	// Weld identical corners into shared vertices, so the
+	// index buffer actually gets reused vertices
+	ObjParser::BuildVertices(objData, out.vertices, out.indices);
+	out.unweldedVertexCount = (unsigned int)objData.corners.size();
+
+	// Calculate tangent vectors for each Vertex
+	CalculateTangents(&out.vertices[0], (int)out.vertices.size(), &out.indices[0], (int)out.indices.size(), threadCount);
+
+	CalculateBounds(out);
+
+	// Nothing's been optimized or simplified yet
+	out.optimizationStats = {};
+	out.lods.assign(1, { 0, (unsigned int)out.indices.size(), 0.0f });
+}
+
+// --------------------------------------------------------
+// Fills in the local-space bounding box from the vertices
+// --------------------------------------------------------
+void MeshLoader::CalculateBounds(MeshData& mesh)
+{
+	if (mesh.vertices.empty())
+	{
+		mesh.boundsMin = XMFLOAT3(0, 0, 0);
+		mesh.boundsMax = XMFLOAT3(0, 0, 0);
+		return;
+	}
+
+	XMVECTOR minimum = XMLoadFloat3(&mesh.vertices[0].Position);
+	XMVECTOR maximum = minimum;
+	for (const Vertex& v : mesh.vertices)
+	{
+		XMVECTOR position = XMLoadFloat3(&v.Position);
+		minimum = XMVectorMin(minimum, position);
+		maximum = XMVectorMax(maximum, position);
+	}
+
+	XMStoreFloat3(&mesh.boundsMin, minimum);
+	XMStoreFloat3(&mesh.boundsMax, maximum);
+}
+
+// --------------------------------------------------------
+// Calculates the tangents of the vertices in a mesh
+// - Same math as CalculateTangentsScalar(), but with each
+//    triangle's x, y and z done together in SIMD vectors,
+//    summed into a separate (aligned) array instead of the
+//    vertices, so there's no reset pass over the vertices
+// - With more than one thread, the other threads find the
+//    tangents of their share of the triangles while the
+//    calling thread builds the adjacency list, then each
+//    thread gathers (and orthonormalizes) a range of
+//    vertices through a vertex-to-triangle adjacency list,
+//    so no two threads write the same memory and the extra
+//    memory doesn't grow with the thread count
+// - Either way, each vertex adds up its triangles in the
+//    same order, so the results don't depend on threadCount
+// - Triangles with no uv area add nothing, rather than an
+//    infinite tangent, and vertices left with no tangent
+//    get one perpendicular to their normal
+// --------------------------------------------------------
+void MeshLoader::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices, unsigned int threadCount)
+{
+	size_t vertexCount = (size_t)numVerts;
+	size_t triangleCount = (size_t)numIndices / 3;
+
+	// Not worth splitting tiny meshes across threads
+	const size_t minimumTrianglesPerThread = 16 * 1024;
+	size_t maxThreads = std::max<size_t>(triangleCount / minimumTrianglesPerThread, 1);
+	size_t jobCount = std::clamp<size_t>(threadCount, 1, maxThreads);
+
+	// Each vertex's summed tangent
+	// - Kept apart from the vertices, so the triangle loop only
+	//    reads them, and padded to 16 bytes for aligned loads
+	std::vector<XMFLOAT4A> sums(vertexCount, XMFLOAT4A(0, 0, 0, 0));
+
+	// On one thread, triangles can simply add to their vertices
+	if (jobCount == 1)
+	{
+		AccumulateTangents(verts, indices, triangleCount, sums.data());
+		OrthonormalizeTangents(verts, sums.data(), 0, vertexCount);
+		return;
+	}
+
+	// Runs a job for every thread, using the calling thread for the first one
+	auto forEachJob = [&](auto job)
+	{
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < jobCount; i++)
+			workers.emplace_back(job, i);
+		job(0);
+		for (std::thread& worker : workers)
+			worker.join();
+	};
+
+	// The calling thread builds the adjacency list while the
+	// others find the tangents of their share of the triangles
+	std::vector<XMFLOAT4A> triangleTangents(triangleCount);
+	VertexTriangles adjacency;
+	forEachJob([&](size_t job)
+	{
+		if (job == 0)
+		{
+			BuildVertexTriangles(indices, triangleCount, vertexCount, adjacency);
+			return;
+		}
+
+		size_t first = triangleCount * (job - 1) / (jobCount - 1);
+		size_t last = triangleCount * job / (jobCount - 1);
+		for (size_t t = first; t < last; t++)
+			XMStoreFloat4A(&triangleTangents[t], TriangleTangent(verts, &indices[t * 3]));
+	});
+
+	// Then each thread gathers (and orthonormalizes) its own range of vertices
+	forEachJob([&](size_t job)
+	{
+		size_t first = vertexCount * job / jobCount;
+		size_t last = vertexCount * (job + 1) / jobCount;
+		GatherTangents(adjacency, triangleTangents.data(), first, last, sums.data());
+		OrthonormalizeTangents(verts, sums.data(), first, last);
+	});
+}
+
+// --------------------------------------------------------
+// Calculates the tangents of the vertices in a mesh
+// - Code originally adapted from: http://www.terathon.com/code/tangent.html
+// - Updated version found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
+// - See listing 7.4 in section 7.5 (page 9 of the PDF)
+//
+// - Note: For this code to work, your Vertex format must
+// contain an XMFLOAT3 called Tangent
+//
+// - Be sure to call this BEFORE creating your D3D vertex/index buffers
+// - Moved here from Mesh so CPU-side loading doesn't need D3D
+// - The original one-triangle-at-a-time version, kept as a
+//    reference for CalculateTangents() and the benchmarks
+// --------------------------------------------------------
+void MeshLoader::CalculateTangentsScalar(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
+{
+	// Reset tangents
+	for (int i = 0; i < numVerts; i++)
+	{
+		verts[i].Tangent = XMFLOAT3(0, 0, 0);
+	}
+	// Calculate tangents one whole triangle at a time
+	for (int i = 0; i < numIndices;)
+	{
+		// Grab indices and vertices of first triangle
+		unsigned int i1 = indices[i++];
+		unsigned int i2 = indices[i++];
+		unsigned int i3 = indices[i++];
+		Vertex* v1 = &verts[i1];
+		Vertex* v2 = &verts[i2];
+		Vertex* v3 = &verts[i3];
+		// Calculate vectors relative to triangle positions
+		float x1 = v2->Position.x - v1->Position.x;
+		float y1 = v2->Position.y - v1->Position.y;
+		float z1 = v2->Position.z - v1->Position.z;
+		float x2 = v3->Position.x - v1->Position.x;
+		float y2 = v3->Position.y - v1->Position.y;
+		float z2 = v3->Position.z - v1->Position.z;
+		// Do the same for vectors relative to triangle uv's
+		float s1 = v2->UV.x - v1->UV.x;
+		float t1 = v2->UV.y - v1->UV.y;
+		float s2 = v3->UV.x - v1->UV.x;
+		float t2 = v3->UV.y - v1->UV.y;
+		// Create vectors for tangent calculation
+		float r = 1.0f / (s1 * t2 - s2 * t1);
+		float tx = (t2 * x1 - t1 * x2) * r;
+		float ty = (t2 * y1 - t1 * y2) * r;
+		float tz = (t2 * z1 - t1 * z2) * r;
+		// Adjust tangents of each vert of the triangle
+		v1->Tangent.x += tx;
+		v1->Tangent.y += ty;
+		v1->Tangent.z += tz;
+		v2->Tangent.x += tx;
+		v2->Tangent.y += ty;
+		v2->Tangent.z += tz;
+		v3->Tangent.x += tx;
+		v3->Tangent.y += ty;
+		v3->Tangent.z += tz;
+	}
+	// Ensure all of the tangents are orthogonal to the normals
+	for (int i = 0; i < numVerts; i++)
+	{
+		// Grab the two vectors
+		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
+		XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
+		// Use Gram-Schmidt orthonormalize to ensure
+		// the normal and tangent are exactly 90 degrees apart
+		tangent = XMVector3Normalize(
+			tangent - normal * XMVector3Dot(normal, tangent));
+		// Store the tangent
+		XMStoreFloat3(&verts[i].Tangent, tangent);
+	}
+}
@@ -0,0 +1,514 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Size of the LRU cache Forsyth's scores are tuned for
+	const int ForsythCacheSize = 32;
+
+	// Size of the FIFO cache used to measure ACMR/ATVR and
+	// to find cluster boundaries (close to real hardware)
+	const unsigned int SimulatedCacheSize = 16;
+
+	// Resolution of each view when estimating overdraw
+	const int OverdrawGridSize = 256;
+
+	// --------------------------------------------------------
+	// Forsyth's vertex score: vertices near the front of the
+	// cache score higher, as do vertices with few triangles
+	// left (so stragglers get finished off)
+	// - The three most recent vertices get a flat, lower score
+	//    so the next triangle doesn't just reuse the same edge
+	// --------------------------------------------------------
+	float ForsythVertexScore(int cachePosition, unsigned int liveTriangles)
+	{
+		if (liveTriangles == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			if (cachePosition < 3)
+				score = 0.75f;
+			else
+				score = powf(1.0f - (float)(cachePosition - 3) / (ForsythCacheSize - 3), 1.5f);
+		}
+
+		return score + 2.0f / sqrtf((float)liveTriangles);
+	}
+
+	// --------------------------------------------------------
+	// Fixed-size FIFO cache of vertex indices
+	// - Timestamps make "is it still in the cache?" O(1)
+	// --------------------------------------------------------
+	class FifoCache
+	{
+	public:
+		FifoCache(size_t vertexCount) : timestamps(vertexCount, 0), time(SimulatedCacheSize + 1) {}
+
+		// Returns true on a miss (the vertex shader would run)
+		bool Touch(unsigned int vertex)
+		{
+			if (time - timestamps[vertex] > SimulatedCacheSize)
+			{
+				timestamps[vertex] = time++;
+				return true;
+			}
+			return false;
+		}
+
+		// Empties the cache without touching every vertex
+		void Flush() { time += SimulatedCacheSize + 1; }
+
+	private:
+		std::vector<unsigned int> timestamps;
+		unsigned int time;
+	};
+
+	// Vertex shader runs for a range of triangles, starting from an empty cache
+	unsigned int CountCacheMisses(const unsigned int* indices, size_t indexCount, size_t vertexCount)
+	{
+		FifoCache cache(vertexCount);
+		unsigned int misses = 0;
+		for (size_t i = 0; i < indexCount; i++)
+			misses += cache.Touch(indices[i]);
+		return misses;
+	}
+
+	// --------------------------------------------------------
+	// Rasterizes one triangle into a depth grid with a
+	// less-than depth test, counting how many pixels pass
+	// --------------------------------------------------------
+	unsigned int RasterizeTriangle(std::vector<float>& depth, XMFLOAT3 a, XMFLOAT3 b, XMFLOAT3 c)
+	{
+		float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+		if (fabsf(area) < 1e-12f)
+			return 0;
+
+		// Make the winding consistent so the edge tests below all agree
+		if (area < 0.0f)
+		{
+			std::swap(b, c);
+			area = -area;
+		}
+
+		int minX = std::max((int)floorf(std::min({ a.x, b.x, c.x })), 0);
+		int maxX = std::min((int)ceilf(std::max({ a.x, b.x, c.x })), OverdrawGridSize - 1);
+		int minY = std::max((int)floorf(std::min({ a.y, b.y, c.y })), 0);
+		int maxY = std::min((int)ceilf(std::max({ a.y, b.y, c.y })), OverdrawGridSize - 1);
+
+		unsigned int shaded = 0;
+		for (int y = minY; y <= maxY; y++)
+		{
+			for (int x = minX; x <= maxX; x++)
+			{
+				// Sample at the pixel center
+				float px = x + 0.5f;
+				float py = y + 0.5f;
+				float w0 = (c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x);
+				float w1 = (a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x);
+				float w2 = (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+				if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+					continue;
+
+				float z = (w0 * a.z + w1 * b.z + w2 * c.z) / area;
+				float& stored = depth[(size_t)y * OverdrawGridSize + x];
+				if (z < stored)
+				{
+					stored = z;
+					shaded++;
+				}
+			}
+		}
+		return shaded;
+	}
+}
+
+// --------------------------------------------------------
+// Runs the whole optimization pipeline on a loaded mesh:
+//  1. Vertex cache ordering (Forsyth)
+//  2. Overdraw clustering (Tipsy), limited so ACMR stays
+//     within 5% of step 1's result
+//  3. Vertex fetch ordering
+// - The before and after stats are stored in the mesh
+// --------------------------------------------------------
+void MeshOptimizer::Optimize(MeshData& mesh)
+{
+	if (mesh.indices.empty())
+		return;
+
+	MeshOptimizationStats& stats = mesh.optimizationStats;
+	stats.ACMRBefore = CalculateACMR(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+	stats.ATVRBefore = CalculateATVR(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+	stats.OverdrawBefore = EstimateOverdraw(mesh, mesh.indices.data(), mesh.indices.size());
+
+	OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+	OptimizeOverdraw(mesh, mesh.indices.data(), mesh.indices.size(), 1.05f);
+	OptimizeVertexFetch(mesh);
+
+	stats.ACMRAfter = CalculateACMR(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+	stats.ATVRAfter = CalculateATVR(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+	stats.OverdrawAfter = EstimateOverdraw(mesh, mesh.indices.data(), mesh.indices.size());
+}
+
+// --------------------------------------------------------
+// Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+// - Greedily emits the best-scoring triangle that uses a
+//    vertex in the (simulated) cache
+// - When none are left, falls back to the next unemitted
+//    triangle in the original order rather than searching
+//    the whole mesh, which keeps this linear
+// --------------------------------------------------------
+void MeshOptimizer::OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Which triangles use each vertex (compressed into one array)
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		liveTriangles[indices[i]]++;
+
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	{
+		std::vector<unsigned int> filled(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t t = 0; t < triangleCount; t++)
+			for (size_t c = 0; c < 3; c++)
+				adjacency[filled[indices[t * 3 + c]]++] = (unsigned int)t;
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexScore[v] = ForsythVertexScore(-1, liveTriangles[v]);
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> output(triangleCount * 3);
+
+	// Room for a full cache plus the three vertices being added
+	unsigned int cache[ForsythCacheSize + 3];
+	unsigned int newCache[ForsythCacheSize + 3];
+	int cacheCount = 0;
+
+	size_t cursor = 0;
+	size_t bestTriangle = 0;
+	for (size_t written = 0; written < triangleCount; written++)
+	{
+		// Emit the chosen triangle and remove it from its vertices' lists
+		const unsigned int* triangle = &indices[bestTriangle * 3];
+		emitted[bestTriangle] = true;
+		for (size_t c = 0; c < 3; c++)
+		{
+			unsigned int v = triangle[c];
+			output[written * 3 + c] = v;
+
+			unsigned int* list = &adjacency[adjacencyOffsets[v]];
+			for (unsigned int i = 0; i < liveTriangles[v]; i++)
+			{
+				if (list[i] == bestTriangle)
+				{
+					list[i] = list[liveTriangles[v] - 1];
+					break;
+				}
+			}
+			liveTriangles[v]--;
+		}
+
+		// New cache: this triangle's vertices, then everything else in LRU order
+		int newCount = 0;
+		for (size_t c = 0; c < 3; c++)
+			newCache[newCount++] = triangle[c];
+		for (int i = 0; i < cacheCount; i++)
+		{
+			unsigned int v = cache[i];
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				newCache[newCount++] = v;
+		}
+
+		// Rescore everything that was (or still is) in the cache
+		for (int i = 0; i < newCount; i++)
+		{
+			unsigned int v = newCache[i];
+			cachePosition[v] = i < ForsythCacheSize ? i : -1;
+			vertexScore[v] = ForsythVertexScore(cachePosition[v], liveTriangles[v]);
+		}
+
+		// The best candidate is a live triangle touching the cache
+		float bestScore = -1.0f;
+		for (int i = 0; i < newCount && i < ForsythCacheSize; i++)
+		{
+			unsigned int v = newCache[i];
+			const unsigned int* list = &adjacency[adjacencyOffsets[v]];
+			for (unsigned int j = 0; j < liveTriangles[v]; j++)
+			{
+				const unsigned int* candidate = &indices[(size_t)list[j] * 3];
+				float score = vertexScore[candidate[0]] + vertexScore[candidate[1]] + vertexScore[candidate[2]];
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = list[j];
+				}
+			}
+		}
+
+		cacheCount = std::min(newCount, ForsythCacheSize);
+		for (int i = 0; i < cacheCount; i++)
+			cache[i] = newCache[i];
+
+		// Dead end, so start again wherever the original order left off
+		if (bestScore < 0.0f)
+		{
+			while (cursor < triangleCount && emitted[cursor])
+				cursor++;
+			bestTriangle = cursor;
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+// --------------------------------------------------------
+// The overdraw half of Sander, Nehab and Barczak's "Fast
+// Triangle Reordering for Vertex Locality and Reduced
+// Overdraw" (Tipsy), run on an already cache-ordered list
+//
+// - Hard boundaries fall where a triangle misses on all
+//    three vertices, since the cache is starting over there
+// - Each hard cluster is split further once its running
+//    ACMR is within the threshold of the whole cluster's
+// - Clusters are then sorted so those facing away from the
+//    mesh's center draw first, which tends to put the parts
+//    that occlude others ahead of what they occlude
+// --------------------------------------------------------
+void MeshOptimizer::OptimizeOverdraw(const MeshData& mesh, unsigned int* indices, size_t indexCount, float threshold)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+		return;
+
+	size_t vertexCount = mesh.vertices.size();
+
+	// Hard boundaries
+	std::vector<size_t> hardClusters;
+	{
+		FifoCache cache(vertexCount);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			unsigned int misses = cache.Touch(indices[t * 3]) + cache.Touch(indices[t * 3 + 1]) + cache.Touch(indices[t * 3 + 2]);
+			if (misses == 3 || t == 0)
+				hardClusters.push_back(t);
+		}
+	}
+	hardClusters.push_back(triangleCount);
+
+	// Soft boundaries inside each hard cluster
+	std::vector<size_t> clusters;
+	{
+		FifoCache cache(vertexCount);
+		for (size_t h = 0; h + 1 < hardClusters.size(); h++)
+		{
+			size_t start = hardClusters[h];
+			size_t end = hardClusters[h + 1];
+			float clusterACMR = (float)CountCacheMisses(&indices[start * 3], (end - start) * 3, vertexCount) / (end - start);
+
+			cache.Flush();
+			clusters.push_back(start);
+			unsigned int misses = 0;
+			size_t triangles = 0;
+			for (size_t t = start; t < end; t++)
+			{
+				misses += cache.Touch(indices[t * 3]) + cache.Touch(indices[t * 3 + 1]) + cache.Touch(indices[t * 3 + 2]);
+				triangles++;
+
+				if (t + 1 < end && (float)misses / triangles <= clusterACMR * threshold)
+				{
+					clusters.push_back(t + 1);
+					cache.Flush();
+					misses = 0;
+					triangles = 0;
+				}
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	size_t clusterCount = clusters.size() - 1;
+	if (clusterCount < 2)
+		return;
+
+	// Area-weighted center of the whole mesh and of each cluster,
+	// plus the direction each cluster faces
+	std::vector<XMFLOAT3> clusterCenters(clusterCount);
+	std::vector<XMFLOAT3> clusterNormals(clusterCount);
+	XMVECTOR meshCenter = XMVectorZero();
+	float meshArea = 0.0f;
+	for (size_t k = 0; k < clusterCount; k++)
+	{
+		XMVECTOR center = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+		for (size_t t = clusters[k]; t < clusters[k + 1]; t++)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&mesh.vertices[indices[t * 3]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&mesh.vertices[indices[t * 3 + 1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&mesh.vertices[indices[t * 3 + 2]].Position);
+
+			// Twice the triangle's area, pointing out of its front face
+			XMVECTOR cross = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			float triangleArea = XMVectorGetX(XMVector3Length(cross));
+
+			XMVECTOR triangleCenter = XMVectorScale(XMVectorAdd(XMVectorAdd(p0, p1), p2), 1.0f / 3.0f);
+			center = XMVectorAdd(center, XMVectorScale(triangleCenter, triangleArea));
+			normal = XMVectorAdd(normal, cross);
+			area += triangleArea;
+		}
+
+		meshCenter = XMVectorAdd(meshCenter, center);
+		meshArea += area;
+
+		XMStoreFloat3(&clusterCenters[k], area > 0.0f ? XMVectorScale(center, 1.0f / area) : center);
+		XMStoreFloat3(&clusterNormals[k], XMVector3Normalize(normal));
+	}
+	if (meshArea > 0.0f)
+		meshCenter = XMVectorScale(meshCenter, 1.0f / meshArea);
+
+	// How far each cluster faces away from the center
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t k = 0; k < clusterCount; k++)
+	{
+		XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&clusterCenters[k]), meshCenter);
+		sortKeys[k] = XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&clusterNormals[k])));
+	}
+
+	std::vector<size_t> order(clusterCount);
+	for (size_t k = 0; k < clusterCount; k++)
+		order[k] = k;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<unsigned int> sorted;
+	sorted.reserve(triangleCount * 3);
+	for (size_t k : order)
+		sorted.insert(sorted.end(), &indices[clusters[k] * 3], &indices[clusters[k + 1] * 3]);
+
+	std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+// --------------------------------------------------------
+// Renumbers vertices in the order the index list first
+// uses them, moving the vertex data to match
+// - Any vertex no triangle uses is dropped
+// --------------------------------------------------------
+void MeshOptimizer::OptimizeVertexFetch(MeshData& mesh)
+{
+	const unsigned int unused = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(mesh.vertices.size(), unused);
+	std::vector<Vertex> reordered;
+	reordered.reserve(mesh.vertices.size());
+
+	for (unsigned int& index : mesh.indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = (unsigned int)reordered.size();
+			reordered.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	mesh.vertices.swap(reordered);
+}
+
+float MeshOptimizer::CalculateACMR(const unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+	if (indexCount < 3)
+		return 0.0f;
+	return (float)CountCacheMisses(indices, indexCount, vertexCount) / (indexCount / 3);
+}
+
+float MeshOptimizer::CalculateATVR(const unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+	if (vertexCount == 0)
+		return 0.0f;
+	return (float)CountCacheMisses(indices, indexCount, vertexCount) / vertexCount;
+}
+
+// --------------------------------------------------------
+// Estimates overdraw by rasterizing the mesh, in index
+// order, looking down each of the six axis directions
+// - Back faces are culled, as they would be on the GPU
+// - Overdraw = pixels that passed the depth test / pixels
+//    left covered at the end
+// --------------------------------------------------------
+float MeshOptimizer::EstimateOverdraw(const MeshData& mesh, const unsigned int* indices, size_t indexCount)
+{
+	XMVECTOR boundsMin = XMLoadFloat3(&mesh.boundsMin);
+	XMVECTOR extent = XMVectorSubtract(XMLoadFloat3(&mesh.boundsMax), boundsMin);
+	XMFLOAT3 size;
+	XMStoreFloat3(&size, extent);
+
+	// Scale so the largest side fills the grid
+	float largest = std::max({ size.x, size.y, size.z });
+	if (largest <= 0.0f)
+		return 0.0f;
+	float scale = (OverdrawGridSize - 1) / largest;
+
+	std::vector<XMFLOAT3> scaled(mesh.vertices.size());
+	for (size_t v = 0; v < mesh.vertices.size(); v++)
+	{
+		XMVECTOR p = XMVectorSubtract(XMLoadFloat3(&mesh.vertices[v].Position), boundsMin);
+		XMStoreFloat3(&scaled[v], XMVectorScale(p, scale));
+	}
+
+	std::vector<float> depth((size_t)OverdrawGridSize * OverdrawGridSize);
+	unsigned long long shaded = 0;
+	unsigned long long covered = 0;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (int direction = -1; direction <= 1; direction += 2)
+		{
+			std::fill(depth.begin(), depth.end(), FLT_MAX);
+
+			for (size_t i = 0; i + 2 < indexCount; i += 3)
+			{
+				XMFLOAT3 corners[3];
+				for (int c = 0; c < 3; c++)
+				{
+					// Project along the axis: the other two coordinates
+					// are the pixel, and distance along the view is depth
+					const float* p = &scaled[indices[i + c]].x;
+					corners[c] = XMFLOAT3(p[(axis + 1) % 3], p[(axis + 2) % 3], p[axis] * direction);
+				}
+
+				// Cull triangles facing away from the view direction
+				XMVECTOR p0 = XMLoadFloat3(&scaled[indices[i]]);
+				XMVECTOR p1 = XMLoadFloat3(&scaled[indices[i + 1]]);
+				XMVECTOR p2 = XMLoadFloat3(&scaled[indices[i + 2]]);
+				XMFLOAT3 normal;
+				XMStoreFloat3(&normal, XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)));
+				if ((&normal.x)[axis] * direction >= 0.0f)
+					continue;
+
+				shaded += RasterizeTriangle(depth, corners[0], corners[1], corners[2]);
+			}
+
+			for (float d : depth)
+				covered += d < FLT_MAX;
+		}
+	}
+
+	return covered > 0 ? (float)shaded / covered : 0.0f;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "MeshData.h"
+
+// --------------------------------------------------------
+// Reorders a mesh's triangles and vertices so the GPU does
+// less work drawing it, without changing what's drawn
+// --------------------------------------------------------
+namespace MeshOptimizer
+{
+	// Runs every step below in order and records before/after stats
+	void Optimize(MeshData& mesh);
+
+	// Reorders triangles so vertices are reused while they're still in
+	// the post-transform cache (Forsyth's linear-speed algorithm)
+	void OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+	// Splits cache-optimized triangles into clusters and sorts them so
+	// outward-facing clusters draw first (Tipsy's overdraw pass)
+	// - Clusters only end where the cache would mostly miss anyway,
+	//    so the ACMR can grow by at most the given threshold
+	void OptimizeOverdraw(const MeshData& mesh, unsigned int* indices, size_t indexCount, float threshold);
+
+	// Renumbers vertices in the order they're first used, so fetching
+	// them walks through memory front to back
+	void OptimizeVertexFetch(MeshData& mesh);
+
+	// Average cache miss ratio: vertex shader runs per triangle (0.5 - 3.0)
+	float CalculateACMR(const unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+	// Average transformed vertex ratio: vertex shader runs per vertex (1.0 is ideal)
+	float CalculateATVR(const unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+	// Rasterizes the mesh from six axis-aligned views and returns pixels
+	// shaded per pixel covered (1.0 means no overdraw)
+	float EstimateOverdraw(const MeshData& mesh, const unsigned int* indices, size_t indexCount);
+}
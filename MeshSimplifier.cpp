@@ -0,0 +1,614 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// How strongly open borders and UV seams hold their shape,
+	// relative to the surface itself
+	const float BorderWeight = 10.0f;
+
+	// Extra cost for collapsing onto a vertex with different
+	// attributes, scaled by the squared edge length
+	const float UVWeight = 1.0f;
+	const float NormalWeight = 1.0f;
+
+	// Collapses that turn a triangle further than this (cosine
+	// of the angle between its old and new normal) are rejected
+	const float MinFlipDot = 0.25f;
+
+	// --------------------------------------------------------
+	// What a vertex's neighborhood looks like, which decides
+	// the edges it may collapse along
+	// --------------------------------------------------------
+	enum class VertexKind
+	{
+		Manifold,	// Interior vertex with a single set of attributes: collapses anywhere
+		Border,		// On one open border: only collapses along it
+		Seam,		// On one UV seam, with two UV groups in one spot: only collapses along it
+		Locked		// Anything more complicated: never moves
+	};
+
+	// --------------------------------------------------------
+	// Symmetric 4x4 matrix measuring the sum of squared
+	// distances to a set of (weighted) planes
+	// --------------------------------------------------------
+	struct Quadric
+	{
+		double a00, a11, a22, a01, a02, a12;
+		double b0, b1, b2;
+		double c;
+		double weight;
+
+		void AddPlane(double nx, double ny, double nz, double d, double w)
+		{
+			a00 += w * nx * nx; a11 += w * ny * ny; a22 += w * nz * nz;
+			a01 += w * nx * ny; a02 += w * nx * nz; a12 += w * ny * nz;
+			b0 += w * nx * d; b1 += w * ny * d; b2 += w * nz * d;
+			c += w * d * d;
+			weight += w;
+		}
+
+		void Add(const Quadric& other)
+		{
+			a00 += other.a00; a11 += other.a11; a22 += other.a22;
+			a01 += other.a01; a02 += other.a02; a12 += other.a12;
+			b0 += other.b0; b1 += other.b1; b2 += other.b2;
+			c += other.c;
+			weight += other.weight;
+		}
+
+		// Weighted average of the squared distances from p to every plane
+		double Evaluate(const XMFLOAT3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double error =
+				a00 * x * x + a11 * y * y + a22 * z * z +
+				2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+				2.0 * (b0 * x + b1 * y + b2 * z) +
+				c;
+			return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+		}
+	};
+
+	unsigned long long EdgeKey(unsigned int a, unsigned int b)
+	{
+		return ((unsigned long long)a << 32) | b;
+	}
+
+	// Unnormalized normal of a triangle (twice its area long)
+	XMVECTOR TriangleNormal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2)
+	{
+		XMVECTOR a = XMLoadFloat3(&p0);
+		return XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&p1), a), XMVectorSubtract(XMLoadFloat3(&p2), a));
+	}
+
+	// How different two vertices' attributes are (before scaling by the edge length)
+	double AttributeCost(const Vertex& a, const Vertex& b)
+	{
+		double du = a.UV.x - b.UV.x;
+		double dv = a.UV.y - b.UV.y;
+		double normalDot = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&a.Normal), XMLoadFloat3(&b.Normal)));
+		return UVWeight * (du * du + dv * dv) + NormalWeight * (1.0 - normalDot);
+	}
+
+	// --------------------------------------------------------
+	// A possible collapse of one vertex (and every other
+	// vertex in the same spot) onto a neighbor
+	// --------------------------------------------------------
+	struct Collapse
+	{
+		unsigned int from;	// Vertex index (any of its wedges)
+		unsigned int to;
+		double cost;
+	};
+}
+
+// --------------------------------------------------------
+// Edge collapse simplification in passes
+// - Vertices in the same spot (split by UV or normal seams)
+//    are grouped into "wedges" and always move together
+// - Each pass finds the cheapest collapse for every vertex,
+//    then applies as many as it can in order of cost,
+//    skipping any near an earlier collapse in the same pass
+//    (so the cost and flip checks stay accurate)
+// - Collapses are half-edge: the survivor keeps its spot
+//    and attributes, so no vertex data is ever created
+// --------------------------------------------------------
+float MeshSimplifier::Simplify(const MeshData& mesh, const unsigned int* indices, size_t indexCount,
+	size_t targetIndexCount, float maxError, std::vector<unsigned int>& out)
+{
+	out.assign(indices, indices + indexCount - indexCount % 3);
+
+	const std::vector<Vertex>& vertices = mesh.vertices;
+	size_t vertexCount = vertices.size();
+	float extent = std::max({ mesh.boundsMax.x - mesh.boundsMin.x, mesh.boundsMax.y - mesh.boundsMin.y, mesh.boundsMax.z - mesh.boundsMin.z });
+	if (out.size() <= targetIndexCount || vertexCount == 0 || extent <= 0.0f)
+		return 0.0f;
+
+	// Group vertices that share a position into a ring of wedges
+	// - position[v] is the first vertex found at v's spot
+	// - uvGroup[v] is the first vertex at v's spot with the same UV;
+	//    only UVs split the surface apart, normals just add cost
+	std::vector<unsigned int> position(vertexCount);
+	std::vector<unsigned int> uvGroup(vertexCount);
+	std::vector<unsigned int> nextWedge(vertexCount);
+	{
+		std::unordered_map<unsigned long long, unsigned int> firstAt;
+		firstAt.reserve(vertexCount);
+		for (unsigned int v = 0; v < vertexCount; v++)
+		{
+			const XMFLOAT3& p = vertices[v].Position;
+			unsigned int bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			unsigned long long key = ((unsigned long long)bits[0] * 73856093ull) ^ ((unsigned long long)bits[1] * 19349663ull << 20) ^ ((unsigned long long)bits[2] * 83492791ull << 40);
+
+			// Walk past (rare) hash collisions with other positions
+			unsigned int first = v;
+			auto found = firstAt.find(key);
+			while (found != firstAt.end())
+			{
+				const XMFLOAT3& q = vertices[found->second].Position;
+				if (q.x == p.x && q.y == p.y && q.z == p.z)
+				{
+					first = found->second;
+					break;
+				}
+				found = firstAt.find(++key);
+			}
+			if (first == v)
+				firstAt.emplace(key, v);
+
+			position[v] = first;
+			uvGroup[v] = v;
+			nextWedge[v] = v;
+			if (first != v)
+			{
+				unsigned int w = first;
+				do
+				{
+					if (uvGroup[w] == w && vertices[w].UV.x == vertices[v].UV.x && vertices[w].UV.y == vertices[v].UV.y)
+					{
+						uvGroup[v] = w;
+						break;
+					}
+					w = nextWedge[w];
+				} while (w != first);
+
+				nextWedge[v] = nextWedge[first];
+				nextWedge[first] = v;
+			}
+		}
+	}
+
+	// Classify every spot from the edges around it
+	// - An "open" edge has no opposite edge between the same two UV groups
+	// - If the opposite exists between other UV groups of the same spots
+	//    it's a seam, otherwise it's a border
+	std::vector<VertexKind> kind(vertexCount, VertexKind::Manifold);
+	std::unordered_set<unsigned long long> seamEdges;
+	std::unordered_set<unsigned long long> borderEdges;
+	{
+		std::unordered_set<unsigned long long> edges;
+		std::unordered_set<unsigned long long> positionEdges;
+		edges.reserve(out.size());
+		positionEdges.reserve(out.size());
+		for (size_t i = 0; i < out.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned int a = out[i + e];
+				unsigned int b = out[i + (e + 1) % 3];
+				edges.insert(EdgeKey(uvGroup[a], uvGroup[b]));
+				positionEdges.insert(EdgeKey(position[a], position[b]));
+			}
+		}
+
+		// Counted per UV group
+		std::vector<unsigned char> openOut(vertexCount, 0);
+		std::vector<unsigned char> openIn(vertexCount, 0);
+		std::vector<unsigned char> borderCount(vertexCount, 0);
+		for (const unsigned long long& edge : edges)
+		{
+			unsigned int a = (unsigned int)(edge >> 32);
+			unsigned int b = (unsigned int)edge;
+			if (edges.count(EdgeKey(b, a)))
+				continue;
+
+			openOut[a] = (unsigned char)std::min(openOut[a] + 1, 255);
+			openIn[b] = (unsigned char)std::min(openIn[b] + 1, 255);
+			if (positionEdges.count(EdgeKey(position[b], position[a])))
+			{
+				seamEdges.insert(EdgeKey(position[a], position[b]));
+			}
+			else
+			{
+				borderEdges.insert(EdgeKey(position[a], position[b]));
+				borderCount[a] = (unsigned char)std::min(borderCount[a] + 1, 255);
+				borderCount[b] = (unsigned char)std::min(borderCount[b] + 1, 255);
+			}
+		}
+
+		for (unsigned int v = 0; v < vertexCount; v++)
+		{
+			if (position[v] != v)
+				continue;
+
+			unsigned int groupCount = 0;
+			bool anyOpen = false;
+			bool allSingleOpen = true;
+			bool anyBorder = false;
+			unsigned int w = v;
+			do
+			{
+				if (uvGroup[w] == w)
+				{
+					groupCount++;
+					anyOpen |= openOut[w] || openIn[w];
+					allSingleOpen &= openOut[w] == 1 && openIn[w] == 1;
+					anyBorder |= borderCount[w] > 0;
+				}
+				w = nextWedge[w];
+			} while (w != v);
+
+			VertexKind k = VertexKind::Locked;
+			if (groupCount == 1 && !anyOpen)
+				k = VertexKind::Manifold;
+			else if (groupCount == 1 && allSingleOpen && borderCount[v] == 2)
+				k = VertexKind::Border;
+			else if (groupCount == 2 && allSingleOpen && !anyBorder)
+				k = VertexKind::Seam;
+
+			w = v;
+			do
+			{
+				kind[w] = k;
+				w = nextWedge[w];
+			} while (w != v);
+		}
+	}
+
+	// Surface quadrics per spot, weighted by triangle area, plus
+	// planes standing up along borders and seams to hold them in place
+	std::vector<Quadric> quadrics(vertexCount, Quadric{});
+	for (size_t i = 0; i < out.size(); i += 3)
+	{
+		const XMFLOAT3& p0 = vertices[out[i]].Position;
+		const XMFLOAT3& p1 = vertices[out[i + 1]].Position;
+		const XMFLOAT3& p2 = vertices[out[i + 2]].Position;
+		XMVECTOR normal = TriangleNormal(p0, p1, p2);
+		float length = XMVectorGetX(XMVector3Length(normal));
+		if (length <= 0.0f)
+			continue;
+
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, XMVectorScale(normal, 1.0f / length));
+		double d = -((double)n.x * p0.x + (double)n.y * p0.y + (double)n.z * p0.z);
+		double area = length * 0.5;
+		for (int c = 0; c < 3; c++)
+			quadrics[position[out[i + c]]].AddPlane(n.x, n.y, n.z, d, area);
+
+		for (int e = 0; e < 3; e++)
+		{
+			unsigned int a = position[out[i + e]];
+			unsigned int b = position[out[i + (e + 1) % 3]];
+			unsigned long long key = EdgeKey(a, b);
+			if (!seamEdges.count(key) && !borderEdges.count(key))
+				continue;
+
+			// Plane through the edge, perpendicular to the triangle
+			XMVECTOR pa = XMLoadFloat3(&vertices[a].Position);
+			XMVECTOR edge = XMVectorSubtract(XMLoadFloat3(&vertices[b].Position), pa);
+			float edgeLength = XMVectorGetX(XMVector3Length(edge));
+			if (edgeLength <= 0.0f)
+				continue;
+
+			XMFLOAT3 en;
+			XMStoreFloat3(&en, XMVector3Normalize(XMVector3Cross(edge, XMLoadFloat3(&n))));
+			double ed = -((double)en.x * vertices[a].Position.x + (double)en.y * vertices[a].Position.y + (double)en.z * vertices[a].Position.z);
+			double w = BorderWeight * edgeLength * edgeLength;
+			quadrics[a].AddPlane(en.x, en.y, en.z, ed, w);
+			quadrics[b].AddPlane(en.x, en.y, en.z, ed, w);
+		}
+	}
+
+	double maxCost = (double)maxError * extent * (double)maxError * extent;
+	double reachedCost = 0.0;
+	size_t triangleCount = out.size() / 3;
+	size_t targetTriangles = targetIndexCount / 3;
+
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> bestCollapse(vertexCount);
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<std::pair<unsigned int, unsigned int>> exactTargets;
+	std::vector<std::pair<unsigned int, unsigned int>> groupTargets;
+	while (triangleCount > targetTriangles)
+	{
+		// Which triangles touch each spot (by its first wedge)
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (unsigned int index : out)
+			adjacencyOffsets[position[index] + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		adjacency.resize(out.size());
+		{
+			std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < out.size(); i++)
+				adjacency[fill[position[out[i]]]++] = (unsigned int)(i / 3);
+		}
+
+		// Cheapest allowed collapse for every spot
+		collapses.clear();
+		std::fill(bestCollapse.begin(), bestCollapse.end(), UINT32_MAX);
+		for (size_t i = 0; i < out.size(); i += 3)
+		{
+			for (int e = 0; e < 6; e++)
+			{
+				// Both directions of each edge
+				unsigned int from = out[i + e % 3];
+				unsigned int to = out[i + (e % 3 + (e < 3 ? 1 : 2)) % 3];
+				unsigned int pf = position[from];
+				unsigned int pt = position[to];
+				if (pf == pt)
+					continue;
+
+				VertexKind fromKind = kind[from];
+				VertexKind toKind = kind[to];
+				if (fromKind == VertexKind::Locked)
+					continue;
+				if (fromKind == VertexKind::Border &&
+					(toKind == VertexKind::Manifold || toKind == VertexKind::Seam ||
+					(!borderEdges.count(EdgeKey(pf, pt)) && !borderEdges.count(EdgeKey(pt, pf)))))
+					continue;
+				if (fromKind == VertexKind::Seam &&
+					(toKind == VertexKind::Manifold || toKind == VertexKind::Border ||
+					(!seamEdges.count(EdgeKey(pf, pt)) && !seamEdges.count(EdgeKey(pt, pf)))))
+					continue;
+
+				// Surface error, plus the cost of this wedge's attributes changing
+				// (the other wedges are checked once it's picked)
+				XMVECTOR edge = XMVectorSubtract(XMLoadFloat3(&vertices[to].Position), XMLoadFloat3(&vertices[from].Position));
+				double cost = quadrics[pf].Evaluate(vertices[to].Position) +
+					XMVectorGetX(XMVector3LengthSq(edge)) * AttributeCost(vertices[from], vertices[to]);
+
+				unsigned int& best = bestCollapse[pf];
+				if (best == UINT32_MAX)
+				{
+					best = (unsigned int)collapses.size();
+					collapses.push_back({ from, to, cost });
+				}
+				else if (cost < collapses[best].cost)
+				{
+					collapses[best] = { from, to, cost };
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		for (unsigned int v = 0; v < vertexCount; v++)
+			remap[v] = v;
+		std::fill(touched.begin(), touched.end(), false);
+
+		size_t removed = 0;
+		size_t applied = 0;
+		bool hitErrorLimit = false;
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.cost > maxCost)
+			{
+				hitErrorLimit = true;
+				break;
+			}
+			if (triangleCount - removed <= targetTriangles)
+				break;
+
+			unsigned int pf = position[collapse.from];
+			unsigned int pt = position[collapse.to];
+			if (touched[pf] || touched[pt])
+				continue;
+
+			// Each wedge of the moving spot goes to the wedge of the target
+			// it shares a triangle with, or failing that, to the one its UV
+			// group goes to (every UV group must go to a single UV group)
+			bool valid = true;
+			exactTargets.clear();
+			groupTargets.clear();
+			for (unsigned int a = adjacencyOffsets[pf]; a < adjacencyOffsets[pf + 1] && valid; a++)
+			{
+				const unsigned int* triangle = &out[(size_t)adjacency[a] * 3];
+				unsigned int from = UINT32_MAX;
+				unsigned int to = UINT32_MAX;
+				for (int c = 0; c < 3; c++)
+				{
+					if (position[triangle[c]] == pf)
+						from = triangle[c];
+					else if (position[triangle[c]] == pt)
+						to = triangle[c];
+				}
+				if (to == UINT32_MAX)
+					continue;
+
+				exactTargets.push_back({ from, to });
+				auto group = std::find_if(groupTargets.begin(), groupTargets.end(), [&](const std::pair<unsigned int, unsigned int>& g) { return g.first == uvGroup[from]; });
+				if (group == groupTargets.end())
+					groupTargets.push_back({ uvGroup[from], to });
+				else if (uvGroup[group->second] != uvGroup[to])
+					valid = false;
+			}
+
+			double attributeCost = 0.0;
+			unsigned int w = pf;
+			do
+			{
+				auto exact = std::find_if(exactTargets.begin(), exactTargets.end(), [&](const std::pair<unsigned int, unsigned int>& e) { return e.first == w; });
+				auto group = std::find_if(groupTargets.begin(), groupTargets.end(), [&](const std::pair<unsigned int, unsigned int>& g) { return g.first == uvGroup[w]; });
+				if (exact != exactTargets.end())
+				{
+					remap[w] = exact->second;
+				}
+				else if (group != groupTargets.end())
+				{
+					remap[w] = group->second;
+				}
+				else
+				{
+					// Only unused wedges can go anywhere
+					for (unsigned int a = adjacencyOffsets[pf]; a < adjacencyOffsets[pf + 1]; a++)
+					{
+						const unsigned int* triangle = &out[(size_t)adjacency[a] * 3];
+						valid &= triangle[0] != w && triangle[1] != w && triangle[2] != w;
+					}
+					remap[w] = collapse.to;
+				}
+
+				attributeCost = std::max(attributeCost, AttributeCost(vertices[w], vertices[remap[w]]));
+				w = nextWedge[w];
+			} while (w != pf && valid);
+
+			// The full cost, now that every wedge's new attributes are known
+			XMVECTOR edge = XMVectorSubtract(XMLoadFloat3(&vertices[collapse.to].Position), XMLoadFloat3(&vertices[collapse.from].Position));
+			double cost = quadrics[pf].Evaluate(vertices[collapse.to].Position) + XMVectorGetX(XMVector3LengthSq(edge)) * attributeCost;
+			valid &= cost <= maxCost;
+
+			// Don't let any remaining triangle flip over (or nearly)
+			size_t collapsedTriangles = 0;
+			for (unsigned int a = adjacencyOffsets[pf]; a < adjacencyOffsets[pf + 1] && valid; a++)
+			{
+				const unsigned int* triangle = &out[(size_t)adjacency[a] * 3];
+				XMFLOAT3 p[3];
+				bool hasTarget = false;
+				for (int c = 0; c < 3; c++)
+				{
+					hasTarget |= position[triangle[c]] == pt;
+					p[c] = position[triangle[c]] == pf ? vertices[collapse.to].Position : vertices[triangle[c]].Position;
+				}
+				if (hasTarget)
+				{
+					collapsedTriangles++;
+					continue;
+				}
+
+				XMVECTOR before = TriangleNormal(vertices[triangle[0]].Position, vertices[triangle[1]].Position, vertices[triangle[2]].Position);
+				XMVECTOR after = TriangleNormal(p[0], p[1], p[2]);
+				float dot = XMVectorGetX(XMVector3Dot(before, after));
+				float lengths = XMVectorGetX(XMVector3Length(before)) * XMVectorGetX(XMVector3Length(after));
+				if (dot < MinFlipDot * lengths)
+					valid = false;
+			}
+
+			if (!valid)
+			{
+				w = pf;
+				do
+				{
+					remap[w] = w;
+					w = nextWedge[w];
+				} while (w != pf);
+				continue;
+			}
+
+			// Keep everything around this collapse out of the rest of the pass
+			for (unsigned int a = adjacencyOffsets[pf]; a < adjacencyOffsets[pf + 1]; a++)
+			{
+				const unsigned int* triangle = &out[(size_t)adjacency[a] * 3];
+				for (int c = 0; c < 3; c++)
+					touched[position[triangle[c]]] = true;
+			}
+
+			quadrics[pt].Add(quadrics[pf]);
+			reachedCost = std::max(reachedCost, cost);
+			removed += collapsedTriangles;
+			applied++;
+		}
+
+		if (applied == 0)
+			break;
+
+		// Apply the collapses, dropping triangles that now have no area
+		size_t write = 0;
+		for (size_t i = 0; i < out.size(); i += 3)
+		{
+			unsigned int a = remap[out[i]];
+			unsigned int b = remap[out[i + 1]];
+			unsigned int c = remap[out[i + 2]];
+			if (position[a] == position[b] || position[b] == position[c] || position[a] == position[c])
+				continue;
+
+			out[write++] = a;
+			out[write++] = b;
+			out[write++] = c;
+		}
+		out.resize(write);
+		triangleCount = write / 3;
+
+		if (hitErrorLimit)
+			break;
+	}
+
+	return (float)(sqrt(reachedCost) / extent);
+}
+
+// --------------------------------------------------------
+// Builds each LOD from the full detail triangles, so errors
+// don't stack up along the chain
+// --------------------------------------------------------
+void MeshSimplifier::BuildLods(MeshData& mesh, const std::vector<float>& triangleRatios, float maxError)
+{
+	if (mesh.lods.empty())
+		mesh.lods.assign(1, { 0, (unsigned int)mesh.indices.size(), 0.0f });
+	mesh.lods.resize(1);
+
+	MeshLod full = mesh.lods[0];
+	std::vector<unsigned int> lodIndices;
+	for (float ratio : triangleRatios)
+	{
+		size_t target = (size_t)(full.IndexCount / 3 * ratio) * 3;
+		float error = Simplify(mesh, &mesh.indices[full.StartIndex], full.IndexCount, target, maxError, lodIndices);
+
+		// Not worth keeping if it's no smaller than the last one
+		if (lodIndices.empty() || lodIndices.size() >= mesh.lods.back().IndexCount)
+			break;
+
+		MeshOptimizer::OptimizeVertexCache(lodIndices.data(), lodIndices.size(), mesh.vertices.size());
+
+		mesh.lods.push_back({ (unsigned int)mesh.indices.size(), (unsigned int)lodIndices.size(), error });
+		mesh.indices.insert(mesh.indices.end(), lodIndices.begin(), lodIndices.end());
+	}
+}
+
+void MeshSimplifier::BuildLods(const std::vector<MeshData*>& meshes, unsigned int threadCount,
+	const std::vector<float>& triangleRatios, float maxError)
+{
+	// Each thread takes the next mesh nobody has started yet
+	std::atomic<size_t> next = 0;
+	auto work = [&]()
+		{
+			for (size_t i = next++; i < meshes.size(); i = next++)
+				BuildLods(*meshes[i], triangleRatios, maxError);
+		};
+
+	std::vector<std::thread> threads;
+	threadCount = std::clamp(threadCount, 1u, (unsigned int)std::max(meshes.size(), (size_t)1));
+	for (unsigned int t = 1; t < threadCount; t++)
+		threads.emplace_back(work);
+	work();
+
+	for (std::thread& thread : threads)
+		thread.join();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include "MeshData.h"
+
+// --------------------------------------------------------
+// Builds lower detail versions of a mesh by collapsing
+// edges (Garland-Heckbert quadric error metrics), for
+// drawing distant objects with fewer triangles
+// --------------------------------------------------------
+namespace MeshSimplifier
+{
+	// Largest error (relative to the mesh's largest extent) any LOD may have
+	const float DefaultMaxError = 0.1f;
+
+	// Triangle ratios (of the full mesh) for each LOD after the first
+	const std::vector<float> DefaultLodRatios = { 0.5f, 0.25f, 0.125f };
+
+	// Simplifies a range of a mesh's triangles down to targetIndexCount
+	// indices, unless that would move the surface more than maxError
+	// - Only edges are collapsed onto existing vertices, so the result
+	//    reuses the mesh's vertices and needs no new ones
+	// - UV seams and open borders only collapse along themselves, and
+	//    collapses across differing UVs and normals cost extra
+	// - Returns the error reached, relative to the largest extent of the bounds
+	float Simplify(const MeshData& mesh, const unsigned int* indices, size_t indexCount,
+		size_t targetIndexCount, float maxError, std::vector<unsigned int>& out);
+
+	// Appends a LOD to the mesh's indices for each ratio, each simplified
+	// from the full detail triangles and optimized for the vertex cache
+	// - LOD 0 (the full mesh) must be the only one so far
+	// - Stops early if a LOD can't get any smaller within maxError
+	void BuildLods(MeshData& mesh, const std::vector<float>& triangleRatios = DefaultLodRatios, float maxError = DefaultMaxError);
+
+	// Same as above for several meshes at once, one per thread
+	void BuildLods(const std::vector<MeshData*>& meshes, unsigned int threadCount,
+		const std::vector<float>& triangleRatios = DefaultLodRatios, float maxError = DefaultMaxError);
+}
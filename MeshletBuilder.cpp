@@ -0,0 +1,308 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// ConeCutoff for meshlets that can never be backface culled
+	// (the dot product in Test() can't get this high)
+	const float NeverCull = 2.0f;
+
+	// Cones wider than this (the smallest dot product between
+	// the axis and a triangle normal) are too wide to be useful
+	const float MinConeDot = 0.1f;
+
+	// How much a candidate triangle's facing counts against it, in
+	// "new vertices" (see Build); 0 builds purely for vertex reuse
+	const float ConeWeight = 0.5f;
+
+	// How many of a triangle's (distinct) vertices aren't yet in the current meshlet?
+	unsigned int CountNewVertices(const unsigned int* triangle, const std::vector<unsigned int>& meshletStamp, unsigned int stamp)
+	{
+		unsigned int a = triangle[0];
+		unsigned int b = triangle[1];
+		unsigned int c = triangle[2];
+		return
+			(meshletStamp[a] != stamp) +
+			(meshletStamp[b] != stamp && b != a) +
+			(meshletStamp[c] != stamp && c != a && c != b);
+	}
+
+	// --------------------------------------------------------
+	// Fills in a finished meshlet's bounding sphere and
+	// backface cone
+	// - The cone's apex is pulled back along the axis until
+	//    it's behind every triangle's plane, which keeps the
+	//    test correct for viewers close to the meshlet
+	// - normals and corners are scratch space, reused between
+	//    meshlets
+	// --------------------------------------------------------
+	void CalculateBounds(const Vertex* vertices, const MeshletData& data, Meshlet& meshlet,
+		std::vector<XMFLOAT3>& normals, std::vector<XMFLOAT3>& corners)
+	{
+		// Sphere around the center of the bounding box
+		XMVECTOR minimum = XMVectorReplicate(FLT_MAX);
+		XMVECTOR maximum = XMVectorReplicate(-FLT_MAX);
+		for (unsigned int i = 0; i < meshlet.VertexCount; i++)
+		{
+			XMVECTOR position = XMLoadFloat3(&vertices[data.vertices[meshlet.VertexOffset + i]].Position);
+			minimum = XMVectorMin(minimum, position);
+			maximum = XMVectorMax(maximum, position);
+		}
+		XMVECTOR center = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+
+		float radiusSquared = 0.0f;
+		for (unsigned int i = 0; i < meshlet.VertexCount; i++)
+		{
+			XMVECTOR position = XMLoadFloat3(&vertices[data.vertices[meshlet.VertexOffset + i]].Position);
+			radiusSquared = std::max(radiusSquared, XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(position, center))));
+		}
+		XMStoreFloat3(&meshlet.Center, center);
+		meshlet.Radius = sqrtf(radiusSquared);
+
+		// Face normals, from the winding D3D treats as front facing
+		normals.clear();
+		corners.clear();
+		XMVECTOR normalSum = XMVectorZero();
+		for (unsigned int t = 0; t < meshlet.TriangleCount; t++)
+		{
+			const unsigned char* triangle = &data.triangles[(size_t)(meshlet.TriangleOffset + t) * 3];
+			XMVECTOR p0 = XMLoadFloat3(&vertices[data.vertices[meshlet.VertexOffset + triangle[0]]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[data.vertices[meshlet.VertexOffset + triangle[1]]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[data.vertices[meshlet.VertexOffset + triangle[2]]].Position);
+
+			XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			float length = XMVectorGetX(XMVector3Length(normal));
+			if (length <= 0.0f)
+				continue;	// Degenerate triangles are never drawn, so they don't matter
+
+			normal = XMVectorScale(normal, 1.0f / length);
+			normalSum = XMVectorAdd(normalSum, normal);
+
+			normals.emplace_back();
+			corners.emplace_back();
+			XMStoreFloat3(&normals.back(), normal);
+			XMStoreFloat3(&corners.back(), p0);
+		}
+
+		meshlet.ConeApex = meshlet.Center;
+		meshlet.ConeAxis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		meshlet.ConeCutoff = NeverCull;
+
+		float sumLength = XMVectorGetX(XMVector3Length(normalSum));
+		if (normals.empty() || sumLength <= 0.0f)
+			return;
+
+		XMVECTOR axis = XMVectorScale(normalSum, 1.0f / sumLength);
+		float minDot = 1.0f;
+		for (const XMFLOAT3& normal : normals)
+			minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(axis, XMLoadFloat3(&normal))));
+
+		if (minDot <= MinConeDot)
+			return;
+
+		// Walk back from the center along the axis until every triangle's plane is in front
+		float maxT = 0.0f;
+		for (size_t i = 0; i < normals.size(); i++)
+		{
+			XMVECTOR normal = XMLoadFloat3(&normals[i]);
+			float distance = XMVectorGetX(XMVector3Dot(XMVectorSubtract(center, XMLoadFloat3(&corners[i])), normal));
+			float alignment = XMVectorGetX(XMVector3Dot(axis, normal));
+			maxT = std::max(maxT, distance / alignment);
+		}
+
+		XMStoreFloat3(&meshlet.ConeApex, XMVectorSubtract(center, XMVectorScale(axis, maxT)));
+		XMStoreFloat3(&meshlet.ConeAxis, axis);
+
+		// Viewers within 90 degrees minus the widest normal's angle of the axis see only back faces
+		meshlet.ConeCutoff = sqrtf(1.0f - minDot * minDot);
+	}
+}
+
+// --------------------------------------------------------
+// Greedy meshlet builder
+// - Each meshlet starts from the first unused triangle, then
+//    repeatedly takes the unused triangle touching its
+//    vertices that needs the fewest new ones, favoring
+//    triangles that face the same way (for tighter cones)
+// - When nothing touching it is left (a separate piece of
+//    the mesh), it continues with the next unused triangle
+//    in index order, which MeshOptimizer already made local
+// - A triangle that doesn't fit seeds the next meshlet, so
+//    consecutive meshlets stay next to each other
+// --------------------------------------------------------
+void MeshletBuilder::Build(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+	MeshletData& out, unsigned int maxVertices, unsigned int maxTriangles)
+{
+	out.meshlets.clear();
+	out.vertices.clear();
+	out.triangles.clear();
+
+	// Local indices are stored in a byte
+	maxVertices = std::clamp(maxVertices, 3u, 256u);
+	maxTriangles = std::max(maxTriangles, 1u);
+
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Which triangles use each vertex (flattened lists, one after another)
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacencyOffsets[indices[i] + 1]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		unsigned int v = indices[i];
+		adjacency[adjacencyOffsets[v] + liveTriangles[v]++] = (unsigned int)(i / 3);
+	}
+
+	// Which meshlet each vertex was last added to (0 = none yet), and its local index there
+	std::vector<unsigned int> meshletStamp(vertexCount, 0);
+	std::vector<unsigned char> localIndex(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+
+	// Face normals, so each meshlet can prefer triangles facing the same way
+	std::vector<XMFLOAT3> triangleNormals(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+		XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+		float length = XMVectorGetX(XMVector3Length(normal));
+		XMStoreFloat3(&triangleNormals[t], length > 0.0f ? XMVectorScale(normal, 1.0f / length) : XMVectorZero());
+	}
+
+	out.meshlets.reserve(triangleCount / maxTriangles + 1);
+	out.vertices.reserve(triangleCount);
+	out.triangles.reserve(triangleCount * 3);
+
+	Meshlet current = {};
+	XMVECTOR currentNormalSum = XMVectorZero();
+	XMVECTOR currentAxis = XMVectorZero();
+	unsigned int stamp = 1;
+	size_t cursor = 0;
+	for (size_t remaining = triangleCount; remaining > 0; remaining--)
+	{
+		// Best unused triangle touching the meshlet so far: fewest new
+		// vertices, then closest to the way the meshlet faces
+		size_t best = triangleCount;
+		unsigned int bestNew = 4;
+		float bestScore = FLT_MAX;
+		for (unsigned int i = 0; i < current.VertexCount; i++)
+		{
+			unsigned int v = out.vertices[current.VertexOffset + i];
+			if (liveTriangles[v] == 0)
+				continue;
+
+			for (unsigned int a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++)
+			{
+				unsigned int t = adjacency[a];
+				if (emitted[t])
+					continue;
+
+				unsigned int newVertices = CountNewVertices(&indices[(size_t)t * 3], meshletStamp, stamp);
+				float facing = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&triangleNormals[t]), currentAxis));
+				float score = newVertices + ConeWeight * (1.0f - facing);
+				if (score < bestScore)
+				{
+					best = t;
+					bestNew = newVertices;
+					bestScore = score;
+				}
+			}
+		}
+
+		// Nothing connected, so fall back to index order
+		if (best == triangleCount)
+		{
+			while (emitted[cursor])
+				cursor++;
+			best = cursor;
+			bestNew = CountNewVertices(&indices[best * 3], meshletStamp, stamp);
+		}
+
+		// Start a new meshlet if this triangle won't fit
+		if (current.VertexCount + bestNew > maxVertices || current.TriangleCount + 1 > maxTriangles)
+		{
+			out.meshlets.push_back(current);
+			current = {};
+			current.VertexOffset = (unsigned int)out.vertices.size();
+			current.TriangleOffset = (unsigned int)(out.triangles.size() / 3);
+			currentNormalSum = XMVectorZero();
+			currentAxis = XMVectorZero();
+			stamp++;
+		}
+
+		for (size_t corner = 0; corner < 3; corner++)
+		{
+			unsigned int v = indices[best * 3 + corner];
+			if (meshletStamp[v] != stamp)
+			{
+				meshletStamp[v] = stamp;
+				localIndex[v] = (unsigned char)current.VertexCount++;
+				out.vertices.push_back(v);
+			}
+			out.triangles.push_back(localIndex[v]);
+			liveTriangles[v]--;
+		}
+		emitted[best] = true;
+		current.TriangleCount++;
+
+		currentNormalSum = XMVectorAdd(currentNormalSum, XMLoadFloat3(&triangleNormals[best]));
+		float sumLength = XMVectorGetX(XMVector3Length(currentNormalSum));
+		if (sumLength > 0.0f)
+			currentAxis = XMVectorScale(currentNormalSum, 1.0f / sumLength);
+	}
+	out.meshlets.push_back(current);
+
+	std::vector<XMFLOAT3> normals;
+	std::vector<XMFLOAT3> corners;
+	for (Meshlet& meshlet : out.meshlets)
+		CalculateBounds(vertices, out, meshlet, normals, corners);
+}
+
+// --------------------------------------------------------
+// Frustum test on the bounding sphere, then backface test
+// on the cone
+// --------------------------------------------------------
+MeshletVisibility MeshletBuilder::Test(const Meshlet& meshlet, const Frustum& frustum, XMFLOAT3 viewPosition)
+{
+	if (!frustum.IntersectsSphere(meshlet.Center, meshlet.Radius))
+		return MeshletVisibility::OutsideFrustum;
+
+	// Same as dot(normalize(apex - view), axis) >= cutoff, without the divide
+	XMVECTOR toApex = XMVectorSubtract(XMLoadFloat3(&meshlet.ConeApex), XMLoadFloat3(&viewPosition));
+	float alignment = XMVectorGetX(XMVector3Dot(toApex, XMLoadFloat3(&meshlet.ConeAxis)));
+	if (alignment >= meshlet.ConeCutoff * XMVectorGetX(XMVector3Length(toApex)) && alignment > 0.0f)
+		return MeshletVisibility::Backfacing;
+
+	return MeshletVisibility::Visible;
+}
+
+unsigned int MeshletBuilder::Cull(const MeshletData& data, const Frustum& frustum, XMFLOAT3 viewPosition, std::vector<unsigned int>& visibleMeshlets)
+{
+	visibleMeshlets.clear();
+
+	unsigned int visibleTriangles = 0;
+	for (size_t i = 0; i < data.meshlets.size(); i++)
+	{
+		if (Test(data.meshlets[i], frustum, viewPosition) == MeshletVisibility::Visible)
+		{
+			visibleMeshlets.push_back((unsigned int)i);
+			visibleTriangles += data.meshlets[i].TriangleCount;
+		}
+	}
+	return visibleTriangles;
+}
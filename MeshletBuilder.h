@@ -0,0 +1,76 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Frustum.h"
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// A small cluster of neighboring triangles that can be
+// culled as a unit
+// --------------------------------------------------------
+struct Meshlet
+{
+	unsigned int VertexOffset;		// First entry in MeshletData::vertices
+	unsigned int VertexCount;
+	unsigned int TriangleOffset;	// First triangle in MeshletData::triangles
+	unsigned int TriangleCount;
+
+	// Local-space sphere around every vertex
+	DirectX::XMFLOAT3 Center;
+	float Radius;
+
+	// Backface cone: if the viewer is inside it, every triangle faces away
+	// - Culled when dot(normalize(ConeApex - viewPosition), ConeAxis) >= ConeCutoff
+	// - ConeCutoff is above 1 when the triangles spread too far to ever cull
+	DirectX::XMFLOAT3 ConeApex;
+	DirectX::XMFLOAT3 ConeAxis;
+	float ConeCutoff;
+};
+
+// --------------------------------------------------------
+// Every meshlet of one mesh
+// --------------------------------------------------------
+struct MeshletData
+{
+	std::vector<Meshlet> meshlets;
+
+	// Mesh vertex index of each meshlet-local vertex
+	std::vector<unsigned int> vertices;
+
+	// Meshlet-local vertex indices, 3 per triangle
+	std::vector<unsigned char> triangles;
+};
+
+// --------------------------------------------------------
+// Why a meshlet was (or wasn't) culled
+// --------------------------------------------------------
+enum class MeshletVisibility
+{
+	Visible,
+	OutsideFrustum,
+	Backfacing
+};
+
+namespace MeshletBuilder
+{
+	// Default limits, which suit mesh shaders and GPU culling alike
+	const unsigned int MaxVertices = 64;
+	const unsigned int MaxTriangles = 124;
+
+	// Splits a mesh into meshlets of at most maxVertices vertices (up to
+	// 256) and maxTriangles triangles, then finds their bounds and cones
+	// - Triangles are grown outward from a seed, preferring the ones
+	//    that add the fewest new vertices and face the same way, so
+	//    meshlets stay compact and their cones stay narrow
+	void Build(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+		MeshletData& out, unsigned int maxVertices = MaxVertices, unsigned int maxTriangles = MaxTriangles);
+
+	// Tests one meshlet against a frustum and a viewer, both in the mesh's local space
+	MeshletVisibility Test(const Meshlet& meshlet, const Frustum& frustum, DirectX::XMFLOAT3 viewPosition);
+
+	// Fills visibleMeshlets with the index of every meshlet that passes Test()
+	// and returns how many triangles they hold
+	unsigned int Cull(const MeshletData& data, const Frustum& frustum, DirectX::XMFLOAT3 viewPosition, std::vector<unsigned int>& visibleMeshlets);
+}
@@ -0,0 +1,508 @@
+#include "ObjParser.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Marks a corner attribute that the face didn't specify
+	const unsigned int MissingIndex = 0xFFFFFFFF;
+
+	// How many records of each type are in the file?
+	struct RecordCounts
+	{
+		size_t positions;
+		size_t uvs;
+		size_t normals;
+		size_t triangles;
+	};
+
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && IsSpace(*p))
+			p++;
+		return p;
+	}
+
+	const char* SkipToken(const char* p, const char* end)
+	{
+		while (p < end && !IsSpace(*p) && *p != '\n')
+			p++;
+		return p;
+	}
+
+	const char* NextLine(const char* p, const char* end)
+	{
+		const void* newline = memchr(p, '\n', end - p);
+		return newline ? (const char*)newline + 1 : end;
+	}
+
+	// Reads a single float, returning the position just past it
+	// - Malformed numbers read as zero rather than stopping the load
+	const char* ParseFloat(const char* p, const char* end, float& out)
+	{
+		p = SkipSpaces(p, end);
+
+		// std::from_chars doesn't accept a leading plus sign
+		if (p < end && *p == '+')
+			p++;
+
+		std::from_chars_result result = std::from_chars(p, end, out);
+		if (result.ec != std::errc())
+			out = 0.0f;
+
+		return result.ptr;
+	}
+
+	// Reads a (possibly negative) integer, returning the position just past it
+	// - Leaves "out" at zero if there are no digits, which OBJ never uses as an index
+	const char* ParseIndex(const char* p, const char* end, int& out)
+	{
+		bool negative = false;
+		if (p < end && *p == '-')
+		{
+			negative = true;
+			p++;
+		}
+
+		int value = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			value = value * 10 + (*p - '0');
+			p++;
+		}
+
+		out = negative ? -value : value;
+		return p;
+	}
+
+	// Turns a 1-based (or negative, relative) OBJ index into a 0-based one
+	unsigned int ResolveIndex(int index, size_t count)
+	{
+		if (index > 0)
+			return (unsigned int)(index - 1);
+		if (index == 0)
+			return MissingIndex;
+
+		long long resolved = (long long)count + index;
+		if (resolved < 0)
+			throw std::invalid_argument("Error parsing OBJ: Relative index points before the start of the file");
+
+		return (unsigned int)resolved;
+	}
+
+	// Fast first pass over the file so every output array can be sized exactly once
+	RecordCounts CountRecords(const char* p, const char* end)
+	{
+		RecordCounts counts = {};
+
+		while (p < end)
+		{
+			p = SkipSpaces(p, end);
+
+			if (end - p >= 2 && p[0] == 'v')
+			{
+				if (IsSpace(p[1])) counts.positions++;
+				else if (p[1] == 't') counts.uvs++;
+				else if (p[1] == 'n') counts.normals++;
+			}
+			else if (end - p >= 2 && p[0] == 'f' && IsSpace(p[1]))
+			{
+				// Count the corners on this face; an n-gon becomes n - 2 triangles
+				// - Must agree exactly with ParseRange(), which writes straight
+				//    into arrays sized from these counts
+				size_t faceCorners = 0;
+				p++;
+				while (true)
+				{
+					p = SkipSpaces(p, end);
+					if (p >= end || *p == '\n' || *p == '#')
+						break;
+
+					int posIndex = 0;
+					ParseIndex(p, end, posIndex);
+					if (posIndex != 0)
+						faceCorners++;
+
+					p = SkipToken(p, end);
+				}
+
+				if (faceCorners >= 3)
+					counts.triangles += faceCorners - 2;
+			}
+
+			p = NextLine(p, end);
+		}
+
+		return counts;
+	}
+
+	// Parses the lines in [p, end), writing each record into the (already sized)
+	// arrays of "out" starting at the given offsets
+	// - Negative indices are relative to everything before them, so they're
+	//    resolved using the offsets plus what's been read so far
+	void ParseRange(const char* p, const char* end, ObjData& out, RecordCounts offsets)
+	{
+		size_t positionCount = offsets.positions;
+		size_t uvCount = offsets.uvs;
+		size_t normalCount = offsets.normals;
+		size_t cornerCount = offsets.triangles * 3;
+
+		// Reused for every face so n-gons don't allocate per line
+		std::vector<ObjCorner> faceCorners;
+
+		while (p < end)
+		{
+			p = SkipSpaces(p, end);
+
+			if (end - p >= 2 && p[0] == 'v' && IsSpace(p[1]))
+			{
+				XMFLOAT3& pos = out.positions[positionCount++];
+				p = ParseFloat(p + 1, end, pos.x);
+				p = ParseFloat(p, end, pos.y);
+				p = ParseFloat(p, end, pos.z);
+			}
+			else if (end - p >= 2 && p[0] == 'v' && p[1] == 't')
+			{
+				XMFLOAT2& uv = out.uvs[uvCount++];
+				p = ParseFloat(p + 2, end, uv.x);
+				p = ParseFloat(p, end, uv.y);
+			}
+			else if (end - p >= 2 && p[0] == 'v' && p[1] == 'n')
+			{
+				XMFLOAT3& norm = out.normals[normalCount++];
+				p = ParseFloat(p + 2, end, norm.x);
+				p = ParseFloat(p, end, norm.y);
+				p = ParseFloat(p, end, norm.z);
+			}
+			else if (end - p >= 2 && p[0] == 'f' && IsSpace(p[1]))
+			{
+				faceCorners.clear();
+				p++;
+
+				// Each corner is "p", "p/t", "p//n" or "p/t/n"
+				while (true)
+				{
+					p = SkipSpaces(p, end);
+					if (p >= end || *p == '\n' || *p == '#')
+						break;
+
+					int posIndex = 0;
+					int uvIndex = 0;
+					int normalIndex = 0;
+					const char* token = ParseIndex(p, end, posIndex);
+					if (token < end && *token == '/')
+					{
+						token = ParseIndex(token + 1, end, uvIndex);
+						if (token < end && *token == '/')
+							ParseIndex(token + 1, end, normalIndex);
+					}
+
+					// Ignore anything after the corner, and skip anything
+					// we couldn't read as a corner at all
+					p = SkipToken(p, end);
+					if (posIndex == 0)
+						continue;
+
+					ObjCorner corner;
+					corner.Position = ResolveIndex(posIndex, positionCount);
+					corner.UV = ResolveIndex(uvIndex, uvCount);
+					corner.Normal = ResolveIndex(normalIndex, normalCount);
+					faceCorners.push_back(corner);
+				}
+
+				// Fan triangulate, flipping the winding order for left-handed space
+				for (size_t i = 1; i + 1 < faceCorners.size(); i++)
+				{
+					out.corners[cornerCount++] = faceCorners[0];
+					out.corners[cornerCount++] = faceCorners[i + 1];
+					out.corners[cornerCount++] = faceCorners[i];
+				}
+			}
+
+			p = NextLine(p, end);
+		}
+	}
+
+	// Replaces missing normals with smooth, area-weighted normals built
+	// from the faces that share each position
+	void GenerateNormals(ObjData& obj)
+	{
+		std::vector<XMFLOAT3> accumulated(obj.positions.size(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+
+		for (size_t i = 0; i + 2 < obj.corners.size(); i += 3)
+		{
+			unsigned int i0 = obj.corners[i].Position;
+			unsigned int i1 = obj.corners[i + 1].Position;
+			unsigned int i2 = obj.corners[i + 2].Position;
+
+			XMVECTOR p0 = XMLoadFloat3(&obj.positions[i0]);
+			XMVECTOR p1 = XMLoadFloat3(&obj.positions[i1]);
+			XMVECTOR p2 = XMLoadFloat3(&obj.positions[i2]);
+
+			// Not normalized, so larger faces contribute more
+			XMVECTOR faceNormal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+
+			unsigned int triangle[3] = { i0, i1, i2 };
+			for (unsigned int c = 0; c < 3; c++)
+			{
+				XMVECTOR sum = XMVectorAdd(XMLoadFloat3(&accumulated[triangle[c]]), faceNormal);
+				XMStoreFloat3(&accumulated[triangle[c]], sum);
+			}
+		}
+
+		// Generated normals go after any the file did have, one per position
+		size_t firstGenerated = obj.normals.size();
+		obj.normals.resize(firstGenerated + obj.positions.size());
+		for (size_t i = 0; i < accumulated.size(); i++)
+		{
+			XMVECTOR n = XMLoadFloat3(&accumulated[i]);
+			if (XMVectorGetX(XMVector3LengthSq(n)) > 0.0f)
+				XMStoreFloat3(&obj.normals[firstGenerated + i], XMVector3Normalize(n));
+			else
+				obj.normals[firstGenerated + i] = XMFLOAT3(0.0f, 1.0f, 0.0f);
+		}
+
+		for (ObjCorner& corner : obj.corners)
+		{
+			if (corner.Normal == MissingIndex)
+				corner.Normal = (unsigned int)firstGenerated + corner.Position;
+		}
+	}
+
+	// Converts to left-handed space, validates indices and fills in
+	// anything the file left out
+	void FinalizeObj(ObjData& obj)
+	{
+		// The model is most likely in a right-handed space, especially if
+		// it came from Maya.  We want a left-handed space for DirectX, so
+		// invert Z on positions and normals (winding was already flipped
+		// as faces were read).  We also flip V, since DirectX defines (0,0)
+		// as the top left of a texture and most modeling packages use the
+		// bottom left.
+		for (XMFLOAT3& position : obj.positions)
+			position.z *= -1.0f;
+		for (XMFLOAT3& normal : obj.normals)
+			normal.z *= -1.0f;
+		for (XMFLOAT2& uv : obj.uvs)
+			uv.y = 1.0f - uv.y;
+
+		bool missingUV = false;
+		bool missingNormal = false;
+		for (const ObjCorner& corner : obj.corners)
+		{
+			if (corner.Position >= obj.positions.size())
+				throw std::invalid_argument("Error parsing OBJ: Face references a position that doesn't exist");
+
+			if (corner.UV == MissingIndex)
+				missingUV = true;
+			else if (corner.UV >= obj.uvs.size())
+				throw std::invalid_argument("Error parsing OBJ: Face references a UV that doesn't exist");
+
+			if (corner.Normal == MissingIndex)
+				missingNormal = true;
+			else if (corner.Normal >= obj.normals.size())
+				throw std::invalid_argument("Error parsing OBJ: Face references a normal that doesn't exist");
+		}
+
+		// Corners without UVs all share a single (0,0) coordinate
+		if (missingUV)
+		{
+			unsigned int defaultUV = (unsigned int)obj.uvs.size();
+			obj.uvs.push_back(XMFLOAT2(0.0f, 0.0f));
+
+			for (ObjCorner& corner : obj.corners)
+			{
+				if (corner.UV == MissingIndex)
+					corner.UV = defaultUV;
+			}
+		}
+
+		if (missingNormal)
+			GenerateNormals(obj);
+	}
+}
+
+// --------------------------------------------------------
+// Parses an entire OBJ file that's already in memory
+//
+// - Supports positions, uvs and normals, faces with any
+//    number of corners (fan triangulated) and negative
+//    (relative) indices
+// - Lines may be any length; there's no line buffer
+// - A quick counting pass sizes every array up front, so
+//    the main pass never reallocates
+// - With more than one thread, the file is split into
+//    chunks at line boundaries.  Each chunk is counted in
+//    parallel, a prefix sum over the counts gives every
+//    chunk its starting offset in the output, and then the
+//    chunks are parsed in parallel straight into place.
+//    The result is identical to a single-threaded parse.
+// - Throws std::invalid_argument on out-of-range indices
+// --------------------------------------------------------
+void ObjParser::Parse(const char* data, size_t size, ObjData& out, unsigned int threadCount)
+{
+	const char* end = data + size;
+
+	// Not worth splitting tiny chunks across threads
+	const size_t minimumChunkSize = 64 * 1024;
+	size_t maxChunks = std::max<size_t>(size / minimumChunkSize, 1);
+	size_t chunkCount = std::clamp<size_t>(threadCount, 1, maxChunks);
+
+	// Split into chunks that each start at the beginning of a line
+	std::vector<const char*> chunkStarts(chunkCount + 1);
+	chunkStarts[0] = data;
+	chunkStarts[chunkCount] = end;
+	for (size_t i = 1; i < chunkCount; i++)
+	{
+		const char* nominalStart = std::max(data + size * i / chunkCount, chunkStarts[i - 1]);
+		chunkStarts[i] = NextLine(nominalStart, end);
+	}
+
+	// Runs a job for every chunk, using the calling thread for the first one
+	auto forEachChunk = [&](auto job)
+	{
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < chunkCount; i++)
+			workers.emplace_back(job, i);
+		job(0);
+		for (std::thread& worker : workers)
+			worker.join();
+	};
+
+	// Count the records in each chunk
+	std::vector<RecordCounts> chunkCounts(chunkCount);
+	forEachChunk([&](size_t i) { chunkCounts[i] = CountRecords(chunkStarts[i], chunkStarts[i + 1]); });
+
+	// Exclusive prefix sum, giving each chunk its offsets into the final arrays
+	std::vector<RecordCounts> chunkOffsets(chunkCount);
+	RecordCounts totals = {};
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		chunkOffsets[i] = totals;
+		totals.positions += chunkCounts[i].positions;
+		totals.uvs += chunkCounts[i].uvs;
+		totals.normals += chunkCounts[i].normals;
+		totals.triangles += chunkCounts[i].triangles;
+	}
+
+	out.positions.resize(totals.positions);
+	out.uvs.reserve(totals.uvs + 1); // Room for a default UV
+	out.uvs.resize(totals.uvs);
+	out.normals.resize(totals.normals);
+	out.corners.resize(totals.triangles * 3);
+
+	// Parse every chunk directly into place
+	// - Exceptions can't cross threads, so remember the first one
+	std::mutex errorMutex;
+	std::exception_ptr firstError;
+	forEachChunk([&](size_t i)
+	{
+		try
+		{
+			ParseRange(chunkStarts[i], chunkStarts[i + 1], out, chunkOffsets[i]);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(errorMutex);
+			if (!firstError)
+				firstError = std::current_exception();
+		}
+	});
+
+	if (firstError)
+		std::rethrow_exception(firstError);
+
+	FinalizeObj(out);
+}
+
+// --------------------------------------------------------
+// Welds the parsed corners into unique vertices and a
+// compact index list
+//
+// - OBJ indexes positions, uvs and normals separately, so
+//    two corners are the same vertex only if all three of
+//    their indices match
+// - Uses an open-addressing (linear probing) hash table
+//    keyed on the full index triplet, sized to a power of
+//    two at least twice the corner count so probes stay short
+// --------------------------------------------------------
+void ObjParser::BuildVertices(const ObjData& obj, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	size_t cornerCount = obj.corners.size();
+
+	size_t tableSize = 16;
+	while (tableSize < cornerCount * 2)
+		tableSize *= 2;
+	size_t tableMask = tableSize - 1;
+
+	// Each slot remembers the triplet it holds and the vertex made from it
+	struct WeldSlot
+	{
+		ObjCorner key;
+		unsigned int vertex;
+	};
+	WeldSlot emptySlot = {};
+	emptySlot.vertex = MissingIndex;
+	std::vector<WeldSlot> table(tableSize, emptySlot);
+
+	verts.clear();
+	verts.reserve(cornerCount);
+	indices.resize(cornerCount);
+
+	for (size_t i = 0; i < cornerCount; i++)
+	{
+		const ObjCorner& corner = obj.corners[i];
+
+		// Mix all three indices so corners sharing a position still spread out
+		unsigned int hash = corner.Position * 0x9E3779B1u;
+		hash ^= corner.UV * 0x85EBCA77u + (hash << 6) + (hash >> 2);
+		hash ^= corner.Normal * 0xC2B2AE3Du + (hash << 6) + (hash >> 2);
+
+		size_t slot = hash & tableMask;
+		while (true)
+		{
+			WeldSlot& current = table[slot];
+
+			// Never seen this triplet, so make a new vertex for it
+			if (current.vertex == MissingIndex)
+			{
+				Vertex v = {};
+				v.Position = obj.positions[corner.Position];
+				v.UV = obj.uvs[corner.UV];
+				v.Normal = obj.normals[corner.Normal];
+
+				current.key = corner;
+				current.vertex = (unsigned int)verts.size();
+				verts.push_back(v);
+				break;
+			}
+
+			// Already have it, so just reuse the index
+			if (current.key.Position == corner.Position &&
+				current.key.UV == corner.UV &&
+				current.key.Normal == corner.Normal)
+			{
+				break;
+			}
+
+			slot = (slot + 1) & tableMask;
+		}
+
+		indices[i] = table[slot].vertex;
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// One corner of a triangle read from an OBJ file
+// - Zero-based indices into ObjData's attribute lists
+// --------------------------------------------------------
+struct ObjCorner
+{
+	unsigned int Position;
+	unsigned int UV;
+	unsigned int Normal;
+};
+
+// --------------------------------------------------------
+// Everything read from an OBJ file, already converted to
+// our left-handed conventions (Z flipped, V flipped and
+// triangle winding reversed)
+// --------------------------------------------------------
+struct ObjData
+{
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT2> uvs;
+	std::vector<DirectX::XMFLOAT3> normals;
+	std::vector<ObjCorner> corners; // Three per triangle
+};
+
+namespace ObjParser
+{
+	// Parses an in-memory OBJ file (usually a MappedFile)
+	// - More than one thread splits the file into chunks parsed in parallel
+	void Parse(const char* data, size_t size, ObjData& out, unsigned int threadCount = 1);
+
+	// Welds the parsed corners into unique vertices and an index list
+	void BuildVertices(const ObjData& obj, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+}
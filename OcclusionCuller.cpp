@@ -0,0 +1,467 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <thread>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+}
+
+// --------------------------------------------------------
+// Picks the coarsest LOD that's still within OccluderMaxError
+// of the full mesh, and copies out just its triangles
+// - LODs are simplified from the full mesh by collapsing
+//    edges onto existing vertices, so they stay close to
+//    (though not strictly inside) the surface
+// --------------------------------------------------------
+void OcclusionCuller::BuildOccluder(const Vertex* vertices, const unsigned int* indices,
+	const MeshLod* lods, size_t lodCount, OccluderMesh& out)
+{
+	out.positions.clear();
+	out.indices.clear();
+	if (lodCount == 0)
+		return;
+
+	size_t chosen = 0;
+	for (size_t i = 1; i < lodCount; i++)
+	{
+		if (lods[i].Error <= OccluderMaxError)
+			chosen = i;
+	}
+
+	// Remap the LOD's vertices to a compact list of positions
+	std::vector<unsigned int> remap;
+	const unsigned int* lodIndices = indices + lods[chosen].StartIndex;
+	out.indices.reserve(lods[chosen].IndexCount);
+	for (unsigned int i = 0; i < lods[chosen].IndexCount; i++)
+	{
+		unsigned int vertex = lodIndices[i];
+		if (vertex >= remap.size())
+			remap.resize(vertex + 1, UINT_MAX);
+
+		if (remap[vertex] == UINT_MAX)
+		{
+			remap[vertex] = (unsigned int)out.positions.size();
+			out.positions.push_back(vertices[vertex].Position);
+		}
+		out.indices.push_back(remap[vertex]);
+	}
+}
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height, unsigned int threadCount) :
+	width{ (std::max(width, 4u) + 3) & ~3u },
+	height{ std::max(height, 1u) },
+	threadCount{ std::max(threadCount, 1u) },
+	reprojection{ false },
+	hasPreviousDepth{ false },
+	stats{}
+{
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+	XMStoreFloat4x4(&previousViewProjection, XMMatrixIdentity());
+
+	// Halve each level (rounding up) down to a single texel
+	unsigned int levelWidth = this->width;
+	unsigned int levelHeight = this->height;
+	while (true)
+	{
+		levels.emplace_back((size_t)levelWidth * levelHeight, 0.0f);
+		levelWidths.push_back(levelWidth);
+		levelHeights.push_back(levelHeight);
+		if (levelWidth == 1 && levelHeight == 1)
+			break;
+
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+}
+
+void OcclusionCuller::BeginFrame(const DirectX::XMFLOAT4X4& newViewProjection)
+{
+	viewProjection = newViewProjection;
+	triangles.clear();
+	std::fill(levels[0].begin(), levels[0].end(), 0.0f);
+	stats = {};
+}
+
+// --------------------------------------------------------
+// Transforms an occluder to screen space and sets up each
+// of its triangles for rasterizing
+// - Triangles that cross the near plane are skipped rather
+//    than clipped, since leaving out an occluder can only
+//    hide less
+// - So are back facing ones (D3D's default: clockwise on
+//    screen is the front), since the front faces of a
+//    closed mesh are always in front of them
+// --------------------------------------------------------
+void OcclusionCuller::AddOccluder(const OccluderMesh& occluder, const DirectX::XMFLOAT4X4& world)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	XMMATRIX worldViewProjection = XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&viewProjection));
+	clipPositions.resize(occluder.positions.size());
+	for (size_t i = 0; i < occluder.positions.size(); i++)
+		XMStoreFloat4(&clipPositions[i], XMVector3Transform(XMLoadFloat3(&occluder.positions[i]), worldViewProjection));
+
+	for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3)
+	{
+		const XMFLOAT4* clip[3] = { &clipPositions[occluder.indices[i]], &clipPositions[occluder.indices[i + 1]], &clipPositions[occluder.indices[i + 2]] };
+		if (clip[0]->z < 0.0f || clip[1]->z < 0.0f || clip[2]->z < 0.0f)
+			continue;
+
+		// Pixel coordinates (y down) and inverse depth
+		float x[3], y[3], z[3];
+		for (int v = 0; v < 3; v++)
+		{
+			float inverseW = 1.0f / clip[v]->w;
+			x[v] = (clip[v]->x * inverseW * 0.5f + 0.5f) * width;
+			y[v] = (0.5f - clip[v]->y * inverseW * 0.5f) * height;
+			z[v] = inverseW;
+		}
+
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (area <= 0.0f)
+			continue;
+
+		// Pixels whose centers might be inside
+		ScreenTriangle triangle;
+		triangle.MinX = std::max((int)ceilf(std::min({ x[0], x[1], x[2] }) - 0.5f), 0);
+		triangle.MaxX = std::min((int)floorf(std::max({ x[0], x[1], x[2] }) - 0.5f), (int)width - 1);
+		triangle.MinY = std::max((int)ceilf(std::min({ y[0], y[1], y[2] }) - 0.5f), 0);
+		triangle.MaxY = std::min((int)floorf(std::max({ y[0], y[1], y[2] }) - 0.5f), (int)height - 1);
+		if (triangle.MinX > triangle.MaxX || triangle.MinY > triangle.MaxY)
+			continue;
+
+		// Edge e runs from vertex e to the next, and is positive on the inside
+		for (int e = 0; e < 3; e++)
+		{
+			int next = (e + 1) % 3;
+			triangle.EdgeA[e] = y[e] - y[next];
+			triangle.EdgeB[e] = x[next] - x[e];
+			triangle.EdgeC[e] = -(triangle.EdgeA[e] * x[e] + triangle.EdgeB[e] * y[e]);
+		}
+
+		// Depth from barycentrics: vertex 1's weight is edge 2 over the
+		// area, and vertex 2's is edge 0 over the area
+		float inverseArea = 1.0f / area;
+		float dz1 = (z[1] - z[0]) * inverseArea;
+		float dz2 = (z[2] - z[0]) * inverseArea;
+		triangle.DepthA = dz1 * triangle.EdgeA[2] + dz2 * triangle.EdgeA[0];
+		triangle.DepthB = dz1 * triangle.EdgeB[2] + dz2 * triangle.EdgeB[0];
+		triangle.DepthC = z[0] + dz1 * triangle.EdgeC[2] + dz2 * triangle.EdgeC[0];
+
+		triangles.push_back(triangle);
+		stats.occluderTriangles++;
+	}
+
+	stats.occluderCount++;
+	stats.rasterMilliseconds += MillisecondsSince(start);
+}
+
+// --------------------------------------------------------
+// Rasterizes every occluder, splitting the screen into one
+// band of rows per thread so no two threads write the same
+// pixels
+// --------------------------------------------------------
+void OcclusionCuller::FinishOccluders()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Not worth splitting a few triangles, or very thin bands
+	const size_t minimumTrianglesPerThread = 64;
+	const unsigned int minimumRowsPerThread = 8;
+	size_t maxThreads = std::max<size_t>(std::min<size_t>(triangles.size() / minimumTrianglesPerThread, height / minimumRowsPerThread), 1);
+	size_t jobCount = std::clamp<size_t>(threadCount, 1, maxThreads);
+
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < jobCount; i++)
+		workers.emplace_back([this, i, jobCount]() { RasterizeRows((unsigned int)(height * i / jobCount), (unsigned int)(height * (i + 1) / jobCount)); });
+	RasterizeRows(0, (unsigned int)(height / jobCount));
+	for (std::thread& worker : workers)
+		worker.join();
+
+	// Keep this frame's occluders (without anything reprojected) for next frame
+	if (reprojection)
+	{
+		rasterizedDepth = levels[0];
+		if (hasPreviousDepth)
+			Reproject();
+
+		previousDepth.swap(rasterizedDepth);
+		previousViewProjection = viewProjection;
+		hasPreviousDepth = true;
+	}
+	else
+	{
+		hasPreviousDepth = false;
+	}
+
+	BuildHierarchy();
+
+	stats.rasterMilliseconds += MillisecondsSince(start);
+}
+
+// --------------------------------------------------------
+// Projects the box's corners to the screen, then compares
+// its nearest point against the farthest occluder depth
+// everywhere it covers
+// - Depth is linear in world space, so a box's nearest
+//    point is always one of its corners
+// --------------------------------------------------------
+bool OcclusionCuller::IsVisible(DirectX::XMFLOAT3 center, DirectX::XMFLOAT3 extents)
+{
+	XMMATRIX matrix = XMLoadFloat4x4(&viewProjection);
+
+	float minX = FLT_MAX, minY = FLT_MAX;
+	float maxX = -FLT_MAX, maxY = -FLT_MAX, maxZ = 0.0f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		XMVECTOR position = XMVectorSet(
+			center.x + ((corner & 1) ? extents.x : -extents.x),
+			center.y + ((corner & 2) ? extents.y : -extents.y),
+			center.z + ((corner & 4) ? extents.z : -extents.z),
+			1.0f);
+
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector4Transform(position, matrix));
+		if (clip.z < 0.0f)
+			return true;
+
+		float inverseW = 1.0f / clip.w;
+		float x = (clip.x * inverseW * 0.5f + 0.5f) * width;
+		float y = (0.5f - clip.y * inverseW * 0.5f) * height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		maxZ = std::max(maxZ, inverseW);
+	}
+
+	if (maxX < 0.0f || maxY < 0.0f || minX >= (float)width || minY >= (float)height)
+		return true;
+
+	// Every pixel the rectangle touches, even partly
+	unsigned int x0 = (unsigned int)std::max(minX, 0.0f);
+	unsigned int y0 = (unsigned int)std::max(minY, 0.0f);
+	unsigned int x1 = (unsigned int)std::min(maxX, (float)(width - 1));
+	unsigned int y1 = (unsigned int)std::min(maxY, (float)(height - 1));
+
+	// Coarsest level needed to cover that in at most 2x2 texels
+	size_t level = 0;
+	while (level + 1 < levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+		level++;
+
+	const std::vector<float>& depths = levels[level];
+	unsigned int levelWidth = levelWidths[level];
+	for (unsigned int y = y0 >> level; y <= y1 >> level; y++)
+	{
+		for (unsigned int x = x0 >> level; x <= x1 >> level; x++)
+		{
+			if (depths[(size_t)y * levelWidth + x] <= maxZ)
+				return true;
+		}
+	}
+	return false;
+}
+
+unsigned int OcclusionCuller::Cull(const WorldBounds& bounds, const std::vector<unsigned int>& candidates, std::vector<unsigned int>& visible)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	visible.clear();
+	for (unsigned int i : candidates)
+	{
+		XMFLOAT3 center(bounds.CenterX[i], bounds.CenterY[i], bounds.CenterZ[i]);
+		XMFLOAT3 extents(bounds.ExtentX[i], bounds.ExtentY[i], bounds.ExtentZ[i]);
+		if (IsVisible(center, extents))
+			visible.push_back(i);
+	}
+
+	stats.testedCount += (unsigned int)candidates.size();
+	stats.culledCount += (unsigned int)(candidates.size() - visible.size());
+	stats.testMilliseconds += MillisecondsSince(start);
+	return (unsigned int)visible.size();
+}
+
+void OcclusionCuller::SetReprojection(bool enabled)
+{
+	reprojection = enabled;
+}
+
+bool OcclusionCuller::GetReprojection()
+{
+	return reprojection;
+}
+
+OcclusionStats OcclusionCuller::GetStats()
+{
+	return stats;
+}
+
+unsigned int OcclusionCuller::GetWidth()
+{
+	return width;
+}
+
+unsigned int OcclusionCuller::GetHeight()
+{
+	return height;
+}
+
+float OcclusionCuller::GetDepth(unsigned int x, unsigned int y)
+{
+	return levels[0][(size_t)y * width + x];
+}
+
+// --------------------------------------------------------
+// Rasterizes the rows [firstRow, lastRow) of every triangle,
+// four pixels at a time
+// - Each group of four starts on a multiple of four, and the
+//    width is a multiple of four, so groups never run past
+//    the end of a row
+// --------------------------------------------------------
+void OcclusionCuller::RasterizeRows(unsigned int firstRow, unsigned int lastRow)
+{
+	XMVECTOR laneOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	XMVECTOR zero = XMVectorZero();
+	std::vector<float>& depth = levels[0];
+
+	for (const ScreenTriangle& triangle : triangles)
+	{
+		int rowStart = std::max(triangle.MinY, (int)firstRow);
+		int rowEnd = std::min(triangle.MaxY, (int)lastRow - 1);
+		if (rowStart > rowEnd)
+			continue;
+
+		XMVECTOR edgeA0 = XMVectorReplicate(triangle.EdgeA[0]);
+		XMVECTOR edgeA1 = XMVectorReplicate(triangle.EdgeA[1]);
+		XMVECTOR edgeA2 = XMVectorReplicate(triangle.EdgeA[2]);
+		XMVECTOR depthA = XMVectorReplicate(triangle.DepthA);
+		int columnStart = triangle.MinX & ~3;
+
+		for (int y = rowStart; y <= rowEnd; y++)
+		{
+			// The parts of each function that stay the same along the row
+			float pixelY = y + 0.5f;
+			XMVECTOR row0 = XMVectorReplicate(triangle.EdgeB[0] * pixelY + triangle.EdgeC[0]);
+			XMVECTOR row1 = XMVectorReplicate(triangle.EdgeB[1] * pixelY + triangle.EdgeC[1]);
+			XMVECTOR row2 = XMVectorReplicate(triangle.EdgeB[2] * pixelY + triangle.EdgeC[2]);
+			XMVECTOR rowDepth = XMVectorReplicate(triangle.DepthB * pixelY + triangle.DepthC);
+
+			float* rowPixels = &depth[(size_t)y * width];
+			for (int x = columnStart; x <= triangle.MaxX; x += 4)
+			{
+				XMVECTOR pixelX = XMVectorAdd(XMVectorReplicate((float)x), laneOffsets);
+
+				XMVECTOR inside = XMVectorGreaterOrEqual(XMVectorMultiplyAdd(edgeA0, pixelX, row0), zero);
+				inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(edgeA1, pixelX, row1), zero));
+				inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(edgeA2, pixelX, row2), zero));
+
+				XMVECTOR pixelDepth = XMVectorMultiplyAdd(depthA, pixelX, rowDepth);
+				XMVECTOR current = XMLoadFloat4((const XMFLOAT4*)&rowPixels[x]);
+				XMStoreFloat4((XMFLOAT4*)&rowPixels[x], XMVectorSelect(current, XMVectorMax(current, pixelDepth), inside));
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Moves each covered pixel of last frame's occluder depth
+// to where it is in this frame, keeping the nearest depth
+// - A pixel and its depth give its clip-space x, y and w,
+//    which are an affine function of world position, so
+//    the change of view is one matrix
+// - Only single pixels move, so gaps open up where the view
+//    spreads things out; gaps are left empty, which only
+//    ever hides less
+// - Occluders that moved since last frame leave their old
+//    depth behind for one frame
+// --------------------------------------------------------
+void OcclusionCuller::Reproject()
+{
+	// Maps world positions to (x, y, w, 1) in clip space
+	auto clipXYW = [](const XMFLOAT4X4& m)
+		{
+			return XMMATRIX(
+				m._11, m._12, m._14, 0.0f,
+				m._21, m._22, m._24, 0.0f,
+				m._31, m._32, m._34, 0.0f,
+				m._41, m._42, m._44, 1.0f);
+		};
+	XMMATRIX previousToCurrent = XMMatrixMultiply(
+		XMMatrixInverse(nullptr, clipXYW(previousViewProjection)),
+		clipXYW(viewProjection));
+	std::vector<float>& depth = levels[0];
+
+	for (unsigned int y = 0; y < height; y++)
+	{
+		float ndcY = 1.0f - (y + 0.5f) / height * 2.0f;
+		for (unsigned int x = 0; x < width; x++)
+		{
+			float previous = previousDepth[(size_t)y * width + x];
+			if (previous <= 0.0f)
+				continue;
+
+			float w = 1.0f / previous;
+			float ndcX = (x + 0.5f) / width * 2.0f - 1.0f;
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector4Transform(XMVectorSet(ndcX * w, ndcY * w, w, 1.0f), previousToCurrent));
+			if (clip.z <= 0.0f)
+				continue;
+
+			float inverseW = 1.0f / clip.z;
+			float pixelX = (clip.x * inverseW * 0.5f + 0.5f) * width;
+			float pixelY = (0.5f - clip.y * inverseW * 0.5f) * height;
+			if (pixelX < 0.0f || pixelY < 0.0f || pixelX >= (float)width || pixelY >= (float)height)
+				continue;
+
+			float& target = depth[(size_t)pixelY * width + (size_t)pixelX];
+			target = std::max(target, inverseW);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Fills each level above the first with the farthest depth
+// (smallest 1 / w) of the (up to) 2x2 texels below it
+// --------------------------------------------------------
+void OcclusionCuller::BuildHierarchy()
+{
+	for (size_t level = 1; level < levels.size(); level++)
+	{
+		const std::vector<float>& below = levels[level - 1];
+		std::vector<float>& above = levels[level];
+		unsigned int belowWidth = levelWidths[level - 1];
+		unsigned int belowHeight = levelHeights[level - 1];
+
+		for (unsigned int y = 0; y < levelHeights[level]; y++)
+		{
+			unsigned int y0 = y * 2;
+			unsigned int y1 = std::min(y0 + 1, belowHeight - 1);
+			for (unsigned int x = 0; x < levelWidths[level]; x++)
+			{
+				unsigned int x0 = x * 2;
+				unsigned int x1 = std::min(x0 + 1, belowWidth - 1);
+				above[(size_t)y * levelWidths[level] + x] = std::min({
+					below[(size_t)y0 * belowWidth + x0], below[(size_t)y0 * belowWidth + x1],
+					below[(size_t)y1 * belowWidth + x0], below[(size_t)y1 * belowWidth + x1] });
+			}
+		}
+	}
+}
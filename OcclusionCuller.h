@@ -0,0 +1,134 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "FrustumCulling.h"
+#include "MeshData.h"
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// A coarse stand-in for a mesh, rasterized by the occlusion
+// culler instead of the full mesh
+// --------------------------------------------------------
+struct OccluderMesh
+{
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<unsigned int> indices;
+};
+
+// --------------------------------------------------------
+// What the occlusion culler did since the last BeginFrame()
+// --------------------------------------------------------
+struct OcclusionStats
+{
+	unsigned int occluderCount;
+	unsigned int occluderTriangles;	// Rasterized, after backface and near plane rejection
+	unsigned int testedCount;
+	unsigned int culledCount;
+	double rasterMilliseconds;		// Occluder setup, rasterizing, reprojecting and building the hierarchy
+	double testMilliseconds;
+};
+
+// --------------------------------------------------------
+// Software occlusion culling, entirely on the CPU
+// - Occluders are rasterized into a small depth buffer,
+//    four pixels at a time, with each thread filling its
+//    own band of rows
+// - Depth is stored as 1 / w (larger is nearer), which is
+//    linear across the screen and keeps its precision even
+//    with a very close near plane, unlike z / w
+// - The depth buffer is then reduced into a hierarchy where
+//    each texel holds the farthest depth of the 2x2 texels
+//    below it
+// - A box is hidden if its nearest depth is behind every
+//    texel its screen rectangle covers, at the level where
+//    that's at most 2x2 texels
+// - Optionally, last frame's occluder depth is reprojected
+//    into this frame's, so occluders don't flicker in and
+//    out as they're added and removed
+// --------------------------------------------------------
+class OcclusionCuller
+{
+public:
+
+	// Largest simplification error (relative to the mesh's size) an occluder
+	// may have, since anything that pokes out can hide what's really visible
+	static constexpr float OccluderMaxError = 0.01f;
+
+	// Fills out with the coarsest of a mesh's LODs within OccluderMaxError,
+	// keeping only the positions it uses
+	static void BuildOccluder(const Vertex* vertices, const unsigned int* indices,
+		const MeshLod* lods, size_t lodCount, OccluderMesh& out);
+
+	// Width is rounded up to a multiple of 4, for rasterizing 4 pixels at once
+	OcclusionCuller(unsigned int width = 256, unsigned int height = 128, unsigned int threadCount = 1);
+	~OcclusionCuller();
+
+	// Clears the depth buffer and stats for a new view
+	void BeginFrame(const DirectX::XMFLOAT4X4& viewProjection);
+
+	// Transforms an occluder's triangles to screen space, ready to rasterize
+	void AddOccluder(const OccluderMesh& occluder, const DirectX::XMFLOAT4X4& world);
+
+	// Rasterizes every occluder added since BeginFrame(), reprojects last frame's
+	// depth (if enabled), then builds the hierarchy that tests read from
+	void FinishOccluders();
+
+	// Is any part of the world-space box possibly visible?
+	// - Boxes crossing the near plane, or off screen, always are
+	bool IsVisible(DirectX::XMFLOAT3 center, DirectX::XMFLOAT3 extents);
+
+	// Fills visible with every index in candidates whose bounds are possibly visible
+	// - Returns how many there are
+	unsigned int Cull(const WorldBounds& bounds, const std::vector<unsigned int>& candidates, std::vector<unsigned int>& visible);
+
+	void SetReprojection(bool enabled);
+	bool GetReprojection();
+
+	OcclusionStats GetStats();
+	unsigned int GetWidth();
+	unsigned int GetHeight();
+
+	// 1 / w at a pixel of the full resolution buffer (0 where nothing was drawn)
+	float GetDepth(unsigned int x, unsigned int y);
+
+private:
+
+	// One occluder triangle in screen space, as edge functions and a
+	// depth plane, all in the form a * x + b * y + c
+	struct ScreenTriangle
+	{
+		float EdgeA[3], EdgeB[3], EdgeC[3];
+		float DepthA, DepthB, DepthC;
+		int MinX, MaxX, MinY, MaxY;	// Pixel bounds, already clamped to the screen
+	};
+
+	unsigned int width;
+	unsigned int height;
+	unsigned int threadCount;
+	bool reprojection;
+
+	DirectX::XMFLOAT4X4 viewProjection;
+	DirectX::XMFLOAT4X4 previousViewProjection;
+	bool hasPreviousDepth;
+
+	std::vector<ScreenTriangle> triangles;
+	std::vector<DirectX::XMFLOAT4> clipPositions;
+
+	// Level 0 is the full resolution depth buffer
+	std::vector<std::vector<float>> levels;
+	std::vector<unsigned int> levelWidths;
+	std::vector<unsigned int> levelHeights;
+
+	// Last frame's occluders alone, for reprojection, and this frame's
+	// (kept before reprojecting into it) for the next frame
+	std::vector<float> previousDepth;
+	std::vector<float> rasterizedDepth;
+
+	OcclusionStats stats;
+
+	void RasterizeRows(unsigned int firstRow, unsigned int lastRow);
+	void Reproject();
+	void BuildHierarchy();
+};
@@ -0,0 +1,267 @@
+#include "PackedVertex.h"
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+// The input layouts in Game::LoadShaders() rely on these exact sizes
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must match its input layout");
+static_assert(sizeof(PackedVertexFloatPosition) == 24, "PackedVertexFloatPosition must match its input layout");
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	const float Unorm16Max = 65535.0f;
+	const float Snorm16Max = 32767.0f;
+
+	// --------------------------------------------------------
+	// Octahedral encoding of four unit vectors at once
+	// - Inputs and outputs are structure-of-arrays: one
+	//    vector holds the x of all four, another the y, etc.
+	// - Projects onto the octahedron |x|+|y|+|z| = 1, then
+	//    folds the lower half over the diagonals so the whole
+	//    sphere fits in the [-1, 1] square
+	// --------------------------------------------------------
+	void OctahedralEncode(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, XMVECTOR& u, XMVECTOR& v)
+	{
+		XMVECTOR zero = XMVectorZero();
+		XMVECTOR one = XMVectorSplatOne();
+
+		// Guard against zero-length vectors
+		XMVECTOR l1 = XMVectorAdd(XMVectorAdd(XMVectorAbs(x), XMVectorAbs(y)), XMVectorAbs(z));
+		XMVECTOR invL1 = XMVectorReciprocal(XMVectorMax(l1, XMVectorReplicate(1e-20f)));
+		XMVECTOR px = XMVectorMultiply(x, invL1);
+		XMVECTOR py = XMVectorMultiply(y, invL1);
+
+		XMVECTOR signX = XMVectorSelect(XMVectorNegate(one), one, XMVectorGreaterOrEqual(px, zero));
+		XMVECTOR signY = XMVectorSelect(XMVectorNegate(one), one, XMVectorGreaterOrEqual(py, zero));
+		XMVECTOR foldedX = XMVectorMultiply(XMVectorSubtract(one, XMVectorAbs(py)), signX);
+		XMVECTOR foldedY = XMVectorMultiply(XMVectorSubtract(one, XMVectorAbs(px)), signY);
+
+		XMVECTOR lowerHalf = XMVectorLess(z, zero);
+		u = XMVectorSelect(px, foldedX, lowerHalf);
+		v = XMVectorSelect(py, foldedY, lowerHalf);
+	}
+
+	// --------------------------------------------------------
+	// Inverse of OctahedralEncode, again four at a time
+	// - Matches OctahedralDecode() in ShaderIncludes.hlsli
+	// --------------------------------------------------------
+	void OctahedralDecode(FXMVECTOR u, FXMVECTOR v, XMVECTOR& x, XMVECTOR& y, XMVECTOR& z)
+	{
+		XMVECTOR zero = XMVectorZero();
+
+		z = XMVectorSubtract(XMVectorSubtract(XMVectorSplatOne(), XMVectorAbs(u)), XMVectorAbs(v));
+		XMVECTOR t = XMVectorSaturate(XMVectorNegate(z));
+		x = XMVectorAdd(u, XMVectorSelect(t, XMVectorNegate(t), XMVectorGreaterOrEqual(u, zero)));
+		y = XMVectorAdd(v, XMVectorSelect(t, XMVectorNegate(t), XMVectorGreaterOrEqual(v, zero)));
+
+		XMVECTOR lengthSq = XMVectorMultiplyAdd(x, x, XMVectorMultiplyAdd(y, y, XMVectorMultiply(z, z)));
+		XMVECTOR invLength = XMVectorReciprocalSqrt(lengthSq);
+		x = XMVectorMultiply(x, invLength);
+		y = XMVectorMultiply(y, invLength);
+		z = XMVectorMultiply(z, invLength);
+	}
+
+	// Rounds [-1, 1] floats to SNORM16, the same way the GPU converts them back
+	XMVECTOR ToSnorm16(FXMVECTOR value)
+	{
+		XMVECTOR one = XMVectorSplatOne();
+		return XMVectorRound(XMVectorScale(XMVectorClamp(value, XMVectorNegate(one), one), Snorm16Max));
+	}
+
+	XMVECTOR FromSnorm16(FXMVECTOR value)
+	{
+		// -32768 also maps to -1, as it does on the GPU
+		XMVECTOR one = XMVectorSplatOne();
+		return XMVectorMax(XMVectorScale(value, 1.0f / Snorm16Max), XMVectorNegate(one));
+	}
+
+	// --------------------------------------------------------
+	// Packs the UVs, normals and tangents that both packed
+	// formats share
+	// - Normals and tangents are processed four vertices at
+	//    a time; a partial group at the end is padded
+	// --------------------------------------------------------
+	template<typename PackedType>
+	void PackAttributes(const Vertex* vertices, size_t count, PackedType* out)
+	{
+		if (count == 0)
+			return;
+
+		// Half floats have their own (SIMD) stream conversion
+		XMConvertFloatToHalfStream(&out[0].UV[0], sizeof(PackedType), &vertices[0].UV.x, sizeof(Vertex), count);
+		XMConvertFloatToHalfStream(&out[0].UV[1], sizeof(PackedType), &vertices[0].UV.y, sizeof(Vertex), count);
+
+		for (size_t first = 0; first < count; first += 4)
+		{
+			// Gather (or pad with a valid unit vector)
+			XMFLOAT3 normals[4] = { { 0, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 } };
+			XMFLOAT3 tangents[4] = { { 1, 0, 0 }, { 1, 0, 0 }, { 1, 0, 0 }, { 1, 0, 0 } };
+			size_t groupSize = count - first < 4 ? count - first : 4;
+			for (size_t i = 0; i < groupSize; i++)
+			{
+				normals[i] = vertices[first + i].Normal;
+				tangents[i] = vertices[first + i].Tangent;
+			}
+
+			XMVECTOR normalU, normalV, tangentU, tangentV;
+			OctahedralEncode(
+				XMVectorSet(normals[0].x, normals[1].x, normals[2].x, normals[3].x),
+				XMVectorSet(normals[0].y, normals[1].y, normals[2].y, normals[3].y),
+				XMVectorSet(normals[0].z, normals[1].z, normals[2].z, normals[3].z),
+				normalU, normalV);
+			OctahedralEncode(
+				XMVectorSet(tangents[0].x, tangents[1].x, tangents[2].x, tangents[3].x),
+				XMVectorSet(tangents[0].y, tangents[1].y, tangents[2].y, tangents[3].y),
+				XMVectorSet(tangents[0].z, tangents[1].z, tangents[2].z, tangents[3].z),
+				tangentU, tangentV);
+
+			XMFLOAT4 nu, nv, tu, tv;
+			XMStoreFloat4(&nu, ToSnorm16(normalU));
+			XMStoreFloat4(&nv, ToSnorm16(normalV));
+			XMStoreFloat4(&tu, ToSnorm16(tangentU));
+			XMStoreFloat4(&tv, ToSnorm16(tangentV));
+
+			for (size_t i = 0; i < groupSize; i++)
+			{
+				short* packed = out[first + i].NormalTangent;
+				packed[0] = (short)(&nu.x)[i];
+				packed[1] = (short)(&nv.x)[i];
+				packed[2] = (short)(&tu.x)[i];
+				packed[3] = (short)(&tv.x)[i];
+			}
+		}
+	}
+
+	// --------------------------------------------------------
+	// Inverse of PackAttributes
+	// --------------------------------------------------------
+	template<typename PackedType>
+	void UnpackAttributes(const PackedType* vertices, size_t count, Vertex* out)
+	{
+		if (count == 0)
+			return;
+
+		XMConvertHalfToFloatStream(&out[0].UV.x, sizeof(Vertex), &vertices[0].UV[0], sizeof(PackedType), count);
+		XMConvertHalfToFloatStream(&out[0].UV.y, sizeof(Vertex), &vertices[0].UV[1], sizeof(PackedType), count);
+
+		for (size_t first = 0; first < count; first += 4)
+		{
+			float packed[4][4] = {};
+			size_t groupSize = count - first < 4 ? count - first : 4;
+			for (size_t i = 0; i < groupSize; i++)
+				for (size_t c = 0; c < 4; c++)
+					packed[c][i] = vertices[first + i].NormalTangent[c];
+
+			XMVECTOR nx, ny, nz, tx, ty, tz;
+			OctahedralDecode(FromSnorm16(XMLoadFloat4((XMFLOAT4*)packed[0])), FromSnorm16(XMLoadFloat4((XMFLOAT4*)packed[1])), nx, ny, nz);
+			OctahedralDecode(FromSnorm16(XMLoadFloat4((XMFLOAT4*)packed[2])), FromSnorm16(XMLoadFloat4((XMFLOAT4*)packed[3])), tx, ty, tz);
+
+			XMFLOAT4 n[3], t[3];
+			XMStoreFloat4(&n[0], nx);
+			XMStoreFloat4(&n[1], ny);
+			XMStoreFloat4(&n[2], nz);
+			XMStoreFloat4(&t[0], tx);
+			XMStoreFloat4(&t[1], ty);
+			XMStoreFloat4(&t[2], tz);
+
+			for (size_t i = 0; i < groupSize; i++)
+			{
+				out[first + i].Normal = XMFLOAT3((&n[0].x)[i], (&n[1].x)[i], (&n[2].x)[i]);
+				out[first + i].Tangent = XMFLOAT3((&t[0].x)[i], (&t[1].x)[i], (&t[2].x)[i]);
+			}
+		}
+	}
+}
+
+unsigned int VertexPacking::GetStride(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormat::Packed: return sizeof(PackedVertex);
+	case VertexFormat::PackedFloatPosition: return sizeof(PackedVertexFloatPosition);
+	default: return sizeof(Vertex);
+	}
+}
+
+// --------------------------------------------------------
+// Quantized positions span the mesh's bounding box; an
+// axis with no extent gets a scale of zero
+// --------------------------------------------------------
+PackedVertexDequantize VertexPacking::GetDequantize(VertexFormat format, const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+{
+	PackedVertexDequantize dequantize = {};
+	if (format == VertexFormat::Packed)
+	{
+		dequantize.Scale = XMFLOAT3(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z);
+		dequantize.Offset = boundsMin;
+	}
+	else
+	{
+		dequantize.Scale = XMFLOAT3(1, 1, 1);
+		dequantize.Offset = XMFLOAT3(0, 0, 0);
+	}
+	return dequantize;
+}
+
+// --------------------------------------------------------
+// Packs vertices with positions quantized to UNORM16
+// - Worst-case position error is half a step, or
+//    extent / 131070 on each axis
+// --------------------------------------------------------
+void VertexPacking::Pack(const Vertex* vertices, size_t count, const PackedVertexDequantize& dequantize, PackedVertex* out)
+{
+	XMVECTOR offset = XMLoadFloat3(&dequantize.Offset);
+	XMVECTOR scale = XMLoadFloat3(&dequantize.Scale);
+	XMVECTOR invScale = XMVectorSelect(XMVectorReciprocal(scale), XMVectorZero(), XMVectorEqual(scale, XMVectorZero()));
+
+	for (size_t i = 0; i < count; i++)
+	{
+		XMVECTOR position = XMVectorSaturate(XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&vertices[i].Position), offset), invScale));
+		position = XMVectorRound(XMVectorScale(position, Unorm16Max));
+
+		XMFLOAT4 quantized;
+		XMStoreFloat4(&quantized, position);
+		out[i].Position[0] = (unsigned short)quantized.x;
+		out[i].Position[1] = (unsigned short)quantized.y;
+		out[i].Position[2] = (unsigned short)quantized.z;
+		out[i].Position[3] = 0;
+	}
+
+	PackAttributes(vertices, count, out);
+}
+
+// --------------------------------------------------------
+// Packs vertices, keeping full float positions
+// --------------------------------------------------------
+void VertexPacking::Pack(const Vertex* vertices, size_t count, PackedVertexFloatPosition* out)
+{
+	for (size_t i = 0; i < count; i++)
+		out[i].Position = vertices[i].Position;
+
+	PackAttributes(vertices, count, out);
+}
+
+void VertexPacking::Unpack(const PackedVertex* vertices, size_t count, const PackedVertexDequantize& dequantize, Vertex* out)
+{
+	XMVECTOR offset = XMLoadFloat3(&dequantize.Offset);
+	XMVECTOR scale = XMVectorScale(XMLoadFloat3(&dequantize.Scale), 1.0f / Unorm16Max);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const unsigned short* packed = vertices[i].Position;
+		XMVECTOR position = XMVectorSet(packed[0], packed[1], packed[2], 0);
+		XMStoreFloat3(&out[i].Position, XMVectorMultiplyAdd(position, scale, offset));
+	}
+
+	UnpackAttributes(vertices, count, out);
+}
+
+void VertexPacking::Unpack(const PackedVertexFloatPosition* vertices, size_t count, Vertex* out)
+{
+	for (size_t i = 0; i < count; i++)
+		out[i].Position = vertices[i].Position;
+
+	UnpackAttributes(vertices, count, out);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Which vertex layout a Mesh's vertex buffer uses
+// --------------------------------------------------------
+enum class VertexFormat
+{
+	Full,					// Vertex: 44 bytes, all floats
+	Packed,					// PackedVertex: 20 bytes, positions quantized to the mesh bounds
+	PackedFloatPosition		// PackedVertexFloatPosition: 24 bytes, full precision positions
+};
+
+// --------------------------------------------------------
+// A compact vertex for meshes that don't need full floats
+// - Position: UNORM16, relative to the mesh's bounding box
+//    (see PackedVertexDequantize)
+// - UV: half floats
+// - Normal and tangent: octahedral encoded, SNORM16
+// - Position.w is padding (there's no three-channel 16-bit
+//    format) and is always written as 0
+// - There's no tangent handedness, as Vertex doesn't have
+//    one; the shaders build the bitangent as cross(T, N)
+// --------------------------------------------------------
+struct PackedVertex
+{
+	unsigned short Position[4];					// R16G16B16A16_UNORM
+	DirectX::PackedVector::HALF UV[2];			// R16G16_FLOAT
+	short NormalTangent[4];						// R16G16B16A16_SNORM
+};
+
+// --------------------------------------------------------
+// Same as PackedVertex, but with float positions for meshes
+// too large (or too detailed) for 16 bits across their bounds
+// --------------------------------------------------------
+struct PackedVertexFloatPosition
+{
+	DirectX::XMFLOAT3 Position;					// R32G32B32_FLOAT
+	DirectX::PackedVector::HALF UV[2];			// R16G16_FLOAT
+	short NormalTangent[4];						// R16G16B16A16_SNORM
+};
+
+// --------------------------------------------------------
+// Turns 0-1 positions back into local space in the shader:
+//  localPosition = packed * Scale + Offset
+// - Float positions use a scale of 1 and an offset of 0
+// --------------------------------------------------------
+struct PackedVertexDequantize
+{
+	DirectX::XMFLOAT3 Scale;
+	DirectX::XMFLOAT3 Offset;
+};
+
+namespace VertexPacking
+{
+	// Bytes per vertex for a given format
+	unsigned int GetStride(VertexFormat format);
+
+	// Dequantize constants for a mesh with the given bounds
+	PackedVertexDequantize GetDequantize(VertexFormat format, const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax);
+
+	// Encodes full vertices, four at a time
+	void Pack(const Vertex* vertices, size_t count, const PackedVertexDequantize& dequantize, PackedVertex* out);
+	void Pack(const Vertex* vertices, size_t count, PackedVertexFloatPosition* out);
+
+	// Decodes back to full vertices (for validation and CPU-side use)
+	void Unpack(const PackedVertex* vertices, size_t count, const PackedVertexDequantize& dequantize, Vertex* out);
+	void Unpack(const PackedVertexFloatPosition* vertices, size_t count, Vertex* out);
+}
@@ -0,0 +1,42 @@
+#include "ShaderIncludes.hlsli"
+
+// Description of constant buffer data
+// - Same as VertexShader.hlsl, plus the constants to dequantize positions
+cbuffer PerObject : register(b2)
+{
+    matrix world;
+    matrix worldInvTranspose;
+    float3 positionScale;
+    float3 positionOffset;
+}
+
+// --------------------------------------------------------
+// Vertex shader for meshes using a packed vertex format
+//
+// - Unpacks the vertex, then does exactly what VertexShader.hlsl does,
+//   so the same pixel shaders work with either format
+// --------------------------------------------------------
+VertexToPixel main( PackedVertexShaderInput input )
+{
+	// Set up output struct
+	VertexToPixel output;
+
+	// Back to local space (a no-op scale and offset for float positions)
+    float3 localPosition = input.localPosition.xyz * positionScale + positionOffset;
+    float3 normal = OctahedralDecode(input.NormalTangent.xy);
+    float3 tangent = OctahedralDecode(input.NormalTangent.zw);
+
+	// Create a WPV (world, projection, view) matrix from the world matrix and the camera's view-projection
+	// Because our C++ matrices are left-handed and HLSL matrices are right-handed, multiply them in the opposite order (VPW)
+    matrix wpv = mul(viewProjection, world);
+
+    output.screenPosition = mul(wpv, float4(localPosition, 1.0f));
+
+	// Pass through UVs and surface normals
+    output.UV = input.UV;
+    output.Normal = mul((float3x3)worldInvTranspose, normal);
+    output.worldPosition = mul(world, float4(localPosition, 1)).xyz;
+    output.Tangent = mul((float3x3)world, tangent);
+
+	return output;
+}
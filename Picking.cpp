@@ -0,0 +1,67 @@
+#include "Picking.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Goes through the view-space direction of the pixel,
+// rather than unprojecting a point on the far plane, as
+// the camera's tiny near plane leaves the inverse
+// projection with little precision
+// --------------------------------------------------------
+void Picking::ScreenRay(Camera& camera, float pixelX, float pixelY, float width, float height,
+	DirectX::XMFLOAT3& origin, DirectX::XMFLOAT3& direction)
+{
+	XMFLOAT4X4 projection = camera.GetProjectionMatrix();
+	XMFLOAT4X4 view = camera.GetViewMatrix();
+
+	// Pixel to normalized device coordinates (y is up), then to a
+	// view-space direction one unit forward
+	float ndcX = (pixelX + 0.5f) / width * 2.0f - 1.0f;
+	float ndcY = 1.0f - (pixelY + 0.5f) / height * 2.0f;
+	XMVECTOR viewDirection = XMVectorSet(ndcX / projection._11, ndcY / projection._22, 1.0f, 0.0f);
+
+	XMMATRIX inverseView = XMMatrixInverse(nullptr, XMLoadFloat4x4(&view));
+	XMStoreFloat3(&direction, XMVector3Normalize(XMVector3TransformNormal(viewDirection, inverseView)));
+	origin = camera.GetTranslation();
+}
+
+// --------------------------------------------------------
+// The ray is moved into each mesh's local space without
+// normalizing its direction, so distances along it are
+// the same in both spaces, even for scaled instances
+// --------------------------------------------------------
+bool Picking::Raycast(const SceneBvh& instanceBvh, const std::vector<const MeshBvh*>& meshes,
+	const std::vector<DirectX::XMFLOAT4X4>& worldMatrices,
+	DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, PickHit& hit)
+{
+	XMVECTOR rayOrigin = XMLoadFloat3(&origin);
+	XMVECTOR rayDirection = XMVector3Normalize(XMLoadFloat3(&direction));
+	XMFLOAT3 normalized;
+	XMStoreFloat3(&normalized, rayDirection);
+
+	bool found = instanceBvh.Raycast(origin, normalized, maxDistance, [&](unsigned int instance, float boxDistance, float& closest)
+		{
+			if (meshes[instance] == nullptr)
+				return false;
+
+			XMMATRIX inverseWorld = XMMatrixInverse(nullptr, XMLoadFloat4x4(&worldMatrices[instance]));
+			XMFLOAT3 localOrigin, localDirection;
+			XMStoreFloat3(&localOrigin, XMVector3Transform(rayOrigin, inverseWorld));
+			XMStoreFloat3(&localDirection, XMVector3TransformNormal(rayDirection, inverseWorld));
+
+			TriangleRayHit triangleHit;
+			if (!meshes[instance]->Raycast(localOrigin, localDirection, closest, triangleHit))
+				return false;
+
+			closest = triangleHit.Distance;
+			hit.Instance = instance;
+			hit.Triangle = triangleHit.Triangle;
+			hit.Distance = triangleHit.Distance;
+			hit.Barycentrics = triangleHit.Barycentrics;
+			return true;
+		});
+
+	if (found)
+		XMStoreFloat3(&hit.Position, XMVectorMultiplyAdd(rayDirection, XMVectorReplicate(hit.Distance), rayOrigin));
+	return found;
+}
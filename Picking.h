@@ -0,0 +1,41 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Camera.h"
+#include "MeshBvh.h"
+#include "SceneBvh.h"
+
+// --------------------------------------------------------
+// The closest thing a picking ray hit
+// --------------------------------------------------------
+struct PickHit
+{
+	unsigned int Instance;				// Index into the instances the ray was cast against
+	unsigned int Triangle;				// Within that instance's mesh
+	float Distance;						// World-space, from the ray's origin
+	DirectX::XMFLOAT2 Barycentrics;		// Weights of the triangle's second and third vertices
+	DirectX::XMFLOAT3 Position;			// World-space
+};
+
+// --------------------------------------------------------
+// Ray casts against a scene of mesh instances, in two
+// levels: a SceneBvh over the instances' world-space
+// boxes, then each instance's MeshBvh, with the ray moved
+// into that mesh's local space
+// --------------------------------------------------------
+namespace Picking
+{
+	// The world-space ray through a pixel of a camera's view (which is
+	// width x height pixels), starting at the camera
+	void ScreenRay(Camera& camera, float pixelX, float pixelY, float width, float height,
+		DirectX::XMFLOAT3& origin, DirectX::XMFLOAT3& direction);
+
+	// Finds the closest triangle the ray hits within maxDistance
+	// - instanceBvh must have been built from the instances' world-space
+	//    bounds, in the same order as meshes and worldMatrices
+	bool Raycast(const SceneBvh& instanceBvh, const std::vector<const MeshBvh*>& meshes,
+		const std::vector<DirectX::XMFLOAT4X4>& worldMatrices,
+		DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, PickHit& hit);
+}
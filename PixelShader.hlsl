@@ -1,15 +1,6 @@
 #include "ShaderIncludes.hlsli"
 // Basic pixel shader. Just returns a color tint passed via constant buffer.
-cbuffer ExternalData : register(b0)
-{
-    float4 colorTint;
-    float2 textureScale;
-    float2 textureOffset;
-    float totalTime;
-    float3 cameraPos;
-    
-    Light lights[5]; // Array of exactly 5 lights
-}
+// Constant data comes from PerFrame and PerMaterial (see ShaderIncludes.hlsli)
 
 // Texture and sampler state are bound with registers
 Texture2D Albedo		    : register(t0);
@@ -0,0 +1,233 @@
+#include "RenderCommandList.h"
+
+#include <algorithm>
+#include <cstring>
+
+static_assert(sizeof(RenderCommandHeader) == 8);
+static_assert(sizeof(BindPipelineCommand) % RenderCommandList::Alignment == 0);
+static_assert(sizeof(BindMaterialCommand) % RenderCommandList::Alignment == 0);
+static_assert(sizeof(SetConstantsCommand) % RenderCommandList::Alignment == 0);
+static_assert(sizeof(DrawCommand) % RenderCommandList::Alignment == 0);
+
+RenderCommandList::RenderCommandList(size_t initialCapacity) :
+	bytes(std::max(initialCapacity, (size_t)Alignment)),
+	used(0),
+	commandCount(0)
+{
+}
+
+RenderCommandList::~RenderCommandList()
+{
+}
+
+void RenderCommandList::Reset()
+{
+	used = 0;
+	commandCount = 0;
+}
+
+void RenderCommandList::BindPipeline(unsigned int pipeline, unsigned int material)
+{
+	BindPipelineCommand* command = Push<BindPipelineCommand>(RenderCommandType::BindPipeline);
+	command->Pipeline = pipeline;
+	command->Material = material;
+}
+
+void RenderCommandList::BindMaterial(unsigned int material)
+{
+	BindMaterialCommand* command = Push<BindMaterialCommand>(RenderCommandType::BindMaterial);
+	command->Material = material;
+}
+
+bool RenderCommandList::SetConstants(RenderShaderStage stage, unsigned int slot, const void* data, unsigned int dataSize)
+{
+	if (dataSize > MaxConstantsSize)
+		return false;
+
+	SetConstantsCommand* command = Push<SetConstantsCommand>(RenderCommandType::SetConstants, dataSize);
+	command->Stage = stage;
+	command->Slot = (unsigned char)slot;
+	command->DataSize = dataSize;
+	memcpy(command + 1, data, dataSize);
+	return true;
+}
+
+void RenderCommandList::Draw(unsigned int mesh, int lod, unsigned int instanceCount, unsigned int startInstance)
+{
+	DrawCommand* command = Push<DrawCommand>(RenderCommandType::Draw);
+	command->Mesh = mesh;
+	command->Lod = lod;
+	command->InstanceCount = instanceCount;
+	command->StartInstance = startInstance;
+}
+
+void RenderCommandList::Append(const RenderCommandList& other)
+{
+	if (other.used == 0)
+		return;
+
+	memcpy(Allocate(other.used), other.bytes.data(), other.used);
+	commandCount += other.commandCount;
+}
+
+const unsigned char* RenderCommandList::GetData() const
+{
+	return bytes.data();
+}
+
+size_t RenderCommandList::GetSize() const
+{
+	return used;
+}
+
+size_t RenderCommandList::GetCapacity() const
+{
+	return bytes.size();
+}
+
+unsigned int RenderCommandList::GetCommandCount() const
+{
+	return commandCount;
+}
+
+const void* RenderCommandList::GetConstantsData(const SetConstantsCommand* command)
+{
+	return command + 1;
+}
+
+const RenderCommandHeader* RenderCommandList::ReadCommand(const unsigned char* data, size_t size, size_t offset)
+{
+	// The header itself has to fit, and so does the rest of the command
+	if (offset >= size || size - offset < sizeof(RenderCommandHeader))
+		return nullptr;
+
+	const RenderCommandHeader* header = reinterpret_cast<const RenderCommandHeader*>(data + offset);
+	if (header->Size == 0 || header->Size % Alignment != 0 || header->Size > size - offset)
+		return nullptr;
+
+	switch (header->Type)
+	{
+	case RenderCommandType::BindPipeline:
+		return header->Size >= sizeof(BindPipelineCommand) ? header : nullptr;
+
+	case RenderCommandType::BindMaterial:
+		return header->Size >= sizeof(BindMaterialCommand) ? header : nullptr;
+
+	case RenderCommandType::SetConstants:
+	{
+		if (header->Size < sizeof(SetConstantsCommand))
+			return nullptr;
+
+		const SetConstantsCommand* command = reinterpret_cast<const SetConstantsCommand*>(header);
+		if (command->DataSize > MaxConstantsSize ||
+			header->Size < sizeof(SetConstantsCommand) + command->DataSize ||
+			command->Slot >= ConstantBufferSlots ||
+			(command->Stage != RenderShaderStage::Vertex && command->Stage != RenderShaderStage::Pixel))
+			return nullptr;
+		return header;
+	}
+
+	case RenderCommandType::Draw:
+		return header->Size >= sizeof(DrawCommand) ? header : nullptr;
+
+	default:
+		return nullptr;
+	}
+}
+
+// --------------------------------------------------------
+// Bumps the end of the list along, doubling the block when
+// it's full (which moves everything already in it)
+// --------------------------------------------------------
+void* RenderCommandList::Allocate(size_t size)
+{
+	size = (size + Alignment - 1) / Alignment * Alignment;
+	if (used + size > bytes.size())
+		bytes.resize(std::max(bytes.size() * 2, used + size));
+
+	void* allocation = bytes.data() + used;
+	used += size;
+	return allocation;
+}
+
+template<typename Command>
+Command* RenderCommandList::Push(RenderCommandType type, size_t extraBytes)
+{
+	size_t size = (sizeof(Command) + extraBytes + Alignment - 1) / Alignment * Alignment;
+	Command* command = static_cast<Command*>(Allocate(size));
+	memset(command, 0, sizeof(Command));
+	command->Header.Type = type;
+	command->Header.Size = (unsigned int)size;
+	commandCount++;
+	return command;
+}
+
+
+NullCommandExecutor::NullCommandExecutor()
+{
+	Reset();
+}
+
+NullCommandExecutor::~NullCommandExecutor()
+{
+}
+
+bool NullCommandExecutor::Execute(const RenderCommandList& list)
+{
+	const unsigned char* data = list.GetData();
+	size_t size = list.GetSize();
+	size_t offset = 0;
+	while (offset < size)
+	{
+		const RenderCommandHeader* header = RenderCommandList::ReadCommand(data, size, offset);
+		if (!header)
+			return false;
+
+		switch (header->Type)
+		{
+		case RenderCommandType::BindPipeline:
+			pipelineBound = true;
+			counts.pipelines++;
+			break;
+
+		case RenderCommandType::BindMaterial:
+			materialBound = true;
+			counts.materials++;
+			break;
+
+		case RenderCommandType::SetConstants:
+		{
+			const SetConstantsCommand* command = reinterpret_cast<const SetConstantsCommand*>(header);
+			counts.constants++;
+			counts.constantBytes += command->DataSize;
+			break;
+		}
+
+		case RenderCommandType::Draw:
+		{
+			const DrawCommand* command = reinterpret_cast<const DrawCommand*>(header);
+			if (!pipelineBound || !materialBound || command->InstanceCount == 0)
+				return false;
+			counts.draws++;
+			counts.instances += command->InstanceCount;
+			break;
+		}
+		}
+
+		offset += header->Size;
+	}
+
+	return true;
+}
+
+void NullCommandExecutor::Reset()
+{
+	counts = {};
+	pipelineBound = false;
+	materialBound = false;
+}
+
+const RenderCommandCounts& NullCommandExecutor::GetCounts() const
+{
+	return counts;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// --------------------------------------------------------
+// What a recorded command does
+// --------------------------------------------------------
+enum class RenderCommandType : unsigned char
+{
+	BindPipeline,	// Vertex shader and input layout, plus the material's pixel shader
+	BindMaterial,	// The material's textures and samplers
+	SetConstants,	// Data for one constant buffer slot, stored right after the command
+	Draw
+};
+
+enum class RenderShaderStage : unsigned char
+{
+	Vertex,
+	Pixel
+};
+
+// --------------------------------------------------------
+// Commands as they sit in a RenderCommandList's bytes
+// - Plain data only: IDs (like handle values) rather than
+//    pointers, so a list means the same thing to any
+//    executor, on any thread
+// - Size covers the whole command, including anything
+//    stored after it, and is a multiple of Alignment, so
+//    the next command starts Size bytes later
+// --------------------------------------------------------
+struct RenderCommandHeader
+{
+	RenderCommandType Type;
+	unsigned char Padding[3];
+	unsigned int Size;
+};
+
+struct BindPipelineCommand
+{
+	RenderCommandHeader Header;
+	unsigned int Pipeline;		// Up to the executor; Game uses VertexFormat
+	unsigned int Material;
+};
+
+struct BindMaterialCommand
+{
+	RenderCommandHeader Header;
+	unsigned int Material;
+	unsigned int Padding;
+};
+
+struct SetConstantsCommand
+{
+	RenderCommandHeader Header;
+	RenderShaderStage Stage;
+	unsigned char Slot;
+	unsigned char Padding[2];
+	unsigned int DataSize;		// In bytes, not counting padding after it
+};
+
+struct DrawCommand
+{
+	RenderCommandHeader Header;
+	unsigned int Mesh;
+	int Lod;
+	unsigned int InstanceCount;
+	unsigned int StartInstance;
+};
+
+// --------------------------------------------------------
+// A list of render commands, packed one after another into
+// a single block of bytes
+// - The block is a linear allocator: each command goes
+//    straight after the last, and Reset() rewinds to the
+//    start without freeing anything, so a list reused every
+//    frame stops allocating once it's big enough
+// - Lists don't share anything, so each thread can record
+//    its own; Append() then joins them in order
+// - Nothing here touches D3D (see D3D11CommandExecutor and
+//    NullCommandExecutor for running a list)
+// --------------------------------------------------------
+class RenderCommandList
+{
+public:
+	static constexpr unsigned int Alignment = 8;
+	static constexpr unsigned int MaxConstantsSize = 65536;	// A whole constant buffer (4096 float4s)
+	static constexpr unsigned int ConstantBufferSlots = 14;
+
+	RenderCommandList(size_t initialCapacity = 64 * 1024);
+	~RenderCommandList();
+
+	void Reset();
+
+	void BindPipeline(unsigned int pipeline, unsigned int material);
+	void BindMaterial(unsigned int material);
+	// Records nothing (and returns false) if there's more data than a constant
+	// buffer can hold, rather than cutting it short
+	bool SetConstants(RenderShaderStage stage, unsigned int slot, const void* data, unsigned int dataSize);
+	void Draw(unsigned int mesh, int lod, unsigned int instanceCount = 1, unsigned int startInstance = 0);
+
+	// Copies every command from other onto the end of this list
+	void Append(const RenderCommandList& other);
+
+	const unsigned char* GetData() const;
+	size_t GetSize() const;
+	size_t GetCapacity() const;
+	unsigned int GetCommandCount() const;
+
+	// Where the data of a SetConstants command is
+	static const void* GetConstantsData(const SetConstantsCommand* command);
+
+	// The command offset bytes into a block of size bytes, or null if it
+	// isn't well formed: a known type, a size that fits and covers that
+	// type, and (for constants) a slot, stage and data size that make sense
+	// - Every executor walks a list through this, so none of them reads
+	//    past the end of it or loops on a zero size
+	static const RenderCommandHeader* ReadCommand(const unsigned char* data, size_t size, size_t offset);
+
+private:
+	// Reserves size bytes (rounded up to Alignment) at the end of the list
+	// - Only good until the next call, since the block may have to grow
+	void* Allocate(size_t size);
+
+	template<typename Command>
+	Command* Push(RenderCommandType type, size_t extraBytes = 0);
+
+	std::vector<unsigned char> bytes;
+	size_t used;
+	unsigned int commandCount;
+};
+
+// --------------------------------------------------------
+// What a NullCommandExecutor found
+// --------------------------------------------------------
+struct RenderCommandCounts
+{
+	unsigned int pipelines;
+	unsigned int materials;
+	unsigned int constants;
+	unsigned int draws;
+	unsigned int instances;
+	unsigned long long constantBytes;
+};
+
+// --------------------------------------------------------
+// Runs a list without drawing anything, checking that every
+// command is well formed and in a sensible order, and
+// counting what it would have done
+// - A list is valid if every command passes ReadCommand(),
+//    and nothing is drawn before a pipeline and material
+//    are bound
+// - Bindings carry over from one Execute() to the next, as
+//    they would on a device, until Reset()
+// --------------------------------------------------------
+class NullCommandExecutor
+{
+public:
+	NullCommandExecutor();
+	~NullCommandExecutor();
+
+	// Returns false (and stops) at the first invalid command
+	bool Execute(const RenderCommandList& list);
+	void Reset();
+
+	const RenderCommandCounts& GetCounts() const;
+
+private:
+	RenderCommandCounts counts;
+	bool pipelineBound;
+	bool materialBound;
+};
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <climits>
+#include <utility>
+#include <vector>
+
+// --------------------------------------------------------
+// A 32-bit reference to something in a ResourcePool
+// - The low IndexBits are the slot it's in, the rest count
+//    how many times that slot has been reused, so an old
+//    handle never finds whatever took its place
+// - Generation 0 is never used, so a zeroed handle is null
+// - Tag only keeps handles to different kinds of resource
+//    from being mixed up
+// --------------------------------------------------------
+template<typename Tag>
+struct ResourceHandle
+{
+	static constexpr unsigned int IndexBits = 20;
+	static constexpr unsigned int IndexMask = (1u << IndexBits) - 1;
+	static constexpr unsigned int MaxGeneration = UINT_MAX >> IndexBits;
+
+	unsigned int Value;
+
+	unsigned int GetIndex() const { return Value & IndexMask; }
+	unsigned int GetGeneration() const { return Value >> IndexBits; }
+	bool IsNull() const { return Value == 0; }
+
+	bool operator==(const ResourceHandle& other) const = default;
+};
+
+// --------------------------------------------------------
+// Owns resources of one type, kept together in a single
+// array and handed out as ResourceHandles
+// - Get() checks the handle's generation, so a released
+//    (stale) handle finds nothing instead of the wrong thing
+// - Released resources stay alive until framesToKeep more
+//    frames have ended, so anything still using them this
+//    frame (or on the GPU) isn't left with a dangling one;
+//    call EndFrame() once at the end of every frame
+// - Destroying a resource moves the last one into its place,
+//    so pointers from Get() are only good until the next
+//    Add() or EndFrame()
+// --------------------------------------------------------
+template<typename T, typename Tag = T>
+class ResourcePool
+{
+public:
+	using Handle = ResourceHandle<Tag>;
+
+	ResourcePool(unsigned int framesToKeep = 2) :
+		framesToKeep(framesToKeep),
+		frame(0),
+		count(0)
+	{
+	}
+
+	// Takes ownership of resource, returning a null handle if every slot
+	// is in use
+	Handle Add(T resource)
+	{
+		unsigned int index;
+		if (!freeSlots.empty())
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else if (slots.size() <= Handle::IndexMask)
+		{
+			index = (unsigned int)slots.size();
+			slots.push_back({ 1, 0 });
+		}
+		else
+		{
+			return {};
+		}
+
+		Slot& slot = slots[index];
+		slot.Item = (unsigned int)items.size();
+		items.push_back(std::move(resource));
+		itemSlots.push_back(index);
+		itemAlive.push_back(1);
+
+		count++;
+		return { (slot.Generation << Handle::IndexBits) | index };
+	}
+
+	// The handle is stale from now on, though the resource itself is only
+	// destroyed framesToKeep frames from now
+	void Release(Handle handle)
+	{
+		if (!IsValid(handle))
+			return;
+
+		// Skip generation 0 when wrapping around, so null stays null
+		Slot& slot = slots[handle.GetIndex()];
+		slot.Generation = slot.Generation == Handle::MaxGeneration ? 1 : slot.Generation + 1;
+		itemAlive[slot.Item] = 0;
+		pending.push_back({ handle.GetIndex(), frame });
+
+		count--;
+	}
+
+	bool IsValid(Handle handle) const
+	{
+		unsigned int index = handle.GetIndex();
+		return index < slots.size() && slots[index].Generation == handle.GetGeneration();
+	}
+
+	// Null if the handle is stale (or null)
+	T* Get(Handle handle)
+	{
+		return IsValid(handle) ? &items[slots[handle.GetIndex()].Item] : nullptr;
+	}
+
+	const T* Get(Handle handle) const
+	{
+		return IsValid(handle) ? &items[slots[handle.GetIndex()].Item] : nullptr;
+	}
+
+	// Destroys anything released framesToKeep frames ago (or earlier)
+	void EndFrame()
+	{
+		frame++;
+
+		// Released in order, so everything old enough is at the front
+		size_t destroyed = 0;
+		while (destroyed < pending.size() && frame - pending[destroyed].Frame >= framesToKeep)
+		{
+			Destroy(pending[destroyed].SlotIndex);
+			destroyed++;
+		}
+		pending.erase(pending.begin(), pending.begin() + destroyed);
+	}
+
+	// Calls function with the handle and value of every resource that hasn't
+	// been released, in storage order
+	template<typename Function>
+	void ForEach(Function&& function)
+	{
+		for (unsigned int i = 0; i < items.size(); i++)
+		{
+			if (!itemAlive[i])
+				continue;
+
+			unsigned int index = itemSlots[i];
+			function(Handle{ (slots[index].Generation << Handle::IndexBits) | index }, items[i]);
+		}
+	}
+
+	// Resources that haven't been released
+	unsigned int GetCount() const { return count; }
+
+	// Released resources that haven't been destroyed yet
+	unsigned int GetPendingCount() const { return (unsigned int)pending.size(); }
+
+private:
+
+	// Every slot ever handed out; Item is where its resource is in items,
+	// for as long as it has one
+	struct Slot
+	{
+		unsigned int Generation;
+		unsigned int Item;
+	};
+
+	struct PendingRelease
+	{
+		unsigned int SlotIndex;
+		unsigned long long Frame;
+	};
+
+	unsigned int framesToKeep;
+	unsigned long long frame;
+	unsigned int count;
+
+	std::vector<Slot> slots;
+	std::vector<unsigned int> freeSlots;
+	std::vector<PendingRelease> pending;
+
+	// One element per resource, released or not
+	std::vector<T> items;
+	std::vector<unsigned int> itemSlots;
+	std::vector<unsigned char> itemAlive;
+
+	// Moves the last resource into this one's place
+	void Destroy(unsigned int index)
+	{
+		unsigned int item = slots[index].Item;
+		unsigned int last = (unsigned int)items.size() - 1;
+		if (item != last)
+		{
+			items[item] = std::move(items[last]);
+			itemSlots[item] = itemSlots[last];
+			itemAlive[item] = itemAlive[last];
+			slots[itemSlots[item]].Item = item;
+		}
+
+		items.pop_back();
+		itemSlots.pop_back();
+		itemAlive.pop_back();
+		freeSlots.push_back(index);
+	}
+};
@@ -0,0 +1,799 @@
+#include "SceneBvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <climits>
+#include <cmath>
+
+using namespace DirectX;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+
+	// Half the surface area of a box, which is all the heuristic needs
+	float HalfArea(XMFLOAT3 boxMin, XMFLOAT3 boxMax)
+	{
+		float x = std::max(boxMax.x - boxMin.x, 0.0f);
+		float y = std::max(boxMax.y - boxMin.y, 0.0f);
+		float z = std::max(boxMax.z - boxMin.z, 0.0f);
+		return x * y + y * z + z * x;
+	}
+
+	void Grow(XMFLOAT3& boxMin, XMFLOAT3& boxMax, XMFLOAT3 otherMin, XMFLOAT3 otherMax)
+	{
+		boxMin = XMFLOAT3(std::min(boxMin.x, otherMin.x), std::min(boxMin.y, otherMin.y), std::min(boxMin.z, otherMin.z));
+		boxMax = XMFLOAT3(std::max(boxMax.x, otherMax.x), std::max(boxMax.y, otherMax.y), std::max(boxMax.z, otherMax.z));
+	}
+
+	bool SameBox(XMFLOAT3 aMin, XMFLOAT3 aMax, XMFLOAT3 bMin, XMFLOAT3 bMax)
+	{
+		return aMin.x == bMin.x && aMin.y == bMin.y && aMin.z == bMin.z &&
+			aMax.x == bMax.x && aMax.y == bMax.y && aMax.z == bMax.z;
+	}
+
+	// Where along the ray it enters the box, or -1 if it misses it (or only
+	// gets there after maxDistance)
+	// - Tests all three slabs at once; origin and inverseDirection have 0
+	//    in w, so w's slab is [0, 0] and clamps the entry point to 0
+	float RayEntersBox(FXMVECTOR origin, FXMVECTOR inverseDirection, float maxDistance, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+	{
+		XMVECTOR t0 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&boxMin), origin), inverseDirection);
+		XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&boxMax), origin), inverseDirection);
+		XMVECTOR near = XMVectorMin(t0, t1);
+		XMVECTOR far = XMVectorMax(t0, t1);
+
+		XMVECTOR enter = XMVectorMax(XMVectorMax(XMVectorSplatX(near), XMVectorSplatY(near)), XMVectorMax(XMVectorSplatZ(near), XMVectorSplatW(near)));
+		XMVECTOR exit = XMVectorMin(XMVectorMin(XMVectorSplatX(far), XMVectorSplatY(far)), XMVectorMin(XMVectorSplatZ(far), XMVectorReplicate(maxDistance)));
+		float entered = XMVectorGetX(enter);
+		return entered <= XMVectorGetX(exit) ? entered : -1.0f;
+	}
+
+	// The top bit of a query's stack entry marks a node entirely inside the
+	// query, so nothing below it needs testing
+	const unsigned int InsideFlag = 0x80000000u;
+}
+
+
+SceneBvh::SceneBvh(std::shared_ptr<WorkerPool> workers) :
+	workers{ workers },
+	topNodeCount{ 0 },
+	unusedNodeCount{ 0 },
+	topBuildCost{ 0.0f },
+	topCost{ 0.0f },
+	stats{}
+{
+}
+
+SceneBvh::~SceneBvh()
+{
+}
+
+// --------------------------------------------------------
+// Builds the nodes above the subtrees one at a time, then
+// builds every subtree, in parallel
+// --------------------------------------------------------
+void SceneBvh::Build(const WorldBounds& bounds)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	unsigned int objectCount = (unsigned int)bounds.CenterX.size();
+	objects.resize(objectCount);
+	for (unsigned int i = 0; i < objectCount; i++)
+	{
+		objects[i].Min = XMFLOAT3(bounds.CenterX[i] - bounds.ExtentX[i], bounds.CenterY[i] - bounds.ExtentY[i], bounds.CenterZ[i] - bounds.ExtentZ[i]);
+		objects[i].Max = XMFLOAT3(bounds.CenterX[i] + bounds.ExtentX[i], bounds.CenterY[i] + bounds.ExtentY[i], bounds.CenterZ[i] + bounds.ExtentZ[i]);
+		objects[i].Index = i;
+		objects[i].Padding = 0;
+	}
+	objectSlots.resize(objectCount);
+	leaves.resize(objectCount);
+
+	nodes.clear();
+	parents.clear();
+	owners.clear();
+	subtrees.clear();
+	unusedNodeCount = 0;
+
+	if (objectCount > 0)
+	{
+		// Split until each part is small enough to be a subtree
+		// - Each range of objects waits on a stack with its node
+		struct Range { unsigned int Node; unsigned int First; unsigned int Count; };
+		std::vector<Range> stack = { { 0, 0, objectCount } };
+		nodes.push_back({});
+		parents.push_back(0);
+		owners.push_back(UINT_MAX);
+
+		while (!stack.empty())
+		{
+			Range range = stack.back();
+			stack.pop_back();
+
+			if (range.Count <= SubtreeSize)
+			{
+				subtrees.push_back({ range.Node, 0, 0, range.First, range.Count, 0.0f, 0.0f });
+				continue;
+			}
+
+			Node& node = nodes[range.Node];
+			unsigned int leftCount = SplitObjects(&objects[range.First], range.Count, node.Min, node.Max);
+			unsigned int left = (unsigned int)nodes.size();
+			nodes[range.Node].LeftOrFirst = left;
+			nodes[range.Node].Count = 0;
+
+			nodes.push_back({});
+			nodes.push_back({});
+			parents.insert(parents.end(), { range.Node, range.Node });
+			owners.insert(owners.end(), { UINT_MAX, UINT_MAX });
+			stack.push_back({ left, range.First, leftCount });
+			stack.push_back({ left + 1, range.First + leftCount, range.Count - leftCount });
+		}
+		topNodeCount = (unsigned int)nodes.size();
+
+		std::vector<unsigned int> all(subtrees.size());
+		for (unsigned int i = 0; i < all.size(); i++)
+			all[i] = i;
+		BuildSubtrees(all);
+
+		// The top nodes' bounds were found while splitting, so only costs are left
+		RecomputeCosts();
+	}
+	else
+	{
+		topNodeCount = 0;
+		topCost = 0.0f;
+	}
+
+	topBuildCost = topCost;
+	for (Subtree& subtree : subtrees)
+		subtree.BuildCost = subtree.Cost;
+
+	stats.buildMilliseconds = MillisecondsSince(start);
+}
+
+// --------------------------------------------------------
+// Refits the boxes of moved objects and the nodes above
+// them, then rebuilds whatever got too much worse
+// - A few moved objects walk up from their leaves, stopping
+//    where a node's box no longer changes
+// - Many moved objects refit every node instead, each
+//    subtree on whichever thread gets to it first
+// - If the nodes above the subtrees got too much worse, or
+//    partial rebuilds have left too many unused nodes
+//    behind, everything is rebuilt
+// --------------------------------------------------------
+void SceneBvh::Refit(const WorldBounds& bounds, const std::vector<unsigned int>& moved)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	stats.rebuiltSubtrees = 0;
+	stats.fullRebuild = false;
+
+	if (bounds.CenterX.size() != objects.size())
+	{
+		Build(bounds);
+		stats.fullRebuild = true;
+		stats.refitMilliseconds = MillisecondsSince(start);
+		return;
+	}
+
+	for (unsigned int i : moved)
+	{
+		ObjectBox& box = objects[objectSlots[i]];
+		box.Min = XMFLOAT3(bounds.CenterX[i] - bounds.ExtentX[i], bounds.CenterY[i] - bounds.ExtentY[i], bounds.CenterZ[i] - bounds.ExtentZ[i]);
+		box.Max = XMFLOAT3(bounds.CenterX[i] + bounds.ExtentX[i], bounds.CenterY[i] + bounds.ExtentY[i], bounds.CenterZ[i] + bounds.ExtentZ[i]);
+	}
+
+	// Walking up from each leaf touches a node at every level for each
+	// object (and out of order), so past a few percent of the objects it's
+	// faster to refit everything
+	if (moved.size() * 32 < objects.size())
+	{
+		for (unsigned int i : moved)
+			RefitUpwards(leaves[i]);
+	}
+	else if (!objects.empty())
+	{
+		std::atomic<size_t> next = 0;
+		auto work = [&]()
+			{
+				for (size_t i = next++; i < subtrees.size(); i = next++)
+				{
+					Subtree& subtree = subtrees[i];
+					float cost = 0.0f;
+					for (unsigned int node = subtree.FirstNode + subtree.NodeCount; node-- > subtree.FirstNode;)
+					{
+						RefitNode(node);
+						cost += NodeCost(node);
+					}
+					subtree.Cost = cost;
+				}
+			};
+
+		RunOnWorkers(subtrees.size(), work);
+
+		// Children are always after their parents
+		topCost = 0.0f;
+		for (unsigned int node = topNodeCount; node-- > 0;)
+		{
+			RefitNode(node);
+			topCost += NodeCost(node);
+		}
+	}
+
+	if (topCost > topBuildCost * RebuildThreshold || unusedNodeCount > nodes.size() - unusedNodeCount)
+	{
+		Build(bounds);
+		stats.fullRebuild = true;
+	}
+	else
+	{
+		std::vector<unsigned int> degraded;
+		for (unsigned int i = 0; i < subtrees.size(); i++)
+		{
+			if (subtrees[i].Cost > subtrees[i].BuildCost * RebuildThreshold)
+				degraded.push_back(i);
+		}
+
+		if (!degraded.empty())
+		{
+			BuildSubtrees(degraded);
+			for (unsigned int i : degraded)
+				subtrees[i].BuildCost = subtrees[i].Cost;
+
+			// The rebuilt subtrees' roots are exact again, so refit the nodes above
+			topCost = 0.0f;
+			for (unsigned int node = topNodeCount; node-- > 0;)
+			{
+				RefitNode(node);
+				topCost += NodeCost(node);
+			}
+			stats.rebuiltSubtrees = (unsigned int)degraded.size();
+		}
+	}
+
+	stats.refitMilliseconds = MillisecondsSince(start);
+}
+
+unsigned int SceneBvh::QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& results) const
+{
+	results.clear();
+	if (nodes.empty())
+		return 0;
+
+	// 0 if the box is outside a plane, 2 if it's inside all of them, 1 otherwise
+	auto classify = [&frustum](XMFLOAT3 boxMin, XMFLOAT3 boxMax)
+		{
+			XMFLOAT3 center((boxMin.x + boxMax.x) * 0.5f, (boxMin.y + boxMax.y) * 0.5f, (boxMin.z + boxMax.z) * 0.5f);
+			XMFLOAT3 extents(boxMax.x - center.x, boxMax.y - center.y, boxMax.z - center.z);
+			int result = 2;
+			for (const XMFLOAT4& plane : frustum.Planes)
+			{
+				float radius = fabsf(plane.x) * extents.x + fabsf(plane.y) * extents.y + fabsf(plane.z) * extents.z;
+				float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+				if (distance < -radius)
+					return 0;
+				if (distance < radius)
+					result = 1;
+			}
+			return result;
+		};
+
+	std::vector<unsigned int> stack = { 0 };
+	while (!stack.empty())
+	{
+		unsigned int entry = stack.back();
+		stack.pop_back();
+		bool inside = (entry & InsideFlag) != 0;
+		const Node& node = nodes[entry & ~InsideFlag];
+
+		if (!inside)
+		{
+			int result = classify(node.Min, node.Max);
+			if (result == 0)
+				continue;
+			inside = result == 2;
+		}
+
+		if (node.Count > 0)
+		{
+			for (unsigned int i = node.LeftOrFirst; i < node.LeftOrFirst + node.Count; i++)
+			{
+				if (inside || classify(objects[i].Min, objects[i].Max) != 0)
+					results.push_back(objects[i].Index);
+			}
+		}
+		else
+		{
+			unsigned int flag = inside ? InsideFlag : 0;
+			stack.push_back(node.LeftOrFirst | flag);
+			stack.push_back((node.LeftOrFirst + 1) | flag);
+		}
+	}
+	return (unsigned int)results.size();
+}
+
+unsigned int SceneBvh::QuerySphere(DirectX::XMFLOAT3 center, float radius, std::vector<unsigned int>& results) const
+{
+	results.clear();
+	if (nodes.empty())
+		return 0;
+
+	auto touches = [center, radius](XMFLOAT3 boxMin, XMFLOAT3 boxMax)
+		{
+			float x = center.x - std::clamp(center.x, boxMin.x, boxMax.x);
+			float y = center.y - std::clamp(center.y, boxMin.y, boxMax.y);
+			float z = center.z - std::clamp(center.z, boxMin.z, boxMax.z);
+			return x * x + y * y + z * z <= radius * radius;
+		};
+
+	std::vector<unsigned int> stack = { 0 };
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (!touches(node.Min, node.Max))
+			continue;
+
+		if (node.Count > 0)
+		{
+			for (unsigned int i = node.LeftOrFirst; i < node.LeftOrFirst + node.Count; i++)
+			{
+				if (touches(objects[i].Min, objects[i].Max))
+					results.push_back(objects[i].Index);
+			}
+		}
+		else
+		{
+			stack.push_back(node.LeftOrFirst);
+			stack.push_back(node.LeftOrFirst + 1);
+		}
+	}
+	return (unsigned int)results.size();
+}
+
+unsigned int SceneBvh::QueryBox(DirectX::XMFLOAT3 boxMin, DirectX::XMFLOAT3 boxMax, std::vector<unsigned int>& results) const
+{
+	results.clear();
+	if (nodes.empty())
+		return 0;
+
+	auto overlaps = [boxMin, boxMax](XMFLOAT3 otherMin, XMFLOAT3 otherMax)
+		{
+			return otherMin.x <= boxMax.x && otherMax.x >= boxMin.x &&
+				otherMin.y <= boxMax.y && otherMax.y >= boxMin.y &&
+				otherMin.z <= boxMax.z && otherMax.z >= boxMin.z;
+		};
+
+	std::vector<unsigned int> stack = { 0 };
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (!overlaps(node.Min, node.Max))
+			continue;
+
+		if (node.Count > 0)
+		{
+			for (unsigned int i = node.LeftOrFirst; i < node.LeftOrFirst + node.Count; i++)
+			{
+				if (overlaps(objects[i].Min, objects[i].Max))
+					results.push_back(objects[i].Index);
+			}
+		}
+		else
+		{
+			stack.push_back(node.LeftOrFirst);
+			stack.push_back(node.LeftOrFirst + 1);
+		}
+	}
+	return (unsigned int)results.size();
+}
+
+bool SceneBvh::Raycast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, BvhRayHit& hit) const
+{
+	XMFLOAT3 normalized;
+	XMStoreFloat3(&normalized, XMVector3Normalize(XMLoadFloat3(&direction)));
+
+	// The boxes are all that's hit, so the first one entered is the closest
+	return Raycast(origin, normalized, maxDistance, [&hit](unsigned int index, float boxDistance, float& closest)
+		{
+			closest = boxDistance;
+			hit.Index = index;
+			hit.Distance = boxDistance;
+			return true;
+		});
+}
+
+// --------------------------------------------------------
+// Visits the nearer child first, and skips anything the
+// ray reaches only after the closest hit so far
+// --------------------------------------------------------
+bool SceneBvh::Raycast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, const RayObjectTest& test) const
+{
+	if (nodes.empty())
+		return false;
+
+	// Zero components become huge, rather than infinite, so 0 * inverse stays 0
+	auto inverse = [](float value) { return 1.0f / (value == 0.0f ? 1e-30f : value); };
+	XMVECTOR rayOrigin = XMVectorSet(origin.x, origin.y, origin.z, 0.0f);
+	XMVECTOR inverseDirection = XMVectorSet(inverse(direction.x), inverse(direction.y), inverse(direction.z), 0.0f);
+
+	float closest = maxDistance;
+	bool found = false;
+	if (RayEntersBox(rayOrigin, inverseDirection, closest, nodes[0].Min, nodes[0].Max) < 0.0f)
+		return false;
+
+	std::vector<unsigned int> stack = { 0 };
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+
+		if (node.Count > 0)
+		{
+			for (unsigned int i = node.LeftOrFirst; i < node.LeftOrFirst + node.Count; i++)
+			{
+				float distance = RayEntersBox(rayOrigin, inverseDirection, closest, objects[i].Min, objects[i].Max);
+				if (distance >= 0.0f && (!found || distance < closest) && test(objects[i].Index, distance, closest))
+					found = true;
+			}
+			continue;
+		}
+
+		// Push the farther child first, so the nearer one is popped next
+		unsigned int left = node.LeftOrFirst;
+		float leftDistance = RayEntersBox(rayOrigin, inverseDirection, closest, nodes[left].Min, nodes[left].Max);
+		float rightDistance = RayEntersBox(rayOrigin, inverseDirection, closest, nodes[left + 1].Min, nodes[left + 1].Max);
+		bool leftFirst = leftDistance >= 0.0f && (rightDistance < 0.0f || leftDistance <= rightDistance);
+		unsigned int first = leftFirst ? left : left + 1;
+		unsigned int second = leftFirst ? left + 1 : left;
+		float firstDistance = leftFirst ? leftDistance : rightDistance;
+		float secondDistance = leftFirst ? rightDistance : leftDistance;
+
+		if (secondDistance >= 0.0f)
+			stack.push_back(second);
+		if (firstDistance >= 0.0f)
+			stack.push_back(first);
+	}
+	return found;
+}
+
+unsigned int SceneBvh::GetObjectCount() const
+{
+	return (unsigned int)objects.size();
+}
+
+SceneBvhStats SceneBvh::GetStats() const
+{
+	SceneBvhStats result = stats;
+	result.nodeCount = (unsigned int)nodes.size() - unusedNodeCount;
+	result.subtreeCount = (unsigned int)subtrees.size();
+
+	float buildCost = topBuildCost;
+	float cost = topCost;
+	for (const Subtree& subtree : subtrees)
+	{
+		buildCost += subtree.BuildCost;
+		cost += subtree.Cost;
+	}
+	result.costRatio = buildCost > 0.0f ? cost / buildCost : 1.0f;
+	return result;
+}
+
+unsigned int SceneBvh::SplitObjects(ObjectBox* first, unsigned int count, DirectX::XMFLOAT3& boundsMin, DirectX::XMFLOAT3& boundsMax)
+{
+	const int binCount = 16;
+
+	// Only x, y and z: the Index after Min would be a denormal float in w,
+	// and doing math on those is very slow
+	auto loadMin = [](const ObjectBox& object) { return XMLoadFloat3(&object.Min); };
+	auto loadMax = [](const ObjectBox& object) { return XMLoadFloat3(&object.Max); };
+	auto halfArea = [](FXMVECTOR boxMin, FXMVECTOR boxMax)
+		{
+			XMFLOAT3 size;
+			XMStoreFloat3(&size, XMVectorMax(XMVectorSubtract(boxMax, boxMin), XMVectorZero()));
+			return size.x * size.y + size.y * size.z + size.z * size.x;
+		};
+
+	XMVECTOR empty = XMVectorReplicate(FLT_MAX);
+	XMVECTOR nodeMin = empty, nodeMax = XMVectorNegate(empty);
+	XMVECTOR centerMin = empty, centerMax = XMVectorNegate(empty);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMVECTOR objectMin = loadMin(first[i]);
+		XMVECTOR objectMax = loadMax(first[i]);
+		XMVECTOR center = XMVectorScale(XMVectorAdd(objectMin, objectMax), 0.5f);
+		nodeMin = XMVectorMin(nodeMin, objectMin);
+		nodeMax = XMVectorMax(nodeMax, objectMax);
+		centerMin = XMVectorMin(centerMin, center);
+		centerMax = XMVectorMax(centerMax, center);
+	}
+	XMStoreFloat3(&boundsMin, nodeMin);
+	XMStoreFloat3(&boundsMax, nodeMax);
+
+	if (count <= MaxLeafSize)
+		return 0;
+
+	// Each center's bin along every axis at once (axes with no extent all land in bin 0)
+	XMFLOAT3 extents;
+	XMStoreFloat3(&extents, XMVectorSubtract(centerMax, centerMin));
+	XMVECTOR scale = XMVectorSet(
+		extents.x > 0.0f ? binCount / extents.x : 0.0f,
+		extents.y > 0.0f ? binCount / extents.y : 0.0f,
+		extents.z > 0.0f ? binCount / extents.z : 0.0f,
+		0.0f);
+	auto binsOf = [&](FXMVECTOR objectMin, FXMVECTOR objectMax)
+		{
+			XMFLOAT3 bins;
+			XMStoreFloat3(&bins, XMVectorMultiply(XMVectorSubtract(XMVectorScale(XMVectorAdd(objectMin, objectMax), 0.5f), centerMin), scale));
+			return XMINT3(std::min((int)bins.x, binCount - 1), std::min((int)bins.y, binCount - 1), std::min((int)bins.z, binCount - 1));
+		};
+
+	XMVECTOR binMins[3][binCount], binMaxes[3][binCount];
+	unsigned int binCounts[3][binCount] = {};
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (int b = 0; b < binCount; b++)
+		{
+			binMins[axis][b] = empty;
+			binMaxes[axis][b] = XMVectorNegate(empty);
+		}
+	}
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMVECTOR objectMin = loadMin(first[i]);
+		XMVECTOR objectMax = loadMax(first[i]);
+		XMINT3 bins = binsOf(objectMin, objectMax);
+		int binIndices[3] = { bins.x, bins.y, bins.z };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			int b = binIndices[axis];
+			binCounts[axis][b]++;
+			binMins[axis][b] = XMVectorMin(binMins[axis][b], objectMin);
+			binMaxes[axis][b] = XMVectorMax(binMaxes[axis][b], objectMax);
+		}
+	}
+
+	float extentsByAxis[3] = { extents.x, extents.y, extents.z };
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	int bestSplit = 0;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (extentsByAxis[axis] <= 0.0f)
+			continue;
+
+		// Sweep from the right to get the cost of everything past each plane,
+		// then from the left to finish each plane's cost
+		float rightCosts[binCount];
+		XMVECTOR sweepMin = empty, sweepMax = XMVectorNegate(empty);
+		unsigned int sweepCount = 0;
+		for (int b = binCount - 1; b > 0; b--)
+		{
+			sweepMin = XMVectorMin(sweepMin, binMins[axis][b]);
+			sweepMax = XMVectorMax(sweepMax, binMaxes[axis][b]);
+			sweepCount += binCounts[axis][b];
+			rightCosts[b] = sweepCount > 0 ? halfArea(sweepMin, sweepMax) * sweepCount : 0.0f;
+		}
+
+		sweepMin = empty;
+		sweepMax = XMVectorNegate(empty);
+		sweepCount = 0;
+		for (int split = 1; split < binCount; split++)
+		{
+			sweepMin = XMVectorMin(sweepMin, binMins[axis][split - 1]);
+			sweepMax = XMVectorMax(sweepMax, binMaxes[axis][split - 1]);
+			sweepCount += binCounts[axis][split - 1];
+			if (sweepCount == 0 || sweepCount == count)
+				continue;
+
+			float cost = halfArea(sweepMin, sweepMax) * sweepCount + rightCosts[split];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	if (bestAxis < 0)
+		return count / 2;
+
+	ObjectBox* middle = std::partition(first, first + count, [&](const ObjectBox& object)
+		{
+			XMINT3 bins = binsOf(loadMin(object), loadMax(object));
+			int binIndices[3] = { bins.x, bins.y, bins.z };
+			return binIndices[bestAxis] < bestSplit;
+		});
+	return (unsigned int)(middle - first);
+}
+
+// --------------------------------------------------------
+// Builds one subtree's nodes into their own list, with its
+// root first (and indices within that list)
+// --------------------------------------------------------
+void SceneBvh::BuildSubtree(const Subtree& subtree, std::vector<Node>& subtreeNodes)
+{
+	struct Range { unsigned int Node; unsigned int First; unsigned int Count; };
+	std::vector<Range> stack = { { 0, subtree.FirstObject, subtree.ObjectCount } };
+	subtreeNodes.assign(1, {});
+
+	while (!stack.empty())
+	{
+		Range range = stack.back();
+		stack.pop_back();
+
+		Node& node = subtreeNodes[range.Node];
+		unsigned int leftCount = SplitObjects(&objects[range.First], range.Count, node.Min, node.Max);
+		if (leftCount == 0)
+		{
+			node.LeftOrFirst = range.First;
+			node.Count = range.Count;
+			continue;
+		}
+
+		unsigned int left = (unsigned int)subtreeNodes.size();
+		node.LeftOrFirst = left;
+		node.Count = 0;
+		subtreeNodes.push_back({});
+		subtreeNodes.push_back({});
+		stack.push_back({ left, range.First, leftCount });
+		stack.push_back({ left + 1, range.First + leftCount, range.Count - leftCount });
+	}
+}
+
+// --------------------------------------------------------
+// Copies a built subtree's nodes to the end of the tree,
+// with its root going in the top node reserved for it
+// - Any nodes it had before are left unused
+// --------------------------------------------------------
+void SceneBvh::AttachSubtree(unsigned int subtreeIndex, std::vector<Node>& subtreeNodes)
+{
+	Subtree& subtree = subtrees[subtreeIndex];
+	unsigned int offset = (unsigned int)nodes.size();
+	unusedNodeCount += subtree.NodeCount;
+	subtree.FirstNode = offset;
+	subtree.NodeCount = (unsigned int)subtreeNodes.size() - 1;
+
+	nodes.resize(offset + subtree.NodeCount);
+	parents.resize(nodes.size());
+	owners.resize(nodes.size(), subtreeIndex);
+
+	// Everything but the root moves down by one, to make room for it
+	auto place = [&](unsigned int local) { return local == 0 ? subtree.Root : offset + local - 1; };
+	float cost = 0.0f;
+	for (unsigned int local = 0; local < subtreeNodes.size(); local++)
+	{
+		unsigned int index = place(local);
+		Node node = subtreeNodes[local];
+		if (node.Count == 0)
+		{
+			node.LeftOrFirst = place(node.LeftOrFirst);
+			parents[node.LeftOrFirst] = index;
+			parents[node.LeftOrFirst + 1] = index;
+		}
+		else
+		{
+			for (unsigned int i = node.LeftOrFirst; i < node.LeftOrFirst + node.Count; i++)
+			{
+				objectSlots[objects[i].Index] = i;
+				leaves[objects[i].Index] = index;
+			}
+		}
+		nodes[index] = node;
+
+		if (local > 0)
+		{
+			owners[index] = subtreeIndex;
+			cost += NodeCost(index);
+		}
+	}
+	subtree.Cost = cost;
+}
+
+// --------------------------------------------------------
+// Builds (or rebuilds) subtrees, each on whichever thread
+// gets to it first, then attaches them in order
+// --------------------------------------------------------
+void SceneBvh::BuildSubtrees(const std::vector<unsigned int>& subtreeIndices)
+{
+	std::vector<std::vector<Node>> built(subtreeIndices.size());
+	std::atomic<size_t> next = 0;
+	auto work = [&]()
+		{
+			for (size_t i = next++; i < subtreeIndices.size(); i = next++)
+				BuildSubtree(subtrees[subtreeIndices[i]], built[i]);
+		};
+
+	RunOnWorkers(subtreeIndices.size(), work);
+
+	for (size_t i = 0; i < subtreeIndices.size(); i++)
+		AttachSubtree(subtreeIndices[i], built[i]);
+}
+
+// Fits a node's box to its objects, or its children
+void SceneBvh::RefitNode(unsigned int index)
+{
+	Node& node = nodes[index];
+	node.Min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	node.Max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	if (node.Count > 0)
+	{
+		for (unsigned int i = node.LeftOrFirst; i < node.LeftOrFirst + node.Count; i++)
+			Grow(node.Min, node.Max, objects[i].Min, objects[i].Max);
+	}
+	else
+	{
+		Grow(node.Min, node.Max, nodes[node.LeftOrFirst].Min, nodes[node.LeftOrFirst].Max);
+		Grow(node.Min, node.Max, nodes[node.LeftOrFirst + 1].Min, nodes[node.LeftOrFirst + 1].Max);
+	}
+}
+
+void SceneBvh::RefitUpwards(unsigned int index)
+{
+	while (true)
+	{
+		XMFLOAT3 oldMin = nodes[index].Min;
+		XMFLOAT3 oldMax = nodes[index].Max;
+		float oldCost = NodeCost(index);
+		RefitNode(index);
+		if (SameBox(oldMin, oldMax, nodes[index].Min, nodes[index].Max))
+			return;
+
+		float change = NodeCost(index) - oldCost;
+		if (owners[index] == UINT_MAX)
+			topCost += change;
+		else
+			subtrees[owners[index]].Cost += change;
+
+		if (index == 0)
+			return;
+		index = parents[index];
+	}
+}
+
+// Runs work() on the worker pool, which it shares with the rest of
+// the frame, rather than making threads for every Refit()
+void SceneBvh::RunOnWorkers(size_t jobs, const std::function<void()>& work)
+{
+	unsigned int threadCount = workers ? workers->GetThreadCount() : 1;
+	unsigned int jobCount = (unsigned int)std::clamp<size_t>(jobs, 1, threadCount);
+	if (jobCount > 1)
+		workers->Run(jobCount, [&](unsigned int) { work(); });
+	else
+		work();
+}
+
+// --------------------------------------------------------
+// Surface area cost of one node: visiting an internal node
+// costs its area, and a leaf its area for each object
+// --------------------------------------------------------
+float SceneBvh::NodeCost(unsigned int index) const
+{
+	const Node& node = nodes[index];
+	return HalfArea(node.Min, node.Max) * (node.Count > 0 ? node.Count : 1);
+}
+
+void SceneBvh::RecomputeCosts()
+{
+	topCost = 0.0f;
+	for (unsigned int node = 0; node < topNodeCount; node++)
+		topCost += NodeCost(node);
+
+	for (Subtree& subtree : subtrees)
+	{
+		subtree.Cost = 0.0f;
+		for (unsigned int node = subtree.FirstNode; node < subtree.FirstNode + subtree.NodeCount; node++)
+			subtree.Cost += NodeCost(node);
+	}
+}
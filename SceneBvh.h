@@ -0,0 +1,171 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "Frustum.h"
+#include "FrustumCulling.h"
+#include "WorkerPool.h"
+
+// --------------------------------------------------------
+// The closest object a ray hit, from SceneBvh::Raycast()
+// --------------------------------------------------------
+struct BvhRayHit
+{
+	unsigned int Index;		// Of the object in the WorldBounds the BVH was built from
+	float Distance;			// Along the ray, in units of its (normalized) direction
+};
+
+// --------------------------------------------------------
+// What the last Build() or Refit() did, and how good the
+// tree is now
+// --------------------------------------------------------
+struct SceneBvhStats
+{
+	unsigned int nodeCount;			// Nodes in use, not counting any left over from partial rebuilds
+	unsigned int subtreeCount;
+	unsigned int rebuiltSubtrees;	// By the last Refit(), for having grown too costly
+	bool fullRebuild;				// Did the last Refit() rebuild everything?
+	float costRatio;				// Surface area cost now, relative to just after building
+	double buildMilliseconds;
+	double refitMilliseconds;		// Including any rebuilds it did
+};
+
+// --------------------------------------------------------
+// A bounding volume hierarchy over the boxes in a set of
+// WorldBounds, for finding objects in a region without
+// looking at all of them
+// - Built top-down, splitting each node where the surface
+//    area heuristic says (checked at a handful of bins
+//    along each axis)
+// - Below a certain size, each part of the tree is built
+//    on its own, so those subtrees can be built (and
+//    refit) in parallel and rebuilt separately
+// - Moving objects are handled by refitting: boxes grow
+//    (or shrink) to fit, but the tree's shape doesn't
+//    change, so it gets worse over time; any subtree that
+//    gets too much worse is rebuilt
+// --------------------------------------------------------
+class SceneBvh
+{
+public:
+
+	// Most objects in a leaf
+	static constexpr unsigned int MaxLeafSize = 4;
+
+	// Most objects in a subtree built (and rebuilt) on its own
+	static constexpr unsigned int SubtreeSize = 4096;
+
+	// How much worse (by surface area cost) a subtree may get before Refit()
+	// rebuilds it
+	static constexpr float RebuildThreshold = 1.5f;
+
+	// Checks a ray against the object itself, once the ray is known to enter
+	// its box (at boxDistance) before the closest hit so far
+	// - Returns true if it hit the object closer than closest, after
+	//    lowering closest to that hit
+	using RayObjectTest = std::function<bool(unsigned int index, float boxDistance, float& closest)>;
+
+	// Subtrees are built and refit on workers' threads, or just the calling
+	// thread without one
+	SceneBvh(std::shared_ptr<WorkerPool> workers = nullptr);
+	~SceneBvh();
+
+	// Builds the whole tree over every object in bounds
+	void Build(const WorldBounds& bounds);
+
+	// Refits the tree around the objects' new bounds, then rebuilds any
+	// subtree whose cost grew past RebuildThreshold
+	// - moved lists the objects whose bounds changed since the last call;
+	//    when it's a large part of the scene, every node is refit instead
+	void Refit(const WorldBounds& bounds, const std::vector<unsigned int>& moved);
+
+	// Each query fills results with the index of every object whose box
+	// passes, in no particular order, and returns how many there are
+	unsigned int QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& results) const;
+	unsigned int QuerySphere(DirectX::XMFLOAT3 center, float radius, std::vector<unsigned int>& results) const;
+	unsigned int QueryBox(DirectX::XMFLOAT3 boxMin, DirectX::XMFLOAT3 boxMax, std::vector<unsigned int>& results) const;
+
+	// Finds the nearest object box the ray enters within maxDistance
+	// - A ray starting inside a box hits it at distance 0
+	bool Raycast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, BvhRayHit& hit) const;
+
+	// Runs test on each object whose box the ray enters, nearest boxes first,
+	// skipping any past the closest hit so far
+	// - Distances are in units of direction's length, which isn't normalized,
+	//    so a ray transformed into another space keeps the same distances
+	bool Raycast(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, const RayObjectTest& test) const;
+
+	unsigned int GetObjectCount() const;
+	SceneBvhStats GetStats() const;
+
+private:
+
+	// Children of an internal node are next to each other, at LeftOrFirst
+	// and LeftOrFirst + 1; a leaf (Count > 0) holds Count objects, starting
+	// at LeftOrFirst in objects
+	struct Node
+	{
+		DirectX::XMFLOAT3 Min;
+		unsigned int LeftOrFirst;
+		DirectX::XMFLOAT3 Max;
+		unsigned int Count;
+	};
+
+	// An object's box, kept in leaf order so leaves read them together
+	struct ObjectBox
+	{
+		DirectX::XMFLOAT3 Min;
+		unsigned int Index;
+		DirectX::XMFLOAT3 Max;
+		unsigned int Padding;
+	};
+
+	// A part of the tree built on its own
+	// - Its root is one of the top nodes, built first; the rest of its
+	//    nodes are together at FirstNode
+	struct Subtree
+	{
+		unsigned int Root;
+		unsigned int FirstNode;
+		unsigned int NodeCount;
+		unsigned int FirstObject;
+		unsigned int ObjectCount;
+		float BuildCost;
+		float Cost;
+	};
+
+	std::shared_ptr<WorkerPool> workers;
+
+	// Nodes below topNodeCount are built (and refit) before the subtrees
+	std::vector<Node> nodes;
+	unsigned int topNodeCount;
+	unsigned int unusedNodeCount;
+	std::vector<Subtree> subtrees;
+
+	std::vector<ObjectBox> objects;
+	std::vector<unsigned int> objectSlots;	// Where each object is in objects
+	std::vector<unsigned int> parents;		// Of each node; the root's is itself
+	std::vector<unsigned int> owners;		// Subtree each node is in, or UINT_MAX for top nodes
+	std::vector<unsigned int> leaves;		// Leaf each object is in
+
+	float topBuildCost;
+	float topCost;
+
+	SceneBvhStats stats;
+
+	static unsigned int SplitObjects(ObjectBox* first, unsigned int count, DirectX::XMFLOAT3& boundsMin, DirectX::XMFLOAT3& boundsMax);
+	void BuildSubtree(const Subtree& subtree, std::vector<Node>& subtreeNodes);
+	void AttachSubtree(unsigned int subtreeIndex, std::vector<Node>& subtreeNodes);
+	void BuildSubtrees(const std::vector<unsigned int>& subtreeIndices);
+
+	void RefitNode(unsigned int index);
+	void RefitUpwards(unsigned int index);
+
+	// Calls work() on as many threads as there are jobs, up to one per subtree
+	void RunOnWorkers(size_t jobs, const std::function<void()>& work);
+	float NodeCost(unsigned int index) const;
+	void RecomputeCosts();
+};
@@ -22,6 +22,26 @@ struct Light
     float2 Padding;
 };
 
+// Constant buffers shared by every entity shader
+// - Should match the ExternalData structs in BufferStructs.h
+// - Each only changes as often as its name says, so it's only
+//    sent (and bound) that often, instead of with every draw
+// - Per-object data has its own buffer (b2) in each vertex shader
+cbuffer PerFrame : register(b0)
+{
+    matrix viewProjection;
+    float3 cameraPos;
+    float totalTime;
+    Light lights[5]; // Array of exactly 5 lights
+}
+
+cbuffer PerMaterial : register(b1)
+{
+    float4 colorTint;
+    float2 textureScale;
+    float2 textureOffset;
+}
+
 // Struct representing a single vertex worth of data
 // - This should match the vertex definition in our C++ code
 // - By "match", I mean the size, order and number of members
@@ -40,6 +60,39 @@ struct VertexShaderInput
     float3 Tangent : TANGENT;
 };
 
+// Compact version of the vertex above
+// - Should match PackedVertex (or PackedVertexFloatPosition) in PackedVertex.h
+// - Positions are scaled and offset back into local space by the vertex shader
+// - localPosition.w is unused (padding for the quantized format)
+struct PackedVertexShaderInput
+{
+    float4 localPosition : POSITION; // Quantized (or float) XYZ position
+    float2 UV : TEXCOORD; // Half float UV coordinates
+    float4 NormalTangent : NORMAL; // Octahedral normal (xy) and tangent (zw)
+};
+
+// Per-instance data for the instanced vertex shaders, from a second vertex buffer
+// - Should match InstanceData in BufferStructs.h
+// - Each matrix comes in as its four rows
+struct InstanceData
+{
+    float4 World0 : WORLD0;
+    float4 World1 : WORLD1;
+    float4 World2 : WORLD2;
+    float4 World3 : WORLD3;
+    float4 WorldInvTranspose0 : WORLDINVTRANSPOSE0;
+    float4 WorldInvTranspose1 : WORLDINVTRANSPOSE1;
+    float4 WorldInvTranspose2 : WORLDINVTRANSPOSE2;
+    float4 WorldInvTranspose3 : WORLDINVTRANSPOSE3;
+};
+
+// Rebuilds an instance's matrix the way it would arrive in a constant buffer
+// - Rows from C++ become columns here, the same as a matrix in a cbuffer
+matrix InstanceMatrix(float4 row0, float4 row1, float4 row2, float4 row3)
+{
+    return transpose(float4x4(row0, row1, row2, row3));
+}
+
 // Struct representing the data we expect to receive from earlier pipeline stages
 // - Should match the output of our corresponding vertex shader
 // - The name of the struct itself is unimportant
@@ -77,6 +130,17 @@ float Attenuate(Light light, float3 worldPos)
     return att * att;
 }
 
+// Turns an octahedral-encoded direction back into a unit vector
+// - Matches OctahedralDecode() in PackedVertex.cpp
+float3 OctahedralDecode(float2 e)
+{
+    float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
 // Raises a color float to a given power. Returns the result with w set to 1.
 float4 GammaCorrect(float4 color, float gamma)
 {
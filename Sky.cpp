@@ -27,13 +27,13 @@ Sky::Sky(std::shared_ptr<Mesh> mesh,
 	rasterizerDesc.FillMode = D3D11_FILL_SOLID;
 	rasterizerDesc.CullMode = D3D11_CULL_FRONT;
 
-	Graphics::Device->CreateRasterizerState(&rasterizerDesc, _rasterizerState.GetAddressOf());
+	_rasterizerState = Graphics::State->GetRasterizerState(rasterizerDesc);
 
 	D3D11_DEPTH_STENCIL_DESC depthStencilDesc = {};
 	depthStencilDesc.DepthEnable = true;
 	depthStencilDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
 
-	Graphics::Device->CreateDepthStencilState(&depthStencilDesc, _depthStencilState.GetAddressOf());
+	_depthStencilState = Graphics::State->GetDepthStencilState(depthStencilDesc);
 }
 
 Sky::~Sky()
@@ -123,17 +123,23 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
 	return cubeSRV;
 }
 
+// --------------------------------------------------------
+// Draws the sky with its own render states
+// - Leaves them set afterwards; whatever draws next asks for
+//    the states it needs, and Graphics::State only sends the
+//    ones that differ
+// --------------------------------------------------------
 void Sky::Draw(std::shared_ptr<Camera> camera)
 {
 	// Prepare render states
-	Graphics::Context->RSSetState(_rasterizerState.Get());
-	Graphics::Context->OMSetDepthStencilState(_depthStencilState.Get(), 0);
+	Graphics::State->SetRasterizerState(_rasterizerState.Get());
+	Graphics::State->SetDepthStencilState(_depthStencilState.Get(), 0);
 
 	// Bind shaders, SRV, and sampler state
-	Graphics::Context->VSSetShader(_vertexShader.Get(), 0, 0);
-	Graphics::Context->PSSetShader(_pixelShader.Get(), 0, 0);
-	Graphics::Context->PSSetSamplers(0, 1, _samplerState.GetAddressOf());
-	Graphics::Context->PSSetShaderResources(0, 1, _SRV.GetAddressOf());
+	Graphics::State->SetVertexShader(_vertexShader.Get());
+	Graphics::State->SetPixelShader(_pixelShader.Get());
+	Graphics::State->SetSampler(D3D11_PIXEL_SHADER, 0, _samplerState.Get());
+	Graphics::State->SetShaderResource(D3D11_PIXEL_SHADER, 0, _SRV.Get());
 
 	// Fill constant buffer with necessary data
 	SkyboxVertexShaderExternalData bufferData = {};
@@ -144,8 +150,4 @@ void Sky::Draw(std::shared_ptr<Camera> camera)
 
 	// Draw the mesh
 	_mesh->Draw();
-
-	// Reset any states that were changed
-	Graphics::Context->RSSetState(0);
-	Graphics::Context->OMSetDepthStencilState(0, 0);
 }
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+
+// --------------------------------------------------------
+// Hands out one state object per distinct description, so
+// identical descriptions share an object instead of each
+// making their own
+// - Descriptions are hashed and compared byte for byte, so
+//    zero them first (= {}) to keep any padding the same
+// - Nothing here touches D3D (create() makes the object),
+//    so it can be checked on its own
+// --------------------------------------------------------
+template<typename Desc, typename Object>
+class StateObjectCache
+{
+	static_assert(std::is_trivially_copyable_v<Desc>, "Descriptions are compared as bytes");
+
+public:
+	// Returns the object made for an identical description, or calls
+	// create(desc) to make (and keep) a new one
+	template<typename Create>
+	Object Get(const Desc& desc, Create create)
+	{
+		auto found = objects.find(desc);
+		if (found != objects.end())
+		{
+			hits++;
+			return found->second;
+		}
+
+		Object object = create(desc);
+		objects.emplace(desc, object);
+		return object;
+	}
+
+	void Clear()
+	{
+		objects.clear();
+		hits = 0;
+	}
+
+	unsigned int GetCount() const { return (unsigned int)objects.size(); }
+	unsigned int GetHits() const { return hits; }	// Times an existing object was handed out
+
+private:
+	// FNV-1a over the description's bytes
+	struct Hash
+	{
+		size_t operator()(const Desc& desc) const
+		{
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&desc);
+			unsigned long long hash = 14695981039346656037ull;
+			for (size_t i = 0; i < sizeof(Desc); i++)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ull;
+			}
+			return (size_t)hash;
+		}
+	};
+
+	struct Equal
+	{
+		bool operator()(const Desc& a, const Desc& b) const
+		{
+			return memcmp(&a, &b, sizeof(Desc)) == 0;
+		}
+	};
+
+	std::unordered_map<Desc, Object, Hash, Equal> objects;
+	unsigned int hits = 0;
+};
@@ -0,0 +1,234 @@
+#include "StateTracker.h"
+
+StateTracker::StateTracker(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext1> context) :
+	device(device),
+	context(context),
+	inputLayout(nullptr),
+	vertexShader(nullptr),
+	pixelShader(nullptr),
+	rasterizerState(nullptr),
+	depthStencilState(nullptr),
+	stencilRef(0),
+	counts{}
+{
+	Invalidate();
+}
+
+StateTracker::~StateTracker()
+{
+}
+
+void StateTracker::SetInputLayout(ID3D11InputLayout* newInputLayout)
+{
+	counts.Shaders.Requested++;
+	if (inputLayoutKnown && inputLayout == newInputLayout)
+		return;
+
+	context->IASetInputLayout(newInputLayout);
+	inputLayout = newInputLayout;
+	inputLayoutKnown = true;
+	counts.Shaders.Issued++;
+}
+
+void StateTracker::SetVertexShader(ID3D11VertexShader* newVertexShader)
+{
+	counts.Shaders.Requested++;
+	if (vertexShaderKnown && vertexShader == newVertexShader)
+		return;
+
+	context->VSSetShader(newVertexShader, 0, 0);
+	vertexShader = newVertexShader;
+	vertexShaderKnown = true;
+	counts.Shaders.Issued++;
+}
+
+void StateTracker::SetPixelShader(ID3D11PixelShader* newPixelShader)
+{
+	counts.Shaders.Requested++;
+	if (pixelShaderKnown && pixelShader == newPixelShader)
+		return;
+
+	context->PSSetShader(newPixelShader, 0, 0);
+	pixelShader = newPixelShader;
+	pixelShaderKnown = true;
+	counts.Shaders.Issued++;
+}
+
+void StateTracker::SetRasterizerState(ID3D11RasterizerState* newRasterizerState)
+{
+	counts.States.Requested++;
+	if (rasterizerStateKnown && rasterizerState == newRasterizerState)
+		return;
+
+	context->RSSetState(newRasterizerState);
+	rasterizerState = newRasterizerState;
+	rasterizerStateKnown = true;
+	counts.States.Issued++;
+}
+
+void StateTracker::SetDepthStencilState(ID3D11DepthStencilState* newDepthStencilState, unsigned int newStencilRef)
+{
+	counts.States.Requested++;
+	if (depthStencilStateKnown && depthStencilState == newDepthStencilState && stencilRef == newStencilRef)
+		return;
+
+	context->OMSetDepthStencilState(newDepthStencilState, newStencilRef);
+	depthStencilState = newDepthStencilState;
+	stencilRef = newStencilRef;
+	depthStencilStateKnown = true;
+	counts.States.Issued++;
+}
+
+void StateTracker::SetShaderResource(D3D11_SHADER_TYPE shaderType, unsigned int slot, ID3D11ShaderResourceView* srv)
+{
+	StageBindings* stage = GetStage(shaderType);
+	if (!stage)
+		return;
+
+	counts.ShaderResources.Requested++;
+	stage->ShaderResources.Set(slot, srv);
+}
+
+void StateTracker::SetSampler(D3D11_SHADER_TYPE shaderType, unsigned int slot, ID3D11SamplerState* sampler)
+{
+	StageBindings* stage = GetStage(shaderType);
+	if (!stage)
+		return;
+
+	counts.Samplers.Requested++;
+	stage->Samplers.Set(slot, sampler);
+}
+
+void StateTracker::SetConstantBuffer(D3D11_SHADER_TYPE shaderType, unsigned int slot, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int constantCount)
+{
+	StageBindings* stage = GetStage(shaderType);
+	if (!stage)
+		return;
+
+	counts.ConstantBuffers.Requested++;
+	stage->ConstantBuffers.Set(slot, { buffer, firstConstant, constantCount });
+}
+
+void StateTracker::Flush()
+{
+	FlushStage(vertexStage, D3D11_VERTEX_SHADER);
+	FlushStage(pixelStage, D3D11_PIXEL_SHADER);
+}
+
+void StateTracker::Invalidate()
+{
+	for (StageBindings* stage : { &vertexStage, &pixelStage })
+	{
+		stage->ShaderResources.Invalidate();
+		stage->Samplers.Invalidate();
+		stage->ConstantBuffers.Invalidate();
+	}
+
+	inputLayoutKnown = false;
+	vertexShaderKnown = false;
+	pixelShaderKnown = false;
+	rasterizerStateKnown = false;
+	depthStencilStateKnown = false;
+}
+
+Microsoft::WRL::ComPtr<ID3D11RasterizerState> StateTracker::GetRasterizerState(const D3D11_RASTERIZER_DESC& desc)
+{
+	return rasterizerStates.Get(desc, [&](const D3D11_RASTERIZER_DESC& d)
+		{
+			Microsoft::WRL::ComPtr<ID3D11RasterizerState> state;
+			device->CreateRasterizerState(&d, state.GetAddressOf());
+			return state;
+		});
+}
+
+Microsoft::WRL::ComPtr<ID3D11DepthStencilState> StateTracker::GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc)
+{
+	return depthStencilStates.Get(desc, [&](const D3D11_DEPTH_STENCIL_DESC& d)
+		{
+			Microsoft::WRL::ComPtr<ID3D11DepthStencilState> state;
+			device->CreateDepthStencilState(&d, state.GetAddressOf());
+			return state;
+		});
+}
+
+Microsoft::WRL::ComPtr<ID3D11SamplerState> StateTracker::GetSamplerState(const D3D11_SAMPLER_DESC& desc)
+{
+	return samplerStates.Get(desc, [&](const D3D11_SAMPLER_DESC& d)
+		{
+			Microsoft::WRL::ComPtr<ID3D11SamplerState> state;
+			device->CreateSamplerState(&d, state.GetAddressOf());
+			return state;
+		});
+}
+
+unsigned int StateTracker::GetCachedStateCount() const
+{
+	return rasterizerStates.GetCount() + depthStencilStates.GetCount() + samplerStates.GetCount();
+}
+
+const StateTrackerCounts& StateTracker::GetCounts() const
+{
+	return counts;
+}
+
+void StateTracker::ResetCounts()
+{
+	counts = {};
+}
+
+StateTracker::StageBindings* StateTracker::GetStage(D3D11_SHADER_TYPE shaderType)
+{
+	switch (shaderType)
+	{
+	case D3D11_VERTEX_SHADER: return &vertexStage;
+	case D3D11_PIXEL_SHADER: return &pixelStage;
+	default: return nullptr;
+	}
+}
+
+// --------------------------------------------------------
+// Sends one stage's changed slots, one call per run of
+// neighbouring slots
+// --------------------------------------------------------
+void StateTracker::FlushStage(StageBindings& stage, D3D11_SHADER_TYPE shaderType)
+{
+	bool vertex = shaderType == D3D11_VERTEX_SHADER;
+
+	counts.ShaderResources.Issued += stage.ShaderResources.Flush(
+		[&](unsigned int first, unsigned int count, ID3D11ShaderResourceView* const* srvs)
+		{
+			if (vertex)
+				context->VSSetShaderResources(first, count, srvs);
+			else
+				context->PSSetShaderResources(first, count, srvs);
+		});
+
+	counts.Samplers.Issued += stage.Samplers.Flush(
+		[&](unsigned int first, unsigned int count, ID3D11SamplerState* const* samplers)
+		{
+			if (vertex)
+				context->VSSetSamplers(first, count, samplers);
+			else
+				context->PSSetSamplers(first, count, samplers);
+		});
+
+	// D3D wants the buffers, offsets and sizes in separate arrays
+	counts.ConstantBuffers.Issued += stage.ConstantBuffers.Flush(
+		[&](unsigned int first, unsigned int count, const ConstantBufferBinding* bindings)
+		{
+			ID3D11Buffer* buffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+			UINT firstConstants[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+			UINT constantCounts[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+			for (unsigned int i = 0; i < count; i++)
+			{
+				buffers[i] = bindings[i].Buffer;
+				firstConstants[i] = bindings[i].FirstConstant;
+				constantCounts[i] = bindings[i].ConstantCount;
+			}
+
+			if (vertex)
+				context->VSSetConstantBuffers1(first, count, buffers, firstConstants, constantCounts);
+			else
+				context->PSSetConstantBuffers1(first, count, buffers, firstConstants, constantCounts);
+		});
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <d3d11.h>
+#include <d3d11_1.h>
+#include <wrl/client.h>
+
+#include "BindingSlots.h"
+#include "StateObjectCache.h"
+
+// --------------------------------------------------------
+// How many binds of one kind were asked for, and how many
+// D3D calls it actually took
+// --------------------------------------------------------
+struct StateBindCounts
+{
+	unsigned int Requested;
+	unsigned int Issued;
+};
+
+struct StateTrackerCounts
+{
+	StateBindCounts Shaders;			// Including input layouts
+	StateBindCounts ShaderResources;
+	StateBindCounts Samplers;
+	StateBindCounts ConstantBuffers;
+	StateBindCounts States;				// Rasterizer and depth-stencil
+};
+
+// --------------------------------------------------------
+// Sits in front of the device context, only passing along
+// binds that change what's bound
+// - Shaders, input layouts and render states are compared
+//    and set straight away
+// - SRVs, samplers and constant buffers wait until Flush()
+//    (which Mesh calls before drawing), so neighbouring
+//    slots go in one call
+// - Only shadows the vertex and pixel stages; binds to any
+//    other stage are ignored
+// - Holds raw pointers, which is safe for anything bound:
+//    the context keeps those alive, so their addresses can't
+//    be reused by something new
+// - Anything that sets state without going through here
+//    (like ImGui) must be followed by Invalidate()
+// --------------------------------------------------------
+class StateTracker
+{
+public:
+	StateTracker(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext1> context);
+	~StateTracker();
+
+	void SetInputLayout(ID3D11InputLayout* inputLayout);
+	void SetVertexShader(ID3D11VertexShader* vertexShader);
+	void SetPixelShader(ID3D11PixelShader* pixelShader);
+	void SetRasterizerState(ID3D11RasterizerState* rasterizerState);	// Null for the default
+	void SetDepthStencilState(ID3D11DepthStencilState* depthStencilState, unsigned int stencilRef);
+
+	void SetShaderResource(D3D11_SHADER_TYPE shaderType, unsigned int slot, ID3D11ShaderResourceView* srv);
+	void SetSampler(D3D11_SHADER_TYPE shaderType, unsigned int slot, ID3D11SamplerState* sampler);
+
+	// firstConstant and constantCount are in 16-byte shader constants
+	void SetConstantBuffer(D3D11_SHADER_TYPE shaderType, unsigned int slot, ID3D11Buffer* buffer, unsigned int firstConstant, unsigned int constantCount);
+
+	// Sends every slot bind still waiting
+	void Flush();
+
+	// Forgets everything that's bound, so the next bind of each is sent
+	void Invalidate();
+
+	// One state object per distinct description (see StateObjectCache)
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> GetRasterizerState(const D3D11_RASTERIZER_DESC& desc);
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc);
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> GetSamplerState(const D3D11_SAMPLER_DESC& desc);
+	unsigned int GetCachedStateCount() const;
+
+	// Nothing here resets the counts; whoever reads them decides how often
+	const StateTrackerCounts& GetCounts() const;
+	void ResetCounts();
+
+private:
+	struct ConstantBufferBinding
+	{
+		ID3D11Buffer* Buffer;
+		unsigned int FirstConstant;
+		unsigned int ConstantCount;
+
+		bool operator==(const ConstantBufferBinding& other) const = default;
+	};
+
+	// Slots shadowed for one shader stage
+	struct StageBindings
+	{
+		BindingSlots<ID3D11ShaderResourceView*, D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT> ShaderResources;
+		BindingSlots<ID3D11SamplerState*, D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT> Samplers;
+		BindingSlots<ConstantBufferBinding, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT> ConstantBuffers;
+	};
+
+	StageBindings* GetStage(D3D11_SHADER_TYPE shaderType);
+	void FlushStage(StageBindings& stage, D3D11_SHADER_TYPE shaderType);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> context;
+
+	StageBindings vertexStage;
+	StageBindings pixelStage;
+
+	// Set straight away, so only what's bound needs keeping
+	// - Unknown until the first set after Invalidate()
+	ID3D11InputLayout* inputLayout;
+	ID3D11VertexShader* vertexShader;
+	ID3D11PixelShader* pixelShader;
+	ID3D11RasterizerState* rasterizerState;
+	ID3D11DepthStencilState* depthStencilState;
+	unsigned int stencilRef;
+	bool inputLayoutKnown;
+	bool vertexShaderKnown;
+	bool pixelShaderKnown;
+	bool rasterizerStateKnown;
+	bool depthStencilStateKnown;
+
+	StateObjectCache<D3D11_RASTERIZER_DESC, Microsoft::WRL::ComPtr<ID3D11RasterizerState>> rasterizerStates;
+	StateObjectCache<D3D11_DEPTH_STENCIL_DESC, Microsoft::WRL::ComPtr<ID3D11DepthStencilState>> depthStencilStates;
+	StateObjectCache<D3D11_SAMPLER_DESC, Microsoft::WRL::ComPtr<ID3D11SamplerState>> samplerStates;
+
+	StateTrackerCounts counts;
+};
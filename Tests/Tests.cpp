@@ -0,0 +1,1353 @@
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../BindingSlots.h"
+#include "../ConstantBufferRing.h"
+#include "../DrawList.h"
+#include "../EntityStore.h"
+#include "../Frustum.h"
+#include "../FrustumCulling.h"
+#include "../InstanceBatcher.h"
+#include "../MappedFile.h"
+#include "../MeshData.h"
+#include "../MeshOptimizer.h"
+#include "../MeshSimplifier.h"
+#include "../OcclusionCuller.h"
+#include "../PackedVertex.h"
+#include "../RenderCommandList.h"
+#include "../ResourcePool.h"
+#include "../SceneBvh.h"
+#include "../StateObjectCache.h"
+#include "../WorkerPool.h"
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Correctness checks for the parts of the engine that don't
+// need a window or a GPU
+// - Every check runs in every configuration (unlike assert),
+//    and a failed one is reported without stopping the rest
+// - Returns non-zero if anything failed, so it can be run
+//    after a build; timings belong in Benchmarks instead
+// --------------------------------------------------------
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	unsigned int checkCount = 0;
+	unsigned int failureCount = 0;
+
+	void Check(bool passed, const char* condition, const char* file, int line)
+	{
+		checkCount++;
+		if (passed)
+			return;
+
+		failureCount++;
+		printf("  FAILED %s(%d): %s\n", file, line, condition);
+	}
+
+	#define CHECK(condition) Check((condition), #condition, __FILE__, __LINE__)
+
+	// Angle between two directions, which needn't be normalized
+	// - atan2 stays precise for tiny angles, where acos doesn't
+	float AngleBetweenDegrees(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		XMVECTOR va = XMLoadFloat3(&a);
+		XMVECTOR vb = XMLoadFloat3(&b);
+		float sine = XMVectorGetX(XMVector3Length(XMVector3Cross(va, vb)));
+		float cosine = XMVectorGetX(XMVector3Dot(va, vb));
+		return XMConvertToDegrees(atan2f(sine, cosine));
+	}
+	// --------------------------------------------------------
+	// A flat, square grid of quads in the XZ plane, facing up
+	// - UVs follow the positions, so there are no seams
+	// --------------------------------------------------------
+	MeshData MakeGrid(unsigned int quadsPerSide)
+	{
+		MeshData mesh = {};
+		unsigned int verticesPerSide = quadsPerSide + 1;
+		for (unsigned int z = 0; z < verticesPerSide; z++)
+		{
+			for (unsigned int x = 0; x < verticesPerSide; x++)
+			{
+				Vertex vertex = {};
+				vertex.Position = XMFLOAT3((float)x, 0.0f, (float)z);
+				vertex.UV = XMFLOAT2((float)x / quadsPerSide, (float)z / quadsPerSide);
+				vertex.Normal = XMFLOAT3(0, 1, 0);
+				vertex.Tangent = XMFLOAT3(1, 0, 0);
+				mesh.vertices.push_back(vertex);
+			}
+		}
+
+		for (unsigned int z = 0; z < quadsPerSide; z++)
+		{
+			for (unsigned int x = 0; x < quadsPerSide; x++)
+			{
+				unsigned int corner = z * verticesPerSide + x;
+				unsigned int quad[6] = { corner, corner + verticesPerSide, corner + verticesPerSide + 1, corner, corner + verticesPerSide + 1, corner + 1 };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+
+		mesh.lods.assign(1, { 0, (unsigned int)mesh.indices.size(), 0.0f });
+		mesh.unweldedVertexCount = (unsigned int)mesh.vertices.size();
+		mesh.boundsMin = XMFLOAT3(0, 0, 0);
+		mesh.boundsMax = XMFLOAT3((float)quadsPerSide, 0, (float)quadsPerSide);
+		return mesh;
+	}
+
+	// Where a shipped mesh is, whether the tests run from the
+	// solution's folder or from Tests (Visual Studio's default)
+	std::string FindMesh(const char* fileName)
+	{
+		for (const char* directory : { "Assets/Meshes/", "../Assets/Meshes/" })
+		{
+			std::string path = std::string(directory) + fileName;
+			if (MappedFile(path.c_str()).IsOpen())
+				return path;
+		}
+		return fileName;
+	}
+	// A camera at the origin looking down +Z
+	XMFLOAT4X4 MakeViewProjection()
+	{
+		XMMATRIX view = XMMatrixLookToLH(XMVectorZero(), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0));
+		XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 2.0f, 0.1f, 100.0f);
+
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(view, projection));
+		return viewProjection;
+	}
+
+	XMFLOAT4X4 MakeIdentity()
+	{
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		return identity;
+	}
+
+	// Random boxes spread around a cube of the given size, centered on the origin
+	WorldBounds MakeRandomBoxes(unsigned int count, float spread, unsigned int seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> positions(-spread * 0.5f, spread * 0.5f);
+		std::uniform_real_distribution<float> sizes(0.1f, 2.0f);
+
+		WorldBounds bounds;
+		FrustumCulling::Resize(bounds, count);
+		XMFLOAT4X4 identity = MakeIdentity();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			XMFLOAT3 center(positions(random), positions(random), positions(random));
+			float size = sizes(random);
+			FrustumCulling::SetFromLocalBox(bounds, i,
+				XMFLOAT3(center.x - size, center.y - size, center.z - size),
+				XMFLOAT3(center.x + size, center.y + size, center.z + size), identity);
+		}
+		return bounds;
+	}
+
+	bool BoxesOverlap(const WorldBounds& bounds, size_t index, XMFLOAT3 boxMin, XMFLOAT3 boxMax)
+	{
+		return
+			bounds.CenterX[index] - bounds.ExtentX[index] <= boxMax.x && bounds.CenterX[index] + bounds.ExtentX[index] >= boxMin.x &&
+			bounds.CenterY[index] - bounds.ExtentY[index] <= boxMax.y && bounds.CenterY[index] + bounds.ExtentY[index] >= boxMin.y &&
+			bounds.CenterZ[index] - bounds.ExtentZ[index] <= boxMax.z && bounds.CenterZ[index] + bounds.ExtentZ[index] >= boxMin.z;
+	}
+
+	// Slab test of a normalized ray against one object's box
+	// - Returns the distance it enters at (0 if it starts inside), or -1 for a miss
+	float RayBoxDistance(const WorldBounds& bounds, size_t index, XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance)
+	{
+		float center[3] = { bounds.CenterX[index], bounds.CenterY[index], bounds.CenterZ[index] };
+		float extent[3] = { bounds.ExtentX[index], bounds.ExtentY[index], bounds.ExtentZ[index] };
+		float from[3] = { origin.x, origin.y, origin.z };
+		float toward[3] = { direction.x, direction.y, direction.z };
+
+		float enter = 0.0f;
+		float exit = maxDistance;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float low = (center[axis] - extent[axis] - from[axis]) / toward[axis];
+			float high = (center[axis] + extent[axis] - from[axis]) / toward[axis];
+			enter = std::max(enter, std::min(low, high));
+			exit = std::min(exit, std::max(low, high));
+		}
+		return enter <= exit ? enter : -1.0f;
+	}
+
+	std::vector<unsigned int> Sorted(std::vector<unsigned int> values)
+	{
+		std::sort(values.begin(), values.end());
+		return values;
+	}
+}
+
+// --------------------------------------------------------
+// Packed vertices decode to within the formats' bounds:
+// half a UNORM16 step of the bounds per position axis,
+// half float UVs, and a small fixed angle for normals and
+// tangents in every direction
+// --------------------------------------------------------
+void TestPackedVertex()
+{
+	// Both ways along each axis, the lower hemisphere (which the
+	// encoding folds over) and then random directions, for a count
+	// that isn't a multiple of four
+	std::vector<XMFLOAT3> directions =
+	{
+		{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+		{ 0.6f, 0.0f, -0.8f }, { 0.0f, -0.6f, -0.8f }, { -0.48f, -0.6f, -0.64f }
+	};
+	std::mt19937 random(6);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	while (directions.size() < 1003)
+	{
+		XMVECTOR direction = XMVectorSet(unit(random), unit(random), unit(random), 0);
+		if (XMVectorGetX(XMVector3LengthSq(direction)) < 0.01f)
+			continue;
+		directions.emplace_back();
+		XMStoreFloat3(&directions.back(), XMVector3Normalize(direction));
+	}
+
+	// Positions spread over a box, except Y, which is the same everywhere
+	// so that axis has no extent at all
+	std::uniform_real_distribution<float> positions(-50.0f, 50.0f);
+	std::vector<Vertex> vertices(directions.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		vertices[i].Position = XMFLOAT3(positions(random), 3.0f, positions(random) * 0.01f);
+		vertices[i].UV = XMFLOAT2(unit(random) * 4.0f, unit(random));
+		vertices[i].Normal = directions[i];
+		vertices[i].Tangent = directions[directions.size() - 1 - i];
+	}
+
+	XMFLOAT3 boundsMin = vertices[0].Position;
+	XMFLOAT3 boundsMax = vertices[0].Position;
+	for (const Vertex& vertex : vertices)
+	{
+		XMStoreFloat3(&boundsMin, XMVectorMin(XMLoadFloat3(&boundsMin), XMLoadFloat3(&vertex.Position)));
+		XMStoreFloat3(&boundsMax, XMVectorMax(XMLoadFloat3(&boundsMax), XMLoadFloat3(&vertex.Position)));
+	}
+
+	// Normals and tangents only have to come back pointing the same way
+	const float MaxAngleDegrees = 0.01f;
+	auto directionsMatch = [&](const std::vector<Vertex>& decoded)
+		{
+			bool match = true;
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				match &= AngleBetweenDegrees(vertices[i].Normal, decoded[i].Normal) <= MaxAngleDegrees;
+				match &= AngleBetweenDegrees(vertices[i].Tangent, decoded[i].Tangent) <= MaxAngleDegrees;
+			}
+			return match;
+		};
+	auto uvsMatch = [&](const std::vector<Vertex>& decoded)
+		{
+			bool match = true;
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				match &= fabsf(decoded[i].UV.x - vertices[i].UV.x) <= fabsf(vertices[i].UV.x) / 2048.0f + 1e-7f;
+				match &= fabsf(decoded[i].UV.y - vertices[i].UV.y) <= fabsf(vertices[i].UV.y) / 2048.0f + 1e-7f;
+			}
+			return match;
+		};
+
+	// Quantized positions
+	PackedVertexDequantize dequantize = VertexPacking::GetDequantize(VertexFormat::Packed, boundsMin, boundsMax);
+	CHECK(dequantize.Scale.y == 0.0f);
+
+	std::vector<PackedVertex> packed(vertices.size());
+	std::vector<Vertex> decoded(vertices.size());
+	VertexPacking::Pack(vertices.data(), vertices.size(), dequantize, packed.data());
+	VertexPacking::Unpack(packed.data(), packed.size(), dequantize, decoded.data());
+
+	bool positionsWithinBound = true;
+	bool paddingZero = true;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const float* original = &vertices[i].Position.x;
+		const float* position = &decoded[i].Position.x;
+		const float* extent = &dequantize.Scale.x;
+		const float* offset = &dequantize.Offset.x;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			// Leaving room for float rounding in the dequantize math itself
+			float floatSlop = 4.0f * FLT_EPSILON * (fabsf(original[axis]) + fabsf(offset[axis]) + extent[axis]);
+			positionsWithinBound &= fabsf(position[axis] - original[axis]) <= extent[axis] / 131070.0f + floatSlop;
+		}
+		paddingZero &= packed[i].Position[3] == 0;
+	}
+	CHECK(positionsWithinBound);
+	CHECK(paddingZero);
+	CHECK(uvsMatch(decoded));
+	CHECK(directionsMatch(decoded));
+
+	// An axis with no extent decodes to exactly where it was
+	bool flatAxisExact = true;
+	for (size_t i = 0; i < vertices.size(); i++)
+		flatAxisExact &= decoded[i].Position.y == 3.0f;
+	CHECK(flatAxisExact);
+
+	// Float positions
+	std::vector<PackedVertexFloatPosition> packedFloat(vertices.size());
+	VertexPacking::Pack(vertices.data(), vertices.size(), packedFloat.data());
+	VertexPacking::Unpack(packedFloat.data(), packedFloat.size(), decoded.data());
+
+	bool positionsExact = true;
+	for (size_t i = 0; i < vertices.size(); i++)
+		positionsExact &= memcmp(&decoded[i].Position, &vertices[i].Position, sizeof(XMFLOAT3)) == 0;
+	CHECK(positionsExact);
+	CHECK(uvsMatch(decoded));
+	CHECK(directionsMatch(decoded));
+
+	CHECK(VertexPacking::GetStride(VertexFormat::Packed) * 2 <= VertexPacking::GetStride(VertexFormat::Full));
+}
+
+// --------------------------------------------------------
+// LODs reuse the mesh's vertices, only ever get smaller,
+// stay within the error limit and keep whole triangles, on
+// a grid and on the shipped meshes
+// --------------------------------------------------------
+void TestMeshSimplifier()
+{
+	MeshData grid = MakeGrid(32);
+	size_t fullIndexCount = grid.indices.size();
+	MeshSimplifier::BuildLods(grid);
+
+	CHECK(grid.lods.size() > 1);
+	CHECK(grid.lods[0].StartIndex == 0 && grid.lods[0].IndexCount == fullIndexCount);
+	for (size_t l = 1; l < grid.lods.size(); l++)
+	{
+		const MeshLod& lod = grid.lods[l];
+		CHECK(lod.IndexCount % 3 == 0);
+		CHECK(lod.IndexCount < grid.lods[l - 1].IndexCount);
+		CHECK(lod.StartIndex + lod.IndexCount <= grid.indices.size());
+		CHECK(lod.Error <= MeshSimplifier::DefaultMaxError);
+
+		bool inRange = true;
+		bool degenerate = false;
+		for (unsigned int i = lod.StartIndex; i < lod.StartIndex + lod.IndexCount; i += 3)
+		{
+			const unsigned int* triangle = &grid.indices[i];
+			inRange &= triangle[0] < grid.vertices.size() && triangle[1] < grid.vertices.size() && triangle[2] < grid.vertices.size();
+			degenerate |= triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2];
+		}
+		CHECK(inRange);
+		CHECK(!degenerate);
+	}
+
+	// Reaching the target within the limit, and a stricter limit
+	// never removing more
+	std::vector<unsigned int> half, strict;
+	size_t target = fullIndexCount / 2 / 3 * 3;
+	float error = MeshSimplifier::Simplify(grid, grid.indices.data(), fullIndexCount, target, MeshSimplifier::DefaultMaxError, half);
+	float strictError = MeshSimplifier::Simplify(grid, grid.indices.data(), fullIndexCount, target, 0.0f, strict);
+	CHECK(half.size() <= target && half.size() % 3 == 0);
+	CHECK(error <= MeshSimplifier::DefaultMaxError);
+	CHECK(strict.size() >= half.size());
+	CHECK(strictError <= error);
+
+	// The shipped meshes, loaded the way Mesh loads them, reach each
+	// ratio's target unless the error limit stops them first (which
+	// ends the chain, as every smaller target would stop there too)
+	std::vector<MeshData> assets;
+	for (const char* fileName : { "sphere.obj", "torus.obj", "helix.obj" })
+	{
+		MappedFile file(FindMesh(fileName).c_str());
+		CHECK(file.IsOpen());
+		if (!file.IsOpen())
+			continue;
+
+		assets.emplace_back();
+		MeshLoader::LoadObj(file.GetData(), file.GetSize(), assets.back());
+		MeshOptimizer::Optimize(assets.back());
+	}
+
+	std::vector<MeshData> threaded = assets;
+	for (MeshData& mesh : assets)
+	{
+		unsigned int fullIndexCount = mesh.lods[0].IndexCount;
+		MeshSimplifier::BuildLods(mesh);
+		CHECK(mesh.lods.size() > 1);
+		CHECK(mesh.lods.size() <= MeshSimplifier::DefaultLodRatios.size() + 1);
+
+		for (size_t l = 1; l < mesh.lods.size(); l++)
+		{
+			const MeshLod& lod = mesh.lods[l];
+			size_t target = (size_t)(fullIndexCount / 3 * MeshSimplifier::DefaultLodRatios[l - 1]) * 3;
+			CHECK(lod.Error <= MeshSimplifier::DefaultMaxError);
+			CHECK(lod.IndexCount % 3 == 0 && lod.IndexCount < mesh.lods[l - 1].IndexCount);
+			CHECK(lod.IndexCount <= target || l == mesh.lods.size() - 1);
+		}
+	}
+
+	// Simplifying the meshes on several threads makes the same LODs
+	std::vector<MeshData*> meshes;
+	for (MeshData& mesh : threaded)
+		meshes.push_back(&mesh);
+	MeshSimplifier::BuildLods(meshes, 3);
+	for (size_t m = 0; m < assets.size(); m++)
+	{
+		bool lodsMatch = threaded[m].lods.size() == assets[m].lods.size();
+		for (size_t l = 0; lodsMatch && l < assets[m].lods.size(); l++)
+		{
+			lodsMatch &= threaded[m].lods[l].StartIndex == assets[m].lods[l].StartIndex;
+			lodsMatch &= threaded[m].lods[l].IndexCount == assets[m].lods[l].IndexCount;
+			lodsMatch &= threaded[m].lods[l].Error == assets[m].lods[l].Error;
+		}
+		CHECK(lodsMatch);
+		CHECK(threaded[m].indices == assets[m].indices);
+	}
+}
+
+// --------------------------------------------------------
+// The SIMD cull agrees with the scalar cull and with Test()
+// --------------------------------------------------------
+void TestFrustumCulling()
+{
+	Frustum frustum = Frustum::FromMatrix(MakeViewProjection());
+
+	// Straight ahead, behind and far off to the side
+	WorldBounds known;
+	FrustumCulling::Resize(known, 3);
+	XMFLOAT4X4 identity = MakeIdentity();
+	FrustumCulling::SetFromLocalBox(known, 0, XMFLOAT3(-1, -1, 9), XMFLOAT3(1, 1, 11), identity);
+	FrustumCulling::SetFromLocalBox(known, 1, XMFLOAT3(-1, -1, -11), XMFLOAT3(1, 1, -9), identity);
+	FrustumCulling::SetFromLocalBox(known, 2, XMFLOAT3(99, -1, 9), XMFLOAT3(101, 1, 11), identity);
+
+	std::vector<unsigned int> visible;
+	CHECK(FrustumCulling::Cull(known, frustum, visible) == 1);
+	CHECK(visible.size() == 1 && visible[0] == 0);
+	CHECK(FrustumCulling::Test(known, 0, frustum));
+	CHECK(!FrustumCulling::Test(known, 1, frustum));
+	CHECK(!FrustumCulling::Test(known, 2, frustum));
+
+	// A count that isn't a multiple of four, to cover the partial group
+	WorldBounds bounds = MakeRandomBoxes(1001, 200.0f, 1);
+	std::vector<unsigned int> simd, scalar, tested;
+	FrustumCulling::Cull(bounds, frustum, simd);
+	FrustumCulling::CullScalar(bounds, frustum, scalar);
+	for (unsigned int i = 0; i < 1001; i++)
+	{
+		if (FrustumCulling::Test(bounds, i, frustum))
+			tested.push_back(i);
+	}
+	CHECK(!simd.empty() && simd.size() < 1001);
+	CHECK(Sorted(simd) == tested);
+	CHECK(Sorted(scalar) == tested);
+}
+
+// --------------------------------------------------------
+// A wall in front of the camera hides what's behind it,
+// but nothing in front of it
+// --------------------------------------------------------
+void TestOcclusionCuller()
+{
+	// A quad at z = 5, much wider than the view, facing the camera
+	Vertex wall[4] = {};
+	wall[0].Position = XMFLOAT3(-20, -20, 5);
+	wall[1].Position = XMFLOAT3(-20, 20, 5);
+	wall[2].Position = XMFLOAT3(20, 20, 5);
+	wall[3].Position = XMFLOAT3(20, -20, 5);
+	unsigned int wallIndices[6] = { 0, 1, 2, 0, 2, 3 };
+	MeshLod wallLod = { 0, 6, 0.0f };
+
+	OccluderMesh occluder;
+	OcclusionCuller::BuildOccluder(wall, wallIndices, &wallLod, 1, occluder);
+	CHECK(occluder.positions.size() == 4);
+	CHECK(occluder.indices.size() == 6);
+
+	for (unsigned int threadCount : { 1u, 4u })
+	{
+		OcclusionCuller culler(256, 128, threadCount);
+		culler.BeginFrame(MakeViewProjection());
+		culler.AddOccluder(occluder, MakeIdentity());
+		culler.FinishOccluders();
+
+		CHECK(culler.GetWidth() % 4 == 0);
+		CHECK(culler.GetStats().occluderTriangles == 2);
+		CHECK(culler.GetDepth(culler.GetWidth() / 2, culler.GetHeight() / 2) > 0.0f);
+
+		CHECK(culler.IsVisible(XMFLOAT3(0, 0, 2), XMFLOAT3(0.5f, 0.5f, 0.5f)));
+		CHECK(!culler.IsVisible(XMFLOAT3(0, 0, 20), XMFLOAT3(1, 1, 1)));
+		CHECK(!culler.IsVisible(XMFLOAT3(3, 1, 40), XMFLOAT3(2, 2, 2)));
+
+		// Crossing the near plane is always visible
+		CHECK(culler.IsVisible(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1)));
+
+		WorldBounds bounds;
+		FrustumCulling::Resize(bounds, 2);
+		FrustumCulling::SetFromLocalBox(bounds, 0, XMFLOAT3(-1, -1, 1), XMFLOAT3(1, 1, 3), MakeIdentity());
+		FrustumCulling::SetFromLocalBox(bounds, 1, XMFLOAT3(-1, -1, 19), XMFLOAT3(1, 1, 21), MakeIdentity());
+
+		std::vector<unsigned int> candidates = { 0, 1 };
+		std::vector<unsigned int> visible;
+		CHECK(culler.Cull(bounds, candidates, visible) == 1);
+		CHECK(visible.size() == 1 && visible[0] == 0);
+		CHECK(culler.GetStats().testedCount == 2 && culler.GetStats().culledCount == 1);
+	}
+
+	// With nothing drawn, nothing is hidden
+	OcclusionCuller empty;
+	empty.BeginFrame(MakeViewProjection());
+	empty.FinishOccluders();
+	CHECK(empty.IsVisible(XMFLOAT3(0, 0, 20), XMFLOAT3(1, 1, 1)));
+}
+
+// --------------------------------------------------------
+// Queries and ray casts find exactly what checking every
+// object would, before and after objects move
+// --------------------------------------------------------
+void TestSceneBvh()
+{
+	const unsigned int objectCount = 10000;
+	WorldBounds bounds = MakeRandomBoxes(objectCount, 400.0f, 2);
+
+	auto checkQueries = [&](const SceneBvh& bvh)
+		{
+			CHECK(bvh.GetObjectCount() == objectCount);
+
+			XMFLOAT3 boxMin(-50, -20, -50);
+			XMFLOAT3 boxMax(30, 40, 10);
+			std::vector<unsigned int> found, expected;
+			bvh.QueryBox(boxMin, boxMax, found);
+			for (unsigned int i = 0; i < objectCount; i++)
+			{
+				if (BoxesOverlap(bounds, i, boxMin, boxMax))
+					expected.push_back(i);
+			}
+			CHECK(!expected.empty());
+			CHECK(Sorted(found) == expected);
+
+			// Boxes the frustum test keeps are a superset of the exact test's
+			Frustum frustum = Frustum::FromMatrix(MakeViewProjection());
+			std::vector<unsigned int> inFrustum;
+			bvh.QueryFrustum(frustum, inFrustum);
+			std::vector<unsigned int> culled;
+			FrustumCulling::CullScalar(bounds, frustum, culled);
+			std::vector<unsigned int> sortedFrustum = Sorted(inFrustum);
+			CHECK(std::includes(sortedFrustum.begin(), sortedFrustum.end(), culled.begin(), culled.end()));
+
+			// The nearest box along a handful of rays
+			std::mt19937 random(3);
+			std::uniform_real_distribution<float> directions(-1.0f, 1.0f);
+			for (int r = 0; r < 32; r++)
+			{
+				XMFLOAT3 origin(0, 0, 0);
+				XMFLOAT3 direction;
+				XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSet(directions(random), directions(random), directions(random), 0)));
+
+				float nearest = -1.0f;
+				for (unsigned int i = 0; i < objectCount; i++)
+				{
+					float distance = RayBoxDistance(bounds, i, origin, direction, 1000.0f);
+					if (distance >= 0.0f && (nearest < 0.0f || distance < nearest))
+						nearest = distance;
+				}
+
+				BvhRayHit hit = {};
+				bool hitAnything = bvh.Raycast(origin, direction, 1000.0f, hit);
+				CHECK(hitAnything == (nearest >= 0.0f));
+				if (hitAnything && nearest >= 0.0f)
+				{
+					CHECK(fabsf(hit.Distance - nearest) < 1e-3f);
+					CHECK(fabsf(RayBoxDistance(bounds, hit.Index, origin, direction, 1000.0f) - nearest) < 1e-3f);
+				}
+			}
+		};
+
+	for (unsigned int threadCount : { 1u, 4u })
+	{
+		SceneBvh bvh(std::make_shared<WorkerPool>(threadCount));
+		bvh.Build(bounds);
+		checkQueries(bvh);
+
+		// Move a few objects a little, then most of them a lot, so both
+		// partial refits and full ones (with rebuilds) are covered
+		std::mt19937 random(4);
+		std::uniform_real_distribution<float> offsets(-100.0f, 100.0f);
+		for (unsigned int movedCount : { 50u, 9000u })
+		{
+			std::vector<unsigned int> moved;
+			for (unsigned int i = 0; i < movedCount; i++)
+			{
+				unsigned int index = (i * 7919) % objectCount;
+				bounds.CenterX[index] += offsets(random) * (movedCount > 100 ? 1.0f : 0.05f);
+				bounds.CenterY[index] += offsets(random) * (movedCount > 100 ? 1.0f : 0.05f);
+				moved.push_back(index);
+			}
+			bvh.Refit(bounds, moved);
+			checkQueries(bvh);
+		}
+
+		bounds = MakeRandomBoxes(objectCount, 400.0f, 2);
+	}
+}
+
+// --------------------------------------------------------
+// Stale handles find nothing, and released resources live
+// for exactly framesToKeep more frames
+// --------------------------------------------------------
+void TestResourcePool()
+{
+	struct Counted
+	{
+		int Value;
+		int* Destroyed;
+
+		Counted(int value, int* destroyed) : Value(value), Destroyed(destroyed) {}
+		Counted(Counted&& other) noexcept : Value(other.Value), Destroyed(other.Destroyed) { other.Destroyed = nullptr; }
+		Counted& operator=(Counted&& other) noexcept
+		{
+			if (Destroyed)
+				(*Destroyed)++;
+			Value = other.Value;
+			Destroyed = other.Destroyed;
+			other.Destroyed = nullptr;
+			return *this;
+		}
+		~Counted() { if (Destroyed) (*Destroyed)++; }
+	};
+
+	int destroyed = 0;
+	{
+		ResourcePool<Counted> pool(2);
+		ResourcePool<Counted>::Handle a = pool.Add(Counted(1, &destroyed));
+		ResourcePool<Counted>::Handle b = pool.Add(Counted(2, &destroyed));
+		ResourcePool<Counted>::Handle c = pool.Add(Counted(3, &destroyed));
+		CHECK(!a.IsNull() && !b.IsNull() && !c.IsNull());
+		CHECK(pool.GetCount() == 3);
+		CHECK(pool.Get(b) && pool.Get(b)->Value == 2);
+		CHECK(!pool.Get({}));
+
+		// Released, but alive until two frames have ended
+		pool.Release(a);
+		CHECK(!pool.IsValid(a) && !pool.Get(a));
+		CHECK(pool.GetCount() == 2 && pool.GetPendingCount() == 1);
+		pool.EndFrame();
+		CHECK(destroyed == 0);
+		pool.EndFrame();
+		CHECK(destroyed == 1 && pool.GetPendingCount() == 0);
+
+		// The others survive being moved into its place
+		CHECK(pool.Get(b) && pool.Get(b)->Value == 2);
+		CHECK(pool.Get(c) && pool.Get(c)->Value == 3);
+
+		// Its slot is reused with a new generation, so the old handle stays stale
+		ResourcePool<Counted>::Handle d = pool.Add(Counted(4, &destroyed));
+		CHECK(d.GetIndex() == a.GetIndex() && d.GetGeneration() != a.GetGeneration());
+		CHECK(!pool.Get(a));
+		CHECK(pool.Get(d) && pool.Get(d)->Value == 4);
+
+		int sum = 0;
+		unsigned int visited = 0;
+		pool.ForEach([&](ResourcePool<Counted>::Handle handle, Counted& item)
+			{
+				sum += item.Value;
+				visited++;
+				CHECK(pool.Get(handle) == &item);
+			});
+		CHECK(visited == 3 && sum == 2 + 3 + 4);
+	}
+	CHECK(destroyed == 4);
+}
+
+// --------------------------------------------------------
+// Children follow their parents, only what moved is marked
+// as changed, and links never form a cycle or dangle
+// --------------------------------------------------------
+void TestEntityStore()
+{
+	EntityStore store;
+	EntityId root = store.Create(Components::Transform);
+	EntityId child = store.Create(Components::Transform | Components::Renderable);
+	EntityId grandchild = store.Create(Components::Transform);
+	EntityId bystander = store.Create(Components::Transform);
+
+	auto translate = [&](EntityId entity, float x, float y, float z)
+		{
+			LocalTransform transform = store.GetTransform(entity);
+			transform.Translation = XMFLOAT3(x, y, z);
+			store.SetTransform(entity, transform);
+		};
+	auto world = [&](EntityId entity)
+		{
+			EntityLocation location = store.GetLocation(entity);
+			return store.GetArchetype(location.Archetype).Worlds[location.Row];
+		};
+	auto worldChanged = [&](EntityId entity)
+		{
+			EntityLocation location = store.GetLocation(entity);
+			return store.GetArchetype(location.Archetype).WorldChanged[location.Row] != 0;
+		};
+
+	translate(root, 10, 0, 0);
+	translate(child, 1, 0, 0);
+	translate(grandchild, 0, 2, 0);
+	translate(bystander, 0, 0, 5);
+
+	// Linked in the wrong order on purpose, so the store has to sort them
+	store.SetParent(grandchild, child);
+	store.SetParent(child, root);
+	CHECK(store.GetParent(child) == root);
+	CHECK(store.GetParent(grandchild) == child);
+	CHECK(store.GetParent(root) == EntityId{});
+	CHECK(store.GetRenderable(child) != nullptr);
+
+	store.UpdateWorldMatrices();
+	CHECK(world(grandchild)._41 == 11.0f && world(grandchild)._42 == 2.0f);
+	CHECK(worldChanged(root) && worldChanged(child) && worldChanged(grandchild) && worldChanged(bystander));
+
+	// Nothing moved
+	store.UpdateWorldMatrices();
+	CHECK(!worldChanged(root) && !worldChanged(child) && !worldChanged(grandchild) && !worldChanged(bystander));
+
+	// Moving (and scaling) the root moves everything below it, and nothing else
+	LocalTransform rootTransform = store.GetTransform(root);
+	rootTransform.Translation = XMFLOAT3(20, 0, 0);
+	rootTransform.Scale = XMFLOAT3(2, 2, 2);
+	store.SetTransform(root, rootTransform);
+	store.UpdateWorldMatrices();
+	CHECK(worldChanged(root) && worldChanged(child) && worldChanged(grandchild) && !worldChanged(bystander));
+	CHECK(world(child)._41 == 22.0f);
+	CHECK(world(grandchild)._41 == 22.0f && world(grandchild)._42 == 4.0f);
+
+	// Inverse transposes follow the same chain
+	EntityLocation location = store.GetLocation(grandchild);
+	XMFLOAT4X4 grandchildWorld = world(grandchild);
+	XMMATRIX expected = XMMatrixTranspose(XMMatrixInverse(nullptr, XMLoadFloat4x4(&grandchildWorld)));
+	XMFLOAT4X4 expectedInverseTranspose;
+	XMStoreFloat4x4(&expectedInverseTranspose, expected);
+	const XMFLOAT4X4& inverseTranspose = store.GetArchetype(location.Archetype).WorldInverseTransposes[location.Row];
+	bool inverseTransposeMatches = true;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			inverseTransposeMatches &= fabsf(inverseTranspose.m[i][j] - expectedInverseTranspose.m[i][j]) < 1e-5f;
+	CHECK(inverseTransposeMatches);
+
+	// Only the moved child's branch changes
+	translate(child, 0, 0, 1);
+	store.UpdateWorldMatrices();
+	CHECK(!worldChanged(root) && worldChanged(child) && worldChanged(grandchild));
+
+	// No cycles, and no parenting to itself
+	store.SetParent(root, grandchild);
+	store.SetParent(child, child);
+	CHECK(store.GetParent(root) == EntityId{});
+	CHECK(store.GetParent(child) == root);
+
+	// Destroying a parent leaves its child relative to the world
+	store.Destroy(child);
+	CHECK(!store.IsAlive(child));
+	CHECK(store.GetParent(grandchild) == EntityId{});
+	store.UpdateWorldMatrices();
+	CHECK(worldChanged(grandchild));
+	CHECK(world(grandchild)._41 == 0.0f && world(grandchild)._42 == 2.0f);
+	CHECK(store.GetCount() == 3);
+}
+
+// --------------------------------------------------------
+// Keys round trip, and sorting (on any number of threads)
+// matches a stable sort
+// --------------------------------------------------------
+void TestDrawListSorting()
+{
+	unsigned long long key = DrawList::MakeKey(DrawPass::Opaque, 5, 77, 300, 12.5f);
+	CHECK(DrawList::GetPass(key) == DrawPass::Opaque);
+	CHECK(DrawList::GetShader(key) == 5);
+	CHECK(DrawList::GetMaterial(key) == 77);
+	CHECK(DrawList::GetMesh(key) == 300);
+
+	unsigned long long transparent = DrawList::MakeKey(DrawPass::Transparent, 6, 78, 301, 12.5f);
+	CHECK(DrawList::GetPass(transparent) == DrawPass::Transparent);
+	CHECK(DrawList::GetShader(transparent) == 6);
+	CHECK(DrawList::GetMaterial(transparent) == 78);
+	CHECK(DrawList::GetMesh(transparent) == 301);
+
+	// Opaque before transparent; opaque front to back, transparent back to front
+	CHECK(key < transparent);
+	CHECK(DrawList::MakeKey(DrawPass::Opaque, 1, 1, 1, 1.0f) < DrawList::MakeKey(DrawPass::Opaque, 1, 1, 1, 2.0f));
+	CHECK(DrawList::MakeKey(DrawPass::Transparent, 1, 1, 1, 2.0f) < DrawList::MakeKey(DrawPass::Transparent, 1, 1, 1, 1.0f));
+	CHECK(DrawList::MakeKey(DrawPass::Opaque, 1, 1, 1, -5.0f) == DrawList::MakeKey(DrawPass::Opaque, 1, 1, 1, 0.0f));
+
+	// Few enough distinct values that plenty of keys tie
+	std::mt19937 random(5);
+	std::uniform_int_distribution<unsigned int> ids(0, 7);
+	std::uniform_real_distribution<float> depths(0.0f, 100.0f);
+	std::vector<unsigned long long> keys;
+	for (unsigned int i = 0; i < 100000; i++)
+	{
+		DrawPass pass = ids(random) == 0 ? DrawPass::Transparent : DrawPass::Opaque;
+		keys.push_back(DrawList::MakeKey(pass, ids(random), ids(random), ids(random), (float)(int)depths(random)));
+	}
+
+	std::vector<unsigned int> expected(keys.size());
+	for (unsigned int i = 0; i < expected.size(); i++)
+		expected[i] = i;
+	std::stable_sort(expected.begin(), expected.end(), [&](unsigned int a, unsigned int b) { return keys[a] < keys[b]; });
+
+	for (unsigned int threadCount : { 1u, 4u })
+	{
+		DrawList list(std::make_shared<WorkerPool>(threadCount));
+		for (unsigned int i = 0; i < keys.size(); i++)
+			list.Add(keys[i], i);
+		list.Sort();
+
+		CHECK(list.GetCount() == keys.size());
+		CHECK(std::is_sorted(list.GetKeys().begin(), list.GetKeys().end()));
+		CHECK(list.GetItems() == expected);
+
+		// Reusable after Clear()
+		list.Clear();
+		CHECK(list.GetCount() == 0);
+		list.Sort();
+		CHECK(list.GetCount() == 0);
+	}
+
+	unsigned long long changes[3] =
+	{
+		DrawList::MakeKey(DrawPass::Opaque, 1, 1, 1, 0.0f),
+		DrawList::MakeKey(DrawPass::Opaque, 1, 1, 2, 0.0f),
+		DrawList::MakeKey(DrawPass::Opaque, 1, 2, 3, 0.0f)
+	};
+	DrawStateChanges counted = DrawList::CountStateChanges(changes, 3);
+	CHECK(counted.shaders == 1 && counted.materials == 2 && counted.meshes == 3);
+}
+
+// --------------------------------------------------------
+// Matching draws in a row share a batch, anything else (or
+// a full batch) starts a new one, and instance data stays
+// in the order draws were added
+// --------------------------------------------------------
+void TestInstanceBatcher()
+{
+	// Each draw's world matrix carries its draw number, so its instance
+	// data can be traced back to it
+	auto world = [](unsigned int draw)
+		{
+			XMFLOAT4X4 matrix = MakeIdentity();
+			matrix._41 = (float)draw;
+			return matrix;
+		};
+	auto inverseTranspose = [](unsigned int draw)
+		{
+			XMFLOAT4X4 matrix = MakeIdentity();
+			matrix._14 = -(float)draw;
+			return matrix;
+		};
+
+	struct Draw
+	{
+		unsigned int Mesh;
+		unsigned int Material;
+		int Lod;
+	};
+	Draw draws[] =
+	{
+		{ 1, 1, 0 }, { 1, 1, 0 }, { 1, 1, 0 },	// Joined
+		{ 2, 1, 0 },							// Mesh changes
+		{ 2, 2, 0 }, { 2, 2, 0 },				// Material changes
+		{ 2, 2, 1 },							// LOD changes
+		{ 1, 1, 0 }, { 1, 1, 0 },				// Matches an earlier batch, but not the one before
+	};
+
+	InstanceBatcher batcher;
+	for (unsigned int i = 0; i < std::size(draws); i++)
+		batcher.Add(draws[i].Mesh, draws[i].Material, draws[i].Lod, world(i), inverseTranspose(i));
+
+	const std::vector<InstanceBatch>& batches = batcher.GetBatches();
+	const std::vector<InstanceData>& instances = batcher.GetInstances();
+	unsigned int expectedCounts[] = { 3, 1, 2, 1, 2 };
+	CHECK(batches.size() == std::size(expectedCounts));
+	CHECK(instances.size() == std::size(draws));
+
+	bool batchesMatch = batches.size() == std::size(expectedCounts);
+	unsigned int firstInstance = 0;
+	for (size_t b = 0; batchesMatch && b < batches.size(); b++)
+	{
+		const Draw& first = draws[firstInstance];
+		batchesMatch &= batches[b].FirstInstance == firstInstance && batches[b].InstanceCount == expectedCounts[b];
+		batchesMatch &= batches[b].Mesh == first.Mesh && batches[b].Material == first.Material && batches[b].Lod == first.Lod;
+		firstInstance += expectedCounts[b];
+	}
+	CHECK(batchesMatch);
+
+	bool instancesInOrder = true;
+	for (unsigned int i = 0; i < instances.size(); i++)
+		instancesInOrder &= instances[i].world._41 == (float)i && instances[i].worldInvTranspose._14 == -(float)i;
+	CHECK(instancesInOrder);
+
+	// A full batch starts another with the same mesh, material and LOD
+	InstanceBatcher limited(4);
+	for (unsigned int i = 0; i < 10; i++)
+		limited.Add(7, 3, 2, world(i), inverseTranspose(i));
+	CHECK(limited.GetBatches().size() == 3);
+	CHECK(limited.GetBatches().size() == 3 &&
+		limited.GetBatches()[0].InstanceCount == 4 && limited.GetBatches()[1].InstanceCount == 4 && limited.GetBatches()[2].InstanceCount == 2);
+	CHECK(limited.GetBatches().size() == 3 &&
+		limited.GetBatches()[1].FirstInstance == 4 && limited.GetBatches()[2].FirstInstance == 8 && limited.GetBatches()[2].Lod == 2);
+
+	// Clear() empties both, ready for the next frame
+	limited.Clear();
+	CHECK(limited.GetBatches().empty() && limited.GetInstances().empty());
+	limited.Add(7, 3, 2, world(0), inverseTranspose(0));
+	CHECK(limited.GetBatches().size() == 1 && limited.GetBatches()[0].FirstInstance == 0);
+}
+
+// --------------------------------------------------------
+// Pieces are handed out in order, wrap around the end, and
+// never overlap a piece whose frame hasn't been retired,
+// whatever mix of empty frames and late or repeated
+// retirements comes along
+// --------------------------------------------------------
+void TestConstantBufferRing()
+{
+	const unsigned int A = ConstantBufferRing::Alignment;
+	unsigned int offset = 0;
+
+	// Sizes round up to the alignment, and so does the capacity (down)
+	ConstantBufferRing ring(5 * A + 100);
+	CHECK(ring.GetCapacity() == 5 * A);
+	CHECK(ring.Allocate(A, offset) && offset == 0);
+	CHECK(ring.Allocate(1, offset) && offset == A);
+	CHECK(ring.GetCurrentFrameBytes() == 2 * A);
+	unsigned long long first = ring.EndFrame();
+	CHECK(ring.Allocate(2 * A, offset) && offset == 2 * A);
+	unsigned long long second = ring.EndFrame();
+	CHECK(ring.GetFramesInFlight() == 2 && ring.GetUsedBytes() == 4 * A);
+
+	// One piece is left at the end, and the start is still in use
+	CHECK(!ring.Allocate(2 * A, offset));
+
+	// Wrapping skips the end, which stays used until this frame retires
+	ring.RetireFrame(first);
+	CHECK(ring.GetUsedBytes() == 2 * A);
+	CHECK(ring.Allocate(2 * A, offset) && offset == 0);
+	CHECK(ring.GetUsedBytes() == 5 * A);
+	CHECK(!ring.Allocate(A, offset));
+	unsigned long long third = ring.EndFrame();
+
+	ring.RetireFrame(second);
+	CHECK(ring.GetUsedBytes() == 3 * A);
+	CHECK(ring.Allocate(2 * A, offset) && offset == 2 * A);
+	unsigned long long fourth = ring.EndFrame();
+
+	// Retiring a frame that's already gone changes nothing
+	ring.RetireFrame(first);
+	CHECK(ring.GetFramesInFlight() == 2 && ring.GetUsedBytes() == 5 * A);
+
+	// Once everything is retired, pieces start from the beginning again
+	ring.RetireFrame(fourth);
+	CHECK(ring.GetFramesInFlight() == 0 && ring.GetUsedBytes() == 0);
+	CHECK(ring.Allocate(A, offset) && offset == 0);
+	CHECK(third < fourth);
+
+	// Growing starts over in a new buffer, with frame numbers carrying on
+	unsigned long long fifth = ring.EndFrame();
+	ring.Reset(16 * A);
+	CHECK(ring.GetCapacity() == 16 * A && ring.GetUsedBytes() == 0 && ring.GetFramesInFlight() == 0);
+	CHECK(ring.GetCurrentFrame() == fifth + 1);
+	CHECK(ring.Allocate(16 * A, offset) && offset == 0);
+	CHECK(!ring.Allocate(A, offset));
+	CHECK(!ConstantBufferRing(4 * A).Allocate(5 * A, offset));
+
+	// Frames that allocate nothing, still in flight when everything before
+	// them retires, mustn't let the next pieces start over at the beginning
+	ConstantBufferRing emptyFrames(12 * A);
+	CHECK(emptyFrames.Allocate(3 * A, offset) && offset == 0);
+	unsigned long long busy = emptyFrames.EndFrame();
+	unsigned long long empty = emptyFrames.EndFrame();
+	emptyFrames.EndFrame();
+	emptyFrames.RetireFrame(busy);
+	CHECK(emptyFrames.GetUsedBytes() == 0 && emptyFrames.GetFramesInFlight() == 2);
+	CHECK(emptyFrames.Allocate(3 * A, offset) && offset == 3 * A);
+	emptyFrames.EndFrame();
+	emptyFrames.RetireFrame(empty);
+	CHECK(emptyFrames.Allocate(4 * A, offset) && offset == 6 * A);
+
+	// Random sizes, frames and retirements, checked against every piece
+	// still in use
+	struct Piece
+	{
+		unsigned long long Frame;
+		unsigned int Offset;
+		unsigned int Size;
+	};
+	std::vector<Piece> live;
+	std::mt19937 random(7);
+	std::uniform_int_distribution<unsigned int> actions(0, 9);
+	std::uniform_int_distribution<unsigned int> sizes(1, 4 * A);
+	ConstantBufferRing randomRing(12 * A);
+	unsigned long long retiredUpTo = 0;
+	unsigned int allocated = 0;
+	bool inBounds = true;
+	bool overlapFree = true;
+	for (int step = 0; step < 100000; step++)
+	{
+		unsigned int action = actions(random);
+		if (action < 5)
+		{
+			unsigned int size = sizes(random);
+			if (!randomRing.Allocate(size, offset))
+				continue;
+
+			unsigned int rounded = (size + A - 1) / A * A;
+			inBounds &= offset % A == 0 && offset + rounded <= randomRing.GetCapacity();
+			for (const Piece& piece : live)
+				overlapFree &= offset + rounded <= piece.Offset || piece.Offset + piece.Size <= offset;
+			live.push_back({ randomRing.GetCurrentFrame(), offset, rounded });
+			allocated++;
+		}
+		else if (action < 8)
+			randomRing.EndFrame();
+		else
+		{
+			// Usually up to a frame or two behind the current one, sometimes
+			// one that's already been retired
+			unsigned long long current = randomRing.GetCurrentFrame();
+			unsigned long long frame = action == 8 ? current - std::min(current, (unsigned long long)(step % 3)) : retiredUpTo / 2;
+			if (frame == 0)
+				continue;
+
+			randomRing.RetireFrame(frame - 1);
+			retiredUpTo = std::max(retiredUpTo, frame);
+			live.erase(std::remove_if(live.begin(), live.end(), [&](const Piece& piece) { return piece.Frame < retiredUpTo; }), live.end());
+		}
+
+		inBounds &= randomRing.GetUsedBytes() <= randomRing.GetCapacity();
+	}
+	CHECK(inBounds);
+	CHECK(overlapFree);
+	CHECK(allocated > 10000);
+}
+
+// --------------------------------------------------------
+// Only slots that changed are sent, one call per run of
+// neighbouring slots, and identical state descriptions
+// share one object
+// - StateTracker counts binds the same way: a request per
+//    Set(), and an issued call per run Flush() sends
+// --------------------------------------------------------
+void TestBindingSlots()
+{
+	struct Call
+	{
+		unsigned int First;
+		std::vector<int> Values;
+	};
+
+	BindingSlots<int, 16> slots;
+	std::vector<Call> calls;
+	unsigned int requested = 0;
+	unsigned int issued = 0;
+	auto set = [&](unsigned int slot, int value)
+		{
+			requested++;
+			return slots.Set(slot, value);
+		};
+	auto flush = [&]()
+		{
+			calls.clear();
+			issued += slots.Flush([&](unsigned int first, unsigned int count, const int* values)
+				{
+					calls.push_back({ first, std::vector<int>(values, values + count) });
+				});
+		};
+
+	// Neighbouring slots go in one call, whatever order they're set in
+	CHECK(set(4, 40) && set(2, 20) && set(3, 30));
+	flush();
+	CHECK(calls.size() == 1 && calls[0].First == 2 && calls[0].Values == std::vector<int>({ 20, 30, 40 }));
+	CHECK(requested == 3 && issued == 1);
+
+	// A gap splits the run in two
+	set(0, 1);
+	set(1, 2);
+	set(5, 6);
+	set(9, 10);
+	flush();
+	CHECK(calls.size() == 3 && calls[0].First == 0 && calls[0].Values == std::vector<int>({ 1, 2 }));
+	CHECK(calls.size() == 3 && calls[1].First == 5 && calls[1].Values == std::vector<int>({ 6 }));
+	CHECK(calls.size() == 3 && calls[2].First == 9 && calls[2].Values == std::vector<int>({ 10 }));
+	CHECK(requested == 7 && issued == 4);
+
+	// Binding what's already there is requested, but never sent, even in
+	// the middle of a run that is
+	CHECK(!set(2, 20) && !set(3, 30));
+	flush();
+	CHECK(calls.empty());
+	CHECK(requested == 9 && issued == 4);
+	set(3, 31);
+	set(4, 40);
+	set(5, 61);
+	flush();
+	CHECK(calls.size() == 2 && calls[0].First == 3 && calls[1].First == 5);
+
+	// Changing a slot and changing it back before flushing sends nothing
+	set(9, 11);
+	CHECK(!set(9, 10));
+	flush();
+	CHECK(calls.empty());
+
+	int bound = 0;
+	CHECK(slots.GetBound(5, bound) && bound == 61);
+	CHECK(!slots.GetBound(12, bound));
+	CHECK(!slots.Set(16, 1));
+
+	// After Invalidate() nothing is known, so even the same values are sent
+	// again, and anything set but not flushed is dropped
+	set(7, 70);
+	slots.Invalidate();
+	CHECK(!slots.GetBound(5, bound));
+	flush();
+	CHECK(calls.empty());
+	CHECK(set(5, 61));
+	flush();
+	CHECK(calls.size() == 1 && calls[0].First == 5);
+
+	// A constant buffer counts as changed if its range does, not just
+	// the buffer
+	struct ConstantBufferRange
+	{
+		const void* Buffer;
+		unsigned int FirstConstant;
+		unsigned int ConstantCount;
+
+		bool operator==(const ConstantBufferRange& other) const = default;
+	};
+	int buffer = 0;
+	BindingSlots<ConstantBufferRange, 14> constantBuffers;
+	CHECK(constantBuffers.Set(1, { &buffer, 0, 16 }));
+	CHECK(constantBuffers.Flush([](unsigned int, unsigned int, const ConstantBufferRange*) {}) == 1);
+	CHECK(!constantBuffers.Set(1, { &buffer, 0, 16 }));
+	CHECK(constantBuffers.Set(1, { &buffer, 16, 16 }));
+	CHECK(constantBuffers.Flush([](unsigned int, unsigned int, const ConstantBufferRange*) {}) == 1);
+
+	// Identical descriptions get the same object; different ones don't
+	struct Description
+	{
+		int Mode;
+		float Bias;
+	};
+	StateObjectCache<Description, int> cache;
+	int created = 0;
+	auto create = [&](const Description&) { return ++created; };
+	Description first = {};
+	first.Mode = 1;
+	Description same = first;
+	Description other = {};
+	other.Mode = 1;
+	other.Bias = 0.5f;
+	CHECK(cache.Get(first, create) == 1);
+	CHECK(cache.Get(same, create) == 1);
+	CHECK(cache.Get(other, create) == 2);
+	CHECK(cache.GetCount() == 2 && cache.GetHits() == 1 && created == 2);
+	cache.Clear();
+	CHECK(cache.GetCount() == 0 && cache.GetHits() == 0);
+}
+
+// --------------------------------------------------------
+// Recorded lists replay as the same commands, append in
+// order, and malformed ones are rejected
+// --------------------------------------------------------
+void TestRenderCommandList()
+{
+	// A tiny initial capacity, so recording has to grow the block
+	RenderCommandList list(16);
+	float constants[20] = {};
+	for (int i = 0; i < 20; i++)
+		constants[i] = (float)i;
+
+	list.BindPipeline(1, 2);
+	list.BindMaterial(2);
+	list.SetConstants(RenderShaderStage::Vertex, 0, constants, sizeof(constants));
+	list.SetConstants(RenderShaderStage::Pixel, 1, constants, 12);
+	list.Draw(3, 0);
+	list.Draw(3, 1, 10, 5);
+	CHECK(list.GetCommandCount() == 6);
+	CHECK(list.GetSize() % RenderCommandList::Alignment == 0);
+	CHECK(list.GetCapacity() >= list.GetSize());
+
+	// The constants come back as they went in
+	const SetConstantsCommand* setConstants = nullptr;
+	for (size_t offset = 0; offset < list.GetSize();)
+	{
+		const RenderCommandHeader* header = reinterpret_cast<const RenderCommandHeader*>(list.GetData() + offset);
+		if (header->Type == RenderCommandType::SetConstants && !setConstants)
+			setConstants = reinterpret_cast<const SetConstantsCommand*>(header);
+		offset += header->Size;
+	}
+	CHECK(setConstants && setConstants->DataSize == sizeof(constants));
+	CHECK(setConstants && memcmp(RenderCommandList::GetConstantsData(setConstants), constants, sizeof(constants)) == 0);
+
+	NullCommandExecutor executor;
+	CHECK(executor.Execute(list));
+	const RenderCommandCounts& counts = executor.GetCounts();
+	CHECK(counts.pipelines == 1 && counts.materials == 1 && counts.constants == 2);
+	CHECK(counts.draws == 2 && counts.instances == 11);
+	CHECK(counts.constantBytes == sizeof(constants) + 12);
+
+	// Appending keeps both lists' commands, in order
+	RenderCommandList other;
+	other.Draw(4, 0, 2);
+	RenderCommandList joined;
+	joined.Append(list);
+	joined.Append(other);
+	CHECK(joined.GetCommandCount() == 7);
+	CHECK(joined.GetSize() == list.GetSize() + other.GetSize());
+	CHECK(memcmp(joined.GetData(), list.GetData(), list.GetSize()) == 0);
+
+	executor.Reset();
+	CHECK(executor.Execute(joined));
+	CHECK(executor.GetCounts().draws == 3 && executor.GetCounts().instances == 13);
+
+	// Bindings carry over between lists, until Reset()
+	CHECK(executor.Execute(other));
+	executor.Reset();
+	CHECK(!executor.Execute(other));
+
+	// Drawing nothing, and constants for a slot that doesn't exist
+	RenderCommandList noInstances;
+	noInstances.BindPipeline(1, 2);
+	noInstances.BindMaterial(2);
+	noInstances.Draw(3, 0, 0);
+	executor.Reset();
+	CHECK(!executor.Execute(noInstances));
+
+	RenderCommandList badSlot;
+	badSlot.SetConstants(RenderShaderStage::Vertex, RenderCommandList::ConstantBufferSlots, constants, 16);
+	executor.Reset();
+	CHECK(!executor.Execute(badSlot));
+
+	// A whole 64 KB constant buffer fits; anything more is refused, not cut short
+	std::vector<unsigned char> fullBuffer(RenderCommandList::MaxConstantsSize + 1, 7);
+	RenderCommandList large;
+	CHECK(large.SetConstants(RenderShaderStage::Pixel, 0, fullBuffer.data(), RenderCommandList::MaxConstantsSize));
+	CHECK(!large.SetConstants(RenderShaderStage::Pixel, 0, fullBuffer.data(), RenderCommandList::MaxConstantsSize + 1));
+	CHECK(large.GetCommandCount() == 1);
+	const SetConstantsCommand* fullCommand = reinterpret_cast<const SetConstantsCommand*>(large.GetData());
+	CHECK(fullCommand->DataSize == 65536);
+	CHECK(memcmp(RenderCommandList::GetConstantsData(fullCommand), fullBuffer.data(), 65536) == 0);
+	executor.Reset();
+	CHECK(executor.Execute(large));
+	CHECK(executor.GetCounts().constantBytes == 65536);
+
+	// Corrupt sizes are caught before anything reads past them
+	std::vector<unsigned char> bytes(list.GetData(), list.GetData() + list.GetSize());
+	RenderCommandHeader* first = reinterpret_cast<RenderCommandHeader*>(bytes.data());
+	CHECK(RenderCommandList::ReadCommand(bytes.data(), bytes.size(), 0) == first);
+	CHECK(!RenderCommandList::ReadCommand(bytes.data(), bytes.size(), bytes.size()));
+	CHECK(!RenderCommandList::ReadCommand(bytes.data(), 4, 0));
+	unsigned int firstSize = first->Size;
+	first->Size = 0;
+	CHECK(!RenderCommandList::ReadCommand(bytes.data(), bytes.size(), 0));
+	first->Size = firstSize + 4;
+	CHECK(!RenderCommandList::ReadCommand(bytes.data(), bytes.size(), 0));
+	first->Size = (unsigned int)bytes.size() + RenderCommandList::Alignment;
+	CHECK(!RenderCommandList::ReadCommand(bytes.data(), bytes.size(), 0));
+	first->Size = sizeof(RenderCommandHeader);
+	CHECK(!RenderCommandList::ReadCommand(bytes.data(), bytes.size(), 0));
+	first->Size = firstSize;
+	first->Type = (RenderCommandType)200;
+	CHECK(!RenderCommandList::ReadCommand(bytes.data(), bytes.size(), 0));
+
+	// Constants claiming more data than the command holds
+	std::vector<unsigned char> constantBytes(large.GetData(), large.GetData() + large.GetSize());
+	reinterpret_cast<SetConstantsCommand*>(constantBytes.data())->DataSize = RenderCommandList::MaxConstantsSize + 8;
+	CHECK(!RenderCommandList::ReadCommand(constantBytes.data(), constantBytes.size(), 0));
+
+	// Reset() rewinds without giving the memory back
+	size_t capacity = list.GetCapacity();
+	list.Reset();
+	CHECK(list.GetSize() == 0 && list.GetCommandCount() == 0);
+	CHECK(list.GetCapacity() == capacity);
+	executor.Reset();
+	CHECK(executor.Execute(list));
+	CHECK(executor.GetCounts().draws == 0);
+}
+
+void TestWorkerPool()
+{
+	WorkerPool pool(4);
+	CHECK(pool.GetThreadCount() == 4);
+
+	// Every job runs exactly once, on its own thread, and all of them are
+	// done by the time Run() returns; the same threads are used every time
+	for (unsigned int jobCount = 1; jobCount <= 6; jobCount++)
+	{
+		unsigned int expected = std::min(jobCount, 4u);
+		for (int repeat = 0; repeat < 50; repeat++)
+		{
+			std::vector<unsigned int> runs(4, 0);
+			std::vector<std::thread::id> ids(4);
+			pool.Run(jobCount, [&](unsigned int job)
+				{
+					runs[job]++;
+					ids[job] = std::this_thread::get_id();
+				});
+
+			bool ranOnce = true;
+			for (unsigned int i = 0; i < 4; i++)
+				ranOnce = ranOnce && runs[i] == (i < expected ? 1u : 0u);
+			CHECK(ranOnce);
+			CHECK(ids[0] == std::this_thread::get_id());
+			for (unsigned int i = 1; i < expected; i++)
+				CHECK(ids[i] != ids[0] && ids[i] != ids[i - 1]);
+		}
+	}
+
+	// A pool of one is just the calling thread
+	WorkerPool single(1);
+	unsigned int singleRuns = 0;
+	single.Run(3, [&](unsigned int) { singleRuns++; });
+	CHECK(single.GetThreadCount() == 1 && singleRuns == 1);
+}
+
+int main()
+{
+	struct Test
+	{
+		const char* Name;
+		void (*Run)();
+	};
+
+	Test tests[] =
+	{
+		{ "PackedVertex", TestPackedVertex },
+		{ "MeshSimplifier", TestMeshSimplifier },
+		{ "FrustumCulling", TestFrustumCulling },
+		{ "OcclusionCuller", TestOcclusionCuller },
+		{ "SceneBvh", TestSceneBvh },
+		{ "ResourcePool", TestResourcePool },
+		{ "EntityStore", TestEntityStore },
+		{ "DrawList sorting", TestDrawListSorting },
+		{ "InstanceBatcher", TestInstanceBatcher },
+		{ "ConstantBufferRing", TestConstantBufferRing },
+		{ "BindingSlots", TestBindingSlots },
+		{ "RenderCommandList", TestRenderCommandList },
+		{ "WorkerPool", TestWorkerPool },
+	};
+
+	for (const Test& test : tests)
+	{
+		unsigned int failuresBefore = failureCount;
+		printf("%s\n", test.Name);
+		test.Run();
+		if (failureCount == failuresBefore)
+			printf("  ok\n");
+	}
+
+	printf("%u checks, %u failed\n", checkCount, failureCount);
+	return failureCount == 0 ? 0 : 1;
+}
@@ -1,16 +1,7 @@
 #include "ShaderIncludes.hlsli"
 // Texture combination pixel shader. Takes two textures
 
-cbuffer ExternalData : register(b0)
-{
-    float4 colorTint;
-    float2 textureScale;
-    float2 textureOffset;
-    float totalTime;
-    float3 cameraPos;
-    float roughness;
-    float3 backgroundColor;
-}
+// Constant data comes from PerFrame and PerMaterial (see ShaderIncludes.hlsli)
 
 // Texture and sampler state are bound with registers
 Texture2D BottomTexture     : register(t0);
@@ -1,25 +1,115 @@
 #include "Transform.h"
 #include<DirectXMath.h>
 
+#include <algorithm>
+#include <cmath>
+
 using namespace DirectX;
 
 Transform::Transform() :
-	scale{ XMFLOAT3(1.0f, 1.0f, 1.0f) },
+	Transform(TransformSystem::Default())
+{
+}
+
+Transform::Transform(TransformSystem& transformSystem) :
+	rotationMode { RotationMode::PitchYawRoll },
 	pitchYawRoll { XMFLOAT3(0.0f, 0.0f, 0.0f) },
-	translation { XMFLOAT3(0.0f, 0.0f, 0.0f) },
+	pitchYawRollHasChanged { false },
 	right { XMFLOAT3(1.0f, 0.0f, 0.0f) },
 	up { XMFLOAT3(0.0f, 1.0f, 0.0f) },
-	forward { XMFLOAT3(0.0f, 0.0f, 1.0f) }
+	forward { XMFLOAT3(0.0f, 0.0f, 1.0f) },
+	system { &transformSystem },
+	parent { nullptr }
 {
-	XMStoreFloat4x4(&world, XMMatrixIdentity());
-	XMStoreFloat4x4(&worldInverseTranspose, XMMatrixIdentity());
-
-	worldMatrixHasChanged = true;
+	slot = system->CreateSlot();
 	rotationHasChanged = true;
 }
 
 Transform::~Transform()
 {
+	// Don't leave anything pointing at this
+	SetParent(nullptr);
+	while (!children.empty())
+		children.back()->SetParent(nullptr);
+
+	system->FreeSlot(slot);
+}
+
+void Transform::AddChild(Transform* child)
+{
+	if (child)
+		child->SetParent(this);
+}
+
+void Transform::RemoveChild(Transform* child)
+{
+	if (child && child->parent == this)
+		child->SetParent(nullptr);
+}
+
+void Transform::SetParent(Transform* newParent)
+{
+	if (newParent == parent || newParent == this)
+		return;
+
+	// Parents have to be in the same system, to update together
+	if (newParent && newParent->system != system)
+		return;
+
+	// Can't become a child of one of its own children
+	for (Transform* ancestor = newParent; ancestor; ancestor = ancestor->parent)
+	{
+		if (ancestor == this)
+			return;
+	}
+
+	if (parent)
+		parent->children.erase(std::find(parent->children.begin(), parent->children.end(), this));
+
+	parent = newParent;
+	if (parent)
+		parent->children.push_back(this);
+
+	system->parents[slot] = parent ? (int)parent->slot : -1;
+	UpdateDepths();
+	MarkWorldMatrixChanged();
+}
+
+Transform* Transform::GetParent()
+{
+	return parent;
+}
+
+Transform* Transform::GetChild(unsigned int index)
+{
+	return index < children.size() ? children[index] : nullptr;
+}
+
+unsigned int Transform::GetChildCount()
+{
+	return (unsigned int)children.size();
+}
+
+int Transform::IndexOfChild(Transform* child)
+{
+	auto it = std::find(children.begin(), children.end(), child);
+	return it == children.end() ? -1 : (int)(it - children.begin());
+}
+
+TransformSystem* Transform::GetSystem()
+{
+	return system;
+}
+
+void Transform::SetRotationMode(RotationMode mode)
+{
+	// Both modes keep the quaternion, and the angles are worked out when needed
+	rotationMode = mode;
+}
+
+Transform::RotationMode Transform::GetRotationMode()
+{
+	return rotationMode;
 }
 
 void Transform::SetScale(float x, float y, float z)
@@ -32,8 +122,8 @@ void Transform::SetScale(float x, float y, float z)
 
 void Transform::SetScale(DirectX::XMFLOAT3 newScale)
 {
-	scale = newScale;
-	worldMatrixHasChanged = true;
+	StoreScale(newScale);
+	MarkWorldMatrixChanged();
 }
 
 void Transform::SetPitchYawRoll(float p, float y, float r)
@@ -47,8 +137,19 @@ void Transform::SetPitchYawRoll(float p, float y, float r)
 void Transform::SetPitchYawRoll(DirectX::XMFLOAT3 newPitchYawRoll)
 {
 	pitchYawRoll = newPitchYawRoll;
-	worldMatrixHasChanged = true;
-	rotationHasChanged = true;
+	pitchYawRollHasChanged = false;
+
+	StoreRotation(XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&newPitchYawRoll)));
+	MarkWorldMatrixChanged();
+}
+
+void Transform::SetRotation(DirectX::XMFLOAT4 newRotation)
+{
+	StoreRotation(XMQuaternionNormalize(XMLoadFloat4(&newRotation)));
+	MarkWorldMatrixChanged();
+
+	// Only worked out if someone asks for them
+	pitchYawRollHasChanged = true;
 }
 
 void Transform::SetTranslation(float x, float y, float z)
@@ -61,8 +162,8 @@ void Transform::SetTranslation(float x, float y, float z)
 
 void Transform::SetTranslation(DirectX::XMFLOAT3 newTranslation)
 {
-	translation = newTranslation;
-	worldMatrixHasChanged = true;
+	StoreTranslation(newTranslation);
+	MarkWorldMatrixChanged();
 }
 
 void Transform::Scale(float x, float y, float z)
@@ -75,12 +176,14 @@ void Transform::Scale(float x, float y, float z)
 
 void Transform::Scale(DirectX::XMFLOAT3 input)
 {
+	XMFLOAT3 scale = GetScale();
 	XMVECTOR original = XMLoadFloat3(&scale);
 	XMVECTOR newScale = XMLoadFloat3(&input);
 
 	XMStoreFloat3(&scale, XMVectorAdd(original, newScale));
+	StoreScale(scale);
 
-	worldMatrixHasChanged = true;
+	MarkWorldMatrixChanged();
 }
 
 void Transform::Rotate(float p, float y, float r)
@@ -93,13 +196,44 @@ void Transform::Rotate(float p, float y, float r)
 
 void Transform::Rotate(DirectX::XMFLOAT3 input)
 {
-	XMVECTOR original = XMLoadFloat3(&pitchYawRoll);
+	if (rotationMode == RotationMode::Quaternion)
+	{
+		XMFLOAT4 quaternion;
+		XMStoreFloat4(&quaternion, XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&input)));
+		Rotate(quaternion);
+		return;
+	}
+
+	XMFLOAT3 currentPitchYawRoll = GetPitchYawRoll();
+	XMVECTOR original = XMLoadFloat3(&currentPitchYawRoll);
 	XMVECTOR newRotation = XMLoadFloat3(&input);
 
-	XMStoreFloat3(&pitchYawRoll, XMVectorAdd(original, newRotation));
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, XMVectorAdd(original, newRotation));
+	SetPitchYawRoll(result);
+}
 
-	worldMatrixHasChanged = true;
-	rotationHasChanged = true;
+// --------------------------------------------------------
+// Rotates by the given quaternion after the current rotation,
+// so around the parent's (or world's) axes
+// - For a rotation around this transform's own axes, pass
+//    one of its direction vectors to RotateAxisAngle()
+// --------------------------------------------------------
+void Transform::Rotate(DirectX::XMFLOAT4 quaternion)
+{
+	XMFLOAT4 current = GetRotation();
+	XMFLOAT4 result;
+	XMStoreFloat4(&result, XMQuaternionMultiply(XMLoadFloat4(&current), XMLoadFloat4(&quaternion)));
+
+	// SetRotation() normalizes, so repeated rotations don't drift
+	SetRotation(result);
+}
+
+void Transform::RotateAxisAngle(DirectX::XMFLOAT3 axis, float angle)
+{
+	XMFLOAT4 quaternion;
+	XMStoreFloat4(&quaternion, XMQuaternionRotationAxis(XMLoadFloat3(&axis), angle));
+	Rotate(quaternion);
 }
 
 void Transform::MoveAbsolute(float x, float y, float z)
@@ -112,12 +246,14 @@ void Transform::MoveAbsolute(float x, float y, float z)
 
 void Transform::MoveAbsolute(DirectX::XMFLOAT3 input)
 {
+	XMFLOAT3 translation = GetTranslation();
 	XMVECTOR original = XMLoadFloat3(&translation);
 	XMVECTOR newTranslation = XMLoadFloat3(&input);
 
 	XMStoreFloat3(&translation, XMVectorAdd(original, newTranslation));
+	StoreTranslation(translation);
 
-	worldMatrixHasChanged = true;
+	MarkWorldMatrixChanged();
 }
 
 void Transform::MoveRelative(float x, float y, float z)
@@ -130,31 +266,74 @@ void Transform::MoveRelative(float x, float y, float z)
 
 void Transform::MoveRelative(DirectX::XMFLOAT3 offset)
 {
-	// Create a quaternion representing the current rotation
-	XMVECTOR rotationQuaternion = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
+	if (rotationHasChanged)
+	{
+		RecalculateDirectionVectors();
+	}
 
-	// Load XMVECTOR from offset XMFLOAT3, rotate it by the quaternion, and add the original translation
-	XMVECTOR tr = XMVectorAdd(XMLoadFloat3(&translation), XMVector3Rotate(XMLoadFloat3(&offset), rotationQuaternion));
+	// The direction vectors are the rotated axes, so the offset is just a sum of them
+	XMFLOAT3 translation = GetTranslation();
+	XMVECTOR tr = XMLoadFloat3(&translation);
+	tr = XMVectorMultiplyAdd(XMLoadFloat3(&right), XMVectorReplicate(offset.x), tr);
+	tr = XMVectorMultiplyAdd(XMLoadFloat3(&up), XMVectorReplicate(offset.y), tr);
+	tr = XMVectorMultiplyAdd(XMLoadFloat3(&forward), XMVectorReplicate(offset.z), tr);
 
 	// Store new value into translation
 	XMStoreFloat3(&translation, tr);
+	StoreTranslation(translation);
 
-	worldMatrixHasChanged = true;
+	MarkWorldMatrixChanged();
 }
 
 DirectX::XMFLOAT3 Transform::GetScale()
 {
-	return scale;
+	return XMFLOAT3(system->scaleX[slot], system->scaleY[slot], system->scaleZ[slot]);
+}
+
+// --------------------------------------------------------
+// Pitch, yaw and roll that XMQuaternionRotationRollPitchYaw
+// would turn back into this quaternion
+// - Matches the rows of XMMatrixRotationRollPitchYaw: row 2
+//    holds -sin(pitch), and yaw and roll come from the rest
+//    of row 2 and column 1
+// - Looking straight up or down, yaw and roll turn around
+//    the same axis, so it's all put into yaw
+// --------------------------------------------------------
+DirectX::XMFLOAT3 Transform::PitchYawRollFromQuaternion(DirectX::XMFLOAT4 q)
+{
+	float sinPitch = -2.0f * (q.y * q.z - q.x * q.w);
+	float pitch = asinf(std::clamp(sinPitch, -1.0f, 1.0f));
+
+	if (fabsf(sinPitch) > 0.99999f)
+	{
+		float yaw = atan2f(-2.0f * (q.x * q.z - q.y * q.w), 1.0f - 2.0f * (q.y * q.y + q.z * q.z));
+		return XMFLOAT3(pitch, yaw, 0.0f);
+	}
+
+	float yaw = atan2f(2.0f * (q.x * q.z + q.y * q.w), 1.0f - 2.0f * (q.x * q.x + q.y * q.y));
+	float roll = atan2f(2.0f * (q.x * q.y + q.z * q.w), 1.0f - 2.0f * (q.x * q.x + q.z * q.z));
+	return XMFLOAT3(pitch, yaw, roll);
 }
 
 DirectX::XMFLOAT3 Transform::GetPitchYawRoll()
 {
+	if (pitchYawRollHasChanged)
+	{
+		pitchYawRoll = PitchYawRollFromQuaternion(GetRotation());
+		pitchYawRollHasChanged = false;
+	}
+
 	return pitchYawRoll;
 }
 
+DirectX::XMFLOAT4 Transform::GetRotation()
+{
+	return XMFLOAT4(system->rotationX[slot], system->rotationY[slot], system->rotationZ[slot], system->rotationW[slot]);
+}
+
 DirectX::XMFLOAT3 Transform::GetTranslation()
 {
-	return translation;
+	return XMFLOAT3(system->translationX[slot], system->translationY[slot], system->translationZ[slot]);
 }
 
 DirectX::XMFLOAT3 Transform::GetRight()
@@ -189,60 +368,82 @@ DirectX::XMFLOAT3 Transform::GetForward()
 
 DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
 {
-	if (worldMatrixHasChanged) {
-		
-		XMMATRIX w = XMMatrixIdentity();
+	// Only does anything if this (or a parent) changed since the system's last update
+	system->UpdateSlot(slot);
 
-		XMMATRIX s = XMMatrixScalingFromVector(XMLoadFloat3(&scale));
-		XMMATRIX r = XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
-		XMMATRIX t = XMMatrixTranslationFromVector(XMLoadFloat3(&translation));
+	return system->worlds[slot];
+}
 
-		// Step 1: Scale
-		w = XMMatrixMultiply(w, s);
-		// Step 2: Rotate
-		w = XMMatrixMultiply(w, r);
-		// Step 3: Translate
-		w = XMMatrixMultiply(w, t);
+DirectX::XMFLOAT4X4 Transform::GetWorldInvTranspose()
+{
+	system->UpdateSlot(slot);
 
-		// Store the result
-		XMStoreFloat4x4(&world, w);
-		XMStoreFloat4x4(&worldInverseTranspose,
-			XMMatrixInverse(0, XMMatrixTranspose(w)));
+	return system->worldInverseTransposes[slot];
+}
 
-		// And reset the change flag
-		worldMatrixHasChanged = false;
-	}
+void Transform::RecalculateDirectionVectors()
+{
+	// The rows of the rotation matrix are the rotated right, up and forward vectors
+	XMFLOAT4 rotation = GetRotation();
+	XMMATRIX rotationMatrix = XMMatrixRotationQuaternion(XMLoadFloat4(&rotation));
 
-	return world;
-}
+	// Store new values into original XMFLOAT3s
+	XMStoreFloat3(&right, rotationMatrix.r[0]);
+	XMStoreFloat3(&up, rotationMatrix.r[1]);
+	XMStoreFloat3(&forward, rotationMatrix.r[2]);
 
-DirectX::XMFLOAT4X4 Transform::GetWorldInvTranspose()
+	rotationHasChanged = false;
+}
+// --------------------------------------------------------
+// Flags this transform's world matrix (and so every child's)
+// as out of date, until the system's next update
+// - A transform that's already flagged has flagged children
+//    too, so this stops there rather than visiting the whole
+//    subtree again
+// --------------------------------------------------------
+void Transform::MarkWorldMatrixChanged()
 {
-	// Use GetWorldMatrix without storing the result to update worldInvTranspose if necessary.
-	GetWorldMatrix();
+	if (!system->MarkChanged(slot))
+		return;
 
-	return worldInverseTranspose;
+	for (Transform* child : children)
+		child->MarkWorldMatrixChanged();
 }
 
-void Transform::RecalculateDirectionVectors()
+// --------------------------------------------------------
+// Tells the system how deep this transform (and everything
+// under it) is, so it can update parents first
+// --------------------------------------------------------
+void Transform::UpdateDepths()
 {
-	// Reset vectors to world right, up, and forward
-	right = XMFLOAT3(1.0f, 0.0f, 0.0f);
-	up = XMFLOAT3(0.0f, 1.0f, 0.0f);
-	forward = XMFLOAT3(0.0f, 0.0f, 1.0f);
+	system->depths[slot] = parent ? system->depths[parent->slot] + 1 : 0;
+	for (Transform* child : children)
+		child->UpdateDepths();
+}
 
-	// Create a quaternion representing the current rotation
-	XMVECTOR rotationQuaternion = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
+void Transform::StoreScale(DirectX::XMFLOAT3 newScale)
+{
+	system->scaleX[slot] = newScale.x;
+	system->scaleY[slot] = newScale.y;
+	system->scaleZ[slot] = newScale.z;
+}
 
-	// Load XMVECTORs from XMFLOAT3s, then rotate those by the quaternion
-	XMVECTOR r = XMVector3Rotate(XMLoadFloat3(&right), rotationQuaternion);
-	XMVECTOR u = XMVector3Rotate(XMLoadFloat3(&up), rotationQuaternion);
-	XMVECTOR f = XMVector3Rotate(XMLoadFloat3(&forward), rotationQuaternion);
+void Transform::StoreRotation(DirectX::FXMVECTOR newRotation)
+{
+	XMFLOAT4 rotation;
+	XMStoreFloat4(&rotation, newRotation);
 
-	// Store new values into original XMFLOAT3s
-	XMStoreFloat3(&right, r);
-	XMStoreFloat3(&up, u);
-	XMStoreFloat3(&forward, f);
+	system->rotationX[slot] = rotation.x;
+	system->rotationY[slot] = rotation.y;
+	system->rotationZ[slot] = rotation.z;
+	system->rotationW[slot] = rotation.w;
 
-	rotationHasChanged = false;
-}
\ No newline at end of file
+	rotationHasChanged = true;
+}
+
+void Transform::StoreTranslation(DirectX::XMFLOAT3 newTranslation)
+{
+	system->translationX[slot] = newTranslation.x;
+	system->translationY[slot] = newTranslation.y;
+	system->translationZ[slot] = newTranslation.z;
+}
@@ -1,18 +1,68 @@
 #pragma once
 
 #include<DirectXMath.h>
+#include <vector>
 
+#include "TransformSystem.h"
+
+// --------------------------------------------------------
+// Scale, rotation and translation of one object, relative
+// to its parent (if it has one)
+// - The values themselves live in a TransformSystem, which
+//    updates every changed world matrix at once each frame
+// - World matrices asked for before then are recalculated
+//    on the spot, if this or one of its parents has changed
+// - Not copyable, since children point at their parent
+// --------------------------------------------------------
 class Transform
 {
 public:
 
+	// What rotations are kept as
+	// - Both keep a quaternion, so world matrices and direction
+	//    vectors never need to be rebuilt from angles
+	// - PitchYawRoll: the angles given are kept as they are, and
+	//    Rotate(p, y, r) adds to them
+	// - Quaternion: Rotate(p, y, r) turns the angles into a rotation
+	//    that follows the current one, and pitch/yaw/roll are only
+	//    worked out from the quaternion when asked for
+	enum class RotationMode
+	{
+		PitchYawRoll,
+		Quaternion
+	};
+
+	// Angles that would give the same rotation as a unit quaternion
+	static DirectX::XMFLOAT3 PitchYawRollFromQuaternion(DirectX::XMFLOAT4 quaternion);
+
 	Transform();
+	Transform(TransformSystem& transformSystem);
 	~Transform();
 
+	Transform(const Transform&) = delete;
+	Transform& operator=(const Transform&) = delete;
+
+	// Parents and children
+	// - Local values are kept, so the child moves with its new parent
+	// - Both must be in the same TransformSystem
+	void AddChild(Transform* child);
+	void RemoveChild(Transform* child);
+	void SetParent(Transform* newParent);
+	Transform* GetParent();
+	Transform* GetChild(unsigned int index);
+	unsigned int GetChildCount();
+	int IndexOfChild(Transform* child);
+
+	TransformSystem* GetSystem();
+
+	void SetRotationMode(RotationMode mode);
+	RotationMode GetRotationMode();
+
 	void SetScale(float x, float y, float z);
 	void SetScale(DirectX::XMFLOAT3 newScale);
 	void SetPitchYawRoll(float p, float y, float r);
 	void SetPitchYawRoll(DirectX::XMFLOAT3 newPitchYawRoll);
+	void SetRotation(DirectX::XMFLOAT4 newRotation);
 	void SetTranslation(float x, float y, float z);
 	void SetTranslation(DirectX::XMFLOAT3 newTranslation);
 
@@ -20,6 +70,8 @@ public:
 	void Scale(DirectX::XMFLOAT3 offset);
 	void Rotate(float p, float y, float r);
 	void Rotate(DirectX::XMFLOAT3 offset);
+	void Rotate(DirectX::XMFLOAT4 quaternion);
+	void RotateAxisAngle(DirectX::XMFLOAT3 axis, float angle);
 	void MoveAbsolute(float x, float y, float z);
 	void MoveAbsolute(DirectX::XMFLOAT3 offset);
 	void MoveRelative(float x, float y, float z);
@@ -27,6 +79,7 @@ public:
 
 	DirectX::XMFLOAT3 GetScale();
 	DirectX::XMFLOAT3 GetPitchYawRoll();
+	DirectX::XMFLOAT4 GetRotation();
 	DirectX::XMFLOAT3 GetTranslation();
 
 	DirectX::XMFLOAT3 GetRight();
@@ -38,19 +91,28 @@ public:
 
 private:
 
-	bool worldMatrixHasChanged;
+	RotationMode rotationMode;
 	bool rotationHasChanged;
 
-	DirectX::XMFLOAT3 scale;
+	// Angles last given (or worked out from the quaternion)
 	DirectX::XMFLOAT3 pitchYawRoll;
-	DirectX::XMFLOAT3 translation;
+	bool pitchYawRollHasChanged;
 
 	DirectX::XMFLOAT3 right;
 	DirectX::XMFLOAT3 up;
 	DirectX::XMFLOAT3 forward;
 
-	DirectX::XMFLOAT4X4 world;
-	DirectX::XMFLOAT4X4 worldInverseTranspose;
+	// Where scale, rotation, translation and world matrices are stored
+	TransformSystem* system;
+	unsigned int slot;
+
+	Transform* parent;
+	std::vector<Transform*> children;
 
 	void RecalculateDirectionVectors();
+	void MarkWorldMatrixChanged();
+	void UpdateDepths();
+	void StoreScale(DirectX::XMFLOAT3 newScale);
+	void StoreRotation(DirectX::FXMVECTOR newRotation);
+	void StoreTranslation(DirectX::XMFLOAT3 newTranslation);
 };
@@ -0,0 +1,306 @@
+#include "TransformSystem.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+TransformSystem::TransformSystem() :
+	count{ 0 }
+{
+}
+
+TransformSystem::~TransformSystem()
+{
+}
+
+TransformSystem& TransformSystem::Default()
+{
+	static TransformSystem system;
+	return system;
+}
+
+// --------------------------------------------------------
+// Recalculates the world matrices of every transform that
+// has changed (or has a parent that changed) since the last
+// update
+// - Changes already flagged every child below them, so this
+//    only needs each slot's own state
+// --------------------------------------------------------
+void TransformSystem::UpdateWorldMatrices()
+{
+	// Each slot only once, and only if it wasn't freed (or
+	// updated on its own) since it changed
+	queue.clear();
+	for (unsigned int slot : changedSlots)
+	{
+		if (states[slot] == SlotState::Changed)
+		{
+			states[slot] = SlotState::Queued;
+			queue.push_back(slot);
+		}
+	}
+	changedSlots.clear();
+
+	UpdateQueue();
+}
+
+// --------------------------------------------------------
+// Recalculates the world matrix of every transform, for
+// comparison against UpdateWorldMatrices()
+// --------------------------------------------------------
+void TransformSystem::RecalculateAllWorldMatrices()
+{
+	queue.clear();
+	for (unsigned int slot = 0; slot < states.size(); slot++)
+	{
+		if (states[slot] != SlotState::Free)
+		{
+			states[slot] = SlotState::Queued;
+			queue.push_back(slot);
+		}
+	}
+	changedSlots.clear();
+
+	UpdateQueue();
+}
+
+unsigned int TransformSystem::GetCount()
+{
+	return count;
+}
+
+// --------------------------------------------------------
+// Takes a free slot (or adds one) for a new Transform, with
+// no scale, rotation or translation
+// --------------------------------------------------------
+unsigned int TransformSystem::CreateSlot()
+{
+	unsigned int slot;
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		slot = (unsigned int)states.size();
+		scaleX.push_back(0); scaleY.push_back(0); scaleZ.push_back(0);
+		rotationX.push_back(0); rotationY.push_back(0); rotationZ.push_back(0); rotationW.push_back(0);
+		translationX.push_back(0); translationY.push_back(0); translationZ.push_back(0);
+		parents.push_back(-1);
+		depths.push_back(0);
+		states.push_back(SlotState::Free);
+		worlds.emplace_back();
+		worldInverseTransposes.emplace_back();
+	}
+
+	scaleX[slot] = scaleY[slot] = scaleZ[slot] = 1.0f;
+	rotationX[slot] = rotationY[slot] = rotationZ[slot] = 0.0f;
+	rotationW[slot] = 1.0f;
+	translationX[slot] = translationY[slot] = translationZ[slot] = 0.0f;
+	parents[slot] = -1;
+	depths[slot] = 0;
+	XMStoreFloat4x4(&worlds[slot], XMMatrixIdentity());
+	XMStoreFloat4x4(&worldInverseTransposes[slot], XMMatrixIdentity());
+	states[slot] = SlotState::Current;
+
+	count++;
+	return slot;
+}
+
+void TransformSystem::FreeSlot(unsigned int slot)
+{
+	// Anything left in changedSlots is skipped, since it's no longer Changed
+	states[slot] = SlotState::Free;
+	freeSlots.push_back(slot);
+	count--;
+}
+
+// --------------------------------------------------------
+// Flags a slot's world matrix as out of date
+// - Returns false if it already was
+// --------------------------------------------------------
+bool TransformSystem::MarkChanged(unsigned int slot)
+{
+	if (states[slot] != SlotState::Current)
+		return false;
+
+	states[slot] = SlotState::Changed;
+	changedSlots.push_back(slot);
+	return true;
+}
+
+// --------------------------------------------------------
+// Brings one slot (and any changed parents) up to date on
+// its own, for a Transform asked for its world matrix
+// between updates
+// --------------------------------------------------------
+void TransformSystem::UpdateSlot(unsigned int slot)
+{
+	if (states[slot] != SlotState::Changed)
+		return;
+
+	int parent = parents[slot];
+	if (parent >= 0)
+		UpdateSlot(parent);
+
+	// Same math as a full update, so results match exactly
+	CalculateLocalMatrices(&slot, 1);
+	if (parent >= 0)
+	{
+		XMStoreFloat4x4(&worlds[slot], XMMatrixMultiply(XMLoadFloat4x4(&worlds[slot]), XMLoadFloat4x4(&worlds[parent])));
+		XMStoreFloat4x4(&worldInverseTransposes[slot], XMMatrixMultiply(XMLoadFloat4x4(&worldInverseTransposes[slot]), XMLoadFloat4x4(&worldInverseTransposes[parent])));
+	}
+
+	// Still in changedSlots, but the next update will skip it
+	states[slot] = SlotState::Current;
+}
+
+// --------------------------------------------------------
+// Updates every slot in the queue
+// - Sorted by depth first (a counting sort, since depths
+//    are small), so parents always finish before children
+// - Local matrices don't depend on each other, so they're
+//    done in batches, then each child is multiplied by its
+//    (already finished) parent's world matrix
+// --------------------------------------------------------
+void TransformSystem::UpdateQueue()
+{
+	if (queue.empty())
+		return;
+
+	unsigned int maxDepth = 0;
+	for (unsigned int slot : queue)
+		maxDepth = std::max(maxDepth, depths[slot]);
+
+	if (maxDepth > 0)
+	{
+		depthStarts.assign(maxDepth + 2, 0);
+		for (unsigned int slot : queue)
+			depthStarts[depths[slot] + 1]++;
+		for (unsigned int d = 1; d < depthStarts.size(); d++)
+			depthStarts[d] += depthStarts[d - 1];
+
+		std::vector<unsigned int> sorted(queue.size());
+		for (unsigned int slot : queue)
+			sorted[depthStarts[depths[slot]]++] = slot;
+		queue.swap(sorted);
+	}
+
+	CalculateLocalMatrices(queue.data(), queue.size());
+
+	for (unsigned int slot : queue)
+	{
+		int parent = parents[slot];
+		if (parent >= 0)
+		{
+			XMStoreFloat4x4(&worlds[slot], XMMatrixMultiply(XMLoadFloat4x4(&worlds[slot]), XMLoadFloat4x4(&worlds[parent])));
+			XMStoreFloat4x4(&worldInverseTransposes[slot], XMMatrixMultiply(XMLoadFloat4x4(&worldInverseTransposes[slot]), XMLoadFloat4x4(&worldInverseTransposes[parent])));
+		}
+		states[slot] = SlotState::Current;
+	}
+}
+
+// --------------------------------------------------------
+// Builds the local world and inverse transpose matrices of
+// the given slots, four at a time (one slot per lane)
+// --------------------------------------------------------
+void TransformSystem::CalculateLocalMatrices(const unsigned int* slots, size_t slotCount)
+{
+	for (size_t first = 0; first < slotCount; first += 4)
+	{
+		// Repeat the last slot to fill any leftover lanes
+		unsigned int a = slots[first];
+		unsigned int b = slots[std::min(first + 1, slotCount - 1)];
+		unsigned int c = slots[std::min(first + 2, slotCount - 1)];
+		unsigned int d = slots[std::min(first + 3, slotCount - 1)];
+		auto gather = [&](const std::vector<float>& values) { return XMVectorSet(values[a], values[b], values[c], values[d]); };
+
+		Lanes lanes;
+		lanes.ScaleX = gather(scaleX);
+		lanes.ScaleY = gather(scaleY);
+		lanes.ScaleZ = gather(scaleZ);
+		lanes.RotationX = gather(rotationX);
+		lanes.RotationY = gather(rotationY);
+		lanes.RotationZ = gather(rotationZ);
+		lanes.RotationW = gather(rotationW);
+		lanes.TranslationX = gather(translationX);
+		lanes.TranslationY = gather(translationY);
+		lanes.TranslationZ = gather(translationZ);
+
+		XMFLOAT4X4* laneWorlds[4] = { &worlds[a], &worlds[b], &worlds[c], &worlds[d] };
+		XMFLOAT4X4* laneInverseTransposes[4] = { &worldInverseTransposes[a], &worldInverseTransposes[b], &worldInverseTransposes[c], &worldInverseTransposes[d] };
+		CalculateMatrices(lanes, std::min<size_t>(4, slotCount - first), laneWorlds, laneInverseTransposes);
+	}
+}
+
+// --------------------------------------------------------
+// Rotation follows XMMatrixRotationQuaternion, so there's
+// no trig here at all
+// - world = scale * rotation * translation, so row i of the
+//    upper 3x3 is row i of the rotation times scale i
+// - The inverse transpose doesn't need a general inverse:
+//    row i is (rotation row i / scale i, -dot(rotation row
+//    i, translation) / scale i), and the last row is 0001
+// --------------------------------------------------------
+void TransformSystem::CalculateMatrices(const Lanes& lanes, size_t laneCount,
+	DirectX::XMFLOAT4X4* const* laneWorlds, DirectX::XMFLOAT4X4* const* laneInverseTransposes)
+{
+	XMVECTOR sx = lanes.ScaleX, sy = lanes.ScaleY, sz = lanes.ScaleZ;
+	XMVECTOR tx = lanes.TranslationX, ty = lanes.TranslationY, tz = lanes.TranslationZ;
+	XMVECTOR qx = lanes.RotationX, qy = lanes.RotationY, qz = lanes.RotationZ, qw = lanes.RotationW;
+
+	// Products of the quaternion's components, doubled
+	XMVECTOR qx2 = XMVectorAdd(qx, qx), qy2 = XMVectorAdd(qy, qy), qz2 = XMVectorAdd(qz, qz);
+	XMVECTOR xx = XMVectorMultiply(qx, qx2), yy = XMVectorMultiply(qy, qy2), zz = XMVectorMultiply(qz, qz2);
+	XMVECTOR xy = XMVectorMultiply(qx, qy2), xz = XMVectorMultiply(qx, qz2), yz = XMVectorMultiply(qy, qz2);
+	XMVECTOR wx = XMVectorMultiply(qw, qx2), wy = XMVectorMultiply(qw, qy2), wz = XMVectorMultiply(qw, qz2);
+
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR one = XMVectorSplatOne();
+
+	// Rotation matrix, one element per vector
+	XMVECTOR r00 = XMVectorSubtract(one, XMVectorAdd(yy, zz));
+	XMVECTOR r01 = XMVectorAdd(xy, wz);
+	XMVECTOR r02 = XMVectorSubtract(xz, wy);
+	XMVECTOR r10 = XMVectorSubtract(xy, wz);
+	XMVECTOR r11 = XMVectorSubtract(one, XMVectorAdd(xx, zz));
+	XMVECTOR r12 = XMVectorAdd(yz, wx);
+	XMVECTOR r20 = XMVectorAdd(xz, wy);
+	XMVECTOR r21 = XMVectorSubtract(yz, wx);
+	XMVECTOR r22 = XMVectorSubtract(one, XMVectorAdd(xx, yy));
+
+	// World rows, one matrix per lane
+	XMVECTOR world[4][4] =
+	{
+		{ XMVectorMultiply(r00, sx), XMVectorMultiply(r01, sx), XMVectorMultiply(r02, sx), zero },
+		{ XMVectorMultiply(r10, sy), XMVectorMultiply(r11, sy), XMVectorMultiply(r12, sy), zero },
+		{ XMVectorMultiply(r20, sz), XMVectorMultiply(r21, sz), XMVectorMultiply(r22, sz), zero },
+		{ tx, ty, tz, one }
+	};
+
+	// Inverse transpose rows
+	XMVECTOR ix = XMVectorDivide(one, sx);
+	XMVECTOR iy = XMVectorDivide(one, sy);
+	XMVECTOR iz = XMVectorDivide(one, sz);
+	auto dotTranslation = [&](XMVECTOR m0, XMVECTOR m1, XMVECTOR m2) { return XMVectorAdd(XMVectorAdd(XMVectorMultiply(m0, tx), XMVectorMultiply(m1, ty)), XMVectorMultiply(m2, tz)); };
+	XMVECTOR inverseTranspose[4][4] =
+	{
+		{ XMVectorMultiply(r00, ix), XMVectorMultiply(r01, ix), XMVectorMultiply(r02, ix), XMVectorNegate(XMVectorMultiply(dotTranslation(r00, r01, r02), ix)) },
+		{ XMVectorMultiply(r10, iy), XMVectorMultiply(r11, iy), XMVectorMultiply(r12, iy), XMVectorNegate(XMVectorMultiply(dotTranslation(r10, r11, r12), iy)) },
+		{ XMVectorMultiply(r20, iz), XMVectorMultiply(r21, iz), XMVectorMultiply(r22, iz), XMVectorNegate(XMVectorMultiply(dotTranslation(r20, r21, r22), iz)) },
+		{ zero, zero, zero, one }
+	};
+
+	// Transposing the 4 element vectors of a row gives that row of each lane's matrix
+	for (int row = 0; row < 4; row++)
+	{
+		XMMATRIX worldRows = XMMatrixTranspose(XMMATRIX(world[row][0], world[row][1], world[row][2], world[row][3]));
+		XMMATRIX inverseTransposeRows = XMMatrixTranspose(XMMATRIX(inverseTranspose[row][0], inverseTranspose[row][1], inverseTranspose[row][2], inverseTranspose[row][3]));
+		for (size_t lane = 0; lane < laneCount; lane++)
+		{
+			XMStoreFloat4((XMFLOAT4*)laneWorlds[lane]->m[row], worldRows.r[lane]);
+			XMStoreFloat4((XMFLOAT4*)laneInverseTransposes[lane]->m[row], inverseTransposeRows.r[lane]);
+		}
+	}
+}
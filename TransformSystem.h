@@ -0,0 +1,94 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Storage for many transforms at once, with each part of
+// scale, rotation and translation in its own array, so
+// world matrices can be calculated several at a time
+// - Transform is a handle to one slot in a system, and is
+//    how everything else reads and changes these values
+// - Changed transforms are queued, and UpdateWorldMatrices()
+//    recalculates all of them together (parents first)
+// --------------------------------------------------------
+class TransformSystem
+{
+public:
+
+	TransformSystem();
+	~TransformSystem();
+
+	TransformSystem(const TransformSystem&) = delete;
+	TransformSystem& operator=(const TransformSystem&) = delete;
+
+	// The system every Transform uses unless it's given another one
+	static TransformSystem& Default();
+
+	// Recalculates the world matrices of every changed transform
+	// (and everything below them), four at a time
+	void UpdateWorldMatrices();
+
+	// Recalculates every world matrix, changed or not
+	void RecalculateAllWorldMatrices();
+
+	// How many transforms are using this system right now
+	unsigned int GetCount();
+
+	// Scale, rotation (a unit quaternion) and translation of up to four
+	// transforms, one per lane
+	struct Lanes
+	{
+		DirectX::XMVECTOR ScaleX, ScaleY, ScaleZ;
+		DirectX::XMVECTOR RotationX, RotationY, RotationZ, RotationW;
+		DirectX::XMVECTOR TranslationX, TranslationY, TranslationZ;
+	};
+
+	// Builds the world and inverse transpose matrices of each lane, ignoring
+	// any parents, and stores the first laneCount of them
+	static void CalculateMatrices(const Lanes& lanes, size_t laneCount,
+		DirectX::XMFLOAT4X4* const* laneWorlds, DirectX::XMFLOAT4X4* const* laneInverseTransposes);
+
+private:
+
+	// Transform is a view onto one slot
+	friend class Transform;
+
+	// What a slot holds
+	enum class SlotState : unsigned char
+	{
+		Free,		// Not used by any Transform
+		Current,	// World matrices are up to date
+		Changed,	// In the changed list, waiting for an update
+		Queued		// Being updated right now
+	};
+
+	// Local values, one array per component (rotation is a unit quaternion)
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> translationX, translationY, translationZ;
+
+	// Parent slot (or -1) and how many parents are above each slot
+	std::vector<int> parents;
+	std::vector<unsigned int> depths;
+
+	std::vector<SlotState> states;
+	std::vector<DirectX::XMFLOAT4X4> worlds;
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTransposes;
+
+	// Slots flagged since the last update (possibly more than once)
+	std::vector<unsigned int> changedSlots;
+	std::vector<unsigned int> freeSlots;
+	unsigned int count;
+
+	// Scratch space for updates, kept to avoid reallocating
+	std::vector<unsigned int> queue;
+	std::vector<unsigned int> depthStarts;
+
+	unsigned int CreateSlot();
+	void FreeSlot(unsigned int slot);
+	bool MarkChanged(unsigned int slot);
+	void UpdateSlot(unsigned int slot);
+	void UpdateQueue();
+	void CalculateLocalMatrices(const unsigned int* slots, size_t slotCount);
+};
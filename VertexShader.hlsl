@@ -1,11 +1,10 @@
 #include "ShaderIncludes.hlsli"
 
 // Description of constant buffer data
-cbuffer ExternalData : register(b0)
+// - The camera's matrices are in PerFrame (see ShaderIncludes.hlsli)
+cbuffer PerObject : register(b2)
 {
     matrix world;
-    matrix projection;
-    matrix view;
     matrix worldInvTranspose;
 }
 
@@ -21,9 +20,9 @@ VertexToPixel main( VertexShaderInput input )
 	// Set up output struct
 	VertexToPixel output;
 	
-	// Create a WPV (world, projection, view) matrix by combining the three matrices passed to the constant buffer
+	// Create a WPV (world, projection, view) matrix from the world matrix and the camera's view-projection
 	// Because our C++ matrices are left-handed and HLSL matrices are right-handed, multiply them in the opposite order (VPW)
-    matrix wpv = mul(projection, mul(view, world));
+    matrix wpv = mul(viewProjection, world);
 
 	// Here we're essentially passing the input position directly through to the next
 	// stage (rasterizer), though it needs to be a 4-component vector now.  
@@ -0,0 +1,91 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned int threadCount) :
+	generation(0),
+	jobCount(0),
+	jobsRemaining(0),
+	job(nullptr),
+	stopping(false)
+{
+	for (unsigned int i = 1; i < std::max(threadCount, 1u); i++)
+		threads.emplace_back(&WorkerPool::WorkerLoop, this, i);
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	workReady.notify_all();
+
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+void WorkerPool::Run(unsigned int jobCount, const std::function<void(unsigned int)>& job)
+{
+	jobCount = std::clamp(jobCount, 1u, GetThreadCount());
+	if (jobCount > 1)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			this->jobCount = jobCount;
+			this->jobsRemaining = jobCount - 1;
+			this->job = &job;
+			generation++;
+		}
+		workReady.notify_all();
+	}
+
+	job(0);
+
+	if (jobCount > 1)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		workDone.wait(lock, [&] { return jobsRemaining == 0; });
+		this->job = nullptr;
+	}
+}
+
+unsigned int WorkerPool::GetThreadCount() const
+{
+	return (unsigned int)threads.size() + 1;
+}
+
+// --------------------------------------------------------
+// Waits for each Run(), does this worker's job if there is
+// one for it, and goes back to waiting
+// - Workers past the job count sleep straight through
+// --------------------------------------------------------
+void WorkerPool::WorkerLoop(unsigned int worker)
+{
+	unsigned long long seenGeneration = 0;
+	while (true)
+	{
+		const std::function<void(unsigned int)>* currentJob;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workReady.wait(lock, [&] { return stopping || generation != seenGeneration; });
+			if (stopping)
+				return;
+
+			seenGeneration = generation;
+			if (worker >= jobCount)
+				continue;
+			currentJob = job;
+		}
+
+		(*currentJob)(worker);
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			last = --jobsRemaining == 0;
+		}
+		if (last)
+			workDone.notify_one();
+	}
+}
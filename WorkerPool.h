@@ -0,0 +1,49 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// Threads made once and kept waiting, for work that's split
+// into jobs every frame
+// - Run() wakes them rather than making new threads, so a
+//    frame doesn't pay to create and join one per job
+// - The calling thread runs job 0 itself, so a pool of N
+//    threads keeps N - 1 of its own
+// - One Run() at a time, from one thread
+// --------------------------------------------------------
+class WorkerPool
+{
+public:
+	WorkerPool(unsigned int threadCount);
+	~WorkerPool();
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// Calls job(i) for i in [0, jobCount), with every job on a different
+	// thread, and returns once they're all done
+	// - jobCount is clamped to GetThreadCount()
+	void Run(unsigned int jobCount, const std::function<void(unsigned int)>& job);
+
+	// Including the thread that calls Run()
+	unsigned int GetThreadCount() const;
+
+private:
+	void WorkerLoop(unsigned int worker);
+
+	std::vector<std::thread> threads;
+
+	// Guarded by mutex; each Run() bumps generation to wake the workers,
+	// and the last job to finish wakes Run() back up
+	std::mutex mutex;
+	std::condition_variable workReady;
+	std::condition_variable workDone;
+	unsigned long long generation;
+	unsigned int jobCount;
+	unsigned int jobsRemaining;
+	const std::function<void(unsigned int)>* job;
+	bool stopping;
+};